@@ -0,0 +1,848 @@
+/* This work is licensed under a Creative Commons CCZero 1.0 Universal License.
+ * See http://creativecommons.org/publicdomain/zero/1.0/ for more information.
+ */
+
+/**
+ * NetworkMessage Encoding Benchmark
+ * ---------------------------------
+ * Measures the UADP encoding functions in isolation: the size calculation
+ * done by ``sendNetworkMessage`` (``UA_DataSetMessage_calcSizeBinary`` for
+ * every DataSetMessage and ``UA_NetworkMessage_calcSizeBinary``),
+ * ``UA_NetworkMessage_encodeBinary`` into a preallocated buffer and
+ * ``UA_NetworkMessage_decodeBinary`` followed by ``UA_NetworkMessage_clear``.
+ *
+ * Every operation is warmed up and then measured in several runs. The median
+ * run is printed in ns per NetworkMessage together with the number of heap
+ * allocations per NetworkMessage. The thread is pinned to one CPU. Allocations
+ * are counted through ``UA_ENABLE_MALLOC_SINGLETON`` if enabled, otherwise by
+ * interposing the glibc allocator.
+ *
+ * Without shape options a fixed suite of shapes is measured. Usage:
+ *
+ *    bench_networkmessage [-fields <n>] [-type scalar|array|string|mix]
+ *                         [-array <n>] [-string <n>]
+ *                         [-encoding variant|datavalue|raw] [-dsm <n>]
+ *                         [-delta <n>] [-iterations <n>] [-cpu <n>]
+ *
+ * ``-delta <n>`` sends delta frames with n changed fields instead of key
+ * frames.
+ *
+ * With ``UA_ENABLE_PUBSUB_ENCRYPTION``, the message security is measured on
+ * the encoded message with the PubSub-Aes256-CTR policy: ``sign`` and
+ * ``encrypt`` protect the message in place, ``verify`` and ``decrypt`` check
+ * and decode it. The latter two include the decoding and compare to
+ * ``decode``.
+ *
+ * With ``UA_ENABLE_PUBSUB_GENERATED_CODEC``, the DataSet of publish_time is
+ * first encoded with the codec generated from ``publish_time.csv`` and with
+ * the generic encoding. The benchmark fails if the bytes differ or if one
+ * path cannot decode the message of the other.
+ *
+ * The chunk reassembler is checked first with a DataSetMessage that arrives
+ * as 1-byte chunks in a scattered order, with a repeated chunk, and with a
+ * chunk of a DataSetMessage that is too large to decode. The benchmark fails
+ * if the reassembled message differs or the large one is not rejected. */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE /* sched_setaffinity */
+#endif
+
+#include <open62541/types.h>
+#include <open62541/types_generated.h>
+#include <open62541/types_generated_handling.h>
+
+#include "ua_pubsub_networkmessage.h"
+#include "ua_pubsub_codec.h"
+#include "ua_pubsub_chunk.h"
+#ifdef UA_ENABLE_PUBSUB_ENCRYPTION
+#include "ua_pubsub_security.h"
+#endif
+#ifdef UA_ENABLE_PUBSUB_GENERATED_CODEC
+#include "publish_time_codec.h"
+#endif
+
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define BENCH_RUNS 5
+
+static UA_UInt64
+nowNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (UA_UInt64)ts.tv_sec * 1000000000 + (UA_UInt64)ts.tv_nsec;
+}
+
+/**
+ * Allocation Counting
+ * ~~~~~~~~~~~~~~~~~~~ */
+
+static UA_Boolean counting = false;
+static size_t allocations = 0;
+
+#if defined(UA_ENABLE_MALLOC_SINGLETON)
+#define BENCH_COUNT_ALLOCATIONS 1
+
+static void *
+countingMalloc(size_t size) {
+    allocations += counting;
+    return malloc(size);
+}
+
+static void *
+countingCalloc(size_t nelem, size_t elsize) {
+    allocations += counting;
+    return calloc(nelem, elsize);
+}
+
+static void *
+countingRealloc(void *ptr, size_t size) {
+    allocations += counting;
+    return realloc(ptr, size);
+}
+
+static void
+installCounter(void) {
+    UA_mallocSingleton = countingMalloc;
+    UA_callocSingleton = countingCalloc;
+    UA_reallocSingleton = countingRealloc;
+}
+
+#elif defined(__GLIBC__)
+#define BENCH_COUNT_ALLOCATIONS 1
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nelem, size_t elsize);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+void *
+malloc(size_t size) {
+    allocations += counting;
+    return __libc_malloc(size);
+}
+
+void *
+calloc(size_t nelem, size_t elsize) {
+    allocations += counting;
+    return __libc_calloc(nelem, elsize);
+}
+
+void *
+realloc(void *ptr, size_t size) {
+    allocations += counting;
+    return __libc_realloc(ptr, size);
+}
+
+static void
+installCounter(void) {}
+
+#else
+#define BENCH_COUNT_ALLOCATIONS 0
+
+static void
+installCounter(void) {}
+
+#endif
+
+/**
+ * Message Shapes
+ * ~~~~~~~~~~~~~~ */
+
+typedef enum {
+    FIELDS_SCALAR, /* alternating UInt32 and Double */
+    FIELDS_ARRAY,  /* Double arrays */
+    FIELDS_STRING,
+    FIELDS_MIX     /* scalar, array and string in turn */
+} FieldType;
+
+typedef struct {
+    size_t fields;
+    FieldType type;
+    size_t arraySize;
+    size_t stringSize;
+    UA_FieldEncoding encoding;
+    size_t dsmCount;
+    size_t deltaFields; /* 0 for key frames */
+} Shape;
+
+static const char *typeNames[] = {"scalar", "array", "string", "mix"};
+static const char *encodingNames[] = {"variant", "raw", "datavalue"};
+
+static void
+setFieldValue(const Shape *shape, size_t index, UA_DataValue *value) {
+    UA_DataValue_init(value);
+    value->hasValue = true;
+    FieldType type = shape->type;
+    if(type == FIELDS_MIX)
+        type = (FieldType)(index % 3);
+    if(type == FIELDS_SCALAR) {
+        if(index % 2 == 0) {
+            UA_UInt32 v = (UA_UInt32)index;
+            UA_Variant_setScalarCopy(&value->value, &v, &UA_TYPES[UA_TYPES_UINT32]);
+        } else {
+            UA_Double v = (UA_Double)index * 0.5;
+            UA_Variant_setScalarCopy(&value->value, &v, &UA_TYPES[UA_TYPES_DOUBLE]);
+        }
+    } else if(type == FIELDS_ARRAY) {
+        UA_Double *v = (UA_Double *)UA_Array_new(shape->arraySize, &UA_TYPES[UA_TYPES_DOUBLE]);
+        for(size_t i = 0; v && i < shape->arraySize; i++)
+            v[i] = (UA_Double)i;
+        UA_Variant_setArray(&value->value, v, v ? shape->arraySize : 0,
+                            &UA_TYPES[UA_TYPES_DOUBLE]);
+    } else {
+        UA_String v;
+        UA_ByteString_allocBuffer(&v, shape->stringSize);
+        if(v.length > 0)
+            memset(v.data, 'a' + (int)(index % 26), v.length);
+        UA_Variant_setScalarCopy(&value->value, &v, &UA_TYPES[UA_TYPES_STRING]);
+        UA_String_deleteMembers(&v);
+    }
+    if(shape->encoding == UA_FIELDENCODING_DATAVALUE) {
+        value->hasSourceTimestamp = true;
+        value->sourceTimestamp = UA_DateTime_now();
+    }
+}
+
+/* Builds a NetworkMessage with the headers that publish_time sends */
+static void
+buildNetworkMessage(const Shape *shape, UA_NetworkMessage *nm) {
+    memset(nm, 0, sizeof(UA_NetworkMessage));
+    nm->version = 1;
+    nm->networkMessageType = UA_NETWORKMESSAGE_DATASET;
+    nm->publisherIdEnabled = true;
+    nm->publisherIdType = UA_PUBLISHERDATATYPE_UINT16;
+    nm->publisherId.publisherIdUInt16 = 2234;
+    nm->groupHeaderEnabled = true;
+    nm->groupHeader.writerGroupIdEnabled = true;
+    nm->groupHeader.writerGroupId = 100;
+    nm->payloadHeaderEnabled = true;
+
+    UA_Byte dsmCount = (UA_Byte)shape->dsmCount;
+    UA_UInt16 *writerIds = (UA_UInt16 *)UA_calloc(dsmCount, sizeof(UA_UInt16));
+    UA_UInt16 *sizes = (UA_UInt16 *)UA_calloc(dsmCount, sizeof(UA_UInt16));
+    UA_DataSetMessage *dsm = (UA_DataSetMessage *)UA_calloc(dsmCount, sizeof(UA_DataSetMessage));
+    nm->payloadHeader.dataSetPayloadHeader.count = dsmCount;
+    nm->payloadHeader.dataSetPayloadHeader.dataSetWriterIds = writerIds;
+    nm->payload.dataSetPayload.sizes = sizes;
+    nm->payload.dataSetPayload.dataSetMessages = dsm;
+
+    for(size_t i = 0; i < dsmCount; i++) {
+        writerIds[i] = (UA_UInt16)(62541 + i);
+        dsm[i].header.dataSetMessageValid = true;
+        dsm[i].header.fieldEncoding = shape->encoding;
+        dsm[i].header.dataSetMessageSequenceNrEnabled = true;
+        dsm[i].header.dataSetMessageSequenceNr = (UA_UInt16)i;
+        if(shape->deltaFields == 0) {
+            dsm[i].header.dataSetMessageType = UA_DATASETMESSAGE_DATAKEYFRAME;
+            UA_DataSetMessage_DataKeyFrameData *kf = &dsm[i].data.keyFrameData;
+            kf->fieldCount = (UA_UInt16)shape->fields;
+            kf->dataSetFields = (UA_DataValue *)
+                UA_Array_new(shape->fields, &UA_TYPES[UA_TYPES_DATAVALUE]);
+            for(size_t j = 0; j < shape->fields; j++)
+                setFieldValue(shape, j, &kf->dataSetFields[j]);
+        } else {
+            /* The changed fields are spread over the DataSet */
+            dsm[i].header.dataSetMessageType = UA_DATASETMESSAGE_DATADELTAFRAME;
+            UA_DataSetMessage_DataDeltaFrameData *df = &dsm[i].data.deltaFrameData;
+            df->fieldCount = (UA_UInt16)shape->deltaFields;
+            df->deltaFrameFields = (UA_DataSetMessage_DeltaFrameField *)
+                UA_calloc(shape->deltaFields, sizeof(UA_DataSetMessage_DeltaFrameField));
+            size_t stride = shape->fields / shape->deltaFields;
+            for(size_t j = 0; j < shape->deltaFields; j++) {
+                df->deltaFrameFields[j].fieldIndex = (UA_UInt16)(j * stride);
+                setFieldValue(shape, j * stride, &df->deltaFrameFields[j].fieldValue);
+            }
+        }
+    }
+}
+
+static void
+freeNetworkMessage(UA_NetworkMessage *nm) {
+    UA_DataSetMessage *dsm = nm->payload.dataSetPayload.dataSetMessages;
+    for(size_t i = 0; i < nm->payloadHeader.dataSetPayloadHeader.count; i++) {
+        if(dsm[i].header.dataSetMessageType == UA_DATASETMESSAGE_DATAKEYFRAME) {
+            UA_Array_delete(dsm[i].data.keyFrameData.dataSetFields,
+                            dsm[i].data.keyFrameData.fieldCount,
+                            &UA_TYPES[UA_TYPES_DATAVALUE]);
+        } else {
+            UA_DataSetMessage_DataDeltaFrameData *df = &dsm[i].data.deltaFrameData;
+            for(size_t j = 0; j < df->fieldCount; j++)
+                UA_DataValue_deleteMembers(&df->deltaFrameFields[j].fieldValue);
+            UA_free(df->deltaFrameFields);
+        }
+    }
+    UA_free(dsm);
+    UA_free(nm->payload.dataSetPayload.sizes);
+    UA_free(nm->payloadHeader.dataSetPayloadHeader.dataSetWriterIds);
+}
+
+/**
+ * Operations
+ * ~~~~~~~~~~ */
+
+typedef struct {
+    UA_NetworkMessage *nm;
+    UA_ByteString buffer;  /* encoded message */
+#ifdef UA_ENABLE_PUBSUB_ENCRYPTION
+    UA_PubSubSecurityContext *security;
+    UA_ByteString secured; /* encoded with the security header */
+    UA_ByteString work;    /* copy of secured that is changed in place */
+    size_t payloadOffset;
+#endif
+    UA_StatusCode result;
+} BenchContext;
+
+typedef void (*BenchOperation)(BenchContext *ctx);
+
+static void
+opSize(BenchContext *ctx) {
+    UA_NetworkMessage *nm = ctx->nm;
+    UA_DataSetMessage *dsm = nm->payload.dataSetPayload.dataSetMessages;
+    for(size_t i = 0; i < nm->payloadHeader.dataSetPayloadHeader.count; i++)
+        nm->payload.dataSetPayload.sizes[i] = (UA_UInt16)UA_DataSetMessage_calcSizeBinary(&dsm[i]);
+    if(UA_NetworkMessage_calcSizeBinary(nm) != ctx->buffer.length)
+        ctx->result = UA_STATUSCODE_BADINTERNALERROR;
+}
+
+static void
+opEncode(BenchContext *ctx) {
+    UA_Byte *bufPos = ctx->buffer.data;
+    const UA_Byte *bufEnd = &ctx->buffer.data[ctx->buffer.length];
+    UA_StatusCode res = UA_NetworkMessage_encodeBinary(ctx->nm, &bufPos, bufEnd);
+    if(res != UA_STATUSCODE_GOOD)
+        ctx->result = res;
+}
+
+static void
+opDecode(BenchContext *ctx) {
+    UA_NetworkMessage decoded;
+    memset(&decoded, 0, sizeof(UA_NetworkMessage));
+    size_t offset = 0;
+    UA_StatusCode res = UA_NetworkMessage_decodeBinary(&ctx->buffer, &offset, &decoded);
+    if(res != UA_STATUSCODE_GOOD)
+        ctx->result = res;
+    UA_NetworkMessage_clear(&decoded);
+}
+
+static int
+compareUInt64(const void *a, const void *b) {
+    UA_UInt64 x = *(const UA_UInt64 *)a, y = *(const UA_UInt64 *)b;
+    return (x > y) - (x < y);
+}
+
+/* Warm up for a quarter of the iterations and at least 50ms. Returns the
+ * median run in ns per operation and the allocations per operation. */
+static UA_StatusCode
+measure(BenchOperation op, BenchContext *ctx, size_t iterations,
+        double *nsPerOp, double *allocsPerOp) {
+    ctx->result = UA_STATUSCODE_GOOD;
+    UA_UInt64 warmupEnd = nowNs() + 50000000;
+    for(size_t i = 0; i < iterations / 4 || nowNs() < warmupEnd; i++)
+        op(ctx);
+    if(ctx->result != UA_STATUSCODE_GOOD)
+        return ctx->result;
+
+    UA_UInt64 runs[BENCH_RUNS];
+    allocations = 0;
+    counting = true;
+    for(size_t r = 0; r < BENCH_RUNS; r++) {
+        UA_UInt64 start = nowNs();
+        for(size_t i = 0; i < iterations; i++)
+            op(ctx);
+        runs[r] = nowNs() - start;
+    }
+    counting = false;
+    qsort(runs, BENCH_RUNS, sizeof(UA_UInt64), compareUInt64);
+    *nsPerOp = (double)runs[BENCH_RUNS / 2] / (double)iterations;
+    *allocsPerOp = (double)allocations / (double)(iterations * BENCH_RUNS);
+    return ctx->result;
+}
+
+static void
+printResult(const char *op, UA_StatusCode res, double ns, double allocs, size_t bytes) {
+    if(res != UA_STATUSCODE_GOOD) {
+        printf("  %-7s %s\n", op, UA_StatusCode_name(res));
+        return;
+    }
+    printf("  %-7s %10.1f ns/msg %8.1f MB/s", op, ns, (double)bytes * 1e3 / ns);
+    if(BENCH_COUNT_ALLOCATIONS)
+        printf(" %8.2f allocs/msg\n", allocs);
+    else
+        printf("\n");
+}
+
+#ifdef UA_ENABLE_PUBSUB_ENCRYPTION
+
+static void
+opProtect(BenchContext *ctx) {
+    UA_StatusCode res =
+        UA_PubSubSecurityContext_protect(ctx->security, &ctx->work, ctx->payloadOffset);
+    if(res != UA_STATUSCODE_GOOD)
+        ctx->result = res;
+}
+
+/* ctx->secured holds the protected message */
+static void
+opVerify(BenchContext *ctx) {
+    memcpy(ctx->work.data, ctx->secured.data, ctx->secured.length);
+    UA_NetworkMessage decoded;
+    memset(&decoded, 0, sizeof(UA_NetworkMessage));
+    UA_StatusCode res =
+        UA_PubSubSecurityContext_decode(ctx->security, &ctx->work, &decoded, NULL, 0);
+    if(res != UA_STATUSCODE_GOOD)
+        ctx->result = res;
+    UA_NetworkMessage_clear(&decoded);
+}
+
+/* Measures protecting and checking in the mode */
+static void
+runSecurity(BenchContext *ctx, UA_MessageSecurityMode mode, size_t iterations) {
+    UA_PubSubSecurityConfig config;
+    memset(&config, 0, sizeof(UA_PubSubSecurityConfig));
+    config.policy = UA_PUBSUB_SECURITYPOLICY_AES256CTR;
+    config.mode = mode;
+    config.securityTokenId = 1;
+    for(size_t i = 0; i < UA_PUBSUB_SECURITY_SIGNINGKEY_LENGTH; i++)
+        config.signingKey[i] = (UA_Byte)i;
+    for(size_t i = 0; i < UA_PUBSUB_SECURITY_ENCRYPTINGKEY_MAXLENGTH; i++)
+        config.encryptingKey[i] = (UA_Byte)(0x80 + i);
+    const char *protectName = (mode == UA_MESSAGESECURITYMODE_SIGN) ? "sign" : "encrypt";
+    const char *checkName = (mode == UA_MESSAGESECURITYMODE_SIGN) ? "verify" : "decrypt";
+
+    ctx->security = UA_PubSubSecurityContext_new(&config);
+    if(!ctx->security) {
+        printf("  %-7s %s\n", protectName, UA_StatusCode_name(UA_STATUSCODE_BADINTERNALERROR));
+        return;
+    }
+
+    /* Encode with the security header and the generic field encoding */
+    UA_Byte nonce[UA_PUBSUB_SECURITY_MESSAGENONCE_LENGTH];
+    UA_NetworkMessage nm = *ctx->nm;
+    UA_PubSubSecurityContext_setHeader(ctx->security, &nm, nonce);
+    const UA_DataSetCodec **codecs = (const UA_DataSetCodec **)
+        UA_calloc(nm.payloadHeader.dataSetPayloadHeader.count, sizeof(UA_DataSetCodec *));
+    size_t size = codecs ? UA_NetworkMessage_calcSizeBinaryCodec(&nm, codecs) : 0;
+    UA_StatusCode res = UA_STATUSCODE_BADNOTSUPPORTED;
+    if(size > 0) {
+        size += UA_PUBSUB_SECURITY_SIGNATURE_LENGTH;
+        ctx->payloadOffset = UA_NetworkMessage_calcSizeHeadersCodec(&nm);
+        res = UA_ByteString_allocBuffer(&ctx->secured, size);
+    }
+    if(res == UA_STATUSCODE_GOOD)
+        res = UA_ByteString_allocBuffer(&ctx->work, size);
+    if(res == UA_STATUSCODE_GOOD) {
+        UA_Byte *bufPos = ctx->secured.data;
+        res = UA_NetworkMessage_encodeBinaryCodec(&nm, codecs, &bufPos, &ctx->secured.data[size]);
+    }
+    if(res == UA_STATUSCODE_GOOD) {
+        double ns = 0.0, allocs = 0.0;
+        memcpy(ctx->work.data, ctx->secured.data, size);
+        res = measure(opProtect, ctx, iterations, &ns, &allocs);
+        printResult(protectName, res, ns, allocs, size);
+        /* secured still holds the plain message */
+        res = UA_PubSubSecurityContext_protect(ctx->security, &ctx->secured, ctx->payloadOffset);
+        if(res == UA_STATUSCODE_GOOD)
+            res = measure(opVerify, ctx, iterations, &ns, &allocs);
+        printResult(checkName, res, ns, allocs, size);
+    } else {
+        printResult(protectName, res, 0.0, 0.0, 0);
+    }
+
+    UA_free(codecs);
+    UA_ByteString_deleteMembers(&ctx->secured);
+    UA_ByteString_deleteMembers(&ctx->work);
+    UA_PubSubSecurityContext_delete(ctx->security);
+    ctx->security = NULL;
+}
+
+#endif /* UA_ENABLE_PUBSUB_ENCRYPTION */
+
+#ifdef UA_ENABLE_PUBSUB_GENERATED_CODEC
+
+/**
+ * Generated Codec Check
+ * ~~~~~~~~~~~~~~~~~~~~~ */
+
+/* Encodes with the generic encoding. Sets the sizes of the DataSetMessages.
+ * Decoded messages with one DataSetMessage have no sizes. */
+static UA_StatusCode
+encodeGeneric(UA_NetworkMessage *nm, UA_ByteString *buf) {
+    UA_DataSetMessage *dsm = nm->payload.dataSetPayload.dataSetMessages;
+    for(size_t i = 0; nm->payload.dataSetPayload.sizes &&
+            i < nm->payloadHeader.dataSetPayloadHeader.count; i++)
+        nm->payload.dataSetPayload.sizes[i] = (UA_UInt16)UA_DataSetMessage_calcSizeBinary(&dsm[i]);
+    UA_StatusCode res = UA_ByteString_allocBuffer(buf, UA_NetworkMessage_calcSizeBinary(nm));
+    if(res != UA_STATUSCODE_GOOD)
+        return res;
+    UA_Byte *bufPos = buf->data;
+    res = UA_NetworkMessage_encodeBinary(nm, &bufPos, &buf->data[buf->length]);
+    if(res == UA_STATUSCODE_GOOD && bufPos != &buf->data[buf->length])
+        res = UA_STATUSCODE_BADENCODINGERROR;
+    return res;
+}
+
+/* Decodes buf and checks that the generic encoding of the result is
+ * expected */
+static UA_StatusCode
+checkDecoded(const UA_ByteString *buf, const UA_DataSetCodec *codec,
+             const UA_ByteString *expected) {
+    UA_NetworkMessage decoded;
+    memset(&decoded, 0, sizeof(UA_NetworkMessage));
+    size_t offset = 0;
+    UA_StatusCode res = codec ?
+        UA_NetworkMessage_decodeBinaryCodec(buf, &offset, &decoded, &codec, 1) :
+        UA_NetworkMessage_decodeBinary(buf, &offset, &decoded);
+    UA_ByteString reencoded;
+    UA_ByteString_init(&reencoded);
+    if(res == UA_STATUSCODE_GOOD)
+        res = encodeGeneric(&decoded, &reencoded);
+    if(res == UA_STATUSCODE_GOOD &&
+       (reencoded.length != expected->length ||
+        memcmp(reencoded.data, expected->data, expected->length) != 0))
+        res = UA_STATUSCODE_BADDECODINGERROR;
+    UA_ByteString_deleteMembers(&reencoded);
+    UA_NetworkMessage_clear(&decoded);
+    return res;
+}
+
+/* The DataSet of publish_time in the order of publish_time.csv */
+static UA_StatusCode
+checkPublishTimeCodec(void) {
+    Shape shape = {4, FIELDS_SCALAR, 0, 0, UA_FIELDENCODING_VARIANT, 1, 0};
+    UA_NetworkMessage nm;
+    buildNetworkMessage(&shape, &nm);
+    UA_DataValue *fields = nm.payload.dataSetPayload.dataSetMessages[0].data.keyFrameData.dataSetFields;
+    for(size_t i = 0; i < 4; i++)
+        UA_DataValue_deleteMembers(&fields[i]);
+    UA_Double array[5] = {0.0, -1.5, 2.25, 1e300, -0.0};
+    UA_String publisher = UA_STRING("Publisher 1");
+    UA_UInt32 counter = 0xDEADBEEF;
+    UA_DateTime time = UA_DateTime_now();
+    UA_Variant_setArrayCopy(&fields[0].value, array, 5, &UA_TYPES[UA_TYPES_DOUBLE]);
+    UA_Variant_setScalarCopy(&fields[1].value, &publisher, &UA_TYPES[UA_TYPES_STRING]);
+    UA_Variant_setScalarCopy(&fields[2].value, &counter, &UA_TYPES[UA_TYPES_UINT32]);
+    UA_Variant_setScalarCopy(&fields[3].value, &time, &UA_TYPES[UA_TYPES_DATETIME]);
+    for(size_t i = 0; i < 4; i++)
+        fields[i].hasValue = true;
+
+    /* Both encodings */
+    const UA_DataSetCodec *codec = &UA_DataSetCodec_PublishTime;
+    UA_ByteString generic, generated;
+    UA_ByteString_init(&generic);
+    UA_ByteString_init(&generated);
+    UA_StatusCode res = encodeGeneric(&nm, &generic);
+    size_t size = 0;
+    if(res == UA_STATUSCODE_GOOD) {
+        /* The codec applies and is not left to the generic fallback */
+        size = UA_NetworkMessage_calcSizeBinaryCodec(&nm, &codec);
+        if(size == 0 || codec->calcSizeFields(fields) == 0)
+            res = UA_STATUSCODE_BADNOTSUPPORTED;
+    }
+    if(res == UA_STATUSCODE_GOOD)
+        res = UA_ByteString_allocBuffer(&generated, size);
+    if(res == UA_STATUSCODE_GOOD) {
+        UA_Byte *bufPos = generated.data;
+        res = UA_NetworkMessage_encodeBinaryCodec(&nm, &codec, &bufPos,
+                                                  &generated.data[size]);
+    }
+    if(res == UA_STATUSCODE_GOOD &&
+       (generated.length != generic.length ||
+        memcmp(generated.data, generic.data, generic.length) != 0)) {
+        printf("  the generated and the generic encoding differ\n");
+        res = UA_STATUSCODE_BADENCODINGERROR;
+    }
+
+    /* Decode each through the other path */
+    if(res == UA_STATUSCODE_GOOD)
+        res = checkDecoded(&generic, codec, &generic);
+    if(res == UA_STATUSCODE_GOOD)
+        res = checkDecoded(&generated, NULL, &generic);
+
+    printf("Generated codec %s: %s (%zu bytes)\n", codec->name,
+           UA_StatusCode_name(res), generic.length);
+    UA_ByteString_deleteMembers(&generic);
+    UA_ByteString_deleteMembers(&generated);
+    freeNetworkMessage(&nm);
+    return res;
+}
+
+#endif /* UA_ENABLE_PUBSUB_GENERATED_CODEC */
+
+/**
+ * Chunk Reassembler Check
+ * ~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static UA_StatusCode
+addChunk(UA_ChunkReassembler *r, const UA_NetworkMessage *headers,
+         const UA_NetworkMessageChunk *chunk, UA_ByteString *buf,
+         UA_NetworkMessage *dst, UA_Boolean *complete) {
+    UA_ByteString msg = *buf;
+    msg.length = UA_NetworkMessage_calcSizeChunkHeaders(headers) + chunk->chunkData.length;
+    UA_Byte *bufPos = msg.data;
+    UA_StatusCode res = UA_NetworkMessage_encodeChunk(headers, chunk, &bufPos,
+                                                      &msg.data[msg.length]);
+    if(res != UA_STATUSCODE_GOOD)
+        return res;
+    return UA_ChunkReassembler_add(r, &msg, 0, dst, complete);
+}
+
+static size_t
+greatestCommonDivisor(size_t a, size_t b) {
+    while(b != 0) {
+        size_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+/* Every byte is a chunk. The chunks are sent with a stride that is coprime to
+ * the size, so neighboring chunks arrive far apart. */
+static UA_StatusCode
+checkChunkReassembly(void) {
+    Shape shape = {1000, FIELDS_SCALAR, 0, 0, UA_FIELDENCODING_VARIANT, 1, 0};
+    UA_NetworkMessage nm;
+    buildNetworkMessage(&shape, &nm);
+    UA_DataSetMessage *dsm = nm.payload.dataSetPayload.dataSetMessages;
+    size_t size = UA_DataSetMessage_calcSizeBinary(dsm);
+    UA_ByteString dsmBuf, chunkBuf, reencoded;
+    UA_ByteString_init(&reencoded);
+    UA_StatusCode res = UA_ByteString_allocBuffer(&dsmBuf, size);
+    res |= UA_ByteString_allocBuffer(&chunkBuf, 64);
+    if(res == UA_STATUSCODE_GOOD) {
+        UA_Byte *bufPos = dsmBuf.data;
+        res = UA_DataSetMessage_encodeBinary(dsm, &bufPos, &dsmBuf.data[size]);
+    }
+
+    UA_NetworkMessage headers = nm;
+    headers.chunkMessage = true;
+    headers.payloadHeader.dataSetPayloadHeader.count = 1;
+    headers.payload.dataSetPayload.sizes = NULL;
+    headers.payload.dataSetPayload.dataSetMessages = NULL;
+    UA_NetworkMessageChunk chunk;
+    memset(&chunk, 0, sizeof(UA_NetworkMessageChunk));
+    chunk.messageSequenceNumber = 1;
+    chunk.totalSize = (UA_UInt32)size;
+    chunk.chunkData.length = 1;
+
+    size_t stride = size / 2 + 1;
+    while(greatestCommonDivisor(stride, size) != 1)
+        stride++;
+
+    UA_ChunkReassembler *r = UA_ChunkReassembler_new(NULL);
+    if(!r)
+        res = UA_STATUSCODE_BADOUTOFMEMORY;
+    UA_NetworkMessage reassembled;
+    memset(&reassembled, 0, sizeof(UA_NetworkMessage));
+    UA_Boolean complete = false;
+    UA_UInt64 start = nowNs();
+    for(size_t i = 0; i < size && res == UA_STATUSCODE_GOOD; i++) {
+        if(complete)
+            res = UA_STATUSCODE_BADINTERNALERROR; /* completed too early */
+        chunk.chunkOffset = (UA_UInt32)((i * stride) % size);
+        chunk.chunkData.data = &dsmBuf.data[chunk.chunkOffset];
+        if(res == UA_STATUSCODE_GOOD)
+            res = addChunk(r, &headers, &chunk, &chunkBuf, &reassembled, &complete);
+        if(i == 1 && res == UA_STATUSCODE_GOOD) /* repeat the chunk */
+            res = addChunk(r, &headers, &chunk, &chunkBuf, &reassembled, &complete);
+    }
+    UA_UInt64 duration = nowNs() - start;
+    if(res == UA_STATUSCODE_GOOD && !complete)
+        res = UA_STATUSCODE_BADINTERNALERROR;
+
+    /* The reassembled DataSetMessage encodes to the same bytes */
+    if(res == UA_STATUSCODE_GOOD)
+        res = UA_ByteString_allocBuffer(&reencoded, size);
+    if(res == UA_STATUSCODE_GOOD) {
+        UA_Byte *bufPos = reencoded.data;
+        res = UA_DataSetMessage_encodeBinary(reassembled.payload.dataSetPayload.dataSetMessages,
+                                             &bufPos, &reencoded.data[size]);
+    }
+    if(res == UA_STATUSCODE_GOOD && memcmp(reencoded.data, dsmBuf.data, size) != 0)
+        res = UA_STATUSCODE_BADDECODINGERROR;
+    if(complete)
+        UA_NetworkMessage_clear(&reassembled);
+
+    /* Too large to decode */
+    if(res == UA_STATUSCODE_GOOD) {
+        chunk.messageSequenceNumber = 2;
+        chunk.chunkOffset = 0;
+        chunk.totalSize = UA_UINT16_MAX + 1;
+        chunk.chunkData.data = dsmBuf.data;
+        UA_StatusCode large = addChunk(r, &headers, &chunk, &chunkBuf, &reassembled, &complete);
+        if(large != UA_STATUSCODE_BADENCODINGLIMITSEXCEEDED)
+            res = UA_STATUSCODE_BADINTERNALERROR;
+    }
+
+    UA_ChunkReassemblerStatistics statistics;
+    memset(&statistics, 0, sizeof(statistics));
+    if(r)
+        UA_ChunkReassembler_getStatistics(r, &statistics);
+    if(res == UA_STATUSCODE_GOOD &&
+       (statistics.duplicates != 1 || statistics.completed != 1 || statistics.rejected != 1))
+        res = UA_STATUSCODE_BADINTERNALERROR;
+
+    printf("Chunk reassembly of %zu 1-byte chunks: %s (%.1f ns/chunk)\n", size,
+           UA_StatusCode_name(res), (double)duration / (double)(size + 1));
+    UA_ChunkReassembler_delete(r);
+    UA_ByteString_deleteMembers(&reencoded);
+    UA_ByteString_deleteMembers(&chunkBuf);
+    UA_ByteString_deleteMembers(&dsmBuf);
+    freeNetworkMessage(&nm);
+    return res;
+}
+
+static void
+runShape(const Shape *shape, size_t iterations) {
+    printf("%zu x %zu %s fields", shape->dsmCount, shape->fields, typeNames[shape->type]);
+    if(shape->type == FIELDS_ARRAY || shape->type == FIELDS_MIX)
+        printf(", arrays of %zu", shape->arraySize);
+    if(shape->type == FIELDS_STRING || shape->type == FIELDS_MIX)
+        printf(", strings of %zu", shape->stringSize);
+    printf(", %s encoding", encodingNames[shape->encoding]);
+    if(shape->deltaFields > 0)
+        printf(", delta frames with %zu fields", shape->deltaFields);
+    printf("\n");
+
+    UA_NetworkMessage nm;
+    buildNetworkMessage(shape, &nm);
+    BenchContext ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.nm = &nm;
+
+    /* Compute the sizes and encode once for the decoding */
+    UA_DataSetMessage *dsm = nm.payload.dataSetPayload.dataSetMessages;
+    for(size_t i = 0; i < shape->dsmCount; i++)
+        nm.payload.dataSetPayload.sizes[i] = (UA_UInt16)UA_DataSetMessage_calcSizeBinary(&dsm[i]);
+    size_t size = UA_NetworkMessage_calcSizeBinary(&nm);
+    UA_StatusCode res = UA_ByteString_allocBuffer(&ctx.buffer, size);
+    if(res == UA_STATUSCODE_GOOD) {
+        UA_Byte *bufPos = ctx.buffer.data;
+        res = UA_NetworkMessage_encodeBinary(&nm, &bufPos, &ctx.buffer.data[size]);
+    }
+    if(res != UA_STATUSCODE_GOOD) {
+        printf("  encoding not possible: %s\n", UA_StatusCode_name(res));
+        UA_ByteString_deleteMembers(&ctx.buffer);
+        freeNetworkMessage(&nm);
+        return;
+    }
+    printf("  %zu bytes\n", size);
+
+    double ns = 0.0, allocs = 0.0;
+    res = measure(opSize, &ctx, iterations, &ns, &allocs);
+    printResult("size", res, ns, allocs, size);
+    res = measure(opEncode, &ctx, iterations, &ns, &allocs);
+    printResult("encode", res, ns, allocs, size);
+    res = measure(opDecode, &ctx, iterations, &ns, &allocs);
+    printResult("decode", res, ns, allocs, size);
+#ifdef UA_ENABLE_PUBSUB_ENCRYPTION
+    runSecurity(&ctx, UA_MESSAGESECURITYMODE_SIGN, iterations);
+    runSecurity(&ctx, UA_MESSAGESECURITYMODE_SIGNANDENCRYPT, iterations);
+#endif
+
+    UA_ByteString_deleteMembers(&ctx.buffer);
+    freeNetworkMessage(&nm);
+}
+
+static const Shape suite[] = {
+    /* fields, type, arraySize, stringSize, encoding, dsmCount, deltaFields */
+    {10, FIELDS_SCALAR, 0, 0, UA_FIELDENCODING_VARIANT, 1, 0},
+    {10, FIELDS_SCALAR, 0, 0, UA_FIELDENCODING_DATAVALUE, 1, 0},
+    {10, FIELDS_SCALAR, 0, 0, UA_FIELDENCODING_RAWDATA, 1, 0},
+    {100, FIELDS_SCALAR, 0, 0, UA_FIELDENCODING_VARIANT, 1, 0},
+    {10, FIELDS_ARRAY, 64, 0, UA_FIELDENCODING_VARIANT, 1, 0},
+    {10, FIELDS_STRING, 0, 32, UA_FIELDENCODING_VARIANT, 1, 0},
+    {30, FIELDS_MIX, 16, 16, UA_FIELDENCODING_VARIANT, 1, 0},
+    {10, FIELDS_SCALAR, 0, 0, UA_FIELDENCODING_VARIANT, 4, 0},
+    {100, FIELDS_SCALAR, 0, 0, UA_FIELDENCODING_VARIANT, 1, 10},
+};
+
+static int
+usage(const char *progname) {
+    printf("Usage: %s [-fields <n>] [-type scalar|array|string|mix]\n"
+           "       [-array <n>] [-string <n>] [-encoding variant|datavalue|raw]\n"
+           "       [-dsm <n>] [-delta <n>] [-iterations <n>] [-cpu <n>]\n", progname);
+    return EXIT_FAILURE;
+}
+
+int main(int argc, char **argv) {
+    Shape shape = {10, FIELDS_SCALAR, 16, 16, UA_FIELDENCODING_VARIANT, 1, 0};
+    UA_Boolean custom = false;
+    size_t iterations = 100000;
+    int cpu = sched_getcpu();
+    for(int i = 1; i < argc; i++) {
+        if(i + 1 >= argc)
+            return usage(argv[0]);
+        const char *arg = argv[i];
+        const char *value = argv[++i];
+        if(strcmp(arg, "-iterations") == 0) {
+            iterations = (size_t)strtoul(value, NULL, 10);
+            continue;
+        }
+        if(strcmp(arg, "-cpu") == 0) {
+            cpu = atoi(value);
+            continue;
+        }
+        custom = true;
+        if(strcmp(arg, "-fields") == 0) {
+            shape.fields = (size_t)strtoul(value, NULL, 10);
+        } else if(strcmp(arg, "-array") == 0) {
+            shape.arraySize = (size_t)strtoul(value, NULL, 10);
+        } else if(strcmp(arg, "-string") == 0) {
+            shape.stringSize = (size_t)strtoul(value, NULL, 10);
+        } else if(strcmp(arg, "-dsm") == 0) {
+            shape.dsmCount = (size_t)strtoul(value, NULL, 10);
+        } else if(strcmp(arg, "-delta") == 0) {
+            shape.deltaFields = (size_t)strtoul(value, NULL, 10);
+        } else if(strcmp(arg, "-type") == 0) {
+            size_t t = 0;
+            while(t < 4 && strcmp(value, typeNames[t]) != 0)
+                t++;
+            if(t == 4)
+                return usage(argv[0]);
+            shape.type = (FieldType)t;
+        } else if(strcmp(arg, "-encoding") == 0) {
+            size_t e = 0;
+            while(e < 3 && strcmp(value, encodingNames[e]) != 0)
+                e++;
+            if(e == 3)
+                return usage(argv[0]);
+            shape.encoding = (UA_FieldEncoding)e;
+        } else {
+            return usage(argv[0]);
+        }
+    }
+    if(iterations == 0 || shape.fields == 0 || shape.fields > UA_UINT16_MAX ||
+       shape.dsmCount == 0 || shape.dsmCount > UA_BYTE_MAX ||
+       shape.deltaFields > shape.fields)
+        return usage(argv[0]);
+
+    /* Stay on one CPU for stable caches and clocks */
+    if(cpu >= 0) {
+        cpu_set_t cpuSet;
+        CPU_ZERO(&cpuSet);
+        CPU_SET(cpu, &cpuSet);
+        if(sched_setaffinity(0, sizeof(cpuSet), &cpuSet) == 0)
+            printf("Pinned to CPU %d, %zu iterations, median of %d runs\n",
+                   cpu, iterations, BENCH_RUNS);
+    }
+    installCounter();
+
+    if(checkChunkReassembly() != UA_STATUSCODE_GOOD)
+        return EXIT_FAILURE;
+
+#ifdef UA_ENABLE_PUBSUB_GENERATED_CODEC
+    if(checkPublishTimeCodec() != UA_STATUSCODE_GOOD)
+        return EXIT_FAILURE;
+#endif
+
+    if(custom) {
+        runShape(&shape, iterations);
+    } else {
+        for(size_t i = 0; i < sizeof(suite) / sizeof(Shape); i++)
+            runShape(&suite[i], iterations);
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,154 @@
+/* This work is licensed under a Creative Commons CCZero 1.0 Universal License.
+ * See http://creativecommons.org/publicdomain/zero/1.0/ for more information.
+ */
+
+/**
+ * Shared Memory Transport Latency
+ * -------------------------------
+ * Measures the one-way latency from ``send`` on the publisher channel to the
+ * return of ``receive`` on the subscriber channel. The subscriber runs in its
+ * own thread and blocks in ``receive``, so the wakeup path is part of the
+ * measurement. The shared memory transport is compared with UDP multicast
+ * over loopback.
+ *
+ * Usage: bench_shm_latency [messages] [size] [interval_us] */
+
+#include <open62541/plugin/log_stdout.h>
+#include <open62541/plugin/pubsub_udp.h>
+#include <open62541/server.h>
+
+#include "pubsub_shm.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+typedef struct {
+    UA_PubSubChannel *channel;
+    size_t messages;
+    UA_UInt64 *latencies;
+    size_t received;
+} SubscriberContext;
+
+static UA_UInt64
+nowNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (UA_UInt64)ts.tv_sec * 1000000000 + (UA_UInt64)ts.tv_nsec;
+}
+
+static int
+compareUInt64(const void *a, const void *b) {
+    UA_UInt64 x = *(const UA_UInt64 *)a, y = *(const UA_UInt64 *)b;
+    return (x > y) - (x < y);
+}
+
+/* The first 8 bytes of every message hold the send time */
+static void *
+subscriberThread(void *arg) {
+    SubscriberContext *ctx = (SubscriberContext *)arg;
+    UA_ByteString buffer;
+    UA_ByteString_allocBuffer(&buffer, 65535);
+    while(ctx->received < ctx->messages) {
+        buffer.length = 65535;
+        UA_StatusCode retval = ctx->channel->receive(ctx->channel, &buffer, NULL, 1000000);
+        if(retval == UA_STATUSCODE_GOODNONCRITICALTIMEOUT)
+            break; /* the remaining messages were lost */
+        if(retval != UA_STATUSCODE_GOOD || buffer.length < sizeof(UA_UInt64))
+            continue;
+        UA_UInt64 now = nowNs(), sent;
+        memcpy(&sent, buffer.data, sizeof(sent));
+        ctx->latencies[ctx->received++] = now - sent;
+    }
+    UA_ByteString_deleteMembers(&buffer);
+    return NULL;
+}
+
+static void
+runBenchmark(const char *name, UA_PubSubTransportLayer layer, char *url,
+             char *networkInterface, size_t messages, size_t size, UA_UInt32 interval) {
+    UA_PubSubConnectionConfig connectionConfig;
+    memset(&connectionConfig, 0, sizeof(connectionConfig));
+    connectionConfig.name = UA_STRING("Benchmark Connection");
+    connectionConfig.transportProfileUri = layer.transportProfileUri;
+    connectionConfig.enabled = UA_TRUE;
+    UA_NetworkAddressUrlDataType networkAddressUrl =
+        {UA_STRING(networkInterface), UA_STRING(url)};
+    UA_Variant_setScalar(&connectionConfig.address, &networkAddressUrl,
+                         &UA_TYPES[UA_TYPES_NETWORKADDRESSURLDATATYPE]);
+
+    UA_PubSubChannel *rx = layer.createPubSubChannel(&connectionConfig);
+    UA_PubSubChannel *tx = layer.createPubSubChannel(&connectionConfig);
+    if(!rx || !tx || rx->regist(rx, NULL, NULL) != UA_STATUSCODE_GOOD) {
+        printf("%-8s channel setup failed\n", name);
+        if(rx)
+            rx->close(rx);
+        if(tx)
+            tx->close(tx);
+        return;
+    }
+
+    SubscriberContext ctx;
+    ctx.channel = rx;
+    ctx.messages = messages;
+    ctx.received = 0;
+    ctx.latencies = (UA_UInt64 *)UA_calloc(messages, sizeof(UA_UInt64));
+    pthread_t thread;
+    pthread_create(&thread, NULL, subscriberThread, &ctx);
+
+    UA_ByteString message;
+    UA_ByteString_allocBuffer(&message, size);
+    memset(message.data, 0xA5, size);
+    struct timespec pause;
+    pause.tv_sec = interval / 1000000;
+    pause.tv_nsec = (long)(interval % 1000000) * 1000;
+    for(size_t i = 0; i < messages; i++) {
+        nanosleep(&pause, NULL);
+        UA_UInt64 sent = nowNs();
+        memcpy(message.data, &sent, sizeof(sent));
+        tx->send(tx, NULL, &message);
+        if(tx->yield)
+            tx->yield(tx, 0);
+    }
+    pthread_join(thread, NULL);
+
+    if(ctx.received > 0) {
+        qsort(ctx.latencies, ctx.received, sizeof(UA_UInt64), compareUInt64);
+        UA_UInt64 sum = 0;
+        for(size_t i = 0; i < ctx.received; i++)
+            sum += ctx.latencies[i];
+        printf("%-8s min %8.2f  avg %8.2f  p50 %8.2f  p99 %8.2f  max %8.2f us  lost %zu\n",
+               name, (double)ctx.latencies[0] / 1e3,
+               (double)sum / (double)ctx.received / 1e3,
+               (double)ctx.latencies[ctx.received / 2] / 1e3,
+               (double)ctx.latencies[(ctx.received * 99) / 100] / 1e3,
+               (double)ctx.latencies[ctx.received - 1] / 1e3,
+               messages - ctx.received);
+    } else {
+        printf("%-8s no messages received\n", name);
+    }
+
+    UA_free(ctx.latencies);
+    UA_ByteString_deleteMembers(&message);
+    rx->unregist(rx, NULL);
+    rx->close(rx);
+    tx->close(tx);
+}
+
+int main(int argc, char **argv) {
+    size_t messages = (argc > 1) ? (size_t)strtoul(argv[1], NULL, 10) : 10000;
+    size_t size = (argc > 2) ? (size_t)strtoul(argv[2], NULL, 10) : 256;
+    UA_UInt32 interval = (argc > 3) ? (UA_UInt32)strtoul(argv[3], NULL, 10) : 100;
+    if(messages == 0 || size < sizeof(UA_UInt64) || size > 2048) {
+        printf("Usage: %s [messages] [size 8..2048] [interval_us]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    printf("%zu messages of %zu bytes every %u us\n", messages, size, interval);
+
+    runBenchmark("shm", UA_PubSubTransportLayerSHM(), "opc.shm://bench_latency",
+                 "", messages, size, interval);
+    runBenchmark("udp-mp", UA_PubSubTransportLayerUDPMP(), "opc.udp://224.0.0.22:4842/",
+                 "127.0.0.1", messages, size, interval);
+    return EXIT_SUCCESS;
+}
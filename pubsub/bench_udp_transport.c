@@ -0,0 +1,118 @@
+/* This work is licensed under a Creative Commons CCZero 1.0 Universal License.
+ * See http://creativecommons.org/publicdomain/zero/1.0/ for more information.
+ */
+
+/**
+ * UDP Transport Benchmark
+ * -----------------------
+ * Sends bursts of NetworkMessage-sized datagrams over the loopback interface
+ * through the UDP-MP transport and, if enabled, through the io_uring
+ * transport. Every burst corresponds to one publish cycle and ends with
+ * ``yield``. The sender and receiver rates are printed in messages/s.
+ *
+ * Usage: bench_udp_transport [messages] [size] [burst]
+ *
+ * To compare the number of system calls, run the benchmark with
+ * ``strace -f -c``. */
+
+#include <open62541/plugin/log_stdout.h>
+#include <open62541/plugin/pubsub_udp.h>
+#include <open62541/server.h>
+
+#ifdef UA_ENABLE_PUBSUB_UDP_URING
+#include "pubsub_udp_uring.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+static UA_UInt64
+nowNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (UA_UInt64)ts.tv_sec * 1000000000 + (UA_UInt64)ts.tv_nsec;
+}
+
+static void
+runBenchmark(const char *name, UA_PubSubTransportLayer layer,
+             size_t messages, size_t size, size_t burst) {
+    UA_PubSubConnectionConfig connectionConfig;
+    memset(&connectionConfig, 0, sizeof(connectionConfig));
+    connectionConfig.name = UA_STRING("Benchmark Connection");
+    connectionConfig.transportProfileUri = layer.transportProfileUri;
+    connectionConfig.enabled = UA_TRUE;
+    UA_NetworkAddressUrlDataType networkAddressUrl =
+        {UA_STRING("127.0.0.1"), UA_STRING("opc.udp://224.0.0.22:4841/")};
+    UA_Variant_setScalar(&connectionConfig.address, &networkAddressUrl,
+                         &UA_TYPES[UA_TYPES_NETWORKADDRESSURLDATATYPE]);
+
+    UA_PubSubChannel *rx = layer.createPubSubChannel(&connectionConfig);
+    UA_PubSubChannel *tx = layer.createPubSubChannel(&connectionConfig);
+    if(!rx || !tx || rx->regist(rx, NULL, NULL) != UA_STATUSCODE_GOOD) {
+        printf("%-10s channel setup failed\n", name);
+        if(rx)
+            rx->close(rx);
+        if(tx)
+            tx->close(tx);
+        return;
+    }
+
+    UA_ByteString message, buffer;
+    UA_ByteString_allocBuffer(&message, size);
+    UA_ByteString_allocBuffer(&buffer, 65535);
+    memset(message.data, 0xA5, size);
+
+    /* Interleave bursts and draining so that the socket buffer does not
+     * overflow. Messages that are still lost are reported. */
+    size_t received = 0;
+    UA_UInt64 sendNs = 0, recvNs = 0;
+    for(size_t sent = 0; sent < messages; ) {
+        UA_UInt64 start = nowNs();
+        size_t n = (messages - sent < burst) ? messages - sent : burst;
+        for(size_t i = 0; i < n; i++)
+            tx->send(tx, NULL, &message);
+        if(tx->yield)
+            tx->yield(tx, 0);
+        sent += n;
+        UA_UInt64 mid = nowNs();
+        sendNs += mid - start;
+
+        for(size_t i = 0; i < n; i++) {
+            buffer.length = 65535;
+            if(rx->receive(rx, &buffer, NULL, 100000) != UA_STATUSCODE_GOOD ||
+               buffer.length == 0)
+                break;
+            received++;
+        }
+        recvNs += nowNs() - mid;
+    }
+
+    printf("%-10s send %12.0f msgs/s   receive %12.0f msgs/s   lost %zu\n", name,
+           (double)messages * 1e9 / (double)(sendNs ? sendNs : 1),
+           (double)received * 1e9 / (double)(recvNs ? recvNs : 1),
+           messages - received);
+
+    UA_ByteString_deleteMembers(&message);
+    UA_ByteString_deleteMembers(&buffer);
+    rx->unregist(rx, NULL);
+    rx->close(rx);
+    tx->close(tx);
+}
+
+int main(int argc, char **argv) {
+    size_t messages = (argc > 1) ? (size_t)strtoul(argv[1], NULL, 10) : 100000;
+    size_t size = (argc > 2) ? (size_t)strtoul(argv[2], NULL, 10) : 256;
+    size_t burst = (argc > 3) ? (size_t)strtoul(argv[3], NULL, 10) : 32;
+    if(messages == 0 || size == 0 || size > 65507 || burst == 0) {
+        printf("Usage: %s [messages] [size] [burst]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    printf("%zu messages of %zu bytes in bursts of %zu\n", messages, size, burst);
+
+    runBenchmark("udp-mp", UA_PubSubTransportLayerUDPMP(), messages, size, burst);
+#ifdef UA_ENABLE_PUBSUB_UDP_URING
+    runBenchmark("io_uring", UA_PubSubTransportLayerUDPUring(), messages, size, burst);
+#endif
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,251 @@
+#!/usr/bin/env python3
+
+# This Source Code Form is subject to the terms of the Mozilla Public
+# License, v. 2.0. If a copy of the MPL was not distributed with this
+# file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+"""Generate the encoding and decoding of the fields of one DataSet layout.
+
+The layout is a CSV file with one line per field in the order of the fields in
+the DataSetMessage: ``FieldName,DataType[,ValueRank]``. DataType is the name of
+a builtin type, ValueRank is -1 (scalar, default) or 1 (array). Lines starting
+with # are comments. The fields of a PublishedDataSet are encoded in the
+reverse order in which they were added.
+
+Usage: generate_dataset_codec.py <layout.csv> <Name> <outbase>
+
+Writes <outbase>.h and <outbase>.c with the codec ``UA_DataSetCodec_<Name>``
+for ``ua_pubsub_codec.h``.
+"""
+
+import argparse
+import csv
+import os
+import re
+import sys
+
+# name: (ns0 id, UA_TYPES index, C type, encoded size or None, kind)
+TYPES = {
+    "Boolean":    (1,  "BOOLEAN",    "UA_Boolean",    1, "bool"),
+    "SByte":      (2,  "SBYTE",      "UA_SByte",      1, "8"),
+    "Byte":       (3,  "BYTE",       "UA_Byte",       1, "8"),
+    "Int16":      (4,  "INT16",      "UA_Int16",      2, "16"),
+    "UInt16":     (5,  "UINT16",     "UA_UInt16",     2, "16"),
+    "Int32":      (6,  "INT32",      "UA_Int32",      4, "32"),
+    "UInt32":     (7,  "UINT32",     "UA_UInt32",     4, "32"),
+    "Int64":      (8,  "INT64",      "UA_Int64",      8, "64"),
+    "UInt64":     (9,  "UINT64",     "UA_UInt64",     8, "64"),
+    "Float":      (10, "FLOAT",      "UA_Float",      4, "Float"),
+    "Double":     (11, "DOUBLE",     "UA_Double",     8, "Double"),
+    "String":     (12, "STRING",     "UA_String",     None, "String"),
+    "DateTime":   (13, "DATETIME",   "UA_DateTime",   8, "64"),
+    "ByteString": (15, "BYTESTRING", "UA_ByteString", None, "String"),
+    "StatusCode": (19, "STATUSCODE", "UA_StatusCode", 4, "32"),
+}
+
+UNSIGNED = {"8": "UA_Byte", "16": "UA_UInt16", "32": "UA_UInt32", "64": "UA_UInt64"}
+
+
+class Field:
+    def __init__(self, index, name, typeName, valueRank):
+        self.index = index
+        self.name = name
+        self.typeName = typeName
+        self.nodeId, typesIndex, self.ctype, self.size, self.kind = TYPES[typeName]
+        self.uaType = "&UA_TYPES[UA_TYPES_%s]" % typesIndex
+        self.array = (valueRank == 1)
+        self.encoding = self.nodeId | (0x80 if self.array else 0)
+        self.value = "f[%d].value" % index
+
+    def comment(self):
+        return "    /* %d: %s (%s%s) */\n" % (self.index, self.name.replace("*/", "* /"),
+                                           self.typeName, "[]" if self.array else "")
+
+
+def parseLayout(path):
+    fields = []
+    with open(path, newline="") as f:
+        for lineno, row in enumerate(csv.reader(f), 1):
+            if not row or not "".join(row).strip() or row[0].lstrip().startswith("#"):
+                continue
+            row = [c.strip() for c in row]
+            if len(row) < 2 or len(row) > 3:
+                sys.exit("%s:%d: expected FieldName,DataType[,ValueRank]" % (path, lineno))
+            if row[1] not in TYPES:
+                sys.exit("%s:%d: unsupported DataType %s" % (path, lineno, row[1]))
+            valueRank = int(row[2]) if len(row) == 3 and row[2] else -1
+            if valueRank not in (-1, 1):
+                sys.exit("%s:%d: ValueRank must be -1 or 1" % (path, lineno))
+            fields.append(Field(len(fields), row[0], row[1], valueRank))
+    if not fields:
+        sys.exit("%s: no fields" % path)
+    if len(fields) > 0xFFFF:
+        sys.exit("%s: too many fields" % path)
+    return fields
+
+
+def writeValue(field, v):
+    """Statement writing the value v of an element"""
+    if field.kind == "bool":
+        return "pos = UA_DataSetCodec_write8(pos, %s ? 1 : 0);" % v
+    if field.kind in ("Float", "Double"):
+        return "pos = UA_DataSetCodec_write%s(pos, %s);" % (field.kind, v)
+    if field.kind == "String":
+        return "pos = UA_DataSetCodec_writeString(pos, &%s);" % v
+    return "pos = UA_DataSetCodec_write%s(pos, (%s)%s);" % (field.kind, UNSIGNED[field.kind], v)
+
+
+def readValue(field, v):
+    """Statement reading an element of fixed size into v"""
+    p = "&src->data[pos]"
+    if field.kind == "bool":
+        return "%s = (src->data[pos] != 0);" % v
+    if field.kind == "8":
+        return "%s = (%s)src->data[pos];" % (v, field.ctype)
+    if field.kind in ("Float", "Double"):
+        return "%s = UA_DataSetCodec_read%s(%s);" % (v, field.kind, p)
+    return "%s = (%s)UA_DataSetCodec_read%s(%s);" % (v, field.ctype, field.kind, p)
+
+
+def genCalcSize(fields):
+    c = "static size_t\ncalcSizeFields(const UA_DataValue *f) {\n"
+    fixed = 0
+    body = ""
+    for fd in fields:
+        body += fd.comment()
+        check = "isArray" if fd.array else "isScalar"
+        body += "    if(!UA_DataSetCodec_%s(&%s, %s))\n        return 0;\n" % (check, fd.value, fd.uaType)
+        if not fd.array and fd.size is not None:
+            fixed += 1 + fd.size
+        elif not fd.array:
+            fixed += 1 + 4
+            body += "    size += ((const %s *)%s.data)->length;\n" % (fd.ctype, fd.value)
+        elif fd.size is not None:
+            fixed += 1 + 4
+            body += "    size += %s.arrayLength * %d;\n" % (fd.value, fd.size)
+        else:
+            fixed += 1 + 4
+            body += ("    for(size_t i = 0; i < %s.arrayLength; i++)\n"
+                     "        size += 4 + ((const %s *)%s.data)[i].length;\n"
+                     % (fd.value, fd.ctype, fd.value))
+    c += "    size_t size = %d;\n" % fixed
+    c += body
+    c += "    return size;\n}\n"
+    return c
+
+
+def genEncode(fields):
+    c = ("static UA_StatusCode\n"
+         "encodeFields(const UA_DataValue *f, UA_Byte **bufPos, const UA_Byte *bufEnd) {\n"
+         "    size_t size = calcSizeFields(f);\n"
+         "    if(size == 0)\n"
+         "        return UA_STATUSCODE_BADENCODINGERROR;\n"
+         "    if((size_t)(bufEnd - *bufPos) < size)\n"
+         "        return UA_STATUSCODE_BADENCODINGLIMITSEXCEEDED;\n\n"
+         "    /* The buffer is checked. Write without further checks. */\n"
+         "    UA_Byte *pos = *bufPos;\n")
+    for fd in fields:
+        c += fd.comment()
+        c += "    pos = UA_DataSetCodec_write8(pos, 0x%02X);\n" % fd.encoding
+        if not fd.array and fd.size is None:
+            c += "    pos = UA_DataSetCodec_writeString(pos, (const %s *)%s.data);\n" % (fd.ctype, fd.value)
+            continue
+        if not fd.array:
+            c += "    %s\n" % writeValue(fd, "*(const %s *)%s.data" % (fd.ctype, fd.value))
+            continue
+        c += ("    {\n"
+              "        const %s *a = (const %s *)%s.data;\n"
+              "        size_t n = %s.arrayLength;\n"
+              "        pos = UA_DataSetCodec_write32(pos, (UA_UInt32)UA_DataSetCodec_encodedLength(a, n));\n"
+              "        for(size_t i = 0; i < n; i++)\n"
+              "            %s\n"
+              "    }\n" % (fd.ctype, fd.ctype, fd.value, fd.value, writeValue(fd, "a[i]")))
+    c += "    *bufPos = pos;\n    return UA_STATUSCODE_GOOD;\n}\n"
+    return c
+
+
+def genDecode(fields):
+    c = ("static UA_StatusCode\n"
+         "decodeFields(const UA_ByteString *src, size_t *offset, UA_DataValue *f) {\n"
+         "    size_t pos = *offset;\n")
+    if any(fd.array or fd.size is None for fd in fields):
+        c += "    UA_StatusCode rv;\n"
+    for fd in fields:
+        c += fd.comment()
+        need = 4 if (fd.array or fd.size is None) else fd.size
+        c += ("    if(!UA_DataSetCodec_expect(src, &pos, 0x%02X, %d))\n"
+              "        return UA_STATUSCODE_BADDECODINGERROR;\n" % (fd.encoding, need))
+        if not fd.array:
+            c += ("    {\n"
+                  "        %s *v = (%s *)UA_DataSetCodec_newScalar(&f[%d], %s);\n"
+                  "        if(!v)\n"
+                  "            return UA_STATUSCODE_BADOUTOFMEMORY;\n" %
+                  (fd.ctype, fd.ctype, fd.index, fd.uaType))
+            if fd.size is None:
+                c += ("        rv = UA_DataSetCodec_readString(src, &pos, v);\n"
+                      "        if(rv != UA_STATUSCODE_GOOD)\n"
+                      "            return rv;\n")
+            else:
+                c += "        %s\n        pos += %d;\n" % (readValue(fd, "*v"), fd.size)
+            c += "    }\n"
+            continue
+        c += ("    rv = UA_DataSetCodec_newArray(src, &pos, &f[%d], %s, %d);\n"
+              "    if(rv != UA_STATUSCODE_GOOD)\n"
+              "        return rv;\n"
+              "    {\n"
+              "        %s *a = (%s *)%s.data;\n"
+              "        for(size_t i = 0; i < %s.arrayLength; i++) {\n" %
+              (fd.index, fd.uaType, fd.size or 4, fd.ctype, fd.ctype, fd.value, fd.value))
+        if fd.size is None:
+            c += ("            rv = UA_DataSetCodec_readString(src, &pos, &a[i]);\n"
+                  "            if(rv != UA_STATUSCODE_GOOD)\n"
+                  "                return rv;\n")
+        else:
+            c += "            %s\n            pos += %d;\n" % (readValue(fd, "a[i]"), fd.size)
+        c += "        }\n    }\n"
+    c += "    *offset = pos;\n    return UA_STATUSCODE_GOOD;\n}\n"
+    return c
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    parser.add_argument("layout", help="CSV file with FieldName,DataType[,ValueRank]")
+    parser.add_argument("name", help="name of the codec (a C identifier)")
+    parser.add_argument("outbase", help="path of the generated files without extension")
+    args = parser.parse_args()
+    if not re.match(r"^[A-Za-z_][A-Za-z0-9_]*$", args.name):
+        sys.exit("The name must be a C identifier")
+
+    fields = parseLayout(args.layout)
+    codec = "UA_DataSetCodec_" + args.name
+    base = os.path.basename(args.outbase)
+    guard = re.sub(r"[^A-Za-z0-9]", "_", base).upper() + "_H_"
+    header = ("/* Generated from %s with generate_dataset_codec.py. Do not edit. */\n\n" %
+              os.path.basename(args.layout))
+
+    with open(args.outbase + ".h", "w") as h:
+        h.write(header)
+        h.write("#ifndef %s\n#define %s\n\n" % (guard, guard))
+        h.write('#include "ua_pubsub_codec.h"\n\n_UA_BEGIN_DECLS\n\n')
+        h.write("/* %d fields: %s */\n" % (len(fields), ", ".join(fd.name for fd in fields)))
+        h.write("extern const UA_DataSetCodec %s;\n\n" % codec)
+        h.write("_UA_END_DECLS\n\n#endif /* %s */\n" % guard)
+
+    with open(args.outbase + ".c", "w") as c:
+        c.write(header)
+        c.write('#include "%s.h"\n\n' % base)
+        c.write(genCalcSize(fields) + "\n")
+        c.write(genEncode(fields) + "\n")
+        c.write(genDecode(fields) + "\n")
+        c.write("static const UA_DataSetCodecField fields[%d] = {\n" % len(fields))
+        for fd in fields:
+            c.write("    {%d, %d}, /* %s */\n" % (fd.nodeId, 1 if fd.array else -1,
+                                                 fd.name.replace("*/", "* /")))
+        c.write("};\n\n")
+        c.write("const UA_DataSetCodec %s = {\n" % codec)
+        c.write('    "%s", %d, fields,\n' % (args.name, len(fields)))
+        c.write("    calcSizeFields, encodeFields, decodeFields\n};\n")
+
+
+if __name__ == "__main__":
+    main()
@@ -31,12 +31,30 @@
 #include <open62541/server_config_default.h>
 #include <open62541/server_config.h>
 
+#include "ua_pubsub_ext.h"
+#ifdef UA_ENABLE_PUBSUB_GENERATED_CODEC
+#include "publish_time_codec.h" /* generate_dataset_codec.py publish_time.csv PublishTime publish_time_codec */
+#endif
+#ifdef UA_ENABLE_PUBSUB_UDP_URING
+#include "pubsub_udp_uring.h"
+#endif
+#ifdef UA_ENABLE_PUBSUB_ETH_RING
+#include "pubsub_ethernet_ring.h"
+#endif
+#ifdef UA_ENABLE_PUBSUB_SHM
+#include "pubsub_shm.h"
+#endif
+
 #include <ifaddrs.h>
+#include <pthread.h>
 #include <signal.h>
 #include <time.h>
 #include <stdlib.h>
 #include <inttypes.h>
 
+/* UDP payload of an Ethernet frame with IPv4 */
+#define MAX_NETWORKMESSAGE_SIZE 1472
+
 UA_NodeId connectionIdent, publishedDataSetIdent, writerGroupIdent;
 UA_Variant           valueVariant;
 UA_Boolean           actVal;
@@ -46,8 +64,15 @@ int sample_count = 10;
 int publish_interval = 1000;
 int write_rate = 1000;
 size_t array_size = 5;
+UA_Boolean on_change = false;
+UA_Duration trigger_min_interval = 0;
+UA_Duration trigger_max_interval = 0;
+UA_Duration publishing_offset = -1;
 UA_Boolean running = true;
 UA_Boolean samples = false;
+UA_Boolean use_mailbox = false;
+UA_Double compress_scale = 0;
+UA_ValueMailbox *timeMailbox = NULL;
 
 static void
 addPubSubConnection(UA_Server *server, UA_String *transportProfile,
@@ -92,10 +117,10 @@ addPublishedDataSet(UA_Server *server) {
  * The DataSetField (DSF) is part of the PDS and describes exactly one published
  * field. */
 
-static void
+static UA_NodeId
 addNewDataSetField(UA_Server *server, UA_UInt16 nsIndex, UA_UInt16 numIdent, char* fieldNameAlias){
     /* Add a field to the previous created PublishedDataSet */
-    UA_NodeId dataSetFieldIdent;
+    UA_NodeId dataSetFieldIdent = UA_NODEID_NULL;
     UA_DataSetFieldConfig dataSetFieldConfig;
     memset(&dataSetFieldConfig, 0, sizeof(UA_DataSetFieldConfig));
     dataSetFieldConfig.dataSetFieldType = UA_PUBSUB_DATASETFIELD_VARIABLE;
@@ -106,6 +131,7 @@ addNewDataSetField(UA_Server *server, UA_UInt16 nsIndex, UA_UInt16 numIdent, cha
     dataSetFieldConfig.field.variable.publishParameters.attributeId = UA_ATTRIBUTEID_VALUE;
     UA_Server_addDataSetField(server, publishedDataSetIdent,
                               &dataSetFieldConfig, &dataSetFieldIdent);
+    return dataSetFieldIdent;
 }
 
 /**
@@ -124,6 +150,18 @@ addWriterGroup(UA_Server *server) {
     writerGroupConfig.enabled = UA_TRUE;
     writerGroupConfig.writerGroupId = 100;
     writerGroupConfig.encodingMimeType = UA_PUBSUB_ENCODING_UADP;
+    /* Send the ids that subscribers filter on */
+    UA_UadpWriterGroupMessageDataType writerGroupMessage;
+    UA_UadpWriterGroupMessageDataType_init(&writerGroupMessage);
+    writerGroupMessage.networkMessageContentMask = (UA_UadpNetworkMessageContentMask)
+        (UA_UADPNETWORKMESSAGECONTENTMASK_PUBLISHERID |
+         UA_UADPNETWORKMESSAGECONTENTMASK_GROUPHEADER |
+         UA_UADPNETWORKMESSAGECONTENTMASK_WRITERGROUPID |
+         UA_UADPNETWORKMESSAGECONTENTMASK_PAYLOADHEADER);
+    writerGroupConfig.messageSettings.encoding = UA_EXTENSIONOBJECT_DECODED;
+    writerGroupConfig.messageSettings.content.decoded.type =
+        &UA_TYPES[UA_TYPES_UADPWRITERGROUPMESSAGEDATATYPE];
+    writerGroupConfig.messageSettings.content.decoded.data = &writerGroupMessage;
 
     UA_Server_addWriterGroup(server, connectionIdent, &writerGroupConfig, &writerGroupIdent);
 }
@@ -189,6 +227,34 @@ static void updateCurrentTime(UA_Server *server, void * data) {
     }
 }
 
+/**
+ * With ``-mailbox``, the time is produced by a thread of its own at the write
+ * rate. It writes into a value mailbox that is bound to the Time field instead
+ * of writing the variable in the server loop. */
+
+static void *
+produceCurrentTime(void *data) {
+    struct timespec interval;
+    interval.tv_sec = write_rate / 1000;
+    interval.tv_nsec = (write_rate % 1000) * 1000000L;
+    while(running) {
+        UA_DateTime now = UA_DateTime_nowMonotonic();
+        UA_ValueMailbox_write(timeMailbox, &now, UA_DateTime_now());
+
+        UA_LOG_INFO(UA_Log_Stdout, UA_LOGCATEGORY_USERLAND,
+                    "[Time]: %lli", now);
+
+        if (samples){
+            counter++;
+            if (counter == sample_count){
+                running = false;
+            }
+        }
+        nanosleep(&interval, NULL);
+    }
+    return NULL;
+}
+
 static void
 addTimeVariable(UA_Server *server, UA_UInt16 nsIndex, UA_UInt32 numIdent) {
 
@@ -326,17 +392,35 @@ static int run(UA_String *transportProfile,
     /* Details about the connection configuration and handling are located in
      * the pubsub connection tutorial */
     config->pubsubTransportLayers =
-            (UA_PubSubTransportLayer *) UA_calloc(2, sizeof(UA_PubSubTransportLayer));
+            (UA_PubSubTransportLayer *) UA_calloc(5, sizeof(UA_PubSubTransportLayer));
     if(!config->pubsubTransportLayers) {
         UA_Server_delete(server);
         return EXIT_FAILURE;
     }
-    config->pubsubTransportLayers[0] = UA_PubSubTransportLayerUDPMP();
+#ifdef UA_ENABLE_PUBSUB_UDP_URING
+    /* Serves the same profile as UDP-MP and is found first */
+    config->pubsubTransportLayers[config->pubsubTransportLayersSize] =
+        UA_PubSubTransportLayerUDPUring();
+    config->pubsubTransportLayersSize++;
+#endif
+    config->pubsubTransportLayers[config->pubsubTransportLayersSize] =
+        UA_PubSubTransportLayerUDPMP();
     config->pubsubTransportLayersSize++;
 
 
+#ifdef UA_ENABLE_PUBSUB_SHM
+    config->pubsubTransportLayers[config->pubsubTransportLayersSize] =
+        UA_PubSubTransportLayerSHM();
+    config->pubsubTransportLayersSize++;
+#endif
 #ifdef UA_ENABLE_PUBSUB_ETH_UADP
-    config->pubsubTransportLayers[1] = UA_PubSubTransportLayerEthernet();
+#ifdef UA_ENABLE_PUBSUB_ETH_RING
+    config->pubsubTransportLayers[config->pubsubTransportLayersSize] =
+        UA_PubSubTransportLayerEthernetRing();
+    config->pubsubTransportLayersSize++;
+#endif
+    config->pubsubTransportLayers[config->pubsubTransportLayersSize] =
+        UA_PubSubTransportLayerEthernet();
     config->pubsubTransportLayersSize++;
 #endif
 
@@ -348,20 +432,72 @@ static int run(UA_String *transportProfile,
     addPublisherVariable(server, 1, 52521);
     addDoubleArray(server, 1, 52252);
 
-    addNewDataSetField(server, 1, 52510, "Time");
+    UA_NodeId timeFieldIdent = addNewDataSetField(server, 1, 52510, "Time");
     addNewDataSetField(server, 1, 52501, "32-bit Integer");
     addNewDataSetField(server, 1, 52521, "String");
-    addNewDataSetField(server, 1, 52252, "Array");
+    UA_NodeId arrayFieldIdent = addNewDataSetField(server, 1, 52252, "Array");
+
+    /* Send the array as delta-coded 16-bit integers instead of Doubles */
+    if (compress_scale > 0) {
+        UA_FieldCompression compression =
+            {UA_FIELDCOMPRESSION_SCALEDINT16, compress_scale, 0.0, true};
+        if(UA_Server_setDataSetFieldCompression(server, arrayFieldIdent,
+                                                &compression) != UA_STATUSCODE_GOOD)
+            printf("Warning: The array cannot be compressed\n");
+    }
+
+#ifdef UA_ENABLE_PUBSUB_GENERATED_CODEC
+    /* Encode the fields with the code generated from publish_time.csv */
+    if(UA_Server_setDataSetCodec(server, publishedDataSetIdent,
+                                 &UA_DataSetCodec_PublishTime) != UA_STATUSCODE_GOOD)
+        printf("Warning: The generated codec does not match the DataSet\n");
+#endif
 
     addWriterGroup(server);
 
     addDataSetWriter(server);
 
-    UA_Server_addRepeatedCallback(server, updateCurrentTime, NULL, write_rate, NULL);
+    /* Large arrays are sent in chunks that fit into an Ethernet frame instead
+     * of IP fragments */
+    UA_Server_setWriterGroupMaxNetworkMessageSize(server, writerGroupIdent,
+                                                  MAX_NETWORKMESSAGE_SIZE);
+
+    /* Publish when the time is written instead of every publish_interval */
+    if (on_change){
+        UA_WriterGroupTriggerConfig triggerConfig;
+        triggerConfig.minInterval = trigger_min_interval;
+        triggerConfig.maxInterval = trigger_max_interval;
+        UA_Server_setWriterGroupTrigger(server, writerGroupIdent, &triggerConfig);
+    }
+
+    /* Send at a fixed offset within the publish cycle */
+    if (publishing_offset >= 0 &&
+        UA_Server_setWriterGroupPublishingOffset(server, writerGroupIdent,
+                                                 publishing_offset) != UA_STATUSCODE_GOOD)
+        printf("Warning: The transport does not support a publishing offset\n");
+
+    pthread_t producer;
+    UA_Boolean producerStarted = false;
+    if (use_mailbox) {
+        timeMailbox = UA_ValueMailbox_new(&UA_TYPES[UA_TYPES_DATETIME], 0);
+        if (timeMailbox &&
+            UA_Server_setDataSetFieldMailbox(server, timeFieldIdent, timeMailbox) == UA_STATUSCODE_GOOD)
+            producerStarted = (pthread_create(&producer, NULL, produceCurrentTime, NULL) == 0);
+        if (!producerStarted)
+            printf("Warning: The time is not produced through a mailbox\n");
+    }
+    if (!producerStarted)
+        UA_Server_addRepeatedCallback(server, updateCurrentTime, NULL, write_rate, NULL);
 
     UA_StatusCode retval = UA_Server_run(server, &running);
 
+    if (producerStarted) {
+        running = false;
+        pthread_join(producer, NULL);
+    }
+
     UA_Server_delete(server);
+    UA_ValueMailbox_delete(timeMailbox);
     return retval == UA_STATUSCODE_GOOD ? EXIT_SUCCESS : EXIT_FAILURE;
 }
 
@@ -391,6 +527,11 @@ int main(int argc, char **argv) {
             }
             networkAddressUrl.networkInterface = UA_STRING(argv[2]);
             networkAddressUrl.url = UA_STRING(argv[1]);
+#ifdef UA_ENABLE_PUBSUB_SHM
+        } else if (strncmp(argv[1], "opc.shm://", 10) == 0) {
+            transportProfile = UA_STRING(UA_PUBSUB_SHM_PROFILE_URI);
+            networkAddressUrl.url = UA_STRING(argv[1]);
+#endif
         } else if (strcmp(argv[1], "-sample") == 0){
             if (argc < 3){
                 printf("Error: Number of samples not supplied\n");
@@ -428,6 +569,35 @@ int main(int argc, char **argv) {
                         printf("Warning");
                     }
                     array_size = strtoul(argv[8], NULL, 0);
+
+                    if (argc > 9 && strcmp(argv[9], "-onchange") == 0) {
+                        if (argc < 12){
+                            printf("Error: Minimum and maximum interval not supplied\n");
+                            return EXIT_FAILURE;
+                        }
+                        on_change = true;
+                        trigger_min_interval = atof(argv[10]);
+                        trigger_max_interval = atof(argv[11]);
+                        printf("on-change publishing, min interval = %s, max interval = %s\n",
+                               argv[10], argv[11]);
+                    } else if (argc > 9 && strcmp(argv[9], "-offset") == 0) {
+                        if (argc < 11){
+                            printf("Error: Publishing offset not supplied\n");
+                            return EXIT_FAILURE;
+                        }
+                        publishing_offset = atof(argv[10]);
+                        printf("publishing offset = %s\n", argv[10]);
+                    } else if (argc > 9 && strcmp(argv[9], "-mailbox") == 0) {
+                        use_mailbox = true;
+                        printf("time produced through a mailbox\n");
+                    } else if (argc > 9 && strcmp(argv[9], "-compress") == 0) {
+                        if (argc < 11){
+                            printf("Error: Scale of the array values not supplied\n");
+                            return EXIT_FAILURE;
+                        }
+                        compress_scale = atof(argv[10]);
+                        printf("array compressed with scale = %s\n", argv[10]);
+                    }
                 }
             }
 
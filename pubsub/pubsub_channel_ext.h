@@ -0,0 +1,69 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef UA_PLUGIN_PUBSUB_CHANNEL_EXT_H_
+#define UA_PLUGIN_PUBSUB_CHANNEL_EXT_H_
+
+#include <open62541/plugin/pubsub.h>
+
+_UA_BEGIN_DECLS
+
+#ifdef UA_ENABLE_PUBSUB /* conditional compilation */
+
+/**
+ * Channel Extensions
+ * ------------------
+ * Optional operations of a PubSubChannel in addition to those of
+ * ``plugin/pubsub.h``. A transport layer registers them for every channel it
+ * creates and removes them before the channel is freed. Members that a
+ * transport does not support are left NULL. */
+
+typedef struct {
+    /* Current time in nanoseconds on the clock that launch times refer to */
+    UA_UInt64 (*now)(UA_PubSubChannel *channel);
+
+    /* Hand the messages that are sent from now on to the network at the given
+     * time (nanoseconds on the clock of ``now``). 0 sends right away. */
+    UA_StatusCode (*setLaunchTime)(UA_PubSubChannel *channel, UA_UInt64 launchTime);
+
+    /* The socket messages are received on if it is not the channel socket.
+     * Returns -1 if the channel does not receive on a socket. */
+    UA_SOCKET (*receiveSocket)(UA_PubSubChannel *channel);
+
+    /* Like ``send``, but returns UA_STATUSCODE_BADWOULDBLOCK instead of
+     * waiting if the message cannot be taken right now */
+    UA_StatusCode (*sendNonBlocking)(UA_PubSubChannel *channel,
+                                     UA_ExtensionObject *transportSettings,
+                                     const UA_ByteString *buf);
+
+    /* Lend a transmit buffer of the transport for a message of the given
+     * length, so that the message is encoded in place. The buffer is handed
+     * back with either sendBuffer or releaseBuffer. Fails without waiting if
+     * no buffer is free. The caller then encodes into its own buffer and uses
+     * ``send``. */
+    UA_StatusCode (*acquireBuffer)(UA_PubSubChannel *channel, size_t length,
+                                   UA_ByteString *buf);
+    UA_StatusCode (*sendBuffer)(UA_PubSubChannel *channel,
+                                UA_ExtensionObject *transportSettings, UA_ByteString *buf);
+    void (*releaseBuffer)(UA_PubSubChannel *channel, UA_ByteString *buf);
+} UA_PubSubChannelExtension;
+
+/* The extension is referenced, not copied */
+UA_StatusCode UA_EXPORT
+UA_PubSubChannel_setExtension(UA_PubSubChannel *channel,
+                              const UA_PubSubChannelExtension *extension);
+
+void UA_EXPORT
+UA_PubSubChannel_removeExtension(UA_PubSubChannel *channel);
+
+/* Returns NULL if the transport registered no extension */
+const UA_PubSubChannelExtension UA_EXPORT *
+UA_PubSubChannel_getExtension(const UA_PubSubChannel *channel);
+
+#endif /* UA_ENABLE_PUBSUB */
+
+_UA_END_DECLS
+
+#endif /* UA_PLUGIN_PUBSUB_CHANNEL_EXT_H_ */
@@ -0,0 +1,52 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef UA_PLUGIN_PUBSUB_ETHERNET_RING_H_
+#define UA_PLUGIN_PUBSUB_ETHERNET_RING_H_
+
+#include <open62541/plugin/pubsub.h>
+
+_UA_BEGIN_DECLS
+
+/**
+ * Ethernet Transport on Memory-Mapped Rings
+ * -----------------------------------------
+ * Alternative implementation of the ``pubsub-eth-uadp`` transport profile for
+ * Linux. Frames are exchanged through rings that are shared with the kernel,
+ * so that sending and receiving needs no system call per frame:
+ *
+ * - ``mmap`` (default): ``PACKET_MMAP`` with ``TPACKET_V3`` receive and
+ *   transmit rings. Transmit frames are queued in the ring and sent in one
+ *   batch when the publish cycle ends (``yield``).
+ * - ``xdp``: an ``AF_XDP`` socket with a UMEM. Requires libxdp and
+ *   ``UA_ENABLE_PUBSUB_ETH_XDP``. Unless ``xdpSkipProgLoad`` is set, the
+ *   default XDP program of libxdp is attached. It redirects *all* frames of
+ *   the selected queue to the socket, so the mode is meant for an interface
+ *   or queue that is dedicated to PubSub (e.g. one end of a veth pair).
+ *   Frames of other EtherTypes are dropped.
+ *
+ * The URL format is ``opc.eth://<MAC>[:<VID>[.<PCP>]]`` with the MAC address
+ * written as ``01-00-5E-00-00-01``. ``networkInterface`` holds the interface
+ * name. The transport layer serves the same profile URI as
+ * ``UA_PubSubTransportLayerEthernet``. It must be registered before that layer
+ * in ``config->pubsubTransportLayers`` to be selected.
+ *
+ * Connection properties:
+ *
+ * - ``mode`` (String): ``mmap`` or ``xdp``
+ * - ``frames`` (UInt32): frames per ring and direction (power of two, at
+ *   least 32, default 256)
+ * - ``xdpQueue`` (UInt32): receive queue for the ``AF_XDP`` socket
+ *   (default 0)
+ * - ``xdpSkipProgLoad`` (Boolean): do not attach an XDP program. A program
+ *   that redirects the PubSub frames into the ``xsks_map`` must be loaded by
+ *   other means. */
+
+UA_PubSubTransportLayer UA_EXPORT
+UA_PubSubTransportLayerEthernetRing(void);
+
+_UA_END_DECLS
+
+#endif /* UA_PLUGIN_PUBSUB_ETHERNET_RING_H_ */
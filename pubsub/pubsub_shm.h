@@ -0,0 +1,43 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef UA_PLUGIN_PUBSUB_SHM_H_
+#define UA_PLUGIN_PUBSUB_SHM_H_
+
+#include <open62541/plugin/pubsub.h>
+
+_UA_BEGIN_DECLS
+
+/**
+ * Shared Memory Transport
+ * -----------------------
+ * Delivers encoded NetworkMessages to subscribers on the same host through a
+ * ring in POSIX shared memory. The URL ``opc.shm://<name>`` selects the
+ * shared memory object ``/ua_pubsub_<name>``. It is created by the first
+ * channel that opens it and is not removed when the channels are closed.
+ *
+ * The ring has a single writer and any number of readers. The writer never
+ * waits for readers: a reader that falls behind by more than the ring size
+ * loses the oldest messages. Every slot carries a sequence number, so that a
+ * reader detects slots that are overwritten while it copies them. Neither
+ * side needs a system call while messages are available. Readers that run out
+ * of messages sleep on a futex in the ring header and are woken by the writer.
+ *
+ * Connection properties:
+ *
+ * - ``slots`` (UInt32): number of messages in the ring (power of two,
+ *   default 256)
+ * - ``slotSize`` (UInt32): maximum message size in bytes (default 2048)
+ *
+ * All channels of one ring must use the same values. */
+
+#define UA_PUBSUB_SHM_PROFILE_URI "http://open62541.org/UA-Profile/Transport/pubsub-shm-uadp"
+
+UA_PubSubTransportLayer UA_EXPORT
+UA_PubSubTransportLayerSHM(void);
+
+_UA_END_DECLS
+
+#endif /* UA_PLUGIN_PUBSUB_SHM_H_ */
@@ -0,0 +1,51 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef UA_PLUGIN_PUBSUB_UDP_URING_H_
+#define UA_PLUGIN_PUBSUB_UDP_URING_H_
+
+#include <open62541/plugin/pubsub.h>
+
+_UA_BEGIN_DECLS
+
+/**
+ * UDP Multicast Transport on io_uring
+ * -----------------------------------
+ * Alternative implementation of the ``pubsub-udp-uadp`` transport profile for
+ * Linux (kernel 6.0 or later, liburing 2.4 or later). Outgoing NetworkMessages
+ * are copied into registered buffers and queued as fixed-buffer writes. The
+ * queue is submitted to the kernel in one batch when the publish cycle ends
+ * (``yield``). Reception uses a multishot receive with a provided buffer ring,
+ * so that no system call is needed while datagrams are queued.
+ *
+ * The transport layer serves the same profile URI as
+ * ``UA_PubSubTransportLayerUDPMP``. It must be registered before the UDP-MP
+ * layer in ``config->pubsubTransportLayers`` to be selected.
+ *
+ * Connection properties in addition to ``ttl``, ``loopback`` and ``reuse``:
+ *
+ * - ``slots`` (UInt32): number of registered transmit buffers and provided
+ *   receive buffers (power of two, default 64)
+ * - ``slotSize`` (UInt32): size of each buffer in bytes (default 9000). Larger
+ *   messages are sent synchronously. Larger datagrams are truncated.
+ * - ``txtimeClock`` (String): clock of the launch times, ``tai`` (default, for
+ *   the etf qdisc) or ``monotonic`` (for the fq qdisc)
+ * - ``zeroCopyThreshold`` (UInt32): messages of this size in bytes or larger
+ *   are sent with ``IORING_OP_SEND_ZC`` (default 4096, 0 disables it). The
+ *   kernel then sends from the slot without copying it. The slot is reused
+ *   after the completion notification of the kernel.
+ *
+ * The channels support launch times (``SO_TXTIME``) through the channel
+ * extension, see ``UA_Server_setWriterGroupPublishingOffset``. They also send
+ * without blocking for ``UA_Server_setPubSubConnectionTxQueue``. The publisher
+ * encodes NetworkMessages directly into free transmit slots, so a message is
+ * neither allocated nor copied in user space. */
+
+UA_PubSubTransportLayer UA_EXPORT
+UA_PubSubTransportLayerUDPUring(void);
+
+_UA_END_DECLS
+
+#endif /* UA_PLUGIN_PUBSUB_UDP_URING_H_ */
@@ -0,0 +1,204 @@
+/* This work is licensed under a Creative Commons CCZero 1.0 Universal License.
+ * See http://creativecommons.org/publicdomain/zero/1.0/ for more information.
+ */
+
+/**
+ * Capture Replay
+ * --------------
+ * Replays a capture file recorded with ``subscribe_time -capture`` (or a
+ * tcpdump capture of the PubSub traffic) with the recorded pacing, N times
+ * faster or as fast as possible.
+ *
+ * By default the messages are fed to the subscriber pipeline in-process:
+ * reader filter, decoding and the last-value cache. The time spent in decoding
+ * and in the cache is printed per message, which gives the throughput ceiling
+ * of a polling subscriber without the network. With ``-send <url>`` the
+ * messages are sent over UDP instead, for example to a ``subscribe_time`` on
+ * the loopback interface.
+ *
+ * Usage: replay_pubsub <file> [-speed <factor>] [-loop <n>]
+ *                      [-filter <writerGroupId> <dataSetWriterId>] [-send <url>]
+ *
+ * ``-speed 0`` replays as fast as possible, ``-speed 1`` (default) with the
+ * recorded pacing. */
+
+#include <open62541/plugin/log_stdout.h>
+#include <open62541/plugin/pubsub_udp.h>
+#include <open62541/server.h>
+
+#include "ua_pubsub_networkmessage.h"
+#include "ua_pubsub_capture.h"
+#include "ua_pubsub_lvc.h"
+#include "ua_pubsub_readerfilter.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+static UA_UInt64
+nowNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (UA_UInt64)ts.tv_sec * 1000000000 + (UA_UInt64)ts.tv_nsec;
+}
+
+static void
+sleepUntilNs(UA_UInt64 deadline) {
+    struct timespec ts;
+    ts.tv_sec = (time_t)(deadline / 1000000000);
+    ts.tv_nsec = (long)(deadline % 1000000000);
+    while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) != 0) {}
+}
+
+typedef struct {
+    size_t messages;
+    size_t bytes;
+    size_t filtered;
+    size_t decodeErrors;
+    size_t sendErrors;
+    UA_UInt64 decodeNs;
+    UA_UInt64 dispatchNs;
+    UA_UInt64 maxLateNs;  /* behind the recorded pacing */
+} ReplayStatistics;
+
+int main(int argc, char **argv) {
+    if(argc < 2 || strcmp(argv[1], "-h") == 0) {
+        printf("Usage: %s <file> [-speed <factor>] [-loop <n>]\n"
+               "       [-filter <writerGroupId> <dataSetWriterId>] [-send <url>]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    double speed = 1.0;
+    size_t loops = 1;
+    const char *sendUrl = NULL;
+    UA_PubSubReaderFilter filter;
+    memset(&filter, 0, sizeof(filter));
+    for(int i = 2; i < argc; i++) {
+        if(strcmp(argv[i], "-speed") == 0 && i + 1 < argc) {
+            speed = strtod(argv[++i], NULL);
+        } else if(strcmp(argv[i], "-loop") == 0 && i + 1 < argc) {
+            loops = (size_t)strtoul(argv[++i], NULL, 10);
+        } else if(strcmp(argv[i], "-filter") == 0 && i + 2 < argc) {
+            filter.writerGroupId = (UA_UInt16)strtoul(argv[++i], NULL, 10);
+            filter.dataSetWriterId = (UA_UInt16)strtoul(argv[++i], NULL, 10);
+        } else if(strcmp(argv[i], "-send") == 0 && i + 1 < argc) {
+            sendUrl = argv[++i];
+        } else {
+            printf("Error: unknown option %s\n", argv[i]);
+            return EXIT_FAILURE;
+        }
+    }
+    if(speed < 0.0 || loops == 0) {
+        printf("Error: invalid speed or loop count\n");
+        return EXIT_FAILURE;
+    }
+
+    UA_PubSubCapture *capture = UA_PubSubCapture_open(argv[1]);
+    if(!capture) {
+        printf("Error: cannot read the capture file %s\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+
+    /* Send over UDP or decode in-process */
+    UA_PubSubChannel *channel = NULL;
+    UA_PubSubLastValueCache *lastValueCache = NULL;
+    if(sendUrl) {
+        UA_PubSubTransportLayer layer = UA_PubSubTransportLayerUDPMP();
+        UA_PubSubConnectionConfig connectionConfig;
+        memset(&connectionConfig, 0, sizeof(connectionConfig));
+        connectionConfig.name = UA_STRING("Replay Connection");
+        connectionConfig.transportProfileUri = layer.transportProfileUri;
+        connectionConfig.enabled = UA_TRUE;
+        UA_NetworkAddressUrlDataType networkAddressUrl =
+            {UA_STRING_NULL, UA_STRING((char *)(uintptr_t)sendUrl)};
+        UA_Variant_setScalar(&connectionConfig.address, &networkAddressUrl,
+                             &UA_TYPES[UA_TYPES_NETWORKADDRESSURLDATATYPE]);
+        channel = layer.createPubSubChannel(&connectionConfig);
+        if(!channel) {
+            printf("Error: cannot open a channel to %s\n", sendUrl);
+            UA_PubSubCapture_close(capture);
+            return EXIT_FAILURE;
+        }
+    } else {
+        lastValueCache = UA_PubSubLastValueCache_new();
+    }
+
+    ReplayStatistics stats;
+    memset(&stats, 0, sizeof(stats));
+    UA_UInt64 start = nowNs();
+    UA_UInt64 loopStart = start;
+    for(size_t loop = 0; loop < loops; loop++) {
+        UA_UInt64 firstTimestamp = 0;
+        UA_UInt64 lastDeadline = loopStart;
+        UA_UInt64 timestamp;
+        UA_ByteString message;
+        while(UA_PubSubCapture_read(capture, &timestamp, &message) == UA_STATUSCODE_GOOD) {
+            /* Wait for the recorded offset from the first message */
+            if(firstTimestamp == 0)
+                firstTimestamp = timestamp;
+            if(speed > 0.0 && timestamp >= firstTimestamp) {
+                UA_UInt64 deadline = loopStart +
+                    (UA_UInt64)((double)(timestamp - firstTimestamp) / speed);
+                UA_UInt64 now = nowNs();
+                if(deadline > now)
+                    sleepUntilNs(deadline);
+                else if(now - deadline > stats.maxLateNs)
+                    stats.maxLateNs = now - deadline;
+                lastDeadline = deadline;
+            }
+            stats.messages++;
+            stats.bytes += message.length;
+
+            if(channel) {
+                if(channel->send(channel, NULL, &message) != UA_STATUSCODE_GOOD)
+                    stats.sendErrors++;
+                continue;
+            }
+
+            if(!UA_PubSubReaderFilter_match(&filter, &message)) {
+                stats.filtered++;
+                continue;
+            }
+            UA_UInt64 t0 = nowNs();
+            UA_NetworkMessage networkMessage;
+            memset(&networkMessage, 0, sizeof(UA_NetworkMessage));
+            size_t offset = 0;
+            UA_StatusCode res = UA_NetworkMessage_decodeBinary(&message, &offset, &networkMessage);
+            UA_UInt64 t1 = nowNs();
+            stats.decodeNs += t1 - t0;
+            if(res != UA_STATUSCODE_GOOD) {
+                stats.decodeErrors++;
+                UA_NetworkMessage_clear(&networkMessage);
+                continue;
+            }
+            UA_PubSubLastValueCache_processNetworkMessage(lastValueCache, &networkMessage);
+            UA_NetworkMessage_clear(&networkMessage);
+            stats.dispatchNs += nowNs() - t1;
+        }
+        UA_PubSubCapture_rewind(capture);
+        /* The next loop continues the pacing after the last message */
+        loopStart = lastDeadline;
+    }
+    UA_UInt64 elapsed = nowNs() - start;
+
+    printf("%zu messages, %zu bytes in %.3f s: %.0f msgs/s, %.1f MB/s\n",
+           stats.messages, stats.bytes, (double)elapsed / 1e9,
+           (double)stats.messages * 1e9 / (double)(elapsed ? elapsed : 1),
+           (double)stats.bytes * 1e3 / (double)(elapsed ? elapsed : 1));
+    if(speed > 0.0)
+        printf("max. %.1f us behind the recorded pacing\n", (double)stats.maxLateNs / 1e3);
+    if(channel) {
+        printf("%zu send errors\n", stats.sendErrors);
+        channel->close(channel);
+    } else {
+        size_t processed = stats.messages - stats.filtered;
+        printf("%zu filtered, %zu decode errors\n", stats.filtered, stats.decodeErrors);
+        size_t decoded = processed - stats.decodeErrors;
+        printf("decode %.0f ns/msg, last-value cache %.0f ns/msg\n",
+               (double)stats.decodeNs / (double)(processed ? processed : 1),
+               (double)stats.dispatchNs / (double)(decoded ? decoded : 1));
+        UA_PubSubLastValueCache_delete(lastValueCache);
+    }
+    UA_PubSubCapture_close(capture);
+    return EXIT_SUCCESS;
+}
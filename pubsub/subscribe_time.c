@@ -21,6 +21,28 @@
 
 #include "ua_pubsub.h"
 #include "ua_pubsub_networkmessage.h"
+#include "ua_pubsub_lvc.h"
+#include "ua_pubsub_readerfilter.h"
+#include "ua_pubsub_capture.h"
+#include "ua_pubsub_chunk.h"
+#include "ua_pubsub_codec.h"
+#include "ua_pubsub_compress.h"
+#include "ua_pubsub_trace.h"
+#ifdef UA_ENABLE_PUBSUB_GENERATED_CODEC
+#include "publish_time_codec.h"
+#endif
+#ifdef UA_ENABLE_PUBSUB_RECEIVER
+#include "ua_pubsub_receiver.h"
+#endif
+#ifdef UA_ENABLE_PUBSUB_UDP_URING
+#include "pubsub_udp_uring.h"
+#endif
+#ifdef UA_ENABLE_PUBSUB_ETH_RING
+#include "pubsub_ethernet_ring.h"
+#endif
+#ifdef UA_ENABLE_PUBSUB_SHM
+#include "pubsub_shm.h"
+#endif
 #ifdef UA_ENABLE_PUBSUB_ETH_UADP
 #include <open62541/plugin/pubsub_ethernet.h>
 #endif
@@ -31,10 +53,15 @@
 #include <stdlib.h>
 #include <inttypes.h>
 
+/* Holds a chunk of a full Ethernet frame */
+#define RECEIVE_BUFFER_SIZE 2048
+
 size_t counter = 0;
 size_t sample_count = 10;
 size_t poll_count1 = 0;
 size_t var_length = 5;
+size_t shards_count = 0;
+UA_Double compress_scale = 0;
 
 typedef struct measurements{
     size_t sequence;
@@ -46,6 +73,20 @@ typedef struct measurements{
 
 measurement *measure;
 
+UA_PubSubLastValueCache *lastValueCache;
+UA_ChunkReassembler *reassembler;
+UA_PubSubReaderFilter readerFilter;
+const char *captureFile = NULL;
+UA_PubSubCapture *capture = NULL;
+
+/* The array of publish_time (the fourth field) is compressed with -compress */
+#define PUBLISH_TIME_WRITER_ID 62541
+#define PUBLISH_TIME_FIELDS 4
+UA_FieldCompression fieldCompressions[PUBLISH_TIME_FIELDS];
+UA_DataSetCompression dataSetCompression =
+    {PUBLISH_TIME_WRITER_ID, PUBLISH_TIME_FIELDS, fieldCompressions};
+size_t compressionsSize = 0;
+
 UA_Boolean running = true;
 static void stopHandler(int sign) {
     UA_LOG_INFO(UA_Log_Stdout, UA_LOGCATEGORY_SERVER, "received ctrl-c");
@@ -55,56 +96,39 @@ static void stopHandler(int sign) {
 //Allocate memory for measurement structure
 
 
+/* Print the values of a decoded NetworkMessage and record the measurement */
 static void
-subscriptionPollingCallback(UA_Server *server, UA_PubSubConnection *connection) {
-
-    UA_ByteString buffer;
-    if (UA_ByteString_allocBuffer(&buffer, 512) != UA_STATUSCODE_GOOD) {
-        UA_LOG_ERROR(UA_Log_Stdout, UA_LOGCATEGORY_SERVER,
-                     "Message buffer allocation failed!");
+handleNetworkMessage(UA_NetworkMessage *networkMessage) {
+    /* The measurements are freed once the samples are written */
+    if(!running)
         return;
-    }
-
-    /* Receive the message. Blocks for 5ms */
-    UA_StatusCode retval =
-            connection->channel->receive(connection->channel, &buffer, NULL, 5);
-    if(retval != UA_STATUSCODE_GOOD || buffer.length == 0) {
-        /* Workaround!! Reset buffer length. Receive can set the length to zero.
-         * Then the buffer is not deleted because no memory allocation is
-         * assumed.
-         * TODO: Return an error code in 'receive' instead of setting the buf
-         * length to zero. */
-        buffer.length = 512;
-        UA_ByteString_clear(&buffer);
-        return;
-    }
-
-    /* Decode the message */
-    UA_LOG_INFO(UA_Log_Stdout, UA_LOGCATEGORY_USERLAND,
-                "Message length: %lu", (unsigned long) buffer.length);
-    UA_NetworkMessage networkMessage;
-
-    memset(&networkMessage, 0, sizeof(UA_NetworkMessage));
-    size_t currentPosition = 0;
-    UA_NetworkMessage_decodeBinary(&buffer, &currentPosition, &networkMessage);
-    UA_ByteString_clear(&buffer);
 
-    if (networkMessage.publisherIdEnabled){
+    if (networkMessage->publisherIdEnabled){
         printf("Enabled");
     }
     /* Is this the correct message type? */
-    if(networkMessage.networkMessageType != UA_NETWORKMESSAGE_DATASET)
-        goto cleanup;
+    if(networkMessage->networkMessageType != UA_NETWORKMESSAGE_DATASET)
+        return;
 
     /* At least one DataSetMessage in the NetworkMessage? */
-    if(networkMessage.payloadHeaderEnabled &&
-       networkMessage.payloadHeader.dataSetPayloadHeader.count < 1)
-        goto cleanup;
+    if(networkMessage->payloadHeaderEnabled &&
+       networkMessage->payloadHeader.dataSetPayloadHeader.count < 1)
+        return;
 
-    /* Is this a KeyFrame-DataSetMessage? */
-    UA_DataSetMessage *dsm = &networkMessage.payload.dataSetPayload.dataSetMessages[0];
-    if(dsm->header.dataSetMessageType != UA_DATASETMESSAGE_DATAKEYFRAME)
-        goto cleanup;
+    /* Apply key and delta frames to the last-value cache */
+    UA_DataSetMessage *dsm = &networkMessage->payload.dataSetPayload.dataSetMessages[0];
+    UA_PubSubLastValueCache_processNetworkMessage(lastValueCache, networkMessage);
+
+    /* Is the DataSet of the first DataSetMessage complete? */
+    UA_Variant publisherId;
+    UA_NetworkMessage_getPublisherId(networkMessage, &publisherId);
+    UA_UInt16 dataSetWriterId = networkMessage->payloadHeaderEnabled ?
+        networkMessage->payloadHeader.dataSetPayloadHeader.dataSetWriterIds[0] : 0;
+    size_t fieldsSize = 0;
+    const UA_DataValue *fields =
+        UA_PubSubLastValueCache_getDataSet(lastValueCache, &publisherId, dataSetWriterId, &fieldsSize);
+    if(!fields)
+        return;
 
     //UA_UInt16  sequence_no = dsm->header.dataSetMessageSequenceNr;
     if(dsm->header.dataSetMessageSequenceNrEnabled){
@@ -114,7 +138,7 @@ subscriptionPollingCallback(UA_Server *server, UA_PubSubConnection *connection)
     }
 
     /* Loop over the fields and print well-known content types */
-    for(int i = 0; i < dsm->data.keyFrameData.fieldCount; i++) {
+    for(size_t i = 0; i < fieldsSize; i++) {
 
         UA_String publisherId = UA_STRING("dummy");
         UA_DateTime currTime = UA_DateTime_nowMonotonic();
@@ -123,10 +147,10 @@ subscriptionPollingCallback(UA_Server *server, UA_PubSubConnection *connection)
         UA_Double doubleVal = 0.0;
         size_t variant_length = 10;
 
-        const UA_DataType *currentType = dsm->data.keyFrameData.dataSetFields[i].value.type;
+        const UA_DataType *currentType = fields[i].value.type;
 
         if(currentType == &UA_TYPES[UA_TYPES_STRING]) {
-            publisherId = *(UA_String *)dsm->data.keyFrameData.dataSetFields[i].value.data;
+            publisherId = *(UA_String *)fields[i].value.data;
 
             /*Convert the string to char* */
             char* pubId = (char*)UA_malloc(sizeof(char)*publisherId.length+1);
@@ -140,20 +164,20 @@ subscriptionPollingCallback(UA_Server *server, UA_PubSubConnection *connection)
 
         if(currentType == &UA_TYPES[UA_TYPES_DATETIME]){
 
-            receivedTime = *(UA_DateTime *)dsm->data.keyFrameData.dataSetFields[i].value.data;
+            receivedTime = *(UA_DateTime *)fields[i].value.data;
 
             measure[poll_count1].currentTime = currTime;
             measure[poll_count1].receiveTime = receivedTime;
         }
 
         if (currentType == &UA_TYPES[UA_TYPES_UINT32]) {
-            intVal= *(UA_UInt32 *)dsm->data.keyFrameData.dataSetFields[i].value.data;
+            intVal= *(UA_UInt32 *)fields[i].value.data;
             UA_LOG_INFO(UA_Log_Stdout, UA_LOGCATEGORY_USERLAND,
                         "Message content: [Integer] \tReceived integer: %u", intVal);
         }
 
         if (currentType == &UA_TYPES[UA_TYPES_DOUBLE]) {
-            UA_Variant *variant = &dsm->data.keyFrameData.dataSetFields[i].value;
+            const UA_Variant *variant = &fields[i].value;
             variant_length = variant->arrayLength;
             var_length = variant_length;
             printf("variant length %d\n", variant_length);
@@ -209,11 +233,109 @@ subscriptionPollingCallback(UA_Server *server, UA_PubSubConnection *connection)
         free(measure);
         running = false;
     }
+}
+
+static void
+subscriptionPollingCallback(UA_Server *server, UA_PubSubConnection *connection) {
+
+    UA_ByteString buffer;
+    if (UA_ByteString_allocBuffer(&buffer, RECEIVE_BUFFER_SIZE) != UA_STATUSCODE_GOOD) {
+        UA_LOG_ERROR(UA_Log_Stdout, UA_LOGCATEGORY_SERVER,
+                     "Message buffer allocation failed!");
+        return;
+    }
+
+    /* Receive the message. Blocks for 5ms */
+    UA_StatusCode retval =
+            connection->channel->receive(connection->channel, &buffer, NULL, 5);
+    if(retval != UA_STATUSCODE_GOOD || buffer.length == 0) {
+        /* Workaround!! Reset buffer length. Receive can set the length to zero.
+         * Then the buffer is not deleted because no memory allocation is
+         * assumed.
+         * TODO: Return an error code in 'receive' instead of setting the buf
+         * length to zero. */
+        buffer.length = RECEIVE_BUFFER_SIZE;
+        UA_ByteString_clear(&buffer);
+        return;
+    }
+    UA_PUBSUB_TRACE(rx_received, 0, buffer.length);
 
-    cleanup:
+    /* Record all received messages with the receive time for replay_pubsub */
+    if(capture)
+        UA_PubSubCapture_write(capture, 0, &buffer);
+
+    /* Skip the messages of other WriterGroups and DataSetWriters that were
+     * not dropped by the kernel */
+    if(!UA_PubSubReaderFilter_match(&readerFilter, &buffer)) {
+        UA_ByteString_clear(&buffer);
+        return;
+    }
+
+    /* Decode the message */
+    UA_LOG_INFO(UA_Log_Stdout, UA_LOGCATEGORY_USERLAND,
+                "Message length: %lu", (unsigned long) buffer.length);
+    UA_NetworkMessage networkMessage;
+
+    memset(&networkMessage, 0, sizeof(UA_NetworkMessage));
+
+    /* Large DataSets arrive in chunks. Handle them once they are complete. */
+    if(UA_NetworkMessage_isChunk(&buffer, 0)) {
+        UA_Boolean complete = false;
+        retval = UA_ChunkReassembler_add(reassembler, &buffer, UA_DateTime_nowMonotonic(),
+                                         &networkMessage, &complete);
+        UA_ByteString_clear(&buffer);
+        if(retval != UA_STATUSCODE_GOOD || !complete)
+            return;
+        if(compressionsSize > 0)
+            UA_NetworkMessage_expandFields(&networkMessage, compressionsSize,
+                                           &dataSetCompression);
+        handleNetworkMessage(&networkMessage);
+        UA_NetworkMessage_clear(&networkMessage);
+        return;
+    }
+
+    size_t currentPosition = 0;
+#ifdef UA_ENABLE_PUBSUB_GENERATED_CODEC
+    /* Decode the fields of publish_time with the generated code. The
+     * compressed array does not match the generated layout. */
+    const UA_DataSetCodec *codec = &UA_DataSetCodec_PublishTime;
+    if(compressionsSize == 0)
+        retval = UA_NetworkMessage_decodeBinaryCodec(&buffer, &currentPosition,
+                                                     &networkMessage, &codec, 1);
+    else
+        retval = UA_NetworkMessage_decodeBinary(&buffer, &currentPosition, &networkMessage);
+#else
+    retval = UA_NetworkMessage_decodeBinary(&buffer, &currentPosition, &networkMessage);
+#endif
+    /* Back to Doubles before the delta frames are applied */
+    if(retval == UA_STATUSCODE_GOOD && compressionsSize > 0)
+        retval = UA_NetworkMessage_expandFields(&networkMessage, compressionsSize,
+                                                &dataSetCompression);
+    UA_PUBSUB_TRACE(rx_decoded, UA_PubSubTrace_writerGroupId(&networkMessage),
+                    UA_PubSubTrace_dataSetWriterId(&networkMessage),
+                    UA_PubSubTrace_sequenceNumber(&networkMessage), buffer.length, retval);
+    UA_ByteString_clear(&buffer);
+
+    UA_PUBSUB_TRACE(rx_dispatched, UA_PubSubTrace_writerGroupId(&networkMessage),
+                    UA_PubSubTrace_dataSetWriterId(&networkMessage),
+                    UA_PubSubTrace_sequenceNumber(&networkMessage), 0);
+    handleNetworkMessage(&networkMessage);
     UA_NetworkMessage_clear(&networkMessage);
 }
 
+#ifdef UA_ENABLE_PUBSUB_RECEIVER
+static void
+shardedMessageCallback(void *context, UA_NetworkMessage *networkMessage) {
+    handleNetworkMessage(networkMessage);
+}
+
+/* The workers of the receiver have decoded the messages already */
+static void
+shardedPollingCallback(UA_Server *server, UA_PubSubReceiver *receiver) {
+    UA_PubSubReceiver_process(receiver, SIZE_MAX, shardedMessageCallback, NULL);
+}
+#endif
+
 static int
 run(UA_String *transportProfile, UA_NetworkAddressUrlDataType *networkAddressUrl) {
     signal(SIGINT, stopHandler);
@@ -225,18 +347,44 @@ run(UA_String *transportProfile, UA_NetworkAddressUrlDataType *networkAddressUrl
 
     measure = (measurement *)malloc(sample_count*sizeof(measurement));
 
+    /* The same settings as the publisher */
+    if(compress_scale > 0) {
+        UA_FieldCompression compression =
+            {UA_FIELDCOMPRESSION_SCALEDINT16, compress_scale, 0.0, true};
+        fieldCompressions[PUBLISH_TIME_FIELDS - 1] = compression;
+        compressionsSize = 1;
+    }
+
     /* Details about the PubSubTransportLayer can be found inside the
      * tutorial_pubsub_connection */
     config->pubsubTransportLayers = (UA_PubSubTransportLayer *)
-            UA_calloc(2, sizeof(UA_PubSubTransportLayer));
+            UA_calloc(5, sizeof(UA_PubSubTransportLayer));
     if(!config->pubsubTransportLayers) {
         UA_Server_delete(server);
         return EXIT_FAILURE;
     }
-    config->pubsubTransportLayers[0] = UA_PubSubTransportLayerUDPMP();
+#ifdef UA_ENABLE_PUBSUB_UDP_URING
+    /* Serves the same profile as UDP-MP and is found first */
+    config->pubsubTransportLayers[config->pubsubTransportLayersSize] =
+        UA_PubSubTransportLayerUDPUring();
+    config->pubsubTransportLayersSize++;
+#endif
+    config->pubsubTransportLayers[config->pubsubTransportLayersSize] =
+        UA_PubSubTransportLayerUDPMP();
     config->pubsubTransportLayersSize++;
+#ifdef UA_ENABLE_PUBSUB_SHM
+    config->pubsubTransportLayers[config->pubsubTransportLayersSize] =
+        UA_PubSubTransportLayerSHM();
+    config->pubsubTransportLayersSize++;
+#endif
 #ifdef UA_ENABLE_PUBSUB_ETH_UADP
-    config->pubsubTransportLayers[1] = UA_PubSubTransportLayerEthernet();
+#ifdef UA_ENABLE_PUBSUB_ETH_RING
+    config->pubsubTransportLayers[config->pubsubTransportLayersSize] =
+        UA_PubSubTransportLayerEthernetRing();
+    config->pubsubTransportLayersSize++;
+#endif
+    config->pubsubTransportLayers[config->pubsubTransportLayersSize] =
+        UA_PubSubTransportLayerEthernet();
     config->pubsubTransportLayersSize++;
 #endif
 
@@ -257,11 +405,45 @@ run(UA_String *transportProfile, UA_NetworkAddressUrlDataType *networkAddressUrl
     /* The following lines register the listening on the configured multicast
      * address and configure a repeated job, which is used to handle received
      * messages. */
+#ifdef UA_ENABLE_PUBSUB_RECEIVER
+    /* Receive and decode on one worker thread per shard instead */
+    UA_PubSubReceiver *receiver = NULL;
+    if(shards_count > 0) {
+        UA_PubSubReceiverConfig receiverConfig;
+        memset(&receiverConfig, 0, sizeof(receiverConfig));
+        receiverConfig.shardsSize = shards_count;
+        receiverConfig.pinWorkers = true;
+        receiverConfig.filter = readerFilter;
+        receiverConfig.compressionsSize = compressionsSize;
+        receiverConfig.compressions = &dataSetCompression;
+        receiver = UA_PubSubReceiver_new(&connectionConfig, &receiverConfig);
+        if(receiver) {
+            UA_UInt64 receiverCallbackId;
+            UA_Server_addRepeatedCallback(server, (UA_ServerCallback)shardedPollingCallback,
+                                          receiver, 10, &receiverCallbackId);
+        }
+    }
+    UA_PubSubConnection *connection = receiver ? NULL :
+            UA_PubSubConnection_findConnectionbyId(server, connectionIdent);
+#else
     UA_PubSubConnection *connection =
             UA_PubSubConnection_findConnectionbyId(server, connectionIdent);
+#endif
+    if(connection != NULL && captureFile) {
+        capture = UA_PubSubCapture_create(captureFile, networkAddressUrl);
+        if(!capture)
+            UA_LOG_WARNING(UA_Log_Stdout, UA_LOGCATEGORY_SERVER,
+                           "Cannot create the capture file %s", captureFile);
+    }
     if(connection != NULL) {
         UA_StatusCode rv = connection->channel->regist(connection->channel, NULL, NULL);
         if (rv == UA_STATUSCODE_GOOD) {
+            if(readerFilter.writerGroupId != 0 || readerFilter.dataSetWriterId != 0) {
+                UA_StatusCode filterRv =
+                    UA_PubSubChannel_attachReaderFilter(connection->channel, &readerFilter);
+                UA_LOG_INFO(UA_Log_Stdout, UA_LOGCATEGORY_SERVER,
+                            "Kernel-side reader filter: %s", UA_StatusCode_name(filterRv));
+            }
             UA_UInt64 subscriptionCallbackId;
             UA_Server_addRepeatedCallback(server, (UA_ServerCallback)subscriptionPollingCallback,
                                           connection, 100, &subscriptionCallbackId);
@@ -271,9 +453,17 @@ run(UA_String *transportProfile, UA_NetworkAddressUrlDataType *networkAddressUrl
         }
     }
 
+    lastValueCache = UA_PubSubLastValueCache_new();
+    reassembler = UA_ChunkReassembler_new(NULL);
     retval |= UA_Server_run(server, &running);
 
     UA_Server_delete(server);
+#ifdef UA_ENABLE_PUBSUB_RECEIVER
+    UA_PubSubReceiver_delete(receiver);
+#endif
+    UA_PubSubLastValueCache_delete(lastValueCache);
+    UA_ChunkReassembler_delete(reassembler);
+    UA_PubSubCapture_close(capture);
     return retval == UA_STATUSCODE_GOOD ? EXIT_SUCCESS : EXIT_FAILURE;;
 }
 
@@ -281,6 +471,12 @@ run(UA_String *transportProfile, UA_NetworkAddressUrlDataType *networkAddressUrl
 static void
 usage(char *progname) {
     printf("usage: %s <uri> [device]\n", progname);
+    printf("       %s -filter <writerGroupId> <dataSetWriterId>\n", progname);
+    printf("       %s -capture <file> [uri]\n", progname);
+    printf("       %s -compress <scale> [uri]\n", progname);
+#ifdef UA_ENABLE_PUBSUB_RECEIVER
+    printf("       %s -shards <n> [-compress <scale>]\n", progname);
+#endif
 }
 
 int main(int argc, char **argv) {
@@ -305,6 +501,12 @@ int main(int argc, char **argv) {
             networkAddressUrl.networkInterface = UA_STRING(argv[2]);
             networkAddressUrl.url = UA_STRING(argv[1]);
         }
+#ifdef UA_ENABLE_PUBSUB_SHM
+        else if (strncmp(argv[1], "opc.shm://", 10) == 0) {
+            transportProfile = UA_STRING(UA_PUBSUB_SHM_PROFILE_URI);
+            networkAddressUrl.url = UA_STRING(argv[1]);
+        }
+#endif
         else if (strcmp(argv[1], "-sample") == 0){
             if (argc < 3){
                 printf("Error: Number of samples not supplied\n");
@@ -315,6 +517,44 @@ int main(int argc, char **argv) {
             printf("samples = %u\n", sample_count);
 
         }
+        else if (strcmp(argv[1], "-filter") == 0) {
+            if (argc < 4) {
+                printf("Error: WriterGroupId and DataSetWriterId not supplied\n");
+                return EXIT_FAILURE;
+            }
+            readerFilter.writerGroupId = (UA_UInt16) strtoul(argv[2], NULL, 10);
+            readerFilter.dataSetWriterId = (UA_UInt16) strtoul(argv[3], NULL, 10);
+        }
+        else if (strcmp(argv[1], "-capture") == 0) {
+            if (argc < 3) {
+                printf("Error: Capture file not supplied\n");
+                return EXIT_FAILURE;
+            }
+            captureFile = argv[2];
+            if (argc > 3 && strncmp(argv[3], "opc.udp://", 10) == 0)
+                networkAddressUrl.url = UA_STRING(argv[3]);
+        }
+        else if (strcmp(argv[1], "-compress") == 0) {
+            if (argc < 3) {
+                printf("Error: Scale of the array values not supplied\n");
+                return EXIT_FAILURE;
+            }
+            compress_scale = atof(argv[2]);
+            printf("array compressed with scale = %s\n", argv[2]);
+            if (argc > 3 && strncmp(argv[3], "opc.udp://", 10) == 0)
+                networkAddressUrl.url = UA_STRING(argv[3]);
+        }
+#ifdef UA_ENABLE_PUBSUB_RECEIVER
+        else if (strcmp(argv[1], "-shards") == 0) {
+            if (argc < 3) {
+                printf("Error: Number of shards not supplied\n");
+                return EXIT_FAILURE;
+            }
+            shards_count = strtoul(argv[2], NULL, 10);
+            if (argc > 4 && strcmp(argv[3], "-compress") == 0)
+                compress_scale = atof(argv[4]);
+        }
+#endif
         else {
             printf("Error: unknown URI\n");
             return EXIT_FAILURE;
@@ -17,6 +17,7 @@
 
 #include "ua_pubsub.h"
 #include "ua_pubsub_networkmessage.h"
+#include "ua_pubsub_lvc.h"
 #ifdef UA_ENABLE_PUBSUB_ETH_UADP
 #include <open62541/plugin/pubsub_ethernet.h>
 #endif
@@ -39,6 +40,8 @@ typedef struct measurements{
 
 measurement *measure;
 
+UA_PubSubLastValueCache *lastValueCache;
+
 UA_Boolean running = true;
 static void stopHandler(int sign) {
     UA_LOG_INFO(UA_Log_Stdout, UA_LOGCATEGORY_SERVER, "received ctrl-c");
@@ -90,18 +93,27 @@ subscriptionPollingCallback(UA_Server *server, UA_PubSubConnection *connection)
        networkMessage.payloadHeader.dataSetPayloadHeader.count < 1)
         goto cleanup;
 
-    /* Is this a KeyFrame-DataSetMessage? */
-    UA_DataSetMessage *dsm = &networkMessage.payload.dataSetPayload.dataSetMessages[0];
-    if(dsm->header.dataSetMessageType != UA_DATASETMESSAGE_DATAKEYFRAME)
+    /* Apply key and delta frames to the last-value cache */
+    UA_PubSubLastValueCache_processNetworkMessage(lastValueCache, &networkMessage);
+
+    /* Is the DataSet of the first DataSetMessage complete? */
+    UA_Variant publisherId;
+    UA_NetworkMessage_getPublisherId(&networkMessage, &publisherId);
+    UA_UInt16 dataSetWriterId = networkMessage.payloadHeaderEnabled ?
+        networkMessage.payloadHeader.dataSetPayloadHeader.dataSetWriterIds[0] : 0;
+    size_t fieldsSize = 0;
+    const UA_DataValue *fields =
+        UA_PubSubLastValueCache_getDataSet(lastValueCache, &publisherId, dataSetWriterId, &fieldsSize);
+    if(!fields)
         goto cleanup;
 
     /* Loop over the fields and print well-known content types */
-    for(int i = 0; i < dsm->data.keyFrameData.fieldCount; i++) {
+    for(size_t i = 0; i < fieldsSize; i++) {
 
-        const UA_DataType *currentType = dsm->data.keyFrameData.dataSetFields[i].value.type;
+        const UA_DataType *currentType = fields[i].value.type;
 
         if(currentType == &UA_TYPES[UA_TYPES_STRING]) {
-            UA_String receivedTime = *(UA_String *)dsm->data.keyFrameData.dataSetFields[i].value.data;
+            UA_String receivedTime = *(UA_String *)fields[i].value.data;
 
             /*Convert the string to char* */
             char* timeReceived = (char*)UA_malloc(sizeof(char)*receivedTime.length+1);
@@ -203,9 +215,11 @@ run(UA_String *transportProfile, UA_NetworkAddressUrlDataType *networkAddressUrl
         }
     }
 
+    lastValueCache = UA_PubSubLastValueCache_new();
     retval |= UA_Server_run(server, &running);
 
     UA_Server_delete(server);
+    UA_PubSubLastValueCache_delete(lastValueCache);
     return retval == UA_STATUSCODE_GOOD ? EXIT_SUCCESS : EXIT_FAILURE;;
 }
 
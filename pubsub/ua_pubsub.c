@@ -11,6 +11,9 @@
 #ifdef UA_ENABLE_PUBSUB /* conditional compilation */
 
 #include "ua_pubsub.h"
+#include "ua_pubsub_ext.h"
+#include "pubsub_channel_ext.h"
+#include "ua_pubsub_trace.h"
 
 #ifdef UA_ENABLE_PUBSUB_INFORMATIONMODEL
 #include "ua_pubsub_ns0.h"
@@ -27,6 +30,905 @@ static void
 UA_WriterGroup_deleteMembers(UA_Server *server, UA_WriterGroup *writerGroup);
 static void
 UA_DataSetField_deleteMembers(UA_DataSetField *field);
+static void
+UA_WriterGroup_disableTrigger(UA_Server *server, UA_WriterGroup *writerGroup);
+static void
+UA_WriterGroup_triggerOnWrite(UA_Server *server, const UA_NodeId *sessionId,
+                              void *sessionContext, const UA_NodeId *nodeId,
+                              void *nodeContext, const UA_NumericRange *range,
+                              const UA_DataValue *data);
+static UA_StatusCode
+UA_WriterGroupConfig_setDefaultMessageSettings(UA_WriterGroupConfig *config);
+static void
+UA_PublishedDataSetCodec_delete(UA_Server *server, const UA_NodeId *publishedDataSet);
+static void
+UA_PubSubTxQueue_delete(const UA_PubSubChannel *channel);
+struct UA_WriterGroupRuntime;
+static void
+UA_WriterGroup_publish(UA_Server *server, struct UA_WriterGroupRuntime *rt);
+static void
+UA_DataSetFieldRuntime_delete(const UA_DataSetField *field);
+static void
+UA_DataSetFieldRuntime_invalidate(void);
+static void
+UA_DataSetFieldRuntimeIndex_delete(UA_Server *server, const UA_NodeId *publishedDataSet);
+static void
+UA_PublishedDataSetSnapshot_delete(UA_Server *server, const UA_NodeId *publishedDataSet);
+
+/**********************************************/
+/*               Runtime state                */
+/**********************************************/
+
+/* Additional state of a WriterGroup that is used by the extensions in
+ * ua_pubsub_ext.h. The entry is created with the WriterGroup and removed
+ * together with it. The publish callbacks get the entry as their data, so
+ * that publishing does not search for it. */
+typedef struct UA_WriterGroupRuntime {
+    LIST_ENTRY(UA_WriterGroupRuntime) listEntry;
+    UA_Server *server;
+    UA_WriterGroup *writerGroup;
+    UA_DateTime lastPublish; /* monotonic */
+
+    /* Event-triggered publishing */
+    UA_Boolean triggerEnabled;
+    UA_WriterGroupTriggerConfig trigger;
+    size_t monitoredNodesSize;
+    UA_NodeId *monitoredNodes;
+    UA_Boolean triggerPending;
+    UA_UInt64 triggerCallbackId;
+    UA_Boolean heartbeatIsRegistered;
+    UA_UInt64 heartbeatCallbackId;
+
+    /* Scheduled transmission */
+    UA_Duration publishingOffset; /* negative if disabled */
+
+    /* Publish scheduler */
+    UA_Duration phase; /* negative if assigned by the scheduler */
+
+    /* Key frame staggering */
+    UA_WriterGroupKeyFrameConfig keyFrame;
+    UA_UInt16 keyFramesInCycle;
+    UA_UInt32 nextKeyFrameSlot;
+
+    /* Chunking */
+    UA_UInt32 maxNetworkMessageSize; /* 0 for no limit */
+
+#ifdef UA_ENABLE_PUBSUB_ENCRYPTION
+    /* Message security with the cached key schedules */
+    UA_PubSubSecurityContext *security;
+#endif
+} UA_WriterGroupRuntime;
+
+static LIST_HEAD(UA_ListOfWriterGroupRuntime, UA_WriterGroupRuntime) writerGroupRuntimes;
+
+static UA_WriterGroupRuntime *
+UA_WriterGroupRuntime_find(UA_WriterGroup *writerGroup) {
+    UA_WriterGroupRuntime *rt;
+    LIST_FOREACH(rt, &writerGroupRuntimes, listEntry) {
+        if(rt->writerGroup == writerGroup)
+            return rt;
+    }
+    return NULL;
+}
+
+/* Find or create the runtime state of the WriterGroup */
+static UA_WriterGroupRuntime *
+UA_WriterGroupRuntime_get(UA_Server *server, UA_WriterGroup *writerGroup) {
+    UA_WriterGroupRuntime *rt = UA_WriterGroupRuntime_find(writerGroup);
+    if(rt)
+        return rt;
+    rt = (UA_WriterGroupRuntime *) UA_calloc(1, sizeof(UA_WriterGroupRuntime));
+    if(!rt)
+        return NULL;
+    rt->server = server;
+    rt->writerGroup = writerGroup;
+    rt->publishingOffset = -1.0;
+    rt->phase = -1.0;
+    LIST_INSERT_HEAD(&writerGroupRuntimes, rt, listEntry);
+    return rt;
+}
+
+static void
+UA_WriterGroupRuntime_delete(UA_Server *server, UA_WriterGroup *writerGroup) {
+    UA_WriterGroupRuntime *rt = UA_WriterGroupRuntime_find(writerGroup);
+    if(!rt)
+        return;
+    if(rt->triggerEnabled)
+        UA_WriterGroup_disableTrigger(server, writerGroup);
+#ifdef UA_ENABLE_PUBSUB_ENCRYPTION
+    UA_PubSubSecurityContext_delete(rt->security);
+#endif
+    LIST_REMOVE(rt, listEntry);
+    UA_free(rt);
+}
+
+#ifdef UA_ENABLE_PUBSUB_DELTAFRAMES
+/* Count a key frame against the budget of the current cycle. Returns false if
+ * the budget is used up. */
+static UA_Boolean
+UA_WriterGroupRuntime_takeKeyFrame(UA_WriterGroupRuntime *rt) {
+    if(!rt || rt->keyFrame.maxKeyFramesPerCycle == 0)
+        return true;
+    if(rt->keyFramesInCycle >= rt->keyFrame.maxKeyFramesPerCycle)
+        return false;
+    rt->keyFramesInCycle++;
+    return true;
+}
+
+/* The delta frame counter after a key frame that was not due, for example
+ * after a version change of the PublishedDataSet. With staggering, the writers
+ * that key frame together are assigned to consecutive slots of the key frame
+ * period. Their next key frames then fall on different cycles. */
+static UA_UInt16
+UA_WriterGroupRuntime_keyFrameCounter(UA_WriterGroupRuntime *rt,
+                                      const UA_DataSetWriter *dataSetWriter) {
+    if(!rt || !rt->keyFrame.staggerKeyFrames)
+        return 0; /* The next message is a key frame as well */
+    /* In 64 bit, the period does not overflow for keyFrameCount UA_UINT32_MAX.
+     * The counter of the writer is 16 bit, later slots are clamped. */
+    UA_UInt64 period = (UA_UInt64)dataSetWriter->config.keyFrameCount + 1;
+    UA_UInt64 slot = 1 + rt->nextKeyFrameSlot++ % period;
+    if(slot > UA_UINT16_MAX)
+        slot = UA_UINT16_MAX;
+    return (UA_UInt16)slot;
+}
+#endif
+
+/**********************************************/
+/*              Publish scheduler             */
+/**********************************************/
+
+/* The cyclic WriterGroups of a server are published from one scheduler that
+ * staggers their phases (see ua_pubsub_scheduler.h). A single timed callback
+ * of the server runs at the next due time. The scheduler of a server is
+ * created with its first cyclic WriterGroup and deleted with the last one.
+ * publishCallbackId of the WriterGroup holds the id of its entry in the
+ * scheduler.
+ *
+ * With UA_ENABLE_PUBSUB_CUSTOM_PUBLISH_HANDLING, the application runs the
+ * publish callbacks (for example in a realtime thread). Every WriterGroup is
+ * then registered on its own with UA_PubSubManager_addRepeatedCallback as
+ * before; phases, priorities and schedule statistics are not available. */
+
+#define UA_PUBSUB_SCHEDULER_RESOLUTION 0.1 /* ms */
+
+static void
+UA_WriterGroup_scheduledPublish(void *application, void *data) {
+    UA_WriterGroup_publish((UA_Server *) application, (UA_WriterGroupRuntime *) data);
+}
+
+#ifndef UA_ENABLE_PUBSUB_CUSTOM_PUBLISH_HANDLING
+
+typedef struct UA_PublishScheduler {
+    LIST_ENTRY(UA_PublishScheduler) listEntry;
+    UA_Server *server;
+    UA_PubSubScheduler *scheduler;
+    UA_Boolean isProcessing;
+    UA_Boolean timerIsRegistered;
+    UA_UInt64 timerId;
+    UA_DateTime timerDue;
+} UA_PublishScheduler;
+
+static LIST_HEAD(UA_ListOfPublishScheduler, UA_PublishScheduler) publishSchedulers;
+
+static UA_PublishScheduler *
+UA_PublishScheduler_find(UA_Server *server) {
+    UA_PublishScheduler *ps;
+    LIST_FOREACH(ps, &publishSchedulers, listEntry) {
+        if(ps->server == server)
+            return ps;
+    }
+    return NULL;
+}
+
+static void
+UA_PublishScheduler_timerCallback(UA_Server *server, void *data);
+
+/* Move the timed callback to the next due time. Deletes the scheduler once
+ * it is empty; ps is then no longer valid. */
+static void
+UA_PublishScheduler_arm(UA_PublishScheduler *ps) {
+    UA_Server *server = ps->server;
+    UA_DateTime due = UA_PubSubScheduler_nextDue(ps->scheduler);
+    if(ps->timerIsRegistered) {
+        if(due == ps->timerDue)
+            return;
+        UA_Server_removeCallback(server, ps->timerId);
+        ps->timerIsRegistered = false;
+    }
+    if(UA_PubSubScheduler_size(ps->scheduler) == 0) {
+        UA_PubSubScheduler_delete(ps->scheduler);
+        LIST_REMOVE(ps, listEntry);
+        UA_free(ps);
+        return;
+    }
+    if(due == 0)
+        return;
+    if(UA_Server_addTimedCallback(server, UA_PublishScheduler_timerCallback, ps,
+                                  due, &ps->timerId) != UA_STATUSCODE_GOOD) {
+        UA_LOG_ERROR(&server->config.logger, UA_LOGCATEGORY_SERVER,
+                     "PubSub Publish: Cannot schedule the WriterGroups");
+        return;
+    }
+    ps->timerIsRegistered = true;
+    ps->timerDue = due;
+}
+
+static void
+UA_PublishScheduler_timerCallback(UA_Server *server, void *data) {
+    UA_PublishScheduler *ps = (UA_PublishScheduler *)data;
+    ps->timerIsRegistered = false;
+    ps->isProcessing = true;
+    UA_PubSubScheduler_process(ps->scheduler, ps->server);
+    ps->isProcessing = false;
+    UA_PublishScheduler_arm(ps);
+}
+
+/* Add an entry for the WriterGroup. The first publish is at the first due
+ * time after notBefore (monotonic, 0 for now). The WriterGroup is not
+ * modified. */
+static UA_StatusCode
+UA_WriterGroup_schedulePublish(UA_Server *server, UA_WriterGroup *writerGroup,
+                               UA_Duration publishingInterval, UA_Byte priority,
+                               UA_DateTime notBefore, UA_UInt64 *callbackId) {
+    UA_WriterGroupRuntime *rt = UA_WriterGroupRuntime_get(server, writerGroup);
+    if(!rt)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    UA_PublishScheduler *ps = UA_PublishScheduler_find(server);
+    if(!ps) {
+        ps = (UA_PublishScheduler *) UA_calloc(1, sizeof(UA_PublishScheduler));
+        if(!ps)
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+        ps->scheduler = UA_PubSubScheduler_new(UA_PUBSUB_SCHEDULER_RESOLUTION);
+        if(!ps->scheduler) {
+            UA_free(ps);
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+        }
+        ps->server = server;
+        LIST_INSERT_HEAD(&publishSchedulers, ps, listEntry);
+    }
+    UA_StatusCode retval =
+        UA_PubSubScheduler_add(ps->scheduler, publishingInterval, rt->phase, priority,
+                               notBefore, UA_WriterGroup_scheduledPublish, rt,
+                               callbackId);
+    /* The timer is moved once the scheduler has processed the due entries */
+    if(!ps->isProcessing)
+        UA_PublishScheduler_arm(ps);
+    return retval;
+}
+
+static void
+UA_WriterGroup_unregisterPublish(UA_Server *server, UA_WriterGroup *writerGroup) {
+    if(!writerGroup->publishCallbackIsRegistered)
+        return;
+    writerGroup->publishCallbackIsRegistered = false;
+    UA_PublishScheduler *ps = UA_PublishScheduler_find(server);
+    if(!ps)
+        return;
+    UA_PubSubScheduler_remove(ps->scheduler, writerGroup->publishCallbackId);
+    if(!ps->isProcessing)
+        UA_PublishScheduler_arm(ps);
+}
+
+static void
+UA_WriterGroup_setPublishPriority(UA_Server *server, UA_WriterGroup *writerGroup) {
+    UA_PublishScheduler *ps = UA_PublishScheduler_find(server);
+    if(writerGroup->publishCallbackIsRegistered && ps)
+        UA_PubSubScheduler_setPriority(ps->scheduler, writerGroup->publishCallbackId,
+                                       writerGroup->config.priority);
+}
+
+static UA_StatusCode
+UA_WriterGroup_getScheduleStatistics(UA_Server *server, UA_WriterGroup *writerGroup,
+                                     UA_PubSubScheduleStatistics *statistics) {
+    UA_PublishScheduler *ps = UA_PublishScheduler_find(server);
+    if(!writerGroup->publishCallbackIsRegistered || !ps)
+        return UA_STATUSCODE_BADINVALIDSTATE;
+    return UA_PubSubScheduler_getStatistics(ps->scheduler, writerGroup->publishCallbackId,
+                                            statistics);
+}
+
+#else /* UA_ENABLE_PUBSUB_CUSTOM_PUBLISH_HANDLING */
+
+static void
+UA_WriterGroup_customPublish(UA_Server *server, void *data) {
+    UA_WriterGroup_scheduledPublish(server, data);
+}
+
+/* Phase, priority and notBefore are left to the application */
+static UA_StatusCode
+UA_WriterGroup_schedulePublish(UA_Server *server, UA_WriterGroup *writerGroup,
+                               UA_Duration publishingInterval, UA_Byte priority,
+                               UA_DateTime notBefore, UA_UInt64 *callbackId) {
+    UA_WriterGroupRuntime *rt = UA_WriterGroupRuntime_get(server, writerGroup);
+    if(!rt)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    return UA_PubSubManager_addRepeatedCallback(server, UA_WriterGroup_customPublish,
+                                                rt, publishingInterval, callbackId);
+}
+
+static void
+UA_WriterGroup_unregisterPublish(UA_Server *server, UA_WriterGroup *writerGroup) {
+    if(!writerGroup->publishCallbackIsRegistered)
+        return;
+    writerGroup->publishCallbackIsRegistered = false;
+    UA_PubSubManager_removeRepeatedPubSubCallback(server, writerGroup->publishCallbackId);
+}
+
+static void
+UA_WriterGroup_setPublishPriority(UA_Server *server, UA_WriterGroup *writerGroup) {
+}
+
+static UA_StatusCode
+UA_WriterGroup_getScheduleStatistics(UA_Server *server, UA_WriterGroup *writerGroup,
+                                     UA_PubSubScheduleStatistics *statistics) {
+    return UA_STATUSCODE_BADNOTSUPPORTED;
+}
+
+#endif /* UA_ENABLE_PUBSUB_CUSTOM_PUBLISH_HANDLING */
+
+#ifdef UA_ENABLE_PUBSUB_DELTAFRAMES
+/* Two generations of samples per DataSetWriter for the delta frames. A cycle
+ * samples into the current generation and compares it with the previous one.
+ * Then the generations are swapped by pointer. The DataSetMessage of the cycle
+ * borrows the values of the current generation instead of copying them. This
+ * replaces the lastSamples of the writer. */
+typedef struct UA_DataSetWriterSamples {
+    LIST_ENTRY(UA_DataSetWriterSamples) listEntry;
+    UA_DataSetWriter *dataSetWriter;
+    size_t samplesSize;
+    UA_DataValue *current;
+    UA_DataValue *previous;
+    UA_DataValue *raw;  /* Samples before the compression and from the snapshot */
+    UA_UInt64 *changed; /* Bitmap of the fields that differ between the generations */
+    UA_UInt64 cycle;    /* Cycles since the samples were created or reset */
+} UA_DataSetWriterSamples;
+
+static LIST_HEAD(UA_ListOfDataSetWriterSamples, UA_DataSetWriterSamples) dataSetWriterSamples;
+
+static UA_DataSetWriterSamples *
+UA_DataSetWriterSamples_find(UA_DataSetWriter *dataSetWriter) {
+    UA_DataSetWriterSamples *samples;
+    LIST_FOREACH(samples, &dataSetWriterSamples, listEntry) {
+        if(samples->dataSetWriter == dataSetWriter)
+            return samples;
+    }
+    return NULL;
+}
+
+static void
+UA_DataSetWriterSamples_clear(UA_DataSetWriterSamples *samples) {
+    UA_Array_delete(samples->current, samples->samplesSize, &UA_TYPES[UA_TYPES_DATAVALUE]);
+    UA_Array_delete(samples->previous, samples->samplesSize, &UA_TYPES[UA_TYPES_DATAVALUE]);
+    UA_Array_delete(samples->raw, samples->samplesSize, &UA_TYPES[UA_TYPES_DATAVALUE]);
+    UA_free(samples->changed);
+    samples->current = NULL;
+    samples->previous = NULL;
+    samples->raw = NULL;
+    samples->changed = NULL;
+    samples->samplesSize = 0;
+    samples->cycle = 0;
+}
+
+/* Find or create the samples of the writer with one entry per field. Existing
+ * samples of a different size are discarded. */
+static UA_DataSetWriterSamples *
+UA_DataSetWriterSamples_get(UA_DataSetWriter *dataSetWriter, size_t samplesSize) {
+    UA_DataSetWriterSamples *samples = UA_DataSetWriterSamples_find(dataSetWriter);
+    if(!samples) {
+        samples = (UA_DataSetWriterSamples *) UA_calloc(1, sizeof(UA_DataSetWriterSamples));
+        if(!samples)
+            return NULL;
+        samples->dataSetWriter = dataSetWriter;
+        LIST_INSERT_HEAD(&dataSetWriterSamples, samples, listEntry);
+    }
+    if(samples->current && samples->samplesSize == samplesSize)
+        return samples;
+
+    UA_DataSetWriterSamples_clear(samples);
+    samples->current = (UA_DataValue *) UA_Array_new(samplesSize, &UA_TYPES[UA_TYPES_DATAVALUE]);
+    samples->previous = (UA_DataValue *) UA_Array_new(samplesSize, &UA_TYPES[UA_TYPES_DATAVALUE]);
+    samples->raw = (UA_DataValue *) UA_Array_new(samplesSize, &UA_TYPES[UA_TYPES_DATAVALUE]);
+    samples->changed = (UA_UInt64 *) UA_calloc(samplesSize / 64 + 1, sizeof(UA_UInt64));
+    samples->samplesSize = samplesSize;
+    if(!samples->current || !samples->previous || !samples->raw || !samples->changed) {
+        UA_DataSetWriterSamples_clear(samples);
+        return NULL;
+    }
+    return samples;
+}
+
+static void
+UA_DataSetWriterSamples_swap(UA_DataSetWriterSamples *samples) {
+    UA_DataValue *tmp = samples->current;
+    samples->current = samples->previous;
+    samples->previous = tmp;
+    samples->cycle++;
+}
+
+static void
+UA_DataSetWriterSamples_delete(UA_DataSetWriter *dataSetWriter) {
+    UA_DataSetWriterSamples *samples = UA_DataSetWriterSamples_find(dataSetWriter);
+    if(!samples)
+        return;
+    UA_DataSetWriterSamples_clear(samples);
+    LIST_REMOVE(samples, listEntry);
+    UA_free(samples);
+}
+#endif
+
+/**********************************************/
+/*             Channel extensions             */
+/**********************************************/
+
+typedef struct UA_PubSubChannelExtensionEntry {
+    LIST_ENTRY(UA_PubSubChannelExtensionEntry) listEntry;
+    const UA_PubSubChannel *channel;
+    const UA_PubSubChannelExtension *extension;
+} UA_PubSubChannelExtensionEntry;
+
+static LIST_HEAD(UA_ListOfPubSubChannelExtension, UA_PubSubChannelExtensionEntry) channelExtensions;
+
+UA_StatusCode
+UA_PubSubChannel_setExtension(UA_PubSubChannel *channel,
+                              const UA_PubSubChannelExtension *extension) {
+    UA_PubSubChannelExtensionEntry *entry;
+    LIST_FOREACH(entry, &channelExtensions, listEntry) {
+        if(entry->channel == channel) {
+            entry->extension = extension;
+            return UA_STATUSCODE_GOOD;
+        }
+    }
+    entry = (UA_PubSubChannelExtensionEntry *)
+        UA_calloc(1, sizeof(UA_PubSubChannelExtensionEntry));
+    if(!entry)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    entry->channel = channel;
+    entry->extension = extension;
+    LIST_INSERT_HEAD(&channelExtensions, entry, listEntry);
+    return UA_STATUSCODE_GOOD;
+}
+
+void
+UA_PubSubChannel_removeExtension(UA_PubSubChannel *channel) {
+    /* The transmit queue needs the extension */
+    UA_PubSubTxQueue_delete(channel);
+    UA_PubSubChannelExtensionEntry *entry, *tmp;
+    LIST_FOREACH_SAFE(entry, &channelExtensions, listEntry, tmp) {
+        if(entry->channel == channel) {
+            LIST_REMOVE(entry, listEntry);
+            UA_free(entry);
+        }
+    }
+}
+
+const UA_PubSubChannelExtension *
+UA_PubSubChannel_getExtension(const UA_PubSubChannel *channel) {
+    UA_PubSubChannelExtensionEntry *entry;
+    LIST_FOREACH(entry, &channelExtensions, listEntry) {
+        if(entry->channel == channel)
+            return entry->extension;
+    }
+    return NULL;
+}
+
+/**********************************************/
+/*               Transmit queue               */
+/**********************************************/
+
+/* Bounded queue of encoded NetworkMessages per channel. The messages are
+ * handed to the transport without blocking. What the transport does not take
+ * right away is queued. While the queue is not empty, new messages are queued
+ * behind the old ones to keep the order, and a timed callback retries the
+ * queue until it is empty.
+ *
+ * A dropped or replaced delta frame leaves the subscribers with stale
+ * values. The DataSetWriters of such a message send a key frame next. */
+
+typedef struct {
+    UA_ByteString message; /* empty if the entry was dropped */
+    UA_ExtensionObject transportSettings;
+    UA_UInt32 hash;        /* of the DataSetWriterIds, 0 if not coalesced */
+    size_t writersSize;
+    UA_UInt16 *writerIds;  /* the DataSetMessage types follow in the same block */
+    UA_Byte *messageTypes;
+} UA_PubSubTxQueueEntry;
+
+typedef struct UA_PubSubTxQueue {
+    LIST_ENTRY(UA_PubSubTxQueue) listEntry;
+    UA_Server *server;
+    UA_PubSubChannel *channel;
+    const UA_PubSubChannelExtension *extension;
+    UA_PubSubTxQueueConfig config;
+    UA_PubSubTxQueueEntry *entries; /* ring of config.capacity entries */
+    size_t head;
+    size_t count;
+    UA_PubSubTxQueueStatistics statistics;
+    UA_UInt64 reportedDrops;
+    UA_Boolean retryIsRegistered;
+    UA_UInt64 retryCallbackId;
+} UA_PubSubTxQueue;
+
+static LIST_HEAD(UA_ListOfPubSubTxQueue, UA_PubSubTxQueue) txQueues;
+
+static UA_PubSubTxQueue *
+UA_PubSubTxQueue_find(UA_Server *server, const UA_PubSubChannel *channel) {
+    UA_PubSubTxQueue *q;
+    LIST_FOREACH(q, &txQueues, listEntry) {
+        if(q->server == server && q->channel == channel)
+            return q;
+    }
+    return NULL;
+}
+
+/* FNV-1a over the DataSetWriterIds. Never 0, that marks entries which are not
+ * coalesced (chunks). */
+static UA_UInt32
+UA_PubSubTxQueue_hash(const UA_UInt16 *writerIds, size_t writersSize) {
+    UA_UInt32 hash = 2166136261u;
+    for(size_t i = 0; i < writersSize; i++) {
+        hash = (hash ^ (UA_Byte)writerIds[i]) * 16777619u;
+        hash = (hash ^ (UA_Byte)(writerIds[i] >> 8)) * 16777619u;
+    }
+    return hash ? hash : 1;
+}
+
+/* Same DataSetWriters with the same DataSetMessage types */
+static UA_Boolean
+UA_PubSubTxQueueEntry_matches(const UA_PubSubTxQueueEntry *entry, UA_UInt32 hash,
+                              const UA_UInt16 *writerIds, const UA_DataSetMessage *dsm,
+                              size_t writersSize) {
+    if(entry->message.length == 0 || entry->hash != hash ||
+       entry->writersSize != writersSize)
+        return false;
+    for(size_t i = 0; i < writersSize; i++) {
+        if(entry->writerIds[i] != writerIds[i] ||
+           entry->messageTypes[i] != (UA_Byte)dsm[i].header.dataSetMessageType)
+            return false;
+    }
+    return true;
+}
+
+static void
+UA_PubSubTxQueueEntry_clear(UA_PubSubTxQueueEntry *entry) {
+    UA_ByteString_deleteMembers(&entry->message);
+    UA_ExtensionObject_deleteMembers(&entry->transportSettings);
+    UA_free(entry->writerIds);
+    memset(entry, 0, sizeof(UA_PubSubTxQueueEntry));
+}
+
+/* The next DataSetMessage of the writers is a key frame. Without a key frame
+ * budget in the cycle they send a KeepAlive instead of a delta frame. */
+static void
+UA_PubSubTxQueue_forceKeyFrames(UA_PubSubTxQueue *q, const UA_UInt16 *writerIds,
+                                const UA_Byte *messageTypes, size_t writersSize) {
+    for(size_t i = 0; i < q->server->pubSubManager.connectionsSize; i++) {
+        UA_PubSubConnection *c = &q->server->pubSubManager.connections[i];
+        if(c->channel != q->channel)
+            continue;
+        UA_WriterGroup *wg;
+        LIST_FOREACH(wg, &c->writerGroups, listEntry) {
+            UA_DataSetWriter *dsw;
+            LIST_FOREACH(dsw, &wg->writers, listEntry) {
+                for(size_t j = 0; j < writersSize; j++) {
+                    if(dsw->config.dataSetWriterId == writerIds[j] &&
+                       messageTypes[j] != UA_DATASETMESSAGE_KEEPALIVE)
+                        dsw->deltaFrameCounter = 0;
+                }
+            }
+        }
+    }
+}
+
+/* Drop a queued message. Only a key frame replaced by a newer key frame of
+ * the same writers is superseded without a forced key frame. */
+static void
+UA_PubSubTxQueueEntry_drop(UA_PubSubTxQueue *q, UA_PubSubTxQueueEntry *entry,
+                           UA_Boolean superseded) {
+    for(size_t i = 0; i < entry->writersSize; i++) {
+        if(!superseded || entry->messageTypes[i] != UA_DATASETMESSAGE_DATAKEYFRAME) {
+            UA_PubSubTxQueue_forceKeyFrames(q, entry->writerIds, entry->messageTypes,
+                                            entry->writersSize);
+            break;
+        }
+    }
+    UA_PubSubTxQueueEntry_clear(entry);
+}
+
+static void
+UA_PubSubTxQueue_free(UA_PubSubTxQueue *q) {
+    if(q->retryIsRegistered)
+        UA_Server_removeCallback(q->server, q->retryCallbackId);
+    for(size_t i = 0; i < q->count; i++)
+        UA_PubSubTxQueueEntry_clear(&q->entries[(q->head + i) % q->config.capacity]);
+    LIST_REMOVE(q, listEntry);
+    UA_free(q->entries);
+    UA_free(q);
+}
+
+/* The channel is closed. Its queue is dropped, whichever server it has. */
+static void
+UA_PubSubTxQueue_delete(const UA_PubSubChannel *channel) {
+    UA_PubSubTxQueue *q, *tmp;
+    LIST_FOREACH_SAFE(q, &txQueues, listEntry, tmp) {
+        if(q->channel == channel)
+            UA_PubSubTxQueue_free(q);
+    }
+}
+
+/* Send the queued messages until the transport would block */
+static void
+UA_PubSubTxQueue_flush(UA_PubSubTxQueue *q) {
+    while(q->count > 0) {
+        UA_PubSubTxQueueEntry *entry = &q->entries[q->head];
+        if(entry->message.length > 0) {
+            UA_StatusCode res =
+                q->extension->sendNonBlocking(q->channel, &entry->transportSettings,
+                                              &entry->message);
+            if(res == UA_STATUSCODE_BADWOULDBLOCK)
+                break;
+            if(res == UA_STATUSCODE_GOOD)
+                q->statistics.sent++;
+            else
+                q->statistics.sendErrors++;
+        }
+        UA_PubSubTxQueueEntry_clear(entry);
+        q->head = (q->head + 1) % q->config.capacity;
+        q->count--;
+    }
+    q->statistics.depth = q->count;
+}
+
+/* Take a slot for a new message according to the policy. Returns NULL if the
+ * new message is dropped. */
+static UA_PubSubTxQueueEntry *
+UA_PubSubTxQueue_take(UA_PubSubTxQueue *q, UA_UInt32 hash, const UA_UInt16 *writerIds,
+                      const UA_DataSetMessage *dsm, size_t writersSize) {
+    size_t capacity = q->config.capacity;
+    if(q->config.policy == UA_PUBSUB_TXQUEUE_COALESCE && hash != 0) {
+        /* The newer message replaces the queued one in its place */
+        for(size_t i = 0; i < q->count; i++) {
+            UA_PubSubTxQueueEntry *entry = &q->entries[(q->head + i) % capacity];
+            if(UA_PubSubTxQueueEntry_matches(entry, hash, writerIds, dsm, writersSize)) {
+                UA_PubSubTxQueueEntry_drop(q, entry, true);
+                q->statistics.coalesced++;
+                return entry;
+            }
+        }
+    }
+    if(q->count < capacity) {
+        q->count++;
+        q->statistics.queued++;
+        return &q->entries[(q->head + q->count - 1) % capacity];
+    }
+    if(q->config.policy == UA_PUBSUB_TXQUEUE_DROPNEWEST) {
+        q->statistics.droppedNewest++;
+        return NULL;
+    }
+    /* Drop the oldest message. The freed slot is the new tail. */
+    UA_PubSubTxQueueEntry *entry = &q->entries[q->head];
+    UA_PubSubTxQueueEntry_drop(q, entry, false);
+    q->head = (q->head + 1) % capacity;
+    q->statistics.droppedOldest++;
+    q->statistics.queued++;
+    return entry;
+}
+
+/* Chunks are not coalesced, a chunk replaces only part of a DataSetMessage */
+static void
+UA_PubSubTxQueue_push(UA_PubSubTxQueue *q, UA_ExtensionObject *transportSettings,
+                      const UA_ByteString *buf, const UA_UInt16 *writerIds,
+                      const UA_DataSetMessage *dsm, size_t writersSize,
+                      UA_Boolean chunk) {
+    UA_UInt32 hash = chunk ? 0 : UA_PubSubTxQueue_hash(writerIds, writersSize);
+    UA_PubSubTxQueueEntry *entry = UA_PubSubTxQueue_take(q, hash, writerIds, dsm, writersSize);
+    if(!entry)
+        goto dropped;
+    UA_StatusCode res = UA_ByteString_copy(buf, &entry->message);
+    if(transportSettings)
+        res |= UA_ExtensionObject_copy(transportSettings, &entry->transportSettings);
+    entry->writerIds = (UA_UInt16 *)
+        UA_malloc(writersSize * (sizeof(UA_UInt16) + sizeof(UA_Byte)));
+    if(!entry->writerIds)
+        res |= UA_STATUSCODE_BADOUTOFMEMORY;
+    if(res != UA_STATUSCODE_GOOD) {
+        /* The empty entry is skipped by the flush */
+        UA_PubSubTxQueueEntry_clear(entry);
+        q->statistics.droppedNewest++;
+        goto dropped;
+    }
+    entry->hash = hash;
+    entry->writersSize = writersSize;
+    entry->messageTypes = (UA_Byte *) &entry->writerIds[writersSize];
+    for(size_t i = 0; i < writersSize; i++) {
+        entry->writerIds[i] = writerIds[i];
+        entry->messageTypes[i] = (UA_Byte)dsm[i].header.dataSetMessageType;
+    }
+    q->statistics.depth = q->count;
+    if(q->count > q->statistics.maxDepth)
+        q->statistics.maxDepth = q->count;
+    return;
+
+ dropped:
+    for(size_t i = 0; i < writersSize; i++) {
+        UA_Byte type = (UA_Byte)dsm[i].header.dataSetMessageType;
+        UA_PubSubTxQueue_forceKeyFrames(q, &writerIds[i], &type, 1);
+    }
+}
+
+static void
+UA_PubSubTxQueue_retryCallback(UA_Server *server, void *data);
+
+static void
+UA_PubSubTxQueue_arm(UA_PubSubTxQueue *q) {
+    if(q->count == 0 || q->retryIsRegistered)
+        return;
+    UA_DateTime due = UA_DateTime_nowMonotonic() +
+        (UA_DateTime)(q->config.retryInterval * (UA_Double)UA_DATETIME_MSEC);
+    if(UA_Server_addTimedCallback(q->server, UA_PubSubTxQueue_retryCallback, q,
+                                  due, &q->retryCallbackId) == UA_STATUSCODE_GOOD)
+        q->retryIsRegistered = true;
+}
+
+static void
+UA_PubSubTxQueue_retryCallback(UA_Server *server, void *data) {
+    UA_PubSubTxQueue *q = (UA_PubSubTxQueue *) data;
+    q->retryIsRegistered = false;
+    UA_PubSubTxQueue_flush(q);
+    if(q->channel->yield)
+        q->channel->yield(q->channel, 0);
+
+    UA_UInt64 drops = q->statistics.droppedOldest + q->statistics.droppedNewest;
+    if(drops != q->reportedDrops) {
+        UA_LOG_WARNING(&server->config.logger, UA_LOGCATEGORY_SERVER,
+                       "PubSub Publish: %lu NetworkMessages dropped from the transmit queue",
+                       (unsigned long)(drops - q->reportedDrops));
+        q->reportedDrops = drops;
+    }
+    UA_PubSubTxQueue_arm(q);
+}
+
+/* Send through the transmit queue of the channel, if it has one. The
+ * DataSetWriterIds and DataSetMessages describe the message for the queue
+ * policy. */
+static UA_StatusCode
+UA_PubSubConnection_send(UA_Server *server, UA_PubSubConnection *connection,
+                         UA_ExtensionObject *transportSettings,
+                         const UA_ByteString *buf, const UA_UInt16 *writerIds,
+                         const UA_DataSetMessage *dsm, UA_Byte dsmCount, UA_Boolean chunk) {
+    UA_PubSubTxQueue *q = UA_PubSubTxQueue_find(server, connection->channel);
+    if(!q)
+        return connection->channel->send(connection->channel, transportSettings, buf);
+
+    /* Older messages go first */
+    if(q->count > 0)
+        UA_PubSubTxQueue_flush(q);
+    if(q->count == 0) {
+        UA_StatusCode res =
+            q->extension->sendNonBlocking(connection->channel, transportSettings, buf);
+        if(res != UA_STATUSCODE_BADWOULDBLOCK) {
+            if(res == UA_STATUSCODE_GOOD)
+                q->statistics.sent++;
+            else
+                q->statistics.sendErrors++;
+            return res;
+        }
+    }
+    UA_PubSubTxQueue_push(q, transportSettings, buf, writerIds, dsm, dsmCount, chunk);
+    UA_PubSubTxQueue_arm(q);
+    return UA_STATUSCODE_GOOD;
+}
+
+/* The extension of the channel if messages can be encoded into its transmit
+ * buffers. Not while messages wait in the transmit queue, they go first. */
+static const UA_PubSubChannelExtension *
+UA_PubSubConnection_bufferExtension(UA_Server *server, UA_PubSubConnection *connection) {
+    const UA_PubSubChannelExtension *ext = UA_PubSubChannel_getExtension(connection->channel);
+    if(!ext || !ext->acquireBuffer)
+        return NULL;
+    UA_PubSubTxQueue *q = UA_PubSubTxQueue_find(server, connection->channel);
+    if(q && q->count > 0)
+        return NULL;
+    return ext;
+}
+
+/* A smaller capacity keeps the newest messages */
+static UA_StatusCode
+UA_PubSubTxQueue_resize(UA_PubSubTxQueue *q, size_t capacity) {
+    UA_PubSubTxQueueEntry *entries = (UA_PubSubTxQueueEntry *)
+        UA_calloc(capacity, sizeof(UA_PubSubTxQueueEntry));
+    if(!entries)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    while(q->count > capacity) {
+        UA_PubSubTxQueueEntry_drop(q, &q->entries[q->head], false);
+        q->head = (q->head + 1) % q->config.capacity;
+        q->count--;
+        q->statistics.droppedOldest++;
+    }
+    for(size_t i = 0; i < q->count; i++)
+        entries[i] = q->entries[(q->head + i) % q->config.capacity];
+    UA_free(q->entries);
+    q->entries = entries;
+    q->head = 0;
+    q->config.capacity = capacity;
+    q->statistics.depth = q->count;
+    return UA_STATUSCODE_GOOD;
+}
+
+UA_StatusCode
+UA_Server_setPubSubConnectionTxQueue(UA_Server *server, const UA_NodeId connection,
+                                     const UA_PubSubTxQueueConfig *config) {
+    if(!config)
+        return UA_STATUSCODE_BADINVALIDARGUMENT;
+    UA_PubSubConnection *c = UA_PubSubConnection_findConnectionbyId(server, connection);
+    if(!c || !c->channel)
+        return UA_STATUSCODE_BADNOTFOUND;
+
+    /* Back to the blocking send. The queued messages are sent first. */
+    UA_PubSubTxQueue *q = UA_PubSubTxQueue_find(server, c->channel);
+    if(config->capacity == 0) {
+        if(!q)
+            return UA_STATUSCODE_GOOD;
+        for(; q->count > 0; q->count--) {
+            UA_PubSubTxQueueEntry *entry = &q->entries[q->head];
+            if(entry->message.length > 0)
+                c->channel->send(c->channel, &entry->transportSettings, &entry->message);
+            UA_PubSubTxQueueEntry_clear(entry);
+            q->head = (q->head + 1) % q->config.capacity;
+        }
+        UA_PubSubTxQueue_free(q);
+        return UA_STATUSCODE_GOOD;
+    }
+
+    if(config->policy != UA_PUBSUB_TXQUEUE_DROPOLDEST &&
+       config->policy != UA_PUBSUB_TXQUEUE_DROPNEWEST &&
+       config->policy != UA_PUBSUB_TXQUEUE_COALESCE)
+        return UA_STATUSCODE_BADINVALIDARGUMENT;
+    if(!(config->retryInterval > 0.0))
+        return UA_STATUSCODE_BADINVALIDARGUMENT;
+    const UA_PubSubChannelExtension *ext = UA_PubSubChannel_getExtension(c->channel);
+    if(!ext || !ext->sendNonBlocking)
+        return UA_STATUSCODE_BADNOTSUPPORTED;
+
+    if(!q) {
+        q = (UA_PubSubTxQueue *) UA_calloc(1, sizeof(UA_PubSubTxQueue));
+        if(!q)
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+        q->entries = (UA_PubSubTxQueueEntry *)
+            UA_calloc(config->capacity, sizeof(UA_PubSubTxQueueEntry));
+        if(!q->entries) {
+            UA_free(q);
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+        }
+        q->server = server;
+        q->channel = c->channel;
+        q->extension = ext;
+        q->config.capacity = config->capacity;
+        LIST_INSERT_HEAD(&txQueues, q, listEntry);
+    } else if(config->capacity != q->config.capacity) {
+        UA_StatusCode retVal = UA_PubSubTxQueue_resize(q, config->capacity);
+        if(retVal != UA_STATUSCODE_GOOD)
+            return retVal;
+    }
+    q->config.policy = config->policy;
+    q->config.retryInterval = config->retryInterval;
+    return UA_STATUSCODE_GOOD;
+}
+
+UA_StatusCode
+UA_Server_getPubSubConnectionTxQueueStatistics(UA_Server *server, const UA_NodeId connection,
+                                               UA_PubSubTxQueueStatistics *statistics) {
+    if(!statistics)
+        return UA_STATUSCODE_BADINVALIDARGUMENT;
+    UA_PubSubConnection *c = UA_PubSubConnection_findConnectionbyId(server, connection);
+    if(!c || !c->channel)
+        return UA_STATUSCODE_BADNOTFOUND;
+    UA_PubSubTxQueue *q = UA_PubSubTxQueue_find(server, c->channel);
+    if(!q)
+        return UA_STATUSCODE_BADINVALIDSTATE;
+    *statistics = q->statistics;
+    return UA_STATUSCODE_GOOD;
+}
 
 /**********************************************/
 /*               Connection                   */
@@ -131,6 +1033,10 @@ UA_Server_addWriterGroup(UA_Server *server, const UA_NodeId connection,
     UA_WriterGroup *newWriterGroup = (UA_WriterGroup *) UA_calloc(1, sizeof(UA_WriterGroup));
     if (!newWriterGroup)
         return UA_STATUSCODE_BADOUTOFMEMORY;
+    if(!UA_WriterGroupRuntime_get(server, newWriterGroup)) {
+        UA_free(newWriterGroup);
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    }
 
     newWriterGroup->linkedConnection = currentConnectionContext->identifier;
     UA_PubSubManager_generateUniqueNodeId(server, &newWriterGroup->identifier);
@@ -141,14 +1047,7 @@ UA_Server_addWriterGroup(UA_Server *server, const UA_NodeId connection,
     //deep copy of the config
     UA_WriterGroupConfig tmpWriterGroupConfig;
     retVal |= UA_WriterGroupConfig_copy(writerGroupConfig, &tmpWriterGroupConfig);
-
-    if(!tmpWriterGroupConfig.messageSettings.content.decoded.type) {
-        UA_UadpWriterGroupMessageDataType *wgm = UA_UadpWriterGroupMessageDataType_new();
-        tmpWriterGroupConfig.messageSettings.content.decoded.data = wgm;
-        tmpWriterGroupConfig.messageSettings.content.decoded.type =
-            &UA_TYPES[UA_TYPES_UADPWRITERGROUPMESSAGEDATATYPE];
-        tmpWriterGroupConfig.messageSettings.encoding = UA_EXTENSIONOBJECT_DECODED;
-    }
+    retVal |= UA_WriterGroupConfig_setDefaultMessageSettings(&tmpWriterGroupConfig);
 
     newWriterGroup->config = tmpWriterGroupConfig;
     retVal |= UA_WriterGroup_addPublishCallback(server, newWriterGroup);
@@ -171,7 +1070,8 @@ UA_Server_removeWriterGroup(UA_Server *server, const UA_NodeId writerGroup){
         return UA_STATUSCODE_BADNOTFOUND;
 
     //unregister the publish callback
-    UA_PubSubManager_removeRepeatedPubSubCallback(server, wg->publishCallbackId);
+    UA_WriterGroupRuntime_delete(server, wg);
+    UA_WriterGroup_unregisterPublish(server, wg);
 #ifdef UA_ENABLE_PUBSUB_INFORMATIONMODEL
     removeGroupRepresentation(server, wg);
 #endif
@@ -265,6 +1165,9 @@ UA_PublishedDataSetConfig_deleteMembers(UA_PublishedDataSetConfig *pdsConfig){
 
 void
 UA_PublishedDataSet_deleteMembers(UA_Server *server, UA_PublishedDataSet *publishedDataSet){
+    UA_PublishedDataSetCodec_delete(server, &publishedDataSet->identifier);
+    UA_PublishedDataSetSnapshot_delete(server, &publishedDataSet->identifier);
+    UA_DataSetFieldRuntimeIndex_delete(server, &publishedDataSet->identifier);
     UA_PublishedDataSetConfig_deleteMembers(&publishedDataSet->config);
     //delete PDS
     UA_DataSetMetaDataType_deleteMembers(&publishedDataSet->dataSetMetaData);
@@ -315,6 +1218,7 @@ UA_Server_addDataSetField(UA_Server *server, const UA_NodeId publishedDataSet,
     if(newField->config.field.variable.promotedField)
         currentDataSet->promotedFieldsCount++;
     currentDataSet->fieldSize++;
+    UA_DataSetFieldRuntime_invalidate();
     result.result = retVal;
     result.configurationVersion.majorVersion = currentDataSet->dataSetMetaData.configurationVersion.majorVersion;
     result.configurationVersion.minorVersion = currentDataSet->dataSetMetaData.configurationVersion.minorVersion;
@@ -351,6 +1255,292 @@ UA_Server_removeDataSetField(UA_Server *server, const UA_NodeId dsf) {
     return result;
 }
 
+/* Update the version of the PublishedDataSet once for a bulk change. The
+ * writers flush their last samples at the next publish and send a key frame. */
+static void
+UA_PublishedDataSet_bumpVersion(UA_PublishedDataSet *pds, UA_DataSetFieldResult *result) {
+    pds->dataSetMetaData.configurationVersion.majorVersion =
+        UA_PubSubConfigurationVersionTimeDifference();
+    result->configurationVersion.majorVersion = pds->dataSetMetaData.configurationVersion.majorVersion;
+    result->configurationVersion.minorVersion = pds->dataSetMetaData.configurationVersion.minorVersion;
+}
+
+UA_DataSetFieldResult
+UA_Server_addDataSetFields(UA_Server *server, const UA_NodeId publishedDataSet,
+                           size_t fieldConfigsSize, const UA_DataSetFieldConfig *fieldConfigs,
+                           UA_NodeId *fieldIdentifiers) {
+    UA_DataSetFieldResult result = {UA_STATUSCODE_BADINVALIDARGUMENT, {0, 0}};
+    if(fieldConfigsSize == 0 || !fieldConfigs)
+        return result;
+
+    UA_PublishedDataSet *currentDataSet = UA_PublishedDataSet_findPDSbyId(server, publishedDataSet);
+    if(!currentDataSet) {
+        result.result = UA_STATUSCODE_BADNOTFOUND;
+        return result;
+    }
+    if(currentDataSet->config.publishedDataSetType != UA_PUBSUB_DATASET_PUBLISHEDITEMS) {
+        result.result = UA_STATUSCODE_BADNOTIMPLEMENTED;
+        return result;
+    }
+
+    /* Create all fields before the PublishedDataSet is changed */
+    UA_DataSetField **newFields = (UA_DataSetField **)
+        UA_calloc(fieldConfigsSize, sizeof(UA_DataSetField *));
+    if(!newFields) {
+        result.result = UA_STATUSCODE_BADOUTOFMEMORY;
+        return result;
+    }
+    UA_StatusCode retVal = UA_STATUSCODE_GOOD;
+    for(size_t i = 0; i < fieldConfigsSize; i++) {
+        newFields[i] = (UA_DataSetField *) UA_calloc(1, sizeof(UA_DataSetField));
+        if(!newFields[i]) {
+            retVal = UA_STATUSCODE_BADOUTOFMEMORY;
+            break;
+        }
+        retVal = UA_DataSetFieldConfig_copy(&fieldConfigs[i], &newFields[i]->config);
+        if(retVal != UA_STATUSCODE_GOOD)
+            break;
+        retVal = UA_NodeId_copy(&currentDataSet->identifier, &newFields[i]->publishedDataSet);
+        if(retVal != UA_STATUSCODE_GOOD)
+            break;
+    }
+    if(retVal != UA_STATUSCODE_GOOD) {
+        for(size_t i = 0; i < fieldConfigsSize && newFields[i]; i++) {
+            UA_DataSetField_deleteMembers(newFields[i]);
+            UA_free(newFields[i]);
+        }
+        UA_free(newFields);
+        result.result = retVal;
+        return result;
+    }
+
+    /* Insert in the order of the single add */
+    for(size_t i = 0; i < fieldConfigsSize; i++) {
+        UA_DataSetField *newField = newFields[i];
+        UA_PubSubManager_generateUniqueNodeId(server, &newField->identifier);
+        if(fieldIdentifiers)
+            UA_NodeId_copy(&newField->identifier, &fieldIdentifiers[i]);
+        LIST_INSERT_HEAD(&currentDataSet->fields, newField, listEntry);
+        if(newField->config.field.variable.promotedField)
+            currentDataSet->promotedFieldsCount++;
+    }
+    currentDataSet->fieldSize += fieldConfigsSize;
+    UA_DataSetFieldRuntime_invalidate();
+    UA_free(newFields);
+
+    UA_PublishedDataSet_bumpVersion(currentDataSet, &result);
+    result.result = UA_STATUSCODE_GOOD;
+    return result;
+}
+
+/* Open addressing set of the NodeIds to remove. The slots hold the index into
+ * the argument array plus one, zero is empty. */
+static size_t
+UA_DataSetFieldSet_find(const size_t *slots, size_t mask, const UA_NodeId *ids,
+                        const UA_NodeId *id) {
+    size_t pos = UA_NodeId_hash(id) & mask;
+    while(slots[pos] != 0 && !UA_NodeId_equal(&ids[slots[pos] - 1], id))
+        pos = (pos + 1) & mask;
+    return pos;
+}
+
+UA_DataSetFieldResult
+UA_Server_removeDataSetFields(UA_Server *server, const UA_NodeId publishedDataSet,
+                              size_t fieldsSize, const UA_NodeId *fields) {
+    UA_DataSetFieldResult result = {UA_STATUSCODE_BADINVALIDARGUMENT, {0, 0}};
+    if(fieldsSize == 0 || !fields)
+        return result;
+
+    UA_PublishedDataSet *currentDataSet = UA_PublishedDataSet_findPDSbyId(server, publishedDataSet);
+    if(!currentDataSet) {
+        result.result = UA_STATUSCODE_BADNOTFOUND;
+        return result;
+    }
+
+    size_t slotsSize = 16;
+    while(slotsSize < 2 * fieldsSize)
+        slotsSize <<= 1;
+    size_t *slots = (size_t *) UA_calloc(slotsSize, sizeof(size_t));
+    if(!slots) {
+        result.result = UA_STATUSCODE_BADOUTOFMEMORY;
+        return result;
+    }
+    for(size_t i = 0; i < fieldsSize; i++) {
+        size_t pos = UA_DataSetFieldSet_find(slots, slotsSize - 1, fields, &fields[i]);
+        if(slots[pos] != 0) {
+            UA_free(slots);
+            return result; /* listed twice */
+        }
+        slots[pos] = i + 1;
+    }
+
+    /* All fields must be part of the PublishedDataSet. Nothing is removed
+     * otherwise. */
+    size_t found = 0;
+    UA_DataSetField *field, *tmpField;
+    LIST_FOREACH(field, &currentDataSet->fields, listEntry) {
+        size_t pos = UA_DataSetFieldSet_find(slots, slotsSize - 1, fields, &field->identifier);
+        if(slots[pos] != 0)
+            found++;
+    }
+    if(found != fieldsSize) {
+        UA_free(slots);
+        result.result = UA_STATUSCODE_BADNOTFOUND;
+        return result;
+    }
+
+    LIST_FOREACH_SAFE(field, &currentDataSet->fields, listEntry, tmpField) {
+        size_t pos = UA_DataSetFieldSet_find(slots, slotsSize - 1, fields, &field->identifier);
+        if(slots[pos] == 0)
+            continue;
+        if(field->config.field.variable.promotedField)
+            currentDataSet->promotedFieldsCount--;
+        UA_DataSetField_deleteMembers(field);
+        LIST_REMOVE(field, listEntry);
+        UA_free(field);
+    }
+    currentDataSet->fieldSize -= fieldsSize;
+    UA_free(slots);
+
+    UA_PublishedDataSet_bumpVersion(currentDataSet, &result);
+    result.result = UA_STATUSCODE_GOOD;
+    return result;
+}
+
+/**********************************************/
+/*               DataSet codecs               */
+/**********************************************/
+
+/* Generated codec of a PublishedDataSet. The entries are keyed by the server
+ * and the identifier, as the PublishedDataSets are stored in a reallocated
+ * array. The
+ * codec is used while the configuration version of the PublishedDataSet is the
+ * one at the time it was set. */
+typedef struct UA_PublishedDataSetCodec {
+    LIST_ENTRY(UA_PublishedDataSetCodec) listEntry;
+    UA_Server *server;
+    UA_NodeId publishedDataSet;
+    const UA_DataSetCodec *codec;
+    UA_ConfigurationVersionDataType configurationVersion;
+    UA_Boolean outdated; /* Logged once */
+} UA_PublishedDataSetCodec;
+
+static LIST_HEAD(UA_ListOfPublishedDataSetCodec, UA_PublishedDataSetCodec) publishedDataSetCodecs;
+
+static UA_PublishedDataSetCodec *
+UA_PublishedDataSetCodec_find(UA_Server *server, const UA_NodeId *publishedDataSet) {
+    UA_PublishedDataSetCodec *entry;
+    LIST_FOREACH(entry, &publishedDataSetCodecs, listEntry) {
+        if(entry->server == server &&
+           UA_NodeId_equal(&entry->publishedDataSet, publishedDataSet))
+            return entry;
+    }
+    return NULL;
+}
+
+static void
+UA_PublishedDataSetCodec_delete(UA_Server *server, const UA_NodeId *publishedDataSet) {
+    UA_PublishedDataSetCodec *entry = UA_PublishedDataSetCodec_find(server, publishedDataSet);
+    if(!entry)
+        return;
+    LIST_REMOVE(entry, listEntry);
+    UA_NodeId_deleteMembers(&entry->publishedDataSet);
+    UA_free(entry);
+}
+
+/* The codec for the DataSetMessages of the PublishedDataSet or NULL */
+static const UA_DataSetCodec *
+UA_PublishedDataSetCodec_select(UA_Server *server, UA_PublishedDataSet *pds) {
+    if(LIST_EMPTY(&publishedDataSetCodecs))
+        return NULL;
+    UA_PublishedDataSetCodec *entry = UA_PublishedDataSetCodec_find(server, &pds->identifier);
+    if(!entry)
+        return NULL;
+    if(entry->configurationVersion.majorVersion == pds->dataSetMetaData.configurationVersion.majorVersion &&
+       entry->configurationVersion.minorVersion == pds->dataSetMetaData.configurationVersion.minorVersion &&
+       entry->codec->fieldsSize == pds->fieldSize)
+        return entry->codec;
+    if(!entry->outdated) {
+        UA_LOG_WARNING(&server->config.logger, UA_LOGCATEGORY_SERVER,
+                       "PubSub Publish: The configuration of the PublishedDataSet changed. "
+                       "The codec %s is no longer used.", entry->codec->name);
+        entry->outdated = true;
+    }
+    return NULL;
+}
+
+/* Compare the layout of the codec with the variables of the fields, in the
+ * order of the fields in the DataSetMessages. Variables with an abstract type
+ * or without a fixed value rank are checked only for every message. */
+static UA_StatusCode
+UA_DataSetCodec_checkFields(UA_Server *server, UA_PublishedDataSet *pds,
+                            const UA_DataSetCodec *codec) {
+    if(codec->fieldsSize != pds->fieldSize)
+        return UA_STATUSCODE_BADTYPEMISMATCH;
+    size_t i = 0;
+    UA_DataSetField *dsf;
+    LIST_FOREACH(dsf, &pds->fields, listEntry) {
+        const UA_DataSetCodecField *field = &codec->fields[i++];
+        if(dsf->config.field.variable.publishParameters.attributeId != UA_ATTRIBUTEID_VALUE)
+            return UA_STATUSCODE_BADTYPEMISMATCH;
+        const UA_NodeId *variable = &dsf->config.field.variable.publishParameters.publishedVariable;
+        UA_NodeId dataType;
+        if(UA_Server_readDataType(server, *variable, &dataType) == UA_STATUSCODE_GOOD) {
+            /* Boolean (1) to LocalizedText (21) */
+            UA_Boolean builtin = dataType.namespaceIndex == 0 &&
+                dataType.identifierType == UA_NODEIDTYPE_NUMERIC &&
+                dataType.identifier.numeric >= 1 && dataType.identifier.numeric <= 21;
+            UA_Boolean match = !builtin || dataType.identifier.numeric == field->builtInType;
+            UA_NodeId_deleteMembers(&dataType);
+            if(!match)
+                return UA_STATUSCODE_BADTYPEMISMATCH;
+        }
+        UA_Int32 valueRank;
+        if(UA_Server_readValueRank(server, *variable, &valueRank) == UA_STATUSCODE_GOOD &&
+           (valueRank == -1 || valueRank == 1) && valueRank != field->valueRank)
+            return UA_STATUSCODE_BADTYPEMISMATCH;
+    }
+    return UA_STATUSCODE_GOOD;
+}
+
+UA_StatusCode
+UA_Server_setDataSetCodec(UA_Server *server, const UA_NodeId pds,
+                          const UA_DataSetCodec *codec) {
+    UA_PublishedDataSet *currentDataSet = UA_PublishedDataSet_findPDSbyId(server, pds);
+    if(!currentDataSet)
+        return UA_STATUSCODE_BADNOTFOUND;
+    if(!codec) {
+        UA_PublishedDataSetCodec_delete(server, &pds);
+        return UA_STATUSCODE_GOOD;
+    }
+
+    UA_StatusCode retval = UA_DataSetCodec_checkFields(server, currentDataSet, codec);
+    if(retval != UA_STATUSCODE_GOOD) {
+        UA_LOG_WARNING(&server->config.logger, UA_LOGCATEGORY_SERVER,
+                       "The codec %s does not match the fields of the PublishedDataSet",
+                       codec->name);
+        return retval;
+    }
+
+    UA_PublishedDataSetCodec *entry = UA_PublishedDataSetCodec_find(server, &pds);
+    if(!entry) {
+        entry = (UA_PublishedDataSetCodec *) UA_calloc(1, sizeof(UA_PublishedDataSetCodec));
+        if(!entry)
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+        retval = UA_NodeId_copy(&pds, &entry->publishedDataSet);
+        if(retval != UA_STATUSCODE_GOOD) {
+            UA_free(entry);
+            return retval;
+        }
+        entry->server = server;
+        LIST_INSERT_HEAD(&publishedDataSetCodecs, entry, listEntry);
+    }
+    entry->codec = codec;
+    entry->configurationVersion = currentDataSet->dataSetMetaData.configurationVersion;
+    entry->outdated = false;
+    return UA_STATUSCODE_GOOD;
+}
+
 /**********************************************/
 /*               DataSetWriter                */
 /**********************************************/
@@ -391,6 +1581,48 @@ UA_Server_getDataSetWriterConfig(UA_Server *server, const UA_NodeId dsw,
     return retVal;
 }
 
+UA_StatusCode
+UA_Server_updateDataSetWriterConfig(UA_Server *server, const UA_NodeId dsw,
+                                    const UA_DataSetWriterConfig *config) {
+    if(!config)
+        return UA_STATUSCODE_BADINVALIDARGUMENT;
+
+    UA_DataSetWriter *dataSetWriter = UA_DataSetWriter_findDSWbyId(server, dsw);
+    if(!dataSetWriter)
+        return UA_STATUSCODE_BADNOTFOUND;
+
+    /* Other settings fall back to the UADP defaults in generateDataSetMessage */
+    const UA_DataType *type = config->messageSettings.content.decoded.type;
+    if((config->messageSettings.encoding == UA_EXTENSIONOBJECT_DECODED ||
+        config->messageSettings.encoding == UA_EXTENSIONOBJECT_DECODED_NODELETE) &&
+       type != &UA_TYPES[UA_TYPES_UADPDATASETWRITERMESSAGEDATATYPE] &&
+       type != &UA_TYPES[UA_TYPES_JSONDATASETWRITERMESSAGEDATATYPE])
+        return UA_STATUSCODE_BADINVALIDARGUMENT;
+
+    /* Build */
+    UA_DataSetWriterConfig newConfig;
+    UA_StatusCode retVal = UA_DataSetWriterConfig_copy(config, &newConfig);
+    if(retVal != UA_STATUSCODE_GOOD) {
+        /* The copy stops at a failed allocation of the properties */
+        if(!newConfig.dataSetWriterProperties)
+            newConfig.dataSetWriterPropertiesSize = 0;
+        UA_DataSetWriterConfig_deleteMembers(&newConfig);
+        return retVal;
+    }
+
+    /* Swap */
+    UA_DataSetWriterConfig oldConfig = dataSetWriter->config;
+    dataSetWriter->config = newConfig;
+    UA_DataSetWriterConfig_deleteMembers(&oldConfig);
+
+#ifdef UA_ENABLE_PUBSUB_DELTAFRAMES
+    /* Delta frames with the new field encoding or key frame period would refer
+     * to a key frame with the old one. Start over with a key frame. */
+    dataSetWriter->deltaFrameCounter = 0;
+#endif
+    return UA_STATUSCODE_GOOD;
+}
+
 UA_DataSetWriter *
 UA_DataSetWriter_findDSWbyId(UA_Server *server, UA_NodeId identifier) {
     for(size_t i = 0; i < server->pubSubManager.connectionsSize; i++){
@@ -426,13 +1658,8 @@ UA_DataSetWriter_deleteMembers(UA_Server *server, UA_DataSetWriter *dataSetWrite
     UA_NodeId_deleteMembers(&dataSetWriter->linkedWriterGroup);
     UA_NodeId_deleteMembers(&dataSetWriter->connectedDataSet);
 #ifdef UA_ENABLE_PUBSUB_DELTAFRAMES
-    //delete lastSamples store
-    for(size_t i = 0; i < dataSetWriter->lastSamplesCount; i++) {
-        UA_DataValue_deleteMembers(&dataSetWriter->lastSamples[i].value);
-    }
-    UA_free(dataSetWriter->lastSamples);
-    dataSetWriter->lastSamples = NULL;
-    dataSetWriter->lastSamplesCount = 0;
+    //delete the sample store
+    UA_DataSetWriterSamples_delete(dataSetWriter);
 #endif
 }
 
@@ -475,6 +1702,39 @@ UA_Server_getWriterGroupConfig(UA_Server *server, const UA_NodeId writerGroup,
     return retVal;
 }
 
+/* Groups without message settings are published with the UADP defaults */
+static UA_StatusCode
+UA_WriterGroupConfig_setDefaultMessageSettings(UA_WriterGroupConfig *config) {
+    if(config->messageSettings.content.decoded.type)
+        return UA_STATUSCODE_GOOD;
+    UA_UadpWriterGroupMessageDataType *wgm = UA_UadpWriterGroupMessageDataType_new();
+    if(!wgm)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    config->messageSettings.content.decoded.data = wgm;
+    config->messageSettings.content.decoded.type =
+        &UA_TYPES[UA_TYPES_UADPWRITERGROUPMESSAGEDATATYPE];
+    config->messageSettings.encoding = UA_EXTENSIONOBJECT_DECODED;
+    return UA_STATUSCODE_GOOD;
+}
+
+/* A configuration that passes is used by the next publish as is */
+static UA_StatusCode
+UA_WriterGroupConfig_validate(const UA_WriterGroupConfig *config) {
+    if(config->encodingMimeType != UA_PUBSUB_ENCODING_UADP &&
+       config->encodingMimeType != UA_PUBSUB_ENCODING_JSON)
+        return UA_STATUSCODE_BADINVALIDARGUMENT;
+    if(!(config->publishingInterval > 0.0))
+        return UA_STATUSCODE_BADINVALIDARGUMENT;
+    const UA_DataType *type = config->messageSettings.content.decoded.type;
+    if(type && config->encodingMimeType == UA_PUBSUB_ENCODING_UADP &&
+       type != &UA_TYPES[UA_TYPES_UADPWRITERGROUPMESSAGEDATATYPE])
+        return UA_STATUSCODE_BADINVALIDARGUMENT;
+    return UA_STATUSCODE_GOOD;
+}
+
+/* The new configuration is built and validated completely before it replaces
+ * the configuration of the group in one step. Publishing runs in the same
+ * thread, so a publish sees either the old or the new configuration. */
 UA_StatusCode
 UA_Server_updateWriterGroupConfig(UA_Server *server, UA_NodeId writerGroupIdentifier,
                                   const UA_WriterGroupConfig *config){
@@ -484,15 +1744,67 @@ UA_Server_updateWriterGroupConfig(UA_Server *server, UA_NodeId writerGroupIdenti
     UA_WriterGroup *currentWriterGroup = UA_WriterGroup_findWGbyId(server, writerGroupIdentifier);
     if(!currentWriterGroup)
         return UA_STATUSCODE_BADNOTFOUND;
-    //The update functionality will be extended during the next PubSub batches.
-    //Currently is only a change of the publishing interval possible.
-    if(currentWriterGroup->config.publishingInterval != config->publishingInterval) {
-        UA_PubSubManager_removeRepeatedPubSubCallback(server, currentWriterGroup->publishCallbackId);
-        currentWriterGroup->config.publishingInterval = config->publishingInterval;
-        UA_WriterGroup_addPublishCallback(server, currentWriterGroup);
-    } else if(currentWriterGroup->config.priority != config->priority) {
+    UA_StatusCode retVal = UA_WriterGroupConfig_validate(config);
+    if(retVal != UA_STATUSCODE_GOOD)
+        return retVal;
+    UA_WriterGroupRuntime *rt = UA_WriterGroupRuntime_get(server, currentWriterGroup);
+    if(!rt)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+
+    /* Build */
+    UA_WriterGroupConfig newConfig;
+    retVal = UA_WriterGroupConfig_copy(config, &newConfig);
+    if(retVal == UA_STATUSCODE_GOOD)
+        retVal = UA_WriterGroupConfig_setDefaultMessageSettings(&newConfig);
+    if(retVal != UA_STATUSCODE_GOOD) {
+        /* The copy stops at a failed allocation of the properties */
+        if(!newConfig.groupProperties)
+            newConfig.groupPropertiesSize = 0;
+        UA_WriterGroupConfig_deleteMembers(&newConfig);
+        return retVal;
+    }
+
+    /* A new interval applies from the first cycle that is at least one new
+     * interval after the last publish. The entry with the new interval is
+     * added before the old one is removed, so that a failure leaves the group
+     * unchanged. Event-triggered groups pick it up when the trigger is
+     * removed. */
+    UA_Boolean intervalChanged =
+        currentWriterGroup->config.publishingInterval != newConfig.publishingInterval;
+    UA_Boolean cyclic = currentWriterGroup->publishCallbackIsRegistered;
+    UA_UInt64 newCallbackId = 0;
+    if(intervalChanged && cyclic) {
+        UA_DateTime notBefore = 0;
+        if(rt->lastPublish != 0)
+            notBefore = rt->lastPublish +
+                (UA_DateTime)(newConfig.publishingInterval * (UA_Double)UA_DATETIME_MSEC);
+        retVal = UA_WriterGroup_schedulePublish(server, currentWriterGroup,
+                                                newConfig.publishingInterval,
+                                                newConfig.priority, notBefore,
+                                                &newCallbackId);
+        if(retVal != UA_STATUSCODE_GOOD) {
+            UA_WriterGroupConfig_deleteMembers(&newConfig);
+            return retVal;
+        }
+    }
+
+    /* Swap */
+    UA_WriterGroupConfig oldConfig = currentWriterGroup->config;
+    currentWriterGroup->config = newConfig;
+    UA_WriterGroupConfig_deleteMembers(&oldConfig);
+
+    if(intervalChanged && cyclic) {
+        UA_WriterGroup_unregisterPublish(server, currentWriterGroup);
+        currentWriterGroup->publishCallbackId = newCallbackId;
+        currentWriterGroup->publishCallbackIsRegistered = true;
+    } else if(cyclic) {
+        UA_WriterGroup_setPublishPriority(server, currentWriterGroup);
+    }
+
+    if(intervalChanged && rt->publishingOffset >= newConfig.publishingInterval) {
         UA_LOG_WARNING(&server->config.logger, UA_LOGCATEGORY_SERVER,
-                       "No or unsupported WriterGroup update.");
+                       "Publishing offset exceeds the new interval and is disabled.");
+        rt->publishingOffset = -1.0;
     }
     return UA_STATUSCODE_GOOD;
 }
@@ -563,18 +1875,6 @@ UA_Server_addDataSetWriter(UA_Server *server,
     //save the current version of the connected PublishedDataSet
     newDataSetWriter->connectedDataSetVersion = currentDataSetContext->dataSetMetaData.configurationVersion;
 
-#ifdef UA_ENABLE_PUBSUB_DELTAFRAMES
-    //initialize the queue for the last values
-    newDataSetWriter->lastSamples = (UA_DataSetWriterSample * )
-        UA_calloc(currentDataSetContext->fieldSize, sizeof(UA_DataSetWriterSample));
-    if(!newDataSetWriter->lastSamples) {
-        UA_DataSetWriterConfig_deleteMembers(&newDataSetWriter->config);
-        UA_free(newDataSetWriter);
-        return UA_STATUSCODE_BADOUTOFMEMORY;
-    }
-    newDataSetWriter->lastSamplesCount = currentDataSetContext->fieldSize;
-#endif
-
     //connect PublishedDataSet with DataSetWriter
     newDataSetWriter->connectedDataSet = currentDataSetContext->identifier;
     newDataSetWriter->linkedWriterGroup = wg->identifier;
@@ -669,6 +1969,7 @@ UA_DataSetFieldConfig_deleteMembers(UA_DataSetFieldConfig *dataSetFieldConfig){
 
 static void
 UA_DataSetField_deleteMembers(UA_DataSetField *field) {
+    UA_DataSetFieldRuntime_delete(field);
     UA_DataSetFieldConfig_deleteMembers(&field->config);
     //delete DataSetField
     UA_NodeId_deleteMembers(&field->identifier);
@@ -676,6 +1977,437 @@ UA_DataSetField_deleteMembers(UA_DataSetField *field) {
     UA_FieldMetaData_deleteMembers(&field->fieldMetaData);
 }
 
+/**********************************************/
+/*            DataSetField sampling           */
+/**********************************************/
+
+/* Sampling state of a DataSetField: the mailbox, the sampling divisor and the
+ * compression. The entries are keyed by the field, which is allocated
+ * individually and does not move. An entry exists only while one of them is
+ * set. */
+typedef struct UA_DataSetFieldRuntime {
+    LIST_ENTRY(UA_DataSetFieldRuntime) listEntry;
+    const UA_DataSetField *field;
+    const UA_ValueMailbox *mailbox;
+    UA_UInt32 samplingDivisor; /* 0 or 1 for every cycle */
+    UA_FieldCompression compression;
+} UA_DataSetFieldRuntime;
+
+static LIST_HEAD(UA_ListOfDataSetFieldRuntime, UA_DataSetFieldRuntime) dataSetFieldRuntimes;
+
+/* Changes when an entry is created or removed and when the fields of a
+ * PublishedDataSet change. The indexes are then rebuilt. */
+static UA_UInt64 dataSetFieldRuntimesGeneration;
+
+static void
+UA_DataSetFieldRuntime_invalidate(void) {
+    dataSetFieldRuntimesGeneration++;
+}
+
+static UA_DataSetFieldRuntime *
+UA_DataSetFieldRuntime_find(const UA_DataSetField *field) {
+    if(LIST_EMPTY(&dataSetFieldRuntimes))
+        return NULL;
+    UA_DataSetFieldRuntime *entry;
+    LIST_FOREACH(entry, &dataSetFieldRuntimes, listEntry) {
+        if(entry->field == field)
+            return entry;
+    }
+    return NULL;
+}
+
+/* Find or create the entry of the field */
+static UA_DataSetFieldRuntime *
+UA_DataSetFieldRuntime_get(const UA_DataSetField *field) {
+    UA_DataSetFieldRuntime *entry = UA_DataSetFieldRuntime_find(field);
+    if(entry)
+        return entry;
+    entry = (UA_DataSetFieldRuntime *) UA_calloc(1, sizeof(UA_DataSetFieldRuntime));
+    if(!entry)
+        return NULL;
+    entry->field = field;
+    LIST_INSERT_HEAD(&dataSetFieldRuntimes, entry, listEntry);
+    UA_DataSetFieldRuntime_invalidate();
+    return entry;
+}
+
+/* Called for every removed field, also without an entry, as the positions of
+ * the other fields change */
+static void
+UA_DataSetFieldRuntime_delete(const UA_DataSetField *field) {
+    UA_DataSetFieldRuntime_invalidate();
+    UA_DataSetFieldRuntime *entry = UA_DataSetFieldRuntime_find(field);
+    if(!entry)
+        return;
+    LIST_REMOVE(entry, listEntry);
+    UA_free(entry);
+}
+
+/* Remove the entry once nothing is set */
+static void
+UA_DataSetFieldRuntime_release(UA_DataSetFieldRuntime *entry) {
+    if(entry->mailbox || entry->samplingDivisor > 1 ||
+       entry->compression.type != UA_FIELDCOMPRESSION_NONE)
+        return;
+    LIST_REMOVE(entry, listEntry);
+    UA_free(entry);
+    UA_DataSetFieldRuntime_invalidate();
+}
+
+/* The entries of the fields of a PublishedDataSet by field position, so that
+ * the DataSetMessage generation does not search the entries for every field.
+ * Keyed by the server and the NodeId, as the PublishedDataSets move in their
+ * array. */
+typedef struct UA_DataSetFieldRuntimeIndex {
+    LIST_ENTRY(UA_DataSetFieldRuntimeIndex) listEntry;
+    UA_Server *server;
+    UA_NodeId publishedDataSet;
+    UA_ConfigurationVersionDataType configurationVersion;
+    UA_UInt64 generation;
+    size_t runtimesSize;
+    UA_DataSetFieldRuntime **runtimes; /* NULL for fields without an entry */
+} UA_DataSetFieldRuntimeIndex;
+
+static LIST_HEAD(UA_ListOfDataSetFieldRuntimeIndex, UA_DataSetFieldRuntimeIndex)
+    dataSetFieldRuntimeIndexes;
+
+static UA_DataSetFieldRuntimeIndex *
+UA_DataSetFieldRuntimeIndex_find(UA_Server *server, const UA_NodeId *publishedDataSet) {
+    UA_DataSetFieldRuntimeIndex *index;
+    LIST_FOREACH(index, &dataSetFieldRuntimeIndexes, listEntry) {
+        if(index->server == server &&
+           UA_NodeId_equal(&index->publishedDataSet, publishedDataSet))
+            return index;
+    }
+    return NULL;
+}
+
+static void
+UA_DataSetFieldRuntimeIndex_delete(UA_Server *server, const UA_NodeId *publishedDataSet) {
+    UA_DataSetFieldRuntimeIndex *index = UA_DataSetFieldRuntimeIndex_find(server, publishedDataSet);
+    if(!index)
+        return;
+    LIST_REMOVE(index, listEntry);
+    UA_NodeId_deleteMembers(&index->publishedDataSet);
+    UA_free(index->runtimes);
+    UA_free(index);
+}
+
+/* The entries of the fields of the PublishedDataSet in the order of the
+ * DataSetMessage. NULL if no field has an entry (or out of memory, then the
+ * fields are sampled without their settings). Rebuilt after a change of the
+ * configuration version or of the entries. */
+static UA_DataSetFieldRuntime **
+UA_DataSetFieldRuntime_index(UA_Server *server, UA_PublishedDataSet *pds) {
+    if(LIST_EMPTY(&dataSetFieldRuntimes) || pds->fieldSize == 0)
+        return NULL;
+    UA_DataSetFieldRuntimeIndex *index = UA_DataSetFieldRuntimeIndex_find(server, &pds->identifier);
+    if(index && index->generation == dataSetFieldRuntimesGeneration &&
+       index->runtimesSize == pds->fieldSize &&
+       index->configurationVersion.majorVersion == pds->dataSetMetaData.configurationVersion.majorVersion &&
+       index->configurationVersion.minorVersion == pds->dataSetMetaData.configurationVersion.minorVersion)
+        return index->runtimes;
+
+    if(!index) {
+        index = (UA_DataSetFieldRuntimeIndex *) UA_calloc(1, sizeof(UA_DataSetFieldRuntimeIndex));
+        if(!index)
+            return NULL;
+        if(UA_NodeId_copy(&pds->identifier, &index->publishedDataSet) != UA_STATUSCODE_GOOD) {
+            UA_free(index);
+            return NULL;
+        }
+        index->server = server;
+        LIST_INSERT_HEAD(&dataSetFieldRuntimeIndexes, index, listEntry);
+    }
+    if(index->runtimesSize != pds->fieldSize) {
+        UA_DataSetFieldRuntime **runtimes = (UA_DataSetFieldRuntime **)
+            UA_realloc(index->runtimes, pds->fieldSize * sizeof(UA_DataSetFieldRuntime *));
+        if(!runtimes) {
+            UA_DataSetFieldRuntimeIndex_delete(server, &pds->identifier);
+            return NULL;
+        }
+        index->runtimes = runtimes;
+        index->runtimesSize = pds->fieldSize;
+    }
+    size_t i = 0;
+    UA_DataSetField *dsf;
+    LIST_FOREACH(dsf, &pds->fields, listEntry)
+        index->runtimes[i++] = UA_DataSetFieldRuntime_find(dsf);
+    index->generation = dataSetFieldRuntimesGeneration;
+    index->configurationVersion = pds->dataSetMetaData.configurationVersion;
+    return index->runtimes;
+}
+
+/* Compare the values of a mailbox with the variable of the field, as for the
+ * codecs. Variables with an abstract type or without a fixed value rank are
+ * not checked. */
+static UA_StatusCode
+UA_DataSetField_checkMailboxValue(UA_Server *server, const UA_DataSetField *field,
+                                  const UA_DataType *type, size_t arrayLength) {
+    if(field->config.field.variable.publishParameters.attributeId != UA_ATTRIBUTEID_VALUE)
+        return UA_STATUSCODE_BADTYPEMISMATCH;
+    const UA_NodeId *variable = &field->config.field.variable.publishParameters.publishedVariable;
+    UA_NodeId dataType;
+    if(UA_Server_readDataType(server, *variable, &dataType) == UA_STATUSCODE_GOOD) {
+        /* Boolean (1) to LocalizedText (21) */
+        UA_Boolean builtin = dataType.namespaceIndex == 0 &&
+            dataType.identifierType == UA_NODEIDTYPE_NUMERIC &&
+            dataType.identifier.numeric >= 1 && dataType.identifier.numeric <= 21;
+        UA_Boolean match = !builtin || UA_NodeId_equal(&dataType, &type->typeId);
+        UA_NodeId_deleteMembers(&dataType);
+        if(!match)
+            return UA_STATUSCODE_BADTYPEMISMATCH;
+    }
+    UA_Int32 valueRank;
+    UA_Int32 mailboxValueRank = (arrayLength > 0) ? 1 : -1;
+    if(UA_Server_readValueRank(server, *variable, &valueRank) == UA_STATUSCODE_GOOD &&
+       (valueRank == -1 || valueRank == 1) && valueRank != mailboxValueRank)
+        return UA_STATUSCODE_BADTYPEMISMATCH;
+    return UA_STATUSCODE_GOOD;
+}
+
+UA_StatusCode
+UA_Server_setDataSetFieldMailbox(UA_Server *server, const UA_NodeId dsf,
+                                 const UA_ValueMailbox *mailbox) {
+    UA_DataSetField *field = UA_DataSetField_findDSFbyId(server, dsf);
+    if(!field)
+        return UA_STATUSCODE_BADNOTFOUND;
+    if(!mailbox) {
+        UA_DataSetFieldRuntime *entry = UA_DataSetFieldRuntime_find(field);
+        if(entry) {
+            entry->mailbox = NULL;
+            UA_DataSetFieldRuntime_release(entry);
+        }
+        return UA_STATUSCODE_GOOD;
+    }
+
+    UA_StatusCode retval =
+        UA_DataSetField_checkMailboxValue(server, field, UA_ValueMailbox_getType(mailbox),
+                                          UA_ValueMailbox_getArrayLength(mailbox));
+    if(retval != UA_STATUSCODE_GOOD) {
+        UA_LOG_WARNING(&server->config.logger, UA_LOGCATEGORY_SERVER,
+                       "The mailbox does not match the variable of the DataSetField");
+        return retval;
+    }
+
+    UA_DataSetFieldRuntime *entry = UA_DataSetFieldRuntime_get(field);
+    if(!entry)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    entry->mailbox = mailbox;
+    return UA_STATUSCODE_GOOD;
+}
+
+UA_StatusCode
+UA_Server_setDataSetFieldSamplingDivisor(UA_Server *server, const UA_NodeId dsf,
+                                         UA_UInt32 samplingDivisor) {
+    UA_DataSetField *field = UA_DataSetField_findDSFbyId(server, dsf);
+    if(!field)
+        return UA_STATUSCODE_BADNOTFOUND;
+#ifdef UA_ENABLE_PUBSUB_DELTAFRAMES
+    if(samplingDivisor <= 1) {
+        UA_DataSetFieldRuntime *entry = UA_DataSetFieldRuntime_find(field);
+        if(entry) {
+            entry->samplingDivisor = 0;
+            UA_DataSetFieldRuntime_release(entry);
+        }
+        return UA_STATUSCODE_GOOD;
+    }
+    UA_DataSetFieldRuntime *entry = UA_DataSetFieldRuntime_get(field);
+    if(!entry)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    entry->samplingDivisor = samplingDivisor;
+    return UA_STATUSCODE_GOOD;
+#else
+    /* The last sample is kept in the sample store of the delta frames */
+    return UA_STATUSCODE_BADNOTSUPPORTED;
+#endif
+}
+
+UA_StatusCode
+UA_Server_setDataSetFieldCompression(UA_Server *server, const UA_NodeId dsf,
+                                     const UA_FieldCompression *compression) {
+    UA_DataSetField *field = UA_DataSetField_findDSFbyId(server, dsf);
+    if(!field)
+        return UA_STATUSCODE_BADNOTFOUND;
+    UA_Boolean enable = compression && compression->type != UA_FIELDCOMPRESSION_NONE;
+    UA_DataSetFieldRuntime *entry = enable ?
+        UA_DataSetFieldRuntime_get(field) : UA_DataSetFieldRuntime_find(field);
+    if(enable && !entry)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+
+    /* Publish the settings in the metadata of the field. This also checks
+     * them. */
+    UA_StatusCode retval =
+        UA_FieldCompression_setProperties(compression, &field->fieldMetaData.propertiesSize,
+                                          &field->fieldMetaData.properties);
+    if(retval != UA_STATUSCODE_GOOD) {
+        if(entry)
+            UA_DataSetFieldRuntime_release(entry);
+        return retval;
+    }
+    if(entry) {
+        if(enable)
+            entry->compression = *compression;
+        else
+            memset(&entry->compression, 0, sizeof(UA_FieldCompression));
+        UA_DataSetFieldRuntime_release(entry);
+    }
+
+    /* The encoded type of the field changes. Update the major version, so that
+     * the writers send a key frame. */
+    UA_PublishedDataSet *pds = UA_PublishedDataSet_findPDSbyId(server, field->publishedDataSet);
+    if(pds)
+        pds->dataSetMetaData.configurationVersion.majorVersion =
+            UA_PubSubConfigurationVersionTimeDifference();
+    return UA_STATUSCODE_GOOD;
+}
+
+/**********************************************/
+/*           PublishedDataSet snapshots       */
+/**********************************************/
+
+/* Snapshot of all fields of a PublishedDataSet. Keyed by the server and the
+ * identifier as the codecs, and used while the configuration version is the one at the time
+ * it was set. */
+typedef struct UA_PublishedDataSetSnapshot {
+    LIST_ENTRY(UA_PublishedDataSetSnapshot) listEntry;
+    UA_Server *server;
+    UA_NodeId publishedDataSet;
+    const UA_DataSetSnapshot *snapshot;
+    size_t *positions; /* of the snapshot fields in the DataSetMessage */
+    UA_ConfigurationVersionDataType configurationVersion;
+    UA_Boolean outdated; /* Logged once */
+} UA_PublishedDataSetSnapshot;
+
+static LIST_HEAD(UA_ListOfPublishedDataSetSnapshot, UA_PublishedDataSetSnapshot) publishedDataSetSnapshots;
+
+static UA_PublishedDataSetSnapshot *
+UA_PublishedDataSetSnapshot_find(UA_Server *server, const UA_NodeId *publishedDataSet) {
+    UA_PublishedDataSetSnapshot *entry;
+    LIST_FOREACH(entry, &publishedDataSetSnapshots, listEntry) {
+        if(entry->server == server &&
+           UA_NodeId_equal(&entry->publishedDataSet, publishedDataSet))
+            return entry;
+    }
+    return NULL;
+}
+
+static void
+UA_PublishedDataSetSnapshot_delete(UA_Server *server, const UA_NodeId *publishedDataSet) {
+    UA_PublishedDataSetSnapshot *entry = UA_PublishedDataSetSnapshot_find(server, publishedDataSet);
+    if(!entry)
+        return;
+    LIST_REMOVE(entry, listEntry);
+    UA_NodeId_deleteMembers(&entry->publishedDataSet);
+    UA_free(entry->positions);
+    UA_free(entry);
+}
+
+/* Sample all fields of the PublishedDataSet from its snapshot into the values
+ * in the order of the DataSetMessage. Returns false without a snapshot. */
+static UA_Boolean
+UA_PublishedDataSetSnapshot_sample(UA_Server *server, UA_PublishedDataSet *pds,
+                                   UA_DataValue *values) {
+    if(LIST_EMPTY(&publishedDataSetSnapshots))
+        return false;
+    UA_PublishedDataSetSnapshot *entry = UA_PublishedDataSetSnapshot_find(server, &pds->identifier);
+    if(!entry)
+        return false;
+    if(entry->configurationVersion.majorVersion != pds->dataSetMetaData.configurationVersion.majorVersion ||
+       entry->configurationVersion.minorVersion != pds->dataSetMetaData.configurationVersion.minorVersion) {
+        if(!entry->outdated) {
+            UA_LOG_WARNING(&server->config.logger, UA_LOGCATEGORY_SERVER,
+                           "PubSub Publish: The configuration of the PublishedDataSet changed. "
+                           "The fields are no longer sampled from the snapshot.");
+            entry->outdated = true;
+        }
+        return false;
+    }
+
+    UA_StatusCode res = UA_DataSetSnapshot_readDataValues(entry->snapshot, values, entry->positions);
+    UA_DateTime now = UA_DateTime_now();
+    for(size_t i = 0; i < pds->fieldSize; i++) {
+        if(res != UA_STATUSCODE_GOOD)
+            values[i].status = res;
+        values[i].hasServerTimestamp = true;
+        values[i].serverTimestamp = now;
+    }
+    return true;
+}
+
+UA_StatusCode
+UA_Server_setPublishedDataSetSnapshot(UA_Server *server, const UA_NodeId pds,
+                                      const UA_DataSetSnapshot *snapshot,
+                                      const UA_NodeId *fields) {
+    UA_PublishedDataSet *currentDataSet = UA_PublishedDataSet_findPDSbyId(server, pds);
+    if(!currentDataSet)
+        return UA_STATUSCODE_BADNOTFOUND;
+    if(!snapshot) {
+        UA_PublishedDataSetSnapshot_delete(server, &pds);
+        return UA_STATUSCODE_GOOD;
+    }
+    if(!fields || UA_DataSetSnapshot_getFieldsSize(snapshot) != currentDataSet->fieldSize)
+        return UA_STATUSCODE_BADINVALIDARGUMENT;
+
+    /* Find the position of every snapshot field in the DataSetMessage. Every
+     * field of the PublishedDataSet has to be in the snapshot once. */
+    size_t fieldsSize = currentDataSet->fieldSize;
+    size_t *positions = (size_t *) UA_calloc(fieldsSize > 0 ? fieldsSize : 1, sizeof(size_t));
+    if(!positions)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    UA_StatusCode retval = UA_STATUSCODE_GOOD;
+    for(size_t i = 0; i < fieldsSize && retval == UA_STATUSCODE_GOOD; i++) {
+        size_t position = 0;
+        UA_DataSetField *dsf;
+        LIST_FOREACH(dsf, &currentDataSet->fields, listEntry) {
+            if(UA_NodeId_equal(&dsf->identifier, &fields[i]))
+                break;
+            position++;
+        }
+        if(!dsf) {
+            retval = UA_STATUSCODE_BADNOTFOUND;
+            break;
+        }
+        for(size_t j = 0; j < i; j++) {
+            if(positions[j] == position)
+                retval = UA_STATUSCODE_BADINVALIDARGUMENT;
+        }
+        positions[i] = position;
+        const UA_DataSetSnapshotField *field = UA_DataSetSnapshot_getField(snapshot, i);
+        if(retval == UA_STATUSCODE_GOOD)
+            retval = UA_DataSetField_checkMailboxValue(server, dsf, field->type, field->arrayLength);
+    }
+    if(retval != UA_STATUSCODE_GOOD) {
+        UA_LOG_WARNING(&server->config.logger, UA_LOGCATEGORY_SERVER,
+                       "The snapshot does not match the fields of the PublishedDataSet");
+        UA_free(positions);
+        return retval;
+    }
+
+    UA_PublishedDataSetSnapshot *entry = UA_PublishedDataSetSnapshot_find(server, &pds);
+    if(!entry) {
+        entry = (UA_PublishedDataSetSnapshot *) UA_calloc(1, sizeof(UA_PublishedDataSetSnapshot));
+        if(!entry) {
+            UA_free(positions);
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+        }
+        retval = UA_NodeId_copy(&pds, &entry->publishedDataSet);
+        if(retval != UA_STATUSCODE_GOOD) {
+            UA_free(positions);
+            UA_free(entry);
+            return retval;
+        }
+        entry->server = server;
+        LIST_INSERT_HEAD(&publishedDataSetSnapshots, entry, listEntry);
+    }
+    UA_free(entry->positions);
+    entry->positions = positions;
+    entry->snapshot = snapshot;
+    entry->configurationVersion = currentDataSet->dataSetMetaData.configurationVersion;
+    entry->outdated = false;
+    return UA_STATUSCODE_GOOD;
+}
+
 /*********************************************************/
 /*               PublishValues handling                  */
 /*********************************************************/
@@ -726,16 +2458,85 @@ valueChangedVariant(UA_Variant *oldValue, UA_Variant *newValue){
     UA_ByteString_delete(newValueEncoding);
     return compareResult;
 }
+
+/* Values of the same pointer-free type are compared in place. Only the others
+ * need to be encoded. */
+static UA_Boolean
+valueChangedSample(UA_Variant *oldValue, UA_Variant *newValue) {
+    const UA_DataType *type = oldValue->type;
+    if(type && type == newValue->type && type->pointerFree &&
+       oldValue->arrayDimensionsSize == 0 && newValue->arrayDimensionsSize == 0 &&
+       oldValue->arrayLength == newValue->arrayLength &&
+       UA_Variant_isScalar(oldValue) == UA_Variant_isScalar(newValue)) {
+        size_t length = UA_Variant_isScalar(oldValue) ? 1 : oldValue->arrayLength;
+        return memcmp(oldValue->data, newValue->data, length * type->memSize) != 0;
+    }
+    return valueChangedVariant(oldValue, newValue);
+}
+#endif
+
+#ifdef UA_ENABLE_PUBSUB_DELTAFRAMES
+/* Whether the field is sampled in this cycle of the writer. Fields with a
+ * sampling divisor are sampled in every n-th cycle and in the first one after
+ * the samples were reset. Otherwise the last sample is moved to the current
+ * generation, so that it is published again and does not count as changed. */
+static UA_Boolean
+UA_DataSetWriterSamples_isSamplingCycle(UA_DataSetWriterSamples *samples,
+                                        const UA_DataSetFieldRuntime *frt, size_t field) {
+    if(!frt || frt->samplingDivisor <= 1 || samples->cycle % frt->samplingDivisor == 0)
+        return true;
+    UA_DataValue tmp = samples->current[field];
+    samples->current[field] = samples->previous[field];
+    samples->previous[field] = tmp;
+    return false;
+}
 #endif
 
+/* Replace value by the compressed encoding of the raw sample. Both may be the
+ * same. */
+static void
+UA_PubSubDataSetField_compressValue(const UA_DataSetFieldRuntime *frt,
+                                    const UA_DataValue *raw, UA_DataValue *value) {
+    if(!frt || frt->compression.type == UA_FIELDCOMPRESSION_NONE)
+        return;
+    UA_Variant compressed;
+    UA_Variant_init(&compressed);
+    UA_StatusCode retval = UA_STATUSCODE_GOOD;
+    if(raw->hasValue)
+        retval = UA_FieldCompression_compress(&frt->compression, &raw->value, &compressed);
+    UA_DataValue result = *raw;
+    result.value = compressed;
+    if(retval != UA_STATUSCODE_GOOD) {
+        result.hasValue = false;
+        result.hasStatus = true;
+        result.status = retval;
+    }
+    UA_DataValue_deleteMembers(value);
+    *value = result;
+}
+
 /**
  * Obtain the latest value for a specific DataSetField. This method is currently
- * called inside the DataSetMessage generation process.
+ * called inside the DataSetMessage generation process. The value may hold an
+ * older sample that is replaced. Its memory is reused for the value of a
+ * mailbox.
  */
 static void
 UA_PubSubDataSetField_sampleValue(UA_Server *server, UA_DataSetField *field,
-                                  UA_DataValue *value) {
+                                  const UA_DataSetFieldRuntime *frt, UA_DataValue *value) {
+    /* Take the value from the mailbox of the field */
+    if(frt && frt->mailbox) {
+        if(UA_ValueMailbox_readDataValue(frt->mailbox, value) != UA_STATUSCODE_GOOD) {
+            value->hasStatus = true;
+            value->status = UA_STATUSCODE_BADOUTOFMEMORY;
+        }
+        value->hasServerTimestamp = true;
+        value->serverTimestamp = UA_DateTime_now();
+        return;
+    }
+
     /* Read the value */
+    UA_DataValue_deleteMembers(value);
     UA_ReadValueId rvid;
     UA_ReadValueId_init(&rvid);
     rvid.nodeId = field->config.field.variable.publishParameters.publishedVariable;
@@ -744,6 +2545,32 @@ UA_PubSubDataSetField_sampleValue(UA_Server *server, UA_DataSetField *field,
     *value = UA_Server_read(server, &rvid, UA_TIMESTAMPSTORETURN_BOTH);
 }
 
+#ifdef UA_ENABLE_PUBSUB_DELTAFRAMES
+/* Sample a field into the current generation. The raw samples from a mailbox
+ * or the snapshot stay in their own slot, so that their memory is reused in
+ * the next cycle. Only the compressed encoding is put into the current
+ * generation. Returns false if the field is not sampled in this cycle. */
+static UA_Boolean
+UA_DataSetWriterSamples_sampleField(UA_Server *server, UA_DataSetWriterSamples *samples,
+                                    UA_DataSetField *field, const UA_DataSetFieldRuntime *frt,
+                                    size_t i, UA_Boolean fromSnapshot) {
+    if(!fromSnapshot && !UA_DataSetWriterSamples_isSamplingCycle(samples, frt, i))
+        return false;
+    UA_Boolean compressed = frt && frt->compression.type != UA_FIELDCOMPRESSION_NONE;
+    if(!fromSnapshot) {
+        UA_PubSubDataSetField_sampleValue(server, field, frt,
+                                          compressed ? &samples->raw[i] : &samples->current[i]);
+    } else if(!compressed) {
+        UA_DataValue tmp = samples->current[i];
+        samples->current[i] = samples->raw[i];
+        samples->raw[i] = tmp;
+    }
+    if(compressed)
+        UA_PubSubDataSetField_compressValue(frt, &samples->raw[i], &samples->current[i]);
+    return true;
+}
+#endif
+
 static UA_StatusCode
 UA_PubSubDataSetWriter_generateKeyFrameMessage(UA_Server *server, UA_DataSetMessage *dataSetMessage,
                                                UA_DataSetWriter *dataSetWriter) {
@@ -761,6 +2588,13 @@ UA_PubSubDataSetWriter_generateKeyFrameMessage(UA_Server *server, UA_DataSetMess
     if(!dataSetMessage->data.keyFrameData.dataSetFields)
         return UA_STATUSCODE_BADOUTOFMEMORY;
 
+#ifdef UA_ENABLE_PUBSUB_DELTAFRAMES
+    UA_DataSetWriterSamples *samples =
+        UA_DataSetWriterSamples_get(dataSetWriter, currentDataSet->fieldSize);
+    if(!samples)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+#endif
+
 #ifdef UA_ENABLE_JSON_ENCODING
     /* json: insert fieldnames used as json keys */
        dataSetMessage->data.keyFrameData.fieldNames =
@@ -769,7 +2603,18 @@ UA_PubSubDataSetWriter_generateKeyFrameMessage(UA_Server *server, UA_DataSetMess
            return UA_STATUSCODE_BADOUTOFMEMORY;
 #endif
 
+    /* Sample all fields at once from the snapshot of the PublishedDataSet */
+#ifdef UA_ENABLE_PUBSUB_DELTAFRAMES
+    UA_Boolean sampled =
+        UA_PublishedDataSetSnapshot_sample(server, currentDataSet, samples->raw);
+#else
+    UA_Boolean sampled =
+        UA_PublishedDataSetSnapshot_sample(server, currentDataSet,
+                                           dataSetMessage->data.keyFrameData.dataSetFields);
+#endif
+
     /* Loop over the fields */
+    UA_DataSetFieldRuntime **frts = UA_DataSetFieldRuntime_index(server, currentDataSet);
     size_t counter = 0;
     UA_DataSetField *dsf;
     LIST_FOREACH(dsf, &currentDataSet->fields, listEntry) {
@@ -782,7 +2627,17 @@ UA_PubSubDataSetWriter_generateKeyFrameMessage(UA_Server *server, UA_DataSetMess
 
         /* Sample the value */
         UA_DataValue *dfv = &dataSetMessage->data.keyFrameData.dataSetFields[counter];
-        UA_PubSubDataSetField_sampleValue(server, dsf, dfv);
+#ifdef UA_ENABLE_PUBSUB_DELTAFRAMES
+        /* into the sample store. The message borrows the value. */
+        UA_DataSetFieldRuntime *frt = frts ? frts[counter] : NULL;
+        UA_DataSetWriterSamples_sampleField(server, samples, dsf, frt, counter, sampled);
+        *dfv = samples->current[counter];
+#else
+        UA_DataSetFieldRuntime *frt = frts ? frts[counter] : NULL;
+        if(!sampled)
+            UA_PubSubDataSetField_sampleValue(server, dsf, frt, dfv);
+        UA_PubSubDataSetField_compressValue(frt, dfv, dfv);
+#endif
 
         /* Deactivate statuscode? */
         if(((u64)dataSetWriter->config.dataSetFieldContentMask & (u64)UA_DATASETFIELDCONTENTMASK_STATUSCODE) == 0)
@@ -802,14 +2657,12 @@ UA_PubSubDataSetWriter_generateKeyFrameMessage(UA_Server *server, UA_DataSetMess
             (u64)UA_DATASETFIELDCONTENTMASK_SERVERPICOSECONDS) == 0)
             dfv->hasServerPicoseconds = false;
 
-#ifdef UA_ENABLE_PUBSUB_DELTAFRAMES
-        /* Update lastValue store */
-        UA_DataValue_deleteMembers(&dataSetWriter->lastSamples[counter].value);
-        UA_DataValue_copy(dfv, &dataSetWriter->lastSamples[counter].value);
-#endif
-
         counter++;
     }
+
+#ifdef UA_ENABLE_PUBSUB_DELTAFRAMES
+    UA_DataSetWriterSamples_swap(samples);
+#endif
     return UA_STATUSCODE_GOOD;
 }
 
@@ -828,67 +2681,97 @@ UA_PubSubDataSetWriter_generateDeltaFrameMessage(UA_Server *server,
     dataSetMessage->header.dataSetMessageValid = true;
     dataSetMessage->header.dataSetMessageType = UA_DATASETMESSAGE_DATADELTAFRAME;
 
+    /* The generate function ensures a sample store of the right size */
+    UA_DataSetWriterSamples *samples = UA_DataSetWriterSamples_find(dataSetWriter);
+    if(!samples || samples->samplesSize != currentDataSet->fieldSize)
+        return UA_STATUSCODE_BADINTERNALERROR;
+    memset(samples->changed, 0, (samples->samplesSize / 64 + 1) * sizeof(UA_UInt64));
+
+    /* Sample all fields at once from the snapshot of the PublishedDataSet */
+    UA_Boolean sampled =
+        UA_PublishedDataSetSnapshot_sample(server, currentDataSet, samples->raw);
+
+    UA_DataSetFieldRuntime **frts = UA_DataSetFieldRuntime_index(server, currentDataSet);
     UA_DataSetField *dsf;
     size_t counter = 0;
     LIST_FOREACH(dsf, &currentDataSet->fields, listEntry) {
-        /* Sample the value */
-        UA_DataValue value;
-        UA_DataValue_init(&value);
-        UA_PubSubDataSetField_sampleValue(server, dsf, &value);
+        /* Sample the value into the current generation */
+        UA_DataValue *value = &samples->current[counter];
+        UA_DataSetFieldRuntime *frt = frts ? frts[counter] : NULL;
+        if(!UA_DataSetWriterSamples_sampleField(server, samples, dsf, frt, counter, sampled)) {
+            /* The last sample is unchanged */
+            counter++;
+            continue;
+        }
 
         /* Check if the value has changed */
-        if(valueChangedVariant(&dataSetWriter->lastSamples[counter].value.value, &value.value)) {
+        if(valueChangedSample(&samples->previous[counter].value, &value->value)) {
+            samples->changed[counter / 64] |= (UA_UInt64)1 << (counter % 64);
             /* increase fieldCount for current delta message */
             dataSetMessage->data.deltaFrameData.fieldCount++;
-            dataSetWriter->lastSamples[counter].valueChanged = true;
-
-            /* Update last stored sample */
-            UA_DataValue_deleteMembers(&dataSetWriter->lastSamples[counter].value);
-            dataSetWriter->lastSamples[counter].value = value;
-        } else {
-            UA_DataValue_deleteMembers(&value);
-            dataSetWriter->lastSamples[counter].valueChanged = false;
         }
-
         counter++;
     }
 
     /* Allocate DeltaFrameFields */
-    UA_DataSetMessage_DeltaFrameField *deltaFields = (UA_DataSetMessage_DeltaFrameField *)
-            UA_calloc(dataSetMessage->data.deltaFrameData.fieldCount, sizeof(UA_DataSetMessage_DeltaFrameField));
-    if(!deltaFields)
-        return UA_STATUSCODE_BADOUTOFMEMORY;
+    UA_DataSetMessage_DeltaFrameField *deltaFields = NULL;
+    if(dataSetMessage->data.deltaFrameData.fieldCount > 0) {
+        deltaFields = (UA_DataSetMessage_DeltaFrameField *)
+            UA_calloc(dataSetMessage->data.deltaFrameData.fieldCount,
+                      sizeof(UA_DataSetMessage_DeltaFrameField));
+        if(!deltaFields)
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+    }
 
+    /* The fields reference the current generation. Words without changes are
+     * skipped. */
     dataSetMessage->data.deltaFrameData.deltaFrameFields = deltaFields;
     size_t currentDeltaField = 0;
-    for(size_t i = 0; i < currentDataSet->fieldSize; i++) {
-        if(!dataSetWriter->lastSamples[i].valueChanged)
-            continue;
-
-        UA_DataSetMessage_DeltaFrameField *dff = &deltaFields[currentDeltaField];
+    for(size_t word = 0; word * 64 < samples->samplesSize; word++) {
+        UA_UInt64 bits = samples->changed[word];
+        for(size_t i = word * 64; bits != 0; i++, bits >>= 1) {
+            if(!(bits & 1))
+                continue;
+
+            UA_DataSetMessage_DeltaFrameField *dff = &deltaFields[currentDeltaField];
+
+            dff->fieldIndex = (UA_UInt16) i;
+            dff->fieldValue = samples->current[i];
+
+            /* Deactivate statuscode? */
+            if(((u64)dataSetWriter->config.dataSetFieldContentMask & (u64)UA_DATASETFIELDCONTENTMASK_STATUSCODE) == 0)
+                dff->fieldValue.hasStatus = false;
+
+            /* Deactivate timestamps? */
+            if(((u64)dataSetWriter->config.dataSetFieldContentMask & (u64)UA_DATASETFIELDCONTENTMASK_SOURCETIMESTAMP) == 0)
+                dff->fieldValue.hasSourceTimestamp = false;
+            if(((u64)dataSetWriter->config.dataSetFieldContentMask & (u64)UA_DATASETFIELDCONTENTMASK_SOURCEPICOSECONDS) ==
+               0)
+                dff->fieldValue.hasServerPicoseconds = false;
+            if(((u64)dataSetWriter->config.dataSetFieldContentMask & (u64)UA_DATASETFIELDCONTENTMASK_SERVERTIMESTAMP) == 0)
+                dff->fieldValue.hasServerTimestamp = false;
+            if(((u64)dataSetWriter->config.dataSetFieldContentMask & (u64)UA_DATASETFIELDCONTENTMASK_SERVERPICOSECONDS) ==
+               0)
+                dff->fieldValue.hasServerPicoseconds = false;
+
+            currentDeltaField++;
+        }
+    }
 
-        dff->fieldIndex = (UA_UInt16) i;
-        UA_DataValue_copy(&dataSetWriter->lastSamples[i].value, &dff->fieldValue);
-        dataSetWriter->lastSamples[i].valueChanged = false;
+    UA_DataSetWriterSamples_swap(samples);
+    return UA_STATUSCODE_GOOD;
+}
+#endif
 
-        /* Deactivate statuscode? */
-        if(((u64)dataSetWriter->config.dataSetFieldContentMask & (u64)UA_DATASETFIELDCONTENTMASK_STATUSCODE) == 0)
-            dff->fieldValue.hasStatus = false;
-
-        /* Deactivate timestamps? */
-        if(((u64)dataSetWriter->config.dataSetFieldContentMask & (u64)UA_DATASETFIELDCONTENTMASK_SOURCETIMESTAMP) == 0)
-            dff->fieldValue.hasSourceTimestamp = false;
-        if(((u64)dataSetWriter->config.dataSetFieldContentMask & (u64)UA_DATASETFIELDCONTENTMASK_SOURCEPICOSECONDS) ==
-           0)
-            dff->fieldValue.hasServerPicoseconds = false;
-        if(((u64)dataSetWriter->config.dataSetFieldContentMask & (u64)UA_DATASETFIELDCONTENTMASK_SERVERTIMESTAMP) == 0)
-            dff->fieldValue.hasServerTimestamp = false;
-        if(((u64)dataSetWriter->config.dataSetFieldContentMask & (u64)UA_DATASETFIELDCONTENTMASK_SERVERPICOSECONDS) ==
-           0)
-            dff->fieldValue.hasServerPicoseconds = false;
-
-        currentDeltaField++;
-    }
+#ifdef UA_ENABLE_PUBSUB_DELTAFRAMES
+/* A KeepAlive in place of a key frame that is held back by the key frame
+ * budget. The header is already set up. The standard defines the sequence
+ * number of a KeepAlive as the one of the next DataSetMessage. */
+static UA_StatusCode
+UA_DataSetWriter_generateKeepAlive(UA_DataSetMessage *dataSetMessage,
+                                   UA_DataSetWriter *dataSetWriter) {
+    dataSetMessage->header.dataSetMessageType = UA_DATASETMESSAGE_KEEPALIVE;
+    dataSetWriter->actualDataSetMessageSequenceCount--;
     return UA_STATUSCODE_GOOD;
 }
 #endif
@@ -897,11 +2780,13 @@ UA_PubSubDataSetWriter_generateDeltaFrameMessage(UA_Server *server,
  * Generate a DataSetMessage for the given writer.
  *
  * @param dataSetWriter ptr to corresponding writer
+ * @param rt runtime state of the WriterGroup for the key frame budget (or NULL)
  * @return ptr to generated DataSetMessage
  */
 static UA_StatusCode
 UA_DataSetWriter_generateDataSetMessage(UA_Server *server, UA_DataSetMessage *dataSetMessage,
-                                        UA_DataSetWriter *dataSetWriter) {
+                                        UA_DataSetWriter *dataSetWriter,
+                                        UA_WriterGroupRuntime *rt) {
     UA_PublishedDataSet *currentDataSet =
         UA_PublishedDataSet_findPDSbyId(server, dataSetWriter->connectedDataSet);
     if(!currentDataSet)
@@ -1048,35 +2933,45 @@ UA_DataSetWriter_generateDataSetMessage(UA_Server *server, UA_DataSetMessage *da
     /* JSON does not differ between deltaframes and keyframes, only keyframes are currently used. */
     if(messageType != UA_TYPES_JSONDATASETWRITERMESSAGEDATATYPE){
 #ifdef UA_ENABLE_PUBSUB_DELTAFRAMES
-    /* Check if the PublishedDataSet version has changed -> if yes flush the lastValue store and send a KeyFrame */
+    /* The standard defines: if a PDS contains only one fields no delta messages
+     * should be generated because they need more memory than a keyframe with 1
+     * field. Only writers with delta frames count against the key frame
+     * budget of the WriterGroup. */
+    UA_Boolean deltaFrames =
+        currentDataSet->fieldSize > 1 && dataSetWriter->config.keyFrameCount > 0;
+
+    /* Check if the PublishedDataSet version has changed -> if yes send a
+     * KeyFrame. The sample store is resized there. */
+    UA_DataSetWriterSamples *samples = UA_DataSetWriterSamples_find(dataSetWriter);
     if(dataSetWriter->connectedDataSetVersion.majorVersion != currentDataSet->dataSetMetaData.configurationVersion.majorVersion ||
-       dataSetWriter->connectedDataSetVersion.minorVersion != currentDataSet->dataSetMetaData.configurationVersion.minorVersion) {
-        /* Remove old samples */
-        for(size_t i = 0; i < dataSetWriter->lastSamplesCount; i++)
-            UA_DataValue_deleteMembers(&dataSetWriter->lastSamples[i].value);
-
-        /* Realloc pds dependent memory */
-        dataSetWriter->lastSamplesCount = currentDataSet->fieldSize;
-        UA_DataSetWriterSample *newSamplesArray = (UA_DataSetWriterSample * )
-            UA_realloc(dataSetWriter->lastSamples, sizeof(UA_DataSetWriterSample) * dataSetWriter->lastSamplesCount);
-        if(!newSamplesArray)
-            return UA_STATUSCODE_BADOUTOFMEMORY;
-        dataSetWriter->lastSamples = newSamplesArray;
-        memset(dataSetWriter->lastSamples, 0, sizeof(UA_DataSetWriterSample) * dataSetWriter->lastSamplesCount);
-
+       dataSetWriter->connectedDataSetVersion.minorVersion != currentDataSet->dataSetMetaData.configurationVersion.minorVersion ||
+       !samples || samples->samplesSize != currentDataSet->fieldSize) {
+        if(deltaFrames && !UA_WriterGroupRuntime_takeKeyFrame(rt))
+            return UA_DataSetWriter_generateKeepAlive(dataSetMessage, dataSetWriter);
         dataSetWriter->connectedDataSetVersion = currentDataSet->dataSetMetaData.configurationVersion;
-        UA_PubSubDataSetWriter_generateKeyFrameMessage(server, dataSetMessage, dataSetWriter);
-        dataSetWriter->deltaFrameCounter = 0;
-        return UA_STATUSCODE_GOOD;
+        dataSetWriter->deltaFrameCounter = deltaFrames ?
+            UA_WriterGroupRuntime_keyFrameCounter(rt, dataSetWriter) : 0;
+        /* Sample all fields, also those with a sampling divisor */
+        if(samples)
+            samples->cycle = 0;
+        return UA_PubSubDataSetWriter_generateKeyFrameMessage(server, dataSetMessage, dataSetWriter);
     }
 
-    /* The standard defines: if a PDS contains only one fields no delta messages
-     * should be generated because they need more memory than a keyframe with 1
-     * field. */
     if(currentDataSet->fieldSize > 1 && dataSetWriter->deltaFrameCounter > 0 &&
        dataSetWriter->deltaFrameCounter <= dataSetWriter->config.keyFrameCount) {
         UA_PubSubDataSetWriter_generateDeltaFrameMessage(server, dataSetMessage, dataSetWriter);
-        dataSetWriter->deltaFrameCounter++;
+        dataSetWriter->deltaFrameCounter++;
+        return UA_STATUSCODE_GOOD;
+    }
+
+    /* The key frame is due, but the budget of the cycle is used up. Continue
+     * with delta frames and try again in the next cycle. Without a valid last
+     * key frame (counter reset by a configuration change), send a KeepAlive
+     * instead. */
+    if(deltaFrames && !UA_WriterGroupRuntime_takeKeyFrame(rt)) {
+        if(dataSetWriter->deltaFrameCounter == 0)
+            return UA_DataSetWriter_generateKeepAlive(dataSetMessage, dataSetWriter);
+        UA_PubSubDataSetWriter_generateDeltaFrameMessage(server, dataSetMessage, dataSetWriter);
         return UA_STATUSCODE_GOOD;
     }
 
@@ -1088,9 +2983,28 @@ UA_DataSetWriter_generateDataSetMessage(UA_Server *server, UA_DataSetMessage *da
     return UA_STATUSCODE_GOOD;
 }
 
+/* The field values of the DataSetMessages are borrowed from the sample store
+ * of the writer. Detach them before the message is freed. */
+static void
+UA_DataSetMessage_release(UA_DataSetMessage *dsm) {
+#ifdef UA_ENABLE_PUBSUB_DELTAFRAMES
+    if(dsm->header.dataSetMessageType == UA_DATASETMESSAGE_DATAKEYFRAME &&
+       dsm->data.keyFrameData.dataSetFields) {
+        for(size_t i = 0; i < dsm->data.keyFrameData.fieldCount; i++)
+            UA_DataValue_init(&dsm->data.keyFrameData.dataSetFields[i]);
+    } else if(dsm->header.dataSetMessageType == UA_DATASETMESSAGE_DATADELTAFRAME &&
+              dsm->data.deltaFrameData.deltaFrameFields) {
+        for(size_t i = 0; i < dsm->data.deltaFrameData.fieldCount; i++)
+            UA_DataValue_init(&dsm->data.deltaFrameData.deltaFrameFields[i].fieldValue);
+    }
+#endif
+    UA_DataSetMessage_free(dsm);
+}
+
 static UA_StatusCode
-sendNetworkMessageJson(UA_PubSubConnection *connection, UA_DataSetMessage *dsm,
-                   UA_UInt16 *writerIds, UA_Byte dsmCount, UA_ExtensionObject *transportSettings) {
+sendNetworkMessageJson(UA_Server *server, UA_PubSubConnection *connection,
+                       UA_DataSetMessage *dsm, UA_UInt16 *writerIds, UA_Byte dsmCount,
+                       UA_ExtensionObject *transportSettings) {
    UA_StatusCode retval = UA_STATUSCODE_BADNOTSUPPORTED;
 #ifdef UA_ENABLE_JSON_ENCODING
     UA_NetworkMessage nm;
@@ -1130,18 +3044,101 @@ sendNetworkMessageJson(UA_PubSubConnection *connection, UA_DataSetMessage *dsm,
     }
 
     /* Send the prepared messages */
-    retval = connection->channel->send(connection->channel, transportSettings, &buf);
+    retval = UA_PubSubConnection_send(server, connection, transportSettings, &buf,
+                                      writerIds, dsm, dsmCount, false);
     if(msgSize > UA_MAX_STACKBUF)
         UA_ByteString_deleteMembers(&buf);
 #endif
     return retval;
 }
 
+/* Chunk size if the WriterGroup has no maximum NetworkMessage size. Fills an
+ * Ethernet frame with IPv4 and UDP headers. */
+#define UA_PUBSUB_CHUNK_DEFAULT_MESSAGESIZE 1472
+
+/* Send each DataSetMessage as a sequence of chunk messages of up to maxSize
+ * bytes. The DataSetMessages are encoded with the generic encoding and then
+ * cut into slices. */
+static UA_StatusCode
+sendChunkedNetworkMessage(UA_Server *server, UA_PubSubConnection *connection,
+                          UA_NetworkMessage *nm,
+                          UA_DataSetMessage *dsm, UA_UInt16 *writerIds, UA_Byte dsmCount,
+                          size_t maxSize, UA_ExtensionObject *transportSettings) {
+    if(maxSize == 0)
+        maxSize = UA_PUBSUB_CHUNK_DEFAULT_MESSAGESIZE;
+    nm->chunkMessage = true;
+    nm->payloadHeaderEnabled = true;
+    nm->payloadHeader.dataSetPayloadHeader.count = 1;
+    nm->payload.dataSetPayload.sizes = NULL;
+    nm->payload.dataSetPayload.dataSetMessages = NULL;
+    size_t headerSize = UA_NetworkMessage_calcSizeChunkHeaders(nm);
+    if(headerSize == 0 || headerSize >= maxSize)
+        return UA_STATUSCODE_BADENCODINGLIMITSEXCEEDED;
+    size_t chunkSize = maxSize - headerSize;
+
+    /* One buffer for the chunks that are not encoded into buffers of the
+     * transport */
+    UA_ByteString chunkBuf;
+    UA_StatusCode retval = UA_ByteString_allocBuffer(&chunkBuf, maxSize);
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+
+    for(UA_Byte i = 0; i < dsmCount && retval == UA_STATUSCODE_GOOD; i++) {
+        UA_ByteString dsmBuf;
+        size_t dsmSize = UA_DataSetMessage_calcSizeBinary(&dsm[i]);
+        if(dsmSize > UA_UINT32_MAX) {
+            retval = UA_STATUSCODE_BADENCODINGLIMITSEXCEEDED;
+            break;
+        }
+        retval = UA_ByteString_allocBuffer(&dsmBuf, dsmSize);
+        if(retval != UA_STATUSCODE_GOOD)
+            break;
+        UA_Byte *dsmPos = dsmBuf.data;
+        retval = UA_DataSetMessage_encodeBinary(&dsm[i], &dsmPos, &dsmBuf.data[dsmSize]);
+
+        nm->payloadHeader.dataSetPayloadHeader.dataSetWriterIds = &writerIds[i];
+        UA_NetworkMessageChunk chunk;
+        chunk.messageSequenceNumber = dsm[i].header.dataSetMessageSequenceNr;
+        chunk.totalSize = (UA_UInt32)dsmSize;
+        for(size_t offset = 0; offset < dsmSize && retval == UA_STATUSCODE_GOOD;
+            offset += chunkSize) {
+            chunk.chunkOffset = (UA_UInt32)offset;
+            chunk.chunkData.data = &dsmBuf.data[offset];
+            chunk.chunkData.length = (dsmSize - offset < chunkSize) ? dsmSize - offset : chunkSize;
+            size_t msgSize = headerSize + chunk.chunkData.length;
+
+            const UA_PubSubChannelExtension *ext =
+                UA_PubSubConnection_bufferExtension(server, connection);
+            UA_ByteString buf = chunkBuf;
+            buf.length = msgSize;
+            UA_Boolean lent = ext &&
+                ext->acquireBuffer(connection->channel, msgSize, &buf) == UA_STATUSCODE_GOOD;
+            UA_Byte *bufPos = buf.data;
+            retval = UA_NetworkMessage_encodeChunk(nm, &chunk, &bufPos, &buf.data[buf.length]);
+            if(retval != UA_STATUSCODE_GOOD) {
+                if(lent)
+                    ext->releaseBuffer(connection->channel, &buf);
+                break;
+            }
+            if(lent)
+                retval = ext->sendBuffer(connection->channel, transportSettings, &buf);
+            else
+                retval = UA_PubSubConnection_send(server, connection, transportSettings,
+                                                  &buf, &writerIds[i], &dsm[i], 1, true);
+        }
+        UA_ByteString_deleteMembers(&dsmBuf);
+    }
+    UA_ByteString_deleteMembers(&chunkBuf);
+    return retval;
+}
+
 static UA_StatusCode
-sendNetworkMessage(UA_PubSubConnection *connection, UA_WriterGroup *wg,
-                   UA_DataSetMessage *dsm, UA_UInt16 *writerIds, UA_Byte dsmCount,
+sendNetworkMessage(UA_PubSubConnection *connection, UA_WriterGroupRuntime *rt,
+                   UA_DataSetMessage *dsm, UA_UInt16 *writerIds,
+                   const UA_DataSetCodec *const *codecs, UA_Byte dsmCount,
                    UA_ExtensionObject *messageSettings,
                    UA_ExtensionObject *transportSettings) {
+    UA_WriterGroup *wg = rt->writerGroup;
 
     if(messageSettings->content.decoded.type !=
        &UA_TYPES[UA_TYPES_UADPWRITERGROUPMESSAGEDATATYPE])
@@ -1185,11 +3182,7 @@ sendNetworkMessage(UA_PubSubConnection *connection, UA_WriterGroup *wg,
         nm.publisherId.publisherIdString = connection->config->publisherId.string;
     }
 
-    /* Compute the length of the dsm separately for the header */
     UA_STACKARRAY(UA_UInt16, dsmLengths, dsmCount);
-    for(UA_Byte i = 0; i < dsmCount; i++)
-        dsmLengths[i] = (UA_UInt16)UA_DataSetMessage_calcSizeBinary(&dsm[i]);
-
     nm.payloadHeader.dataSetPayloadHeader.count = dsmCount;
     nm.payloadHeader.dataSetPayloadHeader.dataSetWriterIds = writerIds;
     nm.groupHeader.writerGroupId = wg->config.writerGroupId;
@@ -1197,17 +3190,79 @@ sendNetworkMessage(UA_PubSubConnection *connection, UA_WriterGroup *wg,
     nm.payload.dataSetPayload.sizes = dsmLengths;
     nm.payload.dataSetPayload.dataSetMessages = dsm;
 
-    /* Allocate the buffer. Allocate on the stack if the buffer is small. */
+    UA_PUBSUB_TRACE(nm_start, wg->config.writerGroupId, writerIds[0],
+                    dsm[0].header.dataSetMessageSequenceNr, dsmCount);
+
+    /* Enable the security header with the next nonce */
+#ifdef UA_ENABLE_PUBSUB_ENCRYPTION
+    UA_Byte nonce[UA_PUBSUB_SECURITY_MESSAGENONCE_LENGTH];
+    UA_PubSubSecurityContext *security = rt->security;
+    if(security)
+        UA_PubSubSecurityContext_setHeader(security, &nm, nonce);
+#endif
+
+    /* Use the generated codecs if there are any. This also computes the
+     * lengths of the DataSetMessages for the header. Secured messages are
+     * always encoded with the codec functions. */
+    size_t msgSize = 0;
+    UA_Boolean anyCodec = nm.securityEnabled;
+    for(UA_Byte i = 0; i < dsmCount; i++)
+        anyCodec |= (codecs[i] != NULL);
+    if(anyCodec)
+        msgSize = UA_NetworkMessage_calcSizeBinaryCodec(&nm, codecs);
+    UA_Boolean useCodecs = (msgSize > 0);
+    if(nm.securityEnabled && !useCodecs)
+        return UA_STATUSCODE_BADNOTSUPPORTED;
+    UA_Boolean oversized = false;
+    if(!useCodecs) {
+        /* Compute the length of the dsm separately for the header */
+        for(UA_Byte i = 0; i < dsmCount; i++) {
+            size_t dsmSize = UA_DataSetMessage_calcSizeBinary(&dsm[i]);
+            oversized |= (dsmSize > UA_UINT16_MAX);
+            dsmLengths[i] = (UA_UInt16)dsmSize;
+        }
+        if(!oversized)
+            msgSize = UA_NetworkMessage_calcSizeBinary(&nm);
+    }
+
+    /* Send in chunks if the message is larger than allowed for the group or
+     * if a DataSetMessage does not fit the 16-bit size in the header */
+    size_t maxSize = rt->maxNetworkMessageSize;
+    if(!nm.securityEnabled && (oversized || (maxSize > 0 && msgSize > maxSize)))
+        return sendChunkedNetworkMessage(rt->server, connection, &nm, dsm, writerIds, dsmCount,
+                                         maxSize, transportSettings);
+
+    /* Space for the signature after the payload */
+#ifdef UA_ENABLE_PUBSUB_ENCRYPTION
+    if(security)
+        msgSize += UA_PUBSUB_SECURITY_SIGNATURE_LENGTH;
+#endif
+
+    /* Secured messages cannot be chunked. Do not send them as one oversized
+     * datagram either. */
+    if(nm.securityEnabled && maxSize > 0 && msgSize > maxSize)
+        return UA_STATUSCODE_BADNOTSUPPORTED;
+
+    /* Encode into a transmit buffer of the transport if it lends one. Else
+     * allocate the buffer. Allocate on the stack if the buffer is small. */
     UA_ByteString buf;
-    size_t msgSize = UA_NetworkMessage_calcSizeBinary(&nm);
+    UA_PUBSUB_TRACE(nm_sized, wg->config.writerGroupId, writerIds[0],
+                    dsm[0].header.dataSetMessageSequenceNr, msgSize);
+    const UA_PubSubChannelExtension *ext =
+        UA_PubSubConnection_bufferExtension(rt->server, connection);
+    UA_Boolean lent = ext &&
+        ext->acquireBuffer(connection->channel, msgSize, &buf) == UA_STATUSCODE_GOOD;
     size_t stackSize = 1;
-    if(msgSize <= UA_MAX_STACKBUF)
+    if(!lent && msgSize <= UA_MAX_STACKBUF)
         stackSize = msgSize;
     UA_STACKARRAY(UA_Byte, stackBuf, stackSize);
-    buf.data = stackBuf;
-    buf.length = msgSize;
+    UA_Boolean allocated = !lent && msgSize > UA_MAX_STACKBUF;
     UA_StatusCode retval;
-    if(msgSize > UA_MAX_STACKBUF) {
+    if(!lent) {
+        buf.data = stackBuf;
+        buf.length = msgSize;
+    }
+    if(allocated) {
         retval = UA_ByteString_allocBuffer(&buf, msgSize);
         if(retval != UA_STATUSCODE_GOOD)
             return retval;
@@ -1217,31 +3272,99 @@ sendNetworkMessage(UA_PubSubConnection *connection, UA_WriterGroup *wg,
     UA_Byte *bufPos = buf.data;
     memset(bufPos, 0, msgSize);
     const UA_Byte *bufEnd = &buf.data[buf.length];
-    retval = UA_NetworkMessage_encodeBinary(&nm, &bufPos, bufEnd);
+    if(useCodecs)
+        retval = UA_NetworkMessage_encodeBinaryCodec(&nm, codecs, &bufPos, bufEnd);
+    else
+        retval = UA_NetworkMessage_encodeBinary(&nm, &bufPos, bufEnd);
+#ifdef UA_ENABLE_PUBSUB_ENCRYPTION
+    /* Encrypt and sign in the encode buffer */
+    if(security && retval == UA_STATUSCODE_GOOD)
+        retval = UA_PubSubSecurityContext_protect(security, &buf,
+                                                  UA_NetworkMessage_calcSizeHeadersCodec(&nm));
+#endif
+    UA_PUBSUB_TRACE(nm_encoded, wg->config.writerGroupId, writerIds[0],
+                    dsm[0].header.dataSetMessageSequenceNr, msgSize, retval);
     if(retval != UA_STATUSCODE_GOOD) {
-        if(msgSize > UA_MAX_STACKBUF)
+        if(lent)
+            ext->releaseBuffer(connection->channel, &buf);
+        if(allocated)
             UA_ByteString_deleteMembers(&buf);
         return retval;
     }
 
     /* Send the prepared messages */
-    retval = connection->channel->send(connection->channel, transportSettings, &buf);
-    if(msgSize > UA_MAX_STACKBUF)
+    if(lent)
+        retval = ext->sendBuffer(connection->channel, transportSettings, &buf);
+    else
+        retval = UA_PubSubConnection_send(rt->server, connection, transportSettings, &buf,
+                                          writerIds, dsm, dsmCount, false);
+    UA_PUBSUB_TRACE(nm_sent, wg->config.writerGroupId, writerIds[0],
+                    dsm[0].header.dataSetMessageSequenceNr, msgSize, retval);
+    if(allocated)
         UA_ByteString_deleteMembers(&buf);
     return retval;
 }
 
+/* Minimum time between the start of the cycle and the launch time. Less is
+ * not enough to encode and hand over the messages. */
+#define UA_PUBSUB_LAUNCH_LEAD_NS 50000
+
+/* Set the launch time of the messages of this cycle to the publishing offset
+ * after the nominal start of the cycle. Returns true if the transport holds
+ * the messages until then. */
+static UA_Boolean
+UA_WriterGroup_setLaunchTime(UA_Server *server, UA_WriterGroup *writerGroup,
+                             UA_WriterGroupRuntime *rt, UA_PubSubConnection *connection) {
+    if(!rt || rt->publishingOffset < 0.0 || rt->triggerEnabled)
+        return false;
+    const UA_PubSubChannelExtension *ext = UA_PubSubChannel_getExtension(connection->channel);
+    if(!ext || !ext->now || !ext->setLaunchTime)
+        return false;
+
+    /* The callback runs at the start of the cycle plus some jitter. The
+     * nominal cycles start at multiples of the interval on the channel clock,
+     * so that the jitter does not move the launch times. */
+    UA_UInt64 now = ext->now(connection->channel);
+    UA_UInt64 interval = (UA_UInt64)(writerGroup->config.publishingInterval * 1e6);
+    UA_UInt64 cycleStart = now;
+    if(interval > 0)
+        cycleStart = now - (now % interval);
+    UA_UInt64 launchTime = cycleStart + (UA_UInt64)(rt->publishingOffset * 1e6);
+    if(launchTime < now + UA_PUBSUB_LAUNCH_LEAD_NS) {
+        UA_LOG_WARNING(&server->config.logger, UA_LOGCATEGORY_SERVER,
+                       "PubSub Publish: Publishing offset already passed, sending right away");
+        return false;
+    }
+    return ext->setLaunchTime(connection->channel, launchTime) == UA_STATUSCODE_GOOD;
+}
+
 /* This callback triggers the collection and publish of NetworkMessages and the
  * contained DataSetMessages. */
 void
 UA_WriterGroup_publishCallback(UA_Server *server, UA_WriterGroup *writerGroup) {
-    UA_LOG_DEBUG(&server->config.logger, UA_LOGCATEGORY_SERVER, "Publish Callback");
-
     if(!writerGroup) {
         UA_LOG_WARNING(&server->config.logger, UA_LOGCATEGORY_SERVER,
                        "Publish failed. WriterGroup not found");
         return;
     }
+    UA_WriterGroupRuntime *rt = UA_WriterGroupRuntime_get(server, writerGroup);
+    if(!rt) {
+        UA_LOG_WARNING(&server->config.logger, UA_LOGCATEGORY_SERVER,
+                       "Publish failed. Out of memory");
+        return;
+    }
+    UA_WriterGroup_publish(server, rt);
+}
+
+/* The publish of the callbacks that hold the runtime state of the group */
+static void
+UA_WriterGroup_publish(UA_Server *server, UA_WriterGroupRuntime *rt) {
+    UA_LOG_DEBUG(&server->config.logger, UA_LOGCATEGORY_SERVER, "Publish Callback");
+    UA_WriterGroup *writerGroup = rt->writerGroup;
+
+    /* The cycles continue from here after a change of the interval */
+    rt->lastPublish = UA_DateTime_nowMonotonic();
+    rt->keyFramesInCycle = 0;
 
     /* Nothing to do? */
     if(writerGroup->writersCount <= 0)
@@ -1264,6 +3387,12 @@ UA_WriterGroup_publishCallback(UA_Server *server, UA_WriterGroup *writerGroup) {
         return;
     }
 
+    UA_PUBSUB_TRACE(publish_start, writerGroup->config.writerGroupId,
+                    writerGroup->writersCount);
+
+    /* Hold the messages back until the publishing offset */
+    UA_Boolean launchTimeSet = UA_WriterGroup_setLaunchTime(server, writerGroup, rt, connection);
+
     /* How many DSM can be sent in one NM? */
     UA_Byte maxDSM = (UA_Byte)writerGroup->config.maxEncapsulatedDataSetMessageCount;
     if(writerGroup->config.maxEncapsulatedDataSetMessageCount > UA_BYTE_MAX)
@@ -1279,6 +3408,7 @@ UA_WriterGroup_publishCallback(UA_Server *server, UA_WriterGroup *writerGroup) {
     UA_DataSetWriter *dsw;
     UA_STACKARRAY(UA_UInt16, dsWriterIds, writerGroup->writersCount);
     UA_STACKARRAY(UA_DataSetMessage, dsmStore, writerGroup->writersCount);
+    UA_STACKARRAY(const UA_DataSetCodec *, dsmCodecs, writerGroup->writersCount);
     LIST_FOREACH(dsw, &writerGroup->writers, listEntry) {
         /* Find the dataset */
         UA_PublishedDataSet *pds =
@@ -1291,31 +3421,36 @@ UA_WriterGroup_publishCallback(UA_Server *server, UA_WriterGroup *writerGroup) {
 
         /* Generate the DSM */
         UA_StatusCode res =
-            UA_DataSetWriter_generateDataSetMessage(server, &dsmStore[dsmCount], dsw);
+            UA_DataSetWriter_generateDataSetMessage(server, &dsmStore[dsmCount], dsw, rt);
+        UA_PUBSUB_TRACE(dsm_generated, writerGroup->config.writerGroupId,
+                        dsw->config.dataSetWriterId,
+                        dsmStore[dsmCount].header.dataSetMessageSequenceNr, res);
         if(res != UA_STATUSCODE_GOOD) {
             UA_LOG_WARNING(&server->config.logger, UA_LOGCATEGORY_SERVER,
                            "PubSub Publish: DataSetMessage creation failed");
             continue;
         }
+        dsmCodecs[dsmCount] = UA_PublishedDataSetCodec_select(server, pds);
 
         /* Send right away if there is only this DSM in a NM. If promoted fields
          * are contained in the PublishedDataSet, then this DSM must go into a
          * dedicated NM as well. */
         if(pds->promotedFieldsCount > 0 || maxDSM == 1) {
             if(writerGroup->config.encodingMimeType == UA_PUBSUB_ENCODING_UADP){
-                res = sendNetworkMessage(connection, writerGroup, &dsmStore[dsmCount],
-                                         &dsw->config.dataSetWriterId, 1,
+                res = sendNetworkMessage(connection, rt, &dsmStore[dsmCount],
+                                         &dsw->config.dataSetWriterId,
+                                         &dsmCodecs[dsmCount], 1,
                                          &writerGroup->config.messageSettings,
                                          &writerGroup->config.transportSettings);
             }else if(writerGroup->config.encodingMimeType == UA_PUBSUB_ENCODING_JSON){
-                res = sendNetworkMessageJson(connection, &dsmStore[dsmCount],
+                res = sendNetworkMessageJson(server, connection, &dsmStore[dsmCount],
                         &dsw->config.dataSetWriterId, 1, &writerGroup->config.transportSettings);
             }
 
             if(res != UA_STATUSCODE_GOOD)
                 UA_LOG_WARNING(&server->config.logger, UA_LOGCATEGORY_SERVER,
                                "PubSub Publish: Could not send a NetworkMessage");
-            UA_DataSetMessage_free(&dsmStore[dsmCount]);
+            UA_DataSetMessage_release(&dsmStore[dsmCount]);
             continue;
         }
 
@@ -1332,12 +3467,13 @@ UA_WriterGroup_publishCallback(UA_Server *server, UA_WriterGroup *writerGroup) {
 
         UA_StatusCode res3 = UA_STATUSCODE_GOOD;
         if(writerGroup->config.encodingMimeType == UA_PUBSUB_ENCODING_UADP){
-            res3 = sendNetworkMessage(connection, writerGroup, &dsmStore[i * maxDSM],
-                                      &dsWriterIds[i * maxDSM], nmDsmCount,
+            res3 = sendNetworkMessage(connection, rt, &dsmStore[i * maxDSM],
+                                      &dsWriterIds[i * maxDSM], &dsmCodecs[i * maxDSM],
+                                      nmDsmCount,
                                       &writerGroup->config.messageSettings,
                                       &writerGroup->config.transportSettings);
         }else if(writerGroup->config.encodingMimeType == UA_PUBSUB_ENCODING_JSON){
-            res3 = sendNetworkMessageJson(connection, &dsmStore[i * maxDSM],
+            res3 = sendNetworkMessageJson(server, connection, &dsmStore[i * maxDSM],
                     &dsWriterIds[i * maxDSM], nmDsmCount, &writerGroup->config.transportSettings);
         }
 
@@ -1348,7 +3484,17 @@ UA_WriterGroup_publishCallback(UA_Server *server, UA_WriterGroup *writerGroup) {
 
     /* Clean up DSM */
     for(size_t i = 0; i < dsmCount; i++)
-        UA_DataSetMessage_free(&dsmStore[i]);
+        UA_DataSetMessage_release(&dsmStore[i]);
+
+    if(launchTimeSet)
+        UA_PubSubChannel_getExtension(connection->channel)->setLaunchTime(connection->channel, 0);
+
+    /* End of the publish cycle. Transports that queue messages (io_uring)
+     * hand them to the kernel here. */
+    if(connection->channel->yield)
+        connection->channel->yield(connection->channel, 0);
+
+    UA_PUBSUB_TRACE(publish_done, writerGroup->config.writerGroupId);
 }
 
 /* Add new publishCallback. The first execution is triggered directly after
@@ -1356,16 +3502,479 @@ UA_WriterGroup_publishCallback(UA_Server *server, UA_WriterGroup *writerGroup) {
 UA_StatusCode
 UA_WriterGroup_addPublishCallback(UA_Server *server, UA_WriterGroup *writerGroup) {
     UA_StatusCode retval =
-            UA_PubSubManager_addRepeatedCallback(server,
-                                                 (UA_ServerCallback) UA_WriterGroup_publishCallback,
-                                                 writerGroup, writerGroup->config.publishingInterval,
-                                                 &writerGroup->publishCallbackId);
+        UA_WriterGroup_schedulePublish(server, writerGroup,
+                                       writerGroup->config.publishingInterval,
+                                       writerGroup->config.priority, 0,
+                                       &writerGroup->publishCallbackId);
     if(retval == UA_STATUSCODE_GOOD)
         writerGroup->publishCallbackIsRegistered = true;
 
     /* Run once after creation */
-    UA_WriterGroup_publishCallback(server, writerGroup);
+    UA_WriterGroupRuntime *rt = UA_WriterGroupRuntime_find(writerGroup);
+    if(rt)
+        UA_WriterGroup_publish(server, rt);
     return retval;
 }
 
+/**********************************************/
+/*          Event-triggered publishing        */
+/**********************************************/
+
+static void
+UA_WriterGroup_triggerPublish(UA_Server *server, UA_WriterGroupRuntime *rt);
+
+static void
+UA_WriterGroup_triggerCallback(UA_Server *server, void *data) {
+    UA_WriterGroupRuntime *rt = (UA_WriterGroupRuntime *) data;
+    rt->triggerPending = false;
+    UA_WriterGroup_triggerPublish(server, rt);
+}
+
+static void
+UA_WriterGroup_heartbeatCallback(UA_Server *server, void *data) {
+    UA_WriterGroupRuntime *rt = (UA_WriterGroupRuntime *) data;
+    rt->heartbeatIsRegistered = false;
+    UA_WriterGroup_triggerPublish(server, rt);
+}
+
+/* Publish the group and re-arm the heartbeat relative to this publish */
+static void
+UA_WriterGroup_triggerPublish(UA_Server *server, UA_WriterGroupRuntime *rt) {
+    UA_WriterGroup_publish(server, rt);
+
+    if(rt->heartbeatIsRegistered) {
+        UA_Server_removeCallback(server, rt->heartbeatCallbackId);
+        rt->heartbeatIsRegistered = false;
+    }
+    if(rt->trigger.maxInterval <= 0.0)
+        return;
+    UA_DateTime due = rt->lastPublish +
+        (UA_DateTime)(rt->trigger.maxInterval * (UA_Double)UA_DATETIME_MSEC);
+    if(UA_Server_addTimedCallback(server, UA_WriterGroup_heartbeatCallback, rt,
+                                  due, &rt->heartbeatCallbackId) == UA_STATUSCODE_GOOD)
+        rt->heartbeatIsRegistered = true;
+}
+
+/* The write hook of a published variable. The value callback of the variable
+ * that was replaced by the hook is called from the hook and restored when the
+ * last event-triggered group of the server stops monitoring the variable. */
+typedef struct UA_TriggerHook {
+    LIST_ENTRY(UA_TriggerHook) listEntry;
+    UA_Server *server;
+    UA_NodeId nodeId;
+    UA_ValueCallback callback; /* of the variable before the hook */
+    size_t refCount;           /* number of groups that monitor the variable */
+} UA_TriggerHook;
+
+static LIST_HEAD(UA_ListOfTriggerHook, UA_TriggerHook) triggerHooks;
+
+static UA_TriggerHook *
+UA_TriggerHook_find(UA_Server *server, const UA_NodeId *nodeId) {
+    UA_TriggerHook *hook;
+    LIST_FOREACH(hook, &triggerHooks, listEntry) {
+        if(hook->server == server && UA_NodeId_equal(&hook->nodeId, nodeId))
+            return hook;
+    }
+    return NULL;
+}
+
+/* Install the hook on the variable, keeping its value callback */
+static UA_StatusCode
+UA_TriggerHook_add(UA_Server *server, const UA_NodeId *nodeId) {
+    UA_TriggerHook *hook = UA_TriggerHook_find(server, nodeId);
+    if(hook) {
+        hook->refCount++;
+        return UA_STATUSCODE_GOOD;
+    }
+
+    const UA_Node *node = UA_Nodestore_getNode(server->nsCtx, nodeId);
+    if(!node)
+        return UA_STATUSCODE_BADNODEIDUNKNOWN;
+    if(node->nodeClass != UA_NODECLASS_VARIABLE) {
+        UA_Nodestore_releaseNode(server->nsCtx, node);
+        return UA_STATUSCODE_BADNODECLASSINVALID;
+    }
+    const UA_VariableNode *variable = (const UA_VariableNode *)node;
+    UA_ValueCallback existing;
+    memset(&existing, 0, sizeof(UA_ValueCallback));
+    if(variable->valueSource == UA_VALUESOURCE_DATA)
+        existing = variable->value.data.callback;
+    UA_Nodestore_releaseNode(server->nsCtx, node);
+
+    hook = (UA_TriggerHook *) UA_calloc(1, sizeof(UA_TriggerHook));
+    if(!hook)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    UA_StatusCode retVal = UA_NodeId_copy(nodeId, &hook->nodeId);
+    if(retVal != UA_STATUSCODE_GOOD) {
+        UA_free(hook);
+        return retVal;
+    }
+    hook->server = server;
+    hook->callback = existing;
+    hook->refCount = 1;
+
+    /* Reads go to the existing callback directly */
+    UA_ValueCallback callback;
+    callback.onRead = existing.onRead;
+    callback.onWrite = UA_WriterGroup_triggerOnWrite;
+    retVal = UA_Server_setVariableNode_valueCallback(server, *nodeId, callback);
+    if(retVal != UA_STATUSCODE_GOOD) {
+        UA_NodeId_deleteMembers(&hook->nodeId);
+        UA_free(hook);
+        return retVal;
+    }
+    LIST_INSERT_HEAD(&triggerHooks, hook, listEntry);
+    return UA_STATUSCODE_GOOD;
+}
+
+/* Restore the value callback when the last group releases the hook */
+static void
+UA_TriggerHook_remove(UA_Server *server, const UA_NodeId *nodeId) {
+    UA_TriggerHook *hook = UA_TriggerHook_find(server, nodeId);
+    if(!hook)
+        return;
+    if(--hook->refCount > 0)
+        return;
+    UA_Server_setVariableNode_valueCallback(server, hook->nodeId, hook->callback);
+    LIST_REMOVE(hook, listEntry);
+    UA_NodeId_deleteMembers(&hook->nodeId);
+    UA_free(hook);
+}
+
+static UA_Boolean
+UA_WriterGroupRuntime_monitors(const UA_WriterGroupRuntime *rt, const UA_NodeId *nodeId) {
+    for(size_t i = 0; i < rt->monitoredNodesSize; i++) {
+        if(UA_NodeId_equal(&rt->monitoredNodes[i], nodeId))
+            return true;
+    }
+    return false;
+}
+
+/* Write hook of the monitored variables. The publish is not done inside the
+ * write. It is deferred to a timed callback, so that several writes from the
+ * same producer callback end up in one NetworkMessage. */
+static void
+UA_WriterGroup_triggerOnWrite(UA_Server *server, const UA_NodeId *sessionId,
+                              void *sessionContext, const UA_NodeId *nodeId,
+                              void *nodeContext, const UA_NumericRange *range,
+                              const UA_DataValue *data) {
+    /* Chain to the value callback of the variable */
+    UA_TriggerHook *hook = UA_TriggerHook_find(server, nodeId);
+    if(hook && hook->callback.onWrite)
+        hook->callback.onWrite(server, sessionId, sessionContext, nodeId,
+                               nodeContext, range, data);
+
+    UA_DateTime now = UA_DateTime_nowMonotonic();
+    UA_WriterGroupRuntime *rt;
+    LIST_FOREACH(rt, &writerGroupRuntimes, listEntry) {
+        if(rt->server != server || !rt->triggerEnabled || rt->triggerPending)
+            continue;
+        if(!UA_WriterGroupRuntime_monitors(rt, nodeId))
+            continue;
+
+        /* Coalesce changes within minInterval after the last publish */
+        UA_DateTime due = rt->lastPublish +
+            (UA_DateTime)(rt->trigger.minInterval * (UA_Double)UA_DATETIME_MSEC);
+        if(due < now)
+            due = now;
+        if(UA_Server_addTimedCallback(server, UA_WriterGroup_triggerCallback, rt,
+                                      due, &rt->triggerCallbackId) != UA_STATUSCODE_GOOD) {
+            UA_LOG_WARNING(&server->config.logger, UA_LOGCATEGORY_SERVER,
+                           "PubSub Publish: Could not schedule event-triggered publish");
+            continue;
+        }
+        rt->triggerPending = true;
+    }
+}
+
+/* Collect the published variables of all fields reachable from the writers */
+static UA_StatusCode
+UA_WriterGroupRuntime_collectMonitoredNodes(UA_Server *server, UA_WriterGroupRuntime *rt) {
+    size_t nodesSize = 0;
+    UA_DataSetWriter *dsw;
+    LIST_FOREACH(dsw, &rt->writerGroup->writers, listEntry) {
+        UA_PublishedDataSet *pds = UA_PublishedDataSet_findPDSbyId(server, dsw->connectedDataSet);
+        if(pds)
+            nodesSize += pds->fieldSize;
+    }
+    if(nodesSize == 0)
+        return UA_STATUSCODE_GOOD;
+
+    rt->monitoredNodes = (UA_NodeId *) UA_calloc(nodesSize, sizeof(UA_NodeId));
+    if(!rt->monitoredNodes)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+
+    LIST_FOREACH(dsw, &rt->writerGroup->writers, listEntry) {
+        UA_PublishedDataSet *pds = UA_PublishedDataSet_findPDSbyId(server, dsw->connectedDataSet);
+        if(!pds)
+            continue;
+        UA_DataSetField *dsf;
+        LIST_FOREACH(dsf, &pds->fields, listEntry) {
+            const UA_NodeId *variable = &dsf->config.field.variable.publishParameters.publishedVariable;
+            if(UA_WriterGroupRuntime_monitors(rt, variable))
+                continue;
+            UA_StatusCode retVal = UA_NodeId_copy(variable, &rt->monitoredNodes[rt->monitoredNodesSize]);
+            if(retVal != UA_STATUSCODE_GOOD)
+                return retVal;
+            rt->monitoredNodesSize++;
+        }
+    }
+    return UA_STATUSCODE_GOOD;
+}
+
+static void
+UA_WriterGroup_disableTrigger(UA_Server *server, UA_WriterGroup *writerGroup) {
+    UA_WriterGroupRuntime *rt = UA_WriterGroupRuntime_find(writerGroup);
+    if(!rt || !rt->triggerEnabled)
+        return;
+    rt->triggerEnabled = false;
+
+    if(rt->triggerPending) {
+        UA_Server_removeCallback(server, rt->triggerCallbackId);
+        rt->triggerPending = false;
+    }
+    if(rt->heartbeatIsRegistered) {
+        UA_Server_removeCallback(server, rt->heartbeatCallbackId);
+        rt->heartbeatIsRegistered = false;
+    }
+
+    /* Release the write hooks. The last group restores the value callback. */
+    for(size_t i = 0; i < rt->monitoredNodesSize; i++)
+        UA_TriggerHook_remove(server, &rt->monitoredNodes[i]);
+    UA_Array_delete(rt->monitoredNodes, rt->monitoredNodesSize, &UA_TYPES[UA_TYPES_NODEID]);
+    rt->monitoredNodes = NULL;
+    rt->monitoredNodesSize = 0;
+}
+
+UA_StatusCode
+UA_Server_setWriterGroupTrigger(UA_Server *server, const UA_NodeId writerGroup,
+                                const UA_WriterGroupTriggerConfig *config) {
+    if(!config || config->minInterval < 0.0 || config->maxInterval < 0.0 ||
+       (config->maxInterval > 0.0 && config->maxInterval < config->minInterval))
+        return UA_STATUSCODE_BADINVALIDARGUMENT;
+
+    UA_WriterGroup *wg = UA_WriterGroup_findWGbyId(server, writerGroup);
+    if(!wg)
+        return UA_STATUSCODE_BADNOTFOUND;
+
+    UA_WriterGroupRuntime *rt = UA_WriterGroupRuntime_get(server, wg);
+    if(!rt)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+
+    /* Reconfigure an already triggered group from scratch */
+    UA_WriterGroup_disableTrigger(server, wg);
+
+    UA_StatusCode retVal = UA_WriterGroupRuntime_collectMonitoredNodes(server, rt);
+    if(retVal != UA_STATUSCODE_GOOD) {
+        UA_Array_delete(rt->monitoredNodes, rt->monitoredNodesSize, &UA_TYPES[UA_TYPES_NODEID]);
+        rt->monitoredNodes = NULL;
+        rt->monitoredNodesSize = 0;
+        return retVal;
+    }
+
+    /* Keep only the variables that could be hooked */
+    size_t hooked = 0;
+    for(size_t i = 0; i < rt->monitoredNodesSize; i++) {
+        retVal = UA_TriggerHook_add(server, &rt->monitoredNodes[i]);
+        if(retVal != UA_STATUSCODE_GOOD) {
+            UA_LOG_WARNING(&server->config.logger, UA_LOGCATEGORY_SERVER,
+                           "Event-triggered WriterGroup: Cannot hook a published variable");
+            UA_NodeId_deleteMembers(&rt->monitoredNodes[i]);
+            continue;
+        }
+        rt->monitoredNodes[hooked++] = rt->monitoredNodes[i];
+    }
+    rt->monitoredNodesSize = hooked;
+
+    /* Stop the cyclic publishing */
+    UA_WriterGroup_unregisterPublish(server, wg);
+
+    rt->trigger = *config;
+    rt->triggerEnabled = true;
+
+    /* Publish the current state right away. This also arms the heartbeat. */
+    UA_WriterGroup_triggerPublish(server, rt);
+    return UA_STATUSCODE_GOOD;
+}
+
+UA_StatusCode
+UA_Server_removeWriterGroupTrigger(UA_Server *server, const UA_NodeId writerGroup) {
+    UA_WriterGroup *wg = UA_WriterGroup_findWGbyId(server, writerGroup);
+    if(!wg)
+        return UA_STATUSCODE_BADNOTFOUND;
+    UA_WriterGroupRuntime *rt = UA_WriterGroupRuntime_find(wg);
+    if(!rt || !rt->triggerEnabled)
+        return UA_STATUSCODE_GOOD;
+    UA_WriterGroup_disableTrigger(server, wg);
+    return UA_WriterGroup_addPublishCallback(server, wg);
+}
+
+/**********************************************/
+/*            Scheduled transmission          */
+/**********************************************/
+
+UA_StatusCode
+UA_Server_setWriterGroupPublishingOffset(UA_Server *server, const UA_NodeId writerGroup,
+                                         UA_Duration publishingOffset) {
+    UA_WriterGroup *wg = UA_WriterGroup_findWGbyId(server, writerGroup);
+    if(!wg)
+        return UA_STATUSCODE_BADNOTFOUND;
+    if(publishingOffset >= wg->config.publishingInterval)
+        return UA_STATUSCODE_BADINVALIDARGUMENT;
+
+    /* The transport must be able to hold messages back */
+    if(publishingOffset >= 0.0) {
+        UA_PubSubConnection *connection =
+            UA_PubSubConnection_findConnectionbyId(server, wg->linkedConnection);
+        if(!connection || !connection->channel)
+            return UA_STATUSCODE_BADNOTFOUND;
+        const UA_PubSubChannelExtension *ext =
+            UA_PubSubChannel_getExtension(connection->channel);
+        if(!ext || !ext->now || !ext->setLaunchTime)
+            return UA_STATUSCODE_BADNOTSUPPORTED;
+    }
+
+    UA_WriterGroupRuntime *rt = UA_WriterGroupRuntime_get(server, wg);
+    if(!rt)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    rt->publishingOffset = (publishingOffset >= 0.0) ? publishingOffset : -1.0;
+    return UA_STATUSCODE_GOOD;
+}
+
+/**********************************************/
+/*            Key frame staggering            */
+/**********************************************/
+
+UA_StatusCode
+UA_Server_setWriterGroupKeyFrameConfig(UA_Server *server, const UA_NodeId writerGroup,
+                                       const UA_WriterGroupKeyFrameConfig *config) {
+#ifdef UA_ENABLE_PUBSUB_DELTAFRAMES
+    if(!config)
+        return UA_STATUSCODE_BADINVALIDARGUMENT;
+    UA_WriterGroup *wg = UA_WriterGroup_findWGbyId(server, writerGroup);
+    if(!wg)
+        return UA_STATUSCODE_BADNOTFOUND;
+    UA_WriterGroupRuntime *rt = UA_WriterGroupRuntime_get(server, wg);
+    if(!rt)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    rt->keyFrame = *config;
+    rt->nextKeyFrameSlot = 0;
+    return UA_STATUSCODE_GOOD;
+#else
+    return UA_STATUSCODE_BADNOTSUPPORTED;
+#endif
+}
+
+/**********************************************/
+/*                  Chunking                  */
+/**********************************************/
+
+UA_StatusCode
+UA_Server_setWriterGroupMaxNetworkMessageSize(UA_Server *server, const UA_NodeId writerGroup,
+                                              UA_UInt32 maxNetworkMessageSize) {
+    UA_WriterGroup *wg = UA_WriterGroup_findWGbyId(server, writerGroup);
+    if(!wg)
+        return UA_STATUSCODE_BADNOTFOUND;
+    UA_WriterGroupRuntime *rt = UA_WriterGroupRuntime_get(server, wg);
+    if(!rt)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    rt->maxNetworkMessageSize = maxNetworkMessageSize;
+    return UA_STATUSCODE_GOOD;
+}
+
+/**********************************************/
+/*               Message security             */
+/**********************************************/
+
+UA_StatusCode
+UA_Server_setWriterGroupSecurity(UA_Server *server, const UA_NodeId writerGroup,
+                                 const UA_PubSubSecurityConfig *config) {
+#ifdef UA_ENABLE_PUBSUB_ENCRYPTION
+    UA_WriterGroup *wg = UA_WriterGroup_findWGbyId(server, writerGroup);
+    if(!wg)
+        return UA_STATUSCODE_BADNOTFOUND;
+    if(wg->config.encodingMimeType != UA_PUBSUB_ENCODING_UADP)
+        return UA_STATUSCODE_BADNOTSUPPORTED;
+
+    /* The codec functions do not encode promoted fields */
+    UA_DataSetWriter *dsw;
+    LIST_FOREACH(dsw, &wg->writers, listEntry) {
+        UA_PublishedDataSet *pds =
+            UA_PublishedDataSet_findPDSbyId(server, dsw->connectedDataSet);
+        if(config && pds && pds->promotedFieldsCount > 0)
+            return UA_STATUSCODE_BADNOTSUPPORTED;
+    }
+    UA_WriterGroupRuntime *rt = UA_WriterGroupRuntime_get(server, wg);
+    if(!rt)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+
+    /* Compute the key schedules before replacing the old ones */
+    UA_PubSubSecurityContext *security = NULL;
+    if(config) {
+        security = UA_PubSubSecurityContext_new(config);
+        if(!security)
+            return UA_STATUSCODE_BADINVALIDARGUMENT;
+    }
+    UA_PubSubSecurityContext_delete(rt->security);
+    rt->security = security;
+    UA_LOG_INFO(&server->config.logger, UA_LOGCATEGORY_SERVER,
+                "PubSub Publish: Message security of the WriterGroup %s",
+                security ? "enabled" : "disabled");
+    return UA_STATUSCODE_GOOD;
+#else
+    return UA_STATUSCODE_BADNOTSUPPORTED;
+#endif
+}
+
+/**********************************************/
+/*              Publish scheduling            */
+/**********************************************/
+
+UA_StatusCode
+UA_Server_setWriterGroupPhase(UA_Server *server, const UA_NodeId writerGroup,
+                              UA_Duration phase) {
+    UA_WriterGroup *wg = UA_WriterGroup_findWGbyId(server, writerGroup);
+    if(!wg)
+        return UA_STATUSCODE_BADNOTFOUND;
+    if(phase >= wg->config.publishingInterval)
+        return UA_STATUSCODE_BADINVALIDARGUMENT;
+    UA_WriterGroupRuntime *rt = UA_WriterGroupRuntime_get(server, wg);
+    if(!rt)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    UA_Duration oldPhase = rt->phase;
+    rt->phase = (phase >= 0.0) ? phase : -1.0;
+    if(!wg->publishCallbackIsRegistered)
+        return UA_STATUSCODE_GOOD;
+
+    /* Move the entry. The next publish is at the new phase, but at least one
+     * interval after the last publish. */
+    UA_DateTime notBefore = 0;
+    if(rt->lastPublish != 0)
+        notBefore = rt->lastPublish +
+            (UA_DateTime)(wg->config.publishingInterval * (UA_Double)UA_DATETIME_MSEC);
+    UA_UInt64 callbackId;
+    UA_StatusCode retVal =
+        UA_WriterGroup_schedulePublish(server, wg, wg->config.publishingInterval,
+                                       wg->config.priority, notBefore, &callbackId);
+    if(retVal != UA_STATUSCODE_GOOD) {
+        rt->phase = oldPhase;
+        return retVal;
+    }
+    UA_WriterGroup_unregisterPublish(server, wg);
+    wg->publishCallbackId = callbackId;
+    wg->publishCallbackIsRegistered = true;
+    return UA_STATUSCODE_GOOD;
+}
+
+UA_StatusCode
+UA_Server_getWriterGroupScheduleStatistics(UA_Server *server, const UA_NodeId writerGroup,
+                                           UA_PubSubScheduleStatistics *statistics) {
+    if(!statistics)
+        return UA_STATUSCODE_BADINVALIDARGUMENT;
+    UA_WriterGroup *wg = UA_WriterGroup_findWGbyId(server, writerGroup);
+    if(!wg)
+        return UA_STATUSCODE_BADNOTFOUND;
+    return UA_WriterGroup_getScheduleStatistics(server, wg, statistics);
+}
+
 #endif /* UA_ENABLE_PUBSUB */
@@ -0,0 +1,362 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include "ua_pubsub_capture.h"
+
+#ifdef UA_ENABLE_PUBSUB /* conditional compilation */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define UA_PCAP_MAGIC_US 0xA1B2C3D4
+#define UA_PCAP_MAGIC_NS 0xA1B23C4D
+#define UA_PCAP_SNAPLEN 65535
+#define UA_PCAP_FILEHEADER_SIZE 24
+#define UA_PCAP_RECORDHEADER_SIZE 16
+
+#define UA_LINKTYPE_ETHERNET 1
+#define UA_LINKTYPE_RAW 101
+#define UA_LINKTYPE_LINUX_SLL 113
+#define UA_LINKTYPE_IPV4 228
+#define UA_LINKTYPE_IPV6 229
+#define UA_LINKTYPE_LINUX_SLL2 276
+
+#define UA_ETHERTYPE_IPV4 0x0800
+#define UA_ETHERTYPE_IPV6 0x86DD
+#define UA_ETHERTYPE_VLAN 0x8100
+#define UA_ETHERTYPE_QINQ 0x88A8
+#define UA_ETHERTYPE_UADP 0xB62C
+
+#define UA_IPV4_HEADER_SIZE 20
+#define UA_IPV6_HEADER_SIZE 40
+#define UA_UDP_HEADER_SIZE 8
+#define UA_CAPTURE_DEFAULT_PORT 4840
+
+struct UA_PubSubCapture {
+    FILE *file;
+    UA_Boolean writing;
+
+    /* Writing */
+    UA_Byte destination[4];
+    UA_UInt16 port;
+    UA_UInt16 ipId;
+
+    /* Reading */
+    UA_Boolean swapped;       /* file has the other byte order */
+    UA_Boolean nanoseconds;
+    UA_UInt32 linkType;
+    UA_Byte *buffer;
+    size_t bufferSize;
+};
+
+static void
+writeUInt16BE(UA_Byte *pos, UA_UInt16 value) {
+    pos[0] = (UA_Byte)(value >> 8);
+    pos[1] = (UA_Byte)value;
+}
+
+static UA_UInt16
+readUInt16BE(const UA_Byte *pos) {
+    return (UA_UInt16)((pos[0] << 8) | pos[1]);
+}
+
+static UA_UInt32
+fileUInt32(const UA_PubSubCapture *capture, const UA_Byte *pos) {
+    UA_UInt32 value;
+    memcpy(&value, pos, 4);
+    if(capture->swapped)
+        value = ((value & 0xFF) << 24) | ((value & 0xFF00) << 8) |
+            ((value >> 8) & 0xFF00) | (value >> 24);
+    return value;
+}
+
+/**
+ * Writing
+ * ~~~~~~~ */
+
+/* Takes the IPv4 address and port from opc.udp://a.b.c.d:port/. Other
+ * addresses are recorded as 0.0.0.0 and port 4840. */
+static void
+setAddress(UA_PubSubCapture *capture, const UA_NetworkAddressUrlDataType *address) {
+    capture->port = UA_CAPTURE_DEFAULT_PORT;
+    if(!address || address->url.length == 0)
+        return;
+    char url[256];
+    size_t length = address->url.length < sizeof(url) - 1 ?
+        address->url.length : sizeof(url) - 1;
+    memcpy(url, address->url.data, length);
+    url[length] = '\0';
+
+    unsigned a, b, c, d, port;
+    char end;
+    int n = sscanf(url, "opc.udp://%u.%u.%u.%u:%u%c", &a, &b, &c, &d, &port, &end);
+    if(n >= 5 && a < 256 && b < 256 && c < 256 && d < 256 && port < 65536) {
+        capture->destination[0] = (UA_Byte)a;
+        capture->destination[1] = (UA_Byte)b;
+        capture->destination[2] = (UA_Byte)c;
+        capture->destination[3] = (UA_Byte)d;
+        capture->port = (UA_UInt16)port;
+        return;
+    }
+    const char *colon = strrchr(url, ':');
+    if(colon && colon[1] >= '0' && colon[1] <= '9')
+        capture->port = (UA_UInt16)strtoul(colon + 1, NULL, 10);
+}
+
+UA_PubSubCapture *
+UA_PubSubCapture_create(const char *path, const UA_NetworkAddressUrlDataType *address) {
+    UA_PubSubCapture *capture = (UA_PubSubCapture *)UA_calloc(1, sizeof(UA_PubSubCapture));
+    if(!capture)
+        return NULL;
+    capture->file = fopen(path, "wb");
+    if(!capture->file) {
+        UA_free(capture);
+        return NULL;
+    }
+    capture->writing = true;
+    setAddress(capture, address);
+
+    /* The file header in the byte order of the host */
+    struct {
+        UA_UInt32 magic;
+        UA_UInt16 versionMajor, versionMinor;
+        UA_Int32 thisZone;
+        UA_UInt32 sigFigs, snapLen, linkType;
+    } header = {UA_PCAP_MAGIC_NS, 2, 4, 0, 0, UA_PCAP_SNAPLEN, UA_LINKTYPE_IPV4};
+    if(fwrite(&header, UA_PCAP_FILEHEADER_SIZE, 1, capture->file) != 1) {
+        fclose(capture->file);
+        UA_free(capture);
+        return NULL;
+    }
+    return capture;
+}
+
+UA_StatusCode
+UA_PubSubCapture_write(UA_PubSubCapture *capture, UA_UInt64 timestamp,
+                       const UA_ByteString *message) {
+    if(!capture->writing)
+        return UA_STATUSCODE_BADINVALIDSTATE;
+    if(message->length > UA_PCAP_SNAPLEN - UA_IPV4_HEADER_SIZE - UA_UDP_HEADER_SIZE)
+        return UA_STATUSCODE_BADENCODINGLIMITSEXCEEDED;
+    if(timestamp == 0) {
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        timestamp = (UA_UInt64)ts.tv_sec * 1000000000 + (UA_UInt64)ts.tv_nsec;
+    }
+
+    size_t packetSize = UA_IPV4_HEADER_SIZE + UA_UDP_HEADER_SIZE + message->length;
+    UA_UInt32 record[4] = {(UA_UInt32)(timestamp / 1000000000),
+                           (UA_UInt32)(timestamp % 1000000000),
+                           (UA_UInt32)packetSize, (UA_UInt32)packetSize};
+
+    /* IPv4 header from 0.0.0.0 to the connection address */
+    UA_Byte headers[UA_IPV4_HEADER_SIZE + UA_UDP_HEADER_SIZE];
+    memset(headers, 0, sizeof(headers));
+    UA_Byte *ip = headers;
+    ip[0] = 0x45;
+    writeUInt16BE(&ip[2], (UA_UInt16)packetSize);
+    writeUInt16BE(&ip[4], capture->ipId++);
+    ip[6] = 0x40; /* don't fragment */
+    ip[8] = 64;   /* ttl */
+    ip[9] = 17;   /* udp */
+    memcpy(&ip[16], capture->destination, 4);
+    UA_UInt32 sum = 0;
+    for(size_t i = 0; i < UA_IPV4_HEADER_SIZE; i += 2)
+        sum += readUInt16BE(&ip[i]);
+    while(sum >> 16)
+        sum = (sum & 0xFFFF) + (sum >> 16);
+    writeUInt16BE(&ip[10], (UA_UInt16)~sum);
+
+    /* UDP header without checksum */
+    UA_Byte *udp = &headers[UA_IPV4_HEADER_SIZE];
+    writeUInt16BE(&udp[0], capture->port);
+    writeUInt16BE(&udp[2], capture->port);
+    writeUInt16BE(&udp[4], (UA_UInt16)(UA_UDP_HEADER_SIZE + message->length));
+
+    if(fwrite(record, UA_PCAP_RECORDHEADER_SIZE, 1, capture->file) != 1 ||
+       fwrite(headers, sizeof(headers), 1, capture->file) != 1 ||
+       (message->length > 0 &&
+        fwrite(message->data, message->length, 1, capture->file) != 1))
+        return UA_STATUSCODE_BADINTERNALERROR;
+    return UA_STATUSCODE_GOOD;
+}
+
+/**
+ * Reading
+ * ~~~~~~~ */
+
+UA_PubSubCapture *
+UA_PubSubCapture_open(const char *path) {
+    UA_PubSubCapture *capture = (UA_PubSubCapture *)UA_calloc(1, sizeof(UA_PubSubCapture));
+    if(!capture)
+        return NULL;
+    capture->file = fopen(path, "rb");
+    if(!capture->file) {
+        UA_free(capture);
+        return NULL;
+    }
+
+    UA_Byte header[UA_PCAP_FILEHEADER_SIZE];
+    if(fread(header, sizeof(header), 1, capture->file) != 1)
+        goto error;
+    UA_UInt32 magic = fileUInt32(capture, header);
+    if(magic != UA_PCAP_MAGIC_US && magic != UA_PCAP_MAGIC_NS) {
+        capture->swapped = true;
+        magic = fileUInt32(capture, header);
+        if(magic != UA_PCAP_MAGIC_US && magic != UA_PCAP_MAGIC_NS)
+            goto error;
+    }
+    capture->nanoseconds = (magic == UA_PCAP_MAGIC_NS);
+    capture->linkType = fileUInt32(capture, &header[20]) & 0xFFFF;
+    capture->bufferSize = fileUInt32(capture, &header[16]);
+    if(capture->bufferSize == 0 || capture->bufferSize > 262144)
+        capture->bufferSize = 262144;
+    capture->buffer = (UA_Byte *)UA_malloc(capture->bufferSize);
+    if(!capture->buffer)
+        goto error;
+    return capture;
+
+ error:
+    fclose(capture->file);
+    UA_free(capture);
+    return NULL;
+}
+
+/* Returns the UDP payload of an IP packet */
+static UA_Boolean
+ipPayload(const UA_Byte *packet, size_t length, UA_ByteString *message) {
+    if(length < 1)
+        return false;
+    size_t headerSize;
+    size_t totalLength;
+    if((packet[0] >> 4) == 4) {
+        headerSize = (size_t)(packet[0] & 0x0F) * 4;
+        if(length < UA_IPV4_HEADER_SIZE || headerSize < UA_IPV4_HEADER_SIZE ||
+           packet[9] != 17)
+            return false;
+        /* Skip fragments */
+        if((readUInt16BE(&packet[6]) & 0x3FFF) != 0)
+            return false;
+        totalLength = readUInt16BE(&packet[2]);
+    } else if((packet[0] >> 4) == 6) {
+        /* Extension headers are not followed */
+        headerSize = UA_IPV6_HEADER_SIZE;
+        if(length < UA_IPV6_HEADER_SIZE || packet[6] != 17)
+            return false;
+        totalLength = UA_IPV6_HEADER_SIZE + (size_t)readUInt16BE(&packet[4]);
+    } else {
+        return false;
+    }
+    if(totalLength > length)
+        return false; /* truncated by the snaplen */
+    if(totalLength < headerSize + UA_UDP_HEADER_SIZE)
+        return false;
+    const UA_Byte *udp = &packet[headerSize];
+    size_t udpLength = readUInt16BE(&udp[4]);
+    if(udpLength < UA_UDP_HEADER_SIZE || headerSize + udpLength > totalLength)
+        return false;
+    message->data = (UA_Byte *)(uintptr_t)&udp[UA_UDP_HEADER_SIZE];
+    message->length = udpLength - UA_UDP_HEADER_SIZE;
+    return true;
+}
+
+static UA_Boolean
+etherTypePayload(UA_UInt16 etherType, const UA_Byte *payload, size_t length,
+                 UA_ByteString *message) {
+    if(etherType == UA_ETHERTYPE_UADP) {
+        message->data = (UA_Byte *)(uintptr_t)payload;
+        message->length = length;
+        return true;
+    }
+    if(etherType == UA_ETHERTYPE_IPV4 || etherType == UA_ETHERTYPE_IPV6)
+        return ipPayload(payload, length, message);
+    return false;
+}
+
+static UA_Boolean
+packetPayload(const UA_PubSubCapture *capture, const UA_Byte *packet, size_t length,
+              UA_ByteString *message) {
+    switch(capture->linkType) {
+    case UA_LINKTYPE_ETHERNET: {
+        size_t pos = 12;
+        if(length < 14)
+            return false;
+        UA_UInt16 etherType = readUInt16BE(&packet[pos]);
+        while(etherType == UA_ETHERTYPE_VLAN || etherType == UA_ETHERTYPE_QINQ) {
+            pos += 4;
+            if(length < pos + 2)
+                return false;
+            etherType = readUInt16BE(&packet[pos]);
+        }
+        pos += 2;
+        return etherTypePayload(etherType, &packet[pos], length - pos, message);
+    }
+    case UA_LINKTYPE_LINUX_SLL:
+        if(length < 16)
+            return false;
+        return etherTypePayload(readUInt16BE(&packet[14]), &packet[16], length - 16, message);
+    case UA_LINKTYPE_LINUX_SLL2:
+        if(length < 20)
+            return false;
+        return etherTypePayload(readUInt16BE(&packet[0]), &packet[20], length - 20, message);
+    case UA_LINKTYPE_RAW:
+    case UA_LINKTYPE_IPV4:
+    case UA_LINKTYPE_IPV6:
+        return ipPayload(packet, length, message);
+    default:
+        return false;
+    }
+}
+
+UA_StatusCode
+UA_PubSubCapture_read(UA_PubSubCapture *capture, UA_UInt64 *timestamp,
+                      UA_ByteString *message) {
+    if(capture->writing)
+        return UA_STATUSCODE_BADINVALIDSTATE;
+
+    /* Skip the packets without a message */
+    while(true) {
+        UA_Byte record[UA_PCAP_RECORDHEADER_SIZE];
+        if(fread(record, sizeof(record), 1, capture->file) != 1)
+            return UA_STATUSCODE_BADENDOFSTREAM;
+        UA_UInt64 seconds = fileUInt32(capture, record);
+        UA_UInt64 fraction = fileUInt32(capture, &record[4]);
+        size_t length = fileUInt32(capture, &record[8]);
+        if(length > capture->bufferSize) {
+            /* Larger than announced in the file header */
+            if(fseek(capture->file, (long)length, SEEK_CUR) != 0)
+                return UA_STATUSCODE_BADENDOFSTREAM;
+            continue;
+        }
+        if(length > 0 && fread(capture->buffer, length, 1, capture->file) != 1)
+            return UA_STATUSCODE_BADENDOFSTREAM;
+        if(!packetPayload(capture, capture->buffer, length, message))
+            continue;
+        *timestamp = seconds * 1000000000 +
+            (capture->nanoseconds ? fraction : fraction * 1000);
+        return UA_STATUSCODE_GOOD;
+    }
+}
+
+UA_StatusCode
+UA_PubSubCapture_rewind(UA_PubSubCapture *capture) {
+    if(capture->writing)
+        return UA_STATUSCODE_BADINVALIDSTATE;
+    if(fseek(capture->file, UA_PCAP_FILEHEADER_SIZE, SEEK_SET) != 0)
+        return UA_STATUSCODE_BADINTERNALERROR;
+    return UA_STATUSCODE_GOOD;
+}
+
+void
+UA_PubSubCapture_close(UA_PubSubCapture *capture) {
+    if(!capture)
+        return;
+    fclose(capture->file);
+    UA_free(capture->buffer);
+    UA_free(capture);
+}
+
+#endif /* UA_ENABLE_PUBSUB */
@@ -0,0 +1,66 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef UA_PUBSUB_CAPTURE_H_
+#define UA_PUBSUB_CAPTURE_H_
+
+#include <open62541/types.h>
+#include <open62541/types_generated.h>
+
+_UA_BEGIN_DECLS
+
+#ifdef UA_ENABLE_PUBSUB /* conditional compilation */
+
+/**
+ * Capture Files
+ * -------------
+ * Records received NetworkMessages with their receive time, so that the same
+ * traffic can be replayed to a subscriber later. The files are pcap files
+ * with nanosecond timestamps. Each message is stored in an IPv4/UDP packet
+ * addressed to the host and port of the connection URL, so tcpdump and
+ * Wireshark can read them.
+ *
+ * Reading also accepts pcap files written by tcpdump (microsecond or
+ * nanosecond timestamps, Ethernet, Linux cooked or raw IP). The UDP payloads
+ * and the payloads of OPC UA Ethernet frames (EtherType 0xB62C) are returned.
+ * Other packets and IP fragments are skipped. */
+
+struct UA_PubSubCapture;
+typedef struct UA_PubSubCapture UA_PubSubCapture;
+
+/* Creates or truncates the file. The address is optional. */
+UA_PubSubCapture UA_EXPORT *
+UA_PubSubCapture_create(const char *path, const UA_NetworkAddressUrlDataType *address);
+
+/* Appends a message. The timestamp is in nanoseconds since 1970; 0 takes the
+ * current time. */
+UA_StatusCode UA_EXPORT
+UA_PubSubCapture_write(UA_PubSubCapture *capture, UA_UInt64 timestamp,
+                       const UA_ByteString *message);
+
+/* Opens a capture file for reading */
+UA_PubSubCapture UA_EXPORT *
+UA_PubSubCapture_open(const char *path);
+
+/* Reads the next message. The message points into a buffer of the capture
+ * that is valid until the next call. Returns UA_STATUSCODE_BADENDOFSTREAM
+ * after the last message. */
+UA_StatusCode UA_EXPORT
+UA_PubSubCapture_read(UA_PubSubCapture *capture, UA_UInt64 *timestamp,
+                      UA_ByteString *message);
+
+/* Continue reading with the first message */
+UA_StatusCode UA_EXPORT
+UA_PubSubCapture_rewind(UA_PubSubCapture *capture);
+
+/* Flushes and closes the file */
+void UA_EXPORT
+UA_PubSubCapture_close(UA_PubSubCapture *capture);
+
+#endif /* UA_ENABLE_PUBSUB */
+
+_UA_END_DECLS
+
+#endif /* UA_PUBSUB_CAPTURE_H_ */
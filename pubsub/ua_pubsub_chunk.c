@@ -0,0 +1,269 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include "ua_pubsub_chunk.h"
+#include "ua_pubsub_codec.h"
+
+#ifdef UA_ENABLE_PUBSUB /* conditional compilation */
+
+#define UA_CHUNK_DEFAULT_MAXMESSAGES 4
+#define UA_CHUNK_DEFAULT_MAXMESSAGESIZE UA_UINT16_MAX
+#define UA_CHUNK_DEFAULT_TIMEOUT 100.0
+
+typedef struct {
+    UA_Boolean used;
+    UA_DateTime started;
+    UA_UInt16 messageSequenceNumber;
+    UA_NetworkMessage headers; /* of the first chunk */
+    UA_ByteString data;        /* TotalSize bytes */
+    UA_Byte *received;         /* one bit per byte of data */
+    size_t receivedSize;       /* number of received bytes */
+} UA_ChunkEntry;
+
+struct UA_ChunkReassembler {
+    UA_ChunkReassemblerConfig config; /* with the defaults applied */
+    UA_ChunkEntry *entries;
+    UA_ChunkReassemblerStatistics statistics;
+};
+
+UA_ChunkReassembler *
+UA_ChunkReassembler_new(const UA_ChunkReassemblerConfig *config) {
+    UA_ChunkReassembler *r = (UA_ChunkReassembler *)UA_calloc(1, sizeof(UA_ChunkReassembler));
+    if(!r)
+        return NULL;
+    if(config)
+        r->config = *config;
+    if(r->config.maxMessages == 0)
+        r->config.maxMessages = UA_CHUNK_DEFAULT_MAXMESSAGES;
+    if(r->config.maxMessageSize == 0)
+        r->config.maxMessageSize = UA_CHUNK_DEFAULT_MAXMESSAGESIZE;
+    if(r->config.timeout <= 0.0)
+        r->config.timeout = UA_CHUNK_DEFAULT_TIMEOUT;
+    r->entries = (UA_ChunkEntry *)UA_calloc(r->config.maxMessages, sizeof(UA_ChunkEntry));
+    if(!r->entries) {
+        UA_free(r);
+        return NULL;
+    }
+    return r;
+}
+
+static void
+UA_ChunkEntry_clear(UA_ChunkEntry *e) {
+    UA_NetworkMessage_clear(&e->headers);
+    UA_ByteString_clear(&e->data);
+    UA_free(e->received);
+    memset(e, 0, sizeof(UA_ChunkEntry));
+}
+
+void
+UA_ChunkReassembler_delete(UA_ChunkReassembler *r) {
+    if(!r)
+        return;
+    for(size_t i = 0; i < r->config.maxMessages; i++) {
+        if(r->entries[i].used)
+            UA_ChunkEntry_clear(&r->entries[i]);
+    }
+    UA_free(r->entries);
+    UA_free(r);
+}
+
+void
+UA_ChunkReassembler_expire(UA_ChunkReassembler *r, UA_DateTime now) {
+    UA_DateTime timeout = (UA_DateTime)(r->config.timeout * UA_DATETIME_MSEC);
+    for(size_t i = 0; i < r->config.maxMessages; i++) {
+        UA_ChunkEntry *e = &r->entries[i];
+        if(e->used && now - e->started > timeout) {
+            UA_ChunkEntry_clear(e);
+            r->statistics.timedOut++;
+        }
+    }
+}
+
+void
+UA_ChunkReassembler_getStatistics(const UA_ChunkReassembler *r,
+                                  UA_ChunkReassemblerStatistics *statistics) {
+    *statistics = r->statistics;
+}
+
+static UA_Boolean
+publisherIdEqual(const UA_NetworkMessage *a, const UA_NetworkMessage *b) {
+    if(a->publisherIdEnabled != b->publisherIdEnabled)
+        return false;
+    if(!a->publisherIdEnabled)
+        return true;
+    if(a->publisherIdType != b->publisherIdType)
+        return false;
+    switch(a->publisherIdType) {
+    case UA_PUBLISHERDATATYPE_BYTE:
+        return a->publisherId.publisherIdByte == b->publisherId.publisherIdByte;
+    case UA_PUBLISHERDATATYPE_UINT16:
+        return a->publisherId.publisherIdUInt16 == b->publisherId.publisherIdUInt16;
+    case UA_PUBLISHERDATATYPE_UINT32:
+        return a->publisherId.publisherIdUInt32 == b->publisherId.publisherIdUInt32;
+    case UA_PUBLISHERDATATYPE_UINT64:
+        return a->publisherId.publisherIdUInt64 == b->publisherId.publisherIdUInt64;
+    default:
+        return UA_String_equal(&a->publisherId.publisherIdString,
+                               &b->publisherId.publisherIdString);
+    }
+}
+
+static UA_Boolean
+UA_ChunkEntry_matches(const UA_ChunkEntry *e, const UA_NetworkMessage *nm,
+                      const UA_NetworkMessageChunk *chunk) {
+    if(!e->used || e->messageSequenceNumber != chunk->messageSequenceNumber)
+        return false;
+    const UA_NetworkMessage *h = &e->headers;
+    if(h->payloadHeader.dataSetPayloadHeader.dataSetWriterIds[0] !=
+       nm->payloadHeader.dataSetPayloadHeader.dataSetWriterIds[0])
+        return false;
+    UA_Boolean hasGroup = h->groupHeaderEnabled && h->groupHeader.writerGroupIdEnabled;
+    if(hasGroup != (nm->groupHeaderEnabled && nm->groupHeader.writerGroupIdEnabled))
+        return false;
+    if(hasGroup && h->groupHeader.writerGroupId != nm->groupHeader.writerGroupId)
+        return false;
+    return publisherIdEqual(h, nm);
+}
+
+/* Marks the bytes [start, end) as received. Returns the number of bytes that
+ * were not received before. The work is linear in the chunk size, whatever
+ * the order and size of the chunks. */
+static size_t
+UA_ChunkEntry_markReceived(UA_ChunkEntry *e, size_t start, size_t end) {
+    size_t added = 0;
+    size_t i = start;
+    while(i < end) {
+        UA_Byte *bits = &e->received[i >> 3];
+        if((i & 7) == 0 && end - i >= 8 && (*bits == 0 || *bits == 0xff)) {
+            /* Whole byte of the bitmap */
+            if(*bits == 0)
+                added += 8;
+            *bits = 0xff;
+            i += 8;
+            continue;
+        }
+        UA_Byte mask = (UA_Byte)(1u << (i & 7));
+        if(!(*bits & mask)) {
+            *bits |= mask;
+            added++;
+        }
+        i++;
+    }
+    e->receivedSize += added;
+    return added;
+}
+
+/* Takes a free slot or evicts the oldest message */
+static UA_ChunkEntry *
+UA_ChunkReassembler_newEntry(UA_ChunkReassembler *r) {
+    UA_ChunkEntry *oldest = NULL;
+    for(size_t i = 0; i < r->config.maxMessages; i++) {
+        UA_ChunkEntry *e = &r->entries[i];
+        if(!e->used)
+            return e;
+        if(!oldest || e->started < oldest->started)
+            oldest = e;
+    }
+    UA_ChunkEntry_clear(oldest);
+    r->statistics.evicted++;
+    return oldest;
+}
+
+/* Decode the DataSetMessage into the headers of the entry */
+static UA_StatusCode
+UA_ChunkEntry_complete(UA_ChunkEntry *e, UA_NetworkMessage *dst) {
+    *dst = e->headers;
+    memset(&e->headers, 0, sizeof(UA_NetworkMessage));
+    dst->chunkMessage = false;
+    UA_DataSetMessage *dsm = (UA_DataSetMessage *)UA_calloc(1, sizeof(UA_DataSetMessage));
+    if(!dsm)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    dst->payload.dataSetPayload.dataSetMessages = dsm;
+    size_t offset = 0;
+    return UA_DataSetMessage_decodeBinary(&e->data, &offset, dsm, (UA_UInt16)e->data.length);
+}
+
+UA_StatusCode
+UA_ChunkReassembler_add(UA_ChunkReassembler *r, const UA_ByteString *src,
+                        UA_DateTime now, UA_NetworkMessage *dst, UA_Boolean *complete) {
+    *complete = false;
+    UA_ChunkReassembler_expire(r, now);
+
+    UA_NetworkMessage nm;
+    UA_NetworkMessageChunk chunk;
+    size_t offset = 0;
+    UA_StatusCode rv = UA_NetworkMessage_decodeChunk(src, &offset, &nm, &chunk);
+    if(rv != UA_STATUSCODE_GOOD) {
+        UA_NetworkMessage_clear(&nm);
+        return rv;
+    }
+    r->statistics.chunks++;
+
+    UA_ChunkEntry *e = NULL;
+    for(size_t i = 0; i < r->config.maxMessages; i++) {
+        if(UA_ChunkEntry_matches(&r->entries[i], &nm, &chunk)) {
+            e = &r->entries[i];
+            break;
+        }
+    }
+
+    if(e && e->data.length != chunk.totalSize) {
+        /* The sequence number was reused for a different message */
+        UA_ChunkEntry_clear(e);
+        r->statistics.rejected++;
+        e = NULL;
+    }
+
+    if(!e) {
+        /* The DataSetMessage is decoded with its size from the 16-bit field
+         * of the payload header */
+        if(chunk.totalSize == 0 || chunk.totalSize > r->config.maxMessageSize ||
+           chunk.totalSize > UA_UINT16_MAX) {
+            UA_NetworkMessage_clear(&nm);
+            r->statistics.rejected++;
+            return UA_STATUSCODE_BADENCODINGLIMITSEXCEEDED;
+        }
+        e = UA_ChunkReassembler_newEntry(r);
+        rv = UA_ByteString_allocBuffer(&e->data, chunk.totalSize);
+        e->received = (UA_Byte *)UA_calloc((chunk.totalSize + 7) / 8, 1);
+        if(rv == UA_STATUSCODE_GOOD && !e->received)
+            rv = UA_STATUSCODE_BADOUTOFMEMORY;
+        if(rv != UA_STATUSCODE_GOOD) {
+            UA_ByteString_clear(&e->data);
+            UA_free(e->received);
+            e->received = NULL;
+            UA_NetworkMessage_clear(&nm);
+            return rv;
+        }
+        e->used = true;
+        e->started = now;
+        e->messageSequenceNumber = chunk.messageSequenceNumber;
+        e->headers = nm;
+        memset(&nm, 0, sizeof(UA_NetworkMessage));
+    }
+    UA_NetworkMessage_clear(&nm);
+
+    size_t start = chunk.chunkOffset;
+    size_t end = start + chunk.chunkData.length;
+    if(UA_ChunkEntry_markReceived(e, start, end) == 0) {
+        r->statistics.duplicates++;
+        return UA_STATUSCODE_GOOD;
+    }
+    memcpy(&e->data.data[start], chunk.chunkData.data, chunk.chunkData.length);
+    if(e->receivedSize < e->data.length)
+        return UA_STATUSCODE_GOOD;
+
+    rv = UA_ChunkEntry_complete(e, dst);
+    UA_ChunkEntry_clear(e);
+    if(rv != UA_STATUSCODE_GOOD) {
+        UA_NetworkMessage_clear(dst);
+        return rv;
+    }
+    r->statistics.completed++;
+    *complete = true;
+    return UA_STATUSCODE_GOOD;
+}
+
+#endif /* UA_ENABLE_PUBSUB */
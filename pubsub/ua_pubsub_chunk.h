@@ -0,0 +1,84 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef UA_PUBSUB_CHUNK_H_
+#define UA_PUBSUB_CHUNK_H_
+
+#include <open62541/types.h>
+
+#include "ua_pubsub_networkmessage.h"
+
+_UA_BEGIN_DECLS
+
+#ifdef UA_ENABLE_PUBSUB /* conditional compilation */
+
+/**
+ * Chunk Reassembler
+ * -----------------
+ * Puts chunked DataSetMessages back together on the subscriber side. A
+ * DataSetMessage is identified by the PublisherId, the WriterGroupId, the
+ * DataSetWriterId and the MessageSequenceNumber of its chunks. The chunks may
+ * arrive in any order. Repeated chunks are ignored. When all bytes up to the
+ * TotalSize are there, the DataSetMessage is decoded and returned in a
+ * NetworkMessage with the headers of its chunks.
+ *
+ * The memory is bounded: at most ``maxMessages`` DataSetMessages of up to
+ * ``maxMessageSize`` bytes are reassembled at the same time. If all slots are
+ * taken, the oldest incomplete message is evicted for a new one. A message
+ * that is not complete ``timeout`` ms after its first chunk is dropped. A lost
+ * chunk therefore costs its DataSetMessage, but does not hold the memory
+ * longer than the timeout. The received bytes are tracked in a bitmap, so the
+ * work per chunk is linear in its size also for many tiny chunks in any order.
+ *
+ * DataSetMessages of more than 65535 bytes are rejected. The decoding needs
+ * their size, which does not fit the 16-bit size of the payload header.
+ *
+ * The reassembler is not thread-safe. Use one per receiving thread. */
+
+typedef struct {
+    size_t maxMessages;     /* 0 selects 4 */
+    size_t maxMessageSize;  /* 0 selects 65535 bytes */
+    UA_Duration timeout;    /* 0 selects 100 ms */
+} UA_ChunkReassemblerConfig;
+
+typedef struct {
+    UA_UInt64 chunks;
+    UA_UInt64 duplicates;
+    UA_UInt64 completed;
+    UA_UInt64 timedOut;
+    UA_UInt64 evicted;
+    UA_UInt64 rejected;     /* over the size limit or inconsistent */
+} UA_ChunkReassemblerStatistics;
+
+struct UA_ChunkReassembler;
+typedef struct UA_ChunkReassembler UA_ChunkReassembler;
+
+UA_ChunkReassembler UA_EXPORT *
+UA_ChunkReassembler_new(const UA_ChunkReassemblerConfig *config);
+
+void UA_EXPORT
+UA_ChunkReassembler_delete(UA_ChunkReassembler *reassembler);
+
+/* Adds an encoded chunk message (see UA_NetworkMessage_isChunk). now is a
+ * monotonic time. If the chunk completes its DataSetMessage, complete is set
+ * and dst holds the reassembled NetworkMessage, to be cleared with
+ * UA_NetworkMessage_clear. */
+UA_StatusCode UA_EXPORT
+UA_ChunkReassembler_add(UA_ChunkReassembler *reassembler, const UA_ByteString *src,
+                        UA_DateTime now, UA_NetworkMessage *dst, UA_Boolean *complete);
+
+/* Drops the messages that have timed out. Also done in _add. */
+void UA_EXPORT
+UA_ChunkReassembler_expire(UA_ChunkReassembler *reassembler, UA_DateTime now);
+
+void UA_EXPORT
+UA_ChunkReassembler_getStatistics(const UA_ChunkReassembler *reassembler,
+                                  UA_ChunkReassemblerStatistics *statistics);
+
+#endif /* UA_ENABLE_PUBSUB */
+
+_UA_END_DECLS
+
+#endif /* UA_PUBSUB_CHUNK_H_ */
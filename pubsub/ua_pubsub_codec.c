@@ -0,0 +1,762 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include "ua_pubsub_codec.h"
+
+#ifdef UA_ENABLE_PUBSUB /* conditional compilation */
+
+/* UADP header flags (Part 14, 7.2.2.2.2) */
+#define UA_UADP_VERSION_MASK 0x0F
+#define UA_UADP_FLAGS_PUBLISHERID 0x10
+#define UA_UADP_FLAGS_GROUPHEADER 0x20
+#define UA_UADP_FLAGS_PAYLOADHEADER 0x40
+#define UA_UADP_FLAGS_EXTFLAGS1 0x80
+#define UA_UADP_EXTFLAGS1_PUBLISHERIDTYPE 0x07
+#define UA_UADP_EXTFLAGS1_DATASETCLASSID 0x08
+#define UA_UADP_EXTFLAGS1_SECURITY 0x10
+#define UA_UADP_EXTFLAGS1_TIMESTAMP 0x20
+#define UA_UADP_EXTFLAGS1_PICOSECONDS 0x40
+#define UA_UADP_EXTFLAGS1_EXTFLAGS2 0x80
+#define UA_UADP_EXTFLAGS2_CHUNK 0x01
+#define UA_UADP_GROUP_WRITERGROUPID 0x01
+#define UA_UADP_GROUP_GROUPVERSION 0x02
+#define UA_UADP_GROUP_NETWORKMESSAGENUMBER 0x04
+#define UA_UADP_GROUP_SEQUENCENUMBER 0x08
+#define UA_UADP_SECURITY_SIGNED 0x01
+#define UA_UADP_SECURITY_ENCRYPTED 0x02
+#define UA_UADP_SECURITY_FOOTER 0x04
+#define UA_UADP_SECURITY_FORCEKEYRESET 0x08
+
+/**
+ * Field Helpers
+ * ~~~~~~~~~~~~~ */
+
+UA_StatusCode
+UA_DataSetCodec_readString(const UA_ByteString *src, size_t *pos, UA_String *v) {
+    if(src->length < *pos + 4)
+        return UA_STATUSCODE_BADDECODINGERROR;
+    UA_Int32 length = (UA_Int32)UA_DataSetCodec_read32(&src->data[*pos]);
+    *pos += 4;
+    if(length < 0) {
+        UA_String_init(v);
+        return UA_STATUSCODE_GOOD;
+    }
+    if(src->length - *pos < (size_t)length)
+        return UA_STATUSCODE_BADDECODINGERROR;
+    if(length == 0) {
+        v->length = 0;
+        v->data = (UA_Byte *)UA_EMPTY_ARRAY_SENTINEL;
+        return UA_STATUSCODE_GOOD;
+    }
+    v->data = (UA_Byte *)UA_malloc((size_t)length);
+    if(!v->data)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    memcpy(v->data, &src->data[*pos], (size_t)length);
+    v->length = (size_t)length;
+    *pos += (size_t)length;
+    return UA_STATUSCODE_GOOD;
+}
+
+void *
+UA_DataSetCodec_newScalar(UA_DataValue *field, const UA_DataType *type) {
+    void *data = UA_new(type);
+    if(!data)
+        return NULL;
+    UA_Variant_setScalar(&field->value, data, type);
+    field->hasValue = true;
+    return data;
+}
+
+UA_StatusCode
+UA_DataSetCodec_newArray(const UA_ByteString *src, size_t *pos, UA_DataValue *field,
+                         const UA_DataType *type, size_t minSize) {
+    if(src->length < *pos + 4)
+        return UA_STATUSCODE_BADDECODINGERROR;
+    UA_Int32 length = (UA_Int32)UA_DataSetCodec_read32(&src->data[*pos]);
+    *pos += 4;
+    field->hasValue = true;
+    field->value.type = type;
+    if(length < 0)
+        return UA_STATUSCODE_GOOD;
+    if(length == 0) {
+        field->value.data = UA_EMPTY_ARRAY_SENTINEL;
+        return UA_STATUSCODE_GOOD;
+    }
+    /* Check the length before allocating */
+    if((src->length - *pos) / minSize < (size_t)length)
+        return UA_STATUSCODE_BADDECODINGERROR;
+    field->value.data = UA_Array_new((size_t)length, type);
+    if(!field->value.data)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    field->value.arrayLength = (size_t)length;
+    return UA_STATUSCODE_GOOD;
+}
+
+/**
+ * DataSetMessages
+ * ~~~~~~~~~~~~~~~ */
+
+static UA_Boolean
+codecApplies(const UA_DataSetCodec *codec, const UA_DataSetMessage *dsm) {
+    return codec && dsm->header.dataSetMessageType == UA_DATASETMESSAGE_DATAKEYFRAME &&
+        dsm->header.fieldEncoding == UA_FIELDENCODING_VARIANT &&
+        dsm->data.keyFrameData.fieldCount == codec->fieldsSize;
+}
+
+/* Returns 0 if the codec does not apply */
+static size_t
+calcSizeDataSetMessage(const UA_DataSetCodec *codec, const UA_DataSetMessage *dsm) {
+    if(!codecApplies(codec, dsm))
+        return 0;
+    size_t fieldsSize = codec->calcSizeFields(dsm->data.keyFrameData.dataSetFields);
+    if(fieldsSize == 0)
+        return 0;
+    return UA_DataSetMessageHeader_calcSizeBinary(&dsm->header) + 2 + fieldsSize;
+}
+
+static UA_StatusCode
+encodeDataSetMessage(const UA_DataSetCodec *codec, const UA_DataSetMessage *dsm,
+                     UA_Byte **bufPos, const UA_Byte *bufEnd) {
+    if(!codecApplies(codec, dsm) ||
+       codec->calcSizeFields(dsm->data.keyFrameData.dataSetFields) == 0)
+        return UA_DataSetMessage_encodeBinary(dsm, bufPos, bufEnd);
+    UA_StatusCode rv = UA_DataSetMessageHeader_encodeBinary(&dsm->header, bufPos, bufEnd);
+    if(rv != UA_STATUSCODE_GOOD)
+        return rv;
+    if(bufEnd - *bufPos < 2)
+        return UA_STATUSCODE_BADENCODINGLIMITSEXCEEDED;
+    *bufPos = UA_DataSetCodec_write16(*bufPos, dsm->data.keyFrameData.fieldCount);
+    return codec->encodeFields(dsm->data.keyFrameData.dataSetFields, bufPos, bufEnd);
+}
+
+/* Try the codecs with the number of fields of the key frame. Then decode
+ * generically. size is 0 if the NetworkMessage does not contain the sizes. */
+static UA_StatusCode
+decodeDataSetMessage(const UA_ByteString *src, size_t *offset, UA_DataSetMessage *dsm,
+                     UA_UInt16 size, const UA_DataSetCodec *const *codecs,
+                     size_t codecsSize) {
+    size_t start = *offset;
+    size_t pos = start;
+    UA_StatusCode rv = UA_DataSetMessageHeader_decodeBinary(src, &pos, &dsm->header);
+    if(rv == UA_STATUSCODE_GOOD &&
+       dsm->header.dataSetMessageType == UA_DATASETMESSAGE_DATAKEYFRAME &&
+       dsm->header.fieldEncoding == UA_FIELDENCODING_VARIANT && src->length >= pos + 2) {
+        UA_UInt16 fieldCount = UA_DataSetCodec_read16(&src->data[pos]);
+        pos += 2;
+        size_t fieldsStart = pos;
+        for(size_t i = 0; i < codecsSize; i++) {
+            if(!codecs[i] || codecs[i]->fieldsSize != fieldCount || fieldCount == 0)
+                continue;
+            UA_DataValue *fields = (UA_DataValue *)
+                UA_Array_new(fieldCount, &UA_TYPES[UA_TYPES_DATAVALUE]);
+            if(!fields)
+                return UA_STATUSCODE_BADOUTOFMEMORY;
+            pos = fieldsStart;
+            rv = codecs[i]->decodeFields(src, &pos, fields);
+            if(rv == UA_STATUSCODE_GOOD && (size == 0 || pos - start == size)) {
+                dsm->data.keyFrameData.fieldCount = fieldCount;
+                dsm->data.keyFrameData.dataSetFields = fields;
+                *offset = pos;
+                return UA_STATUSCODE_GOOD;
+            }
+            UA_Array_delete(fields, fieldCount, &UA_TYPES[UA_TYPES_DATAVALUE]);
+        }
+    }
+    memset(dsm, 0, sizeof(UA_DataSetMessage));
+    *offset = start;
+    return UA_DataSetMessage_decodeBinary(src, offset, dsm, size);
+}
+
+/**
+ * NetworkMessage Headers
+ * ~~~~~~~~~~~~~~~~~~~~~~
+ * Written in the same way as by UA_NetworkMessage_encodeBinary. Chunk messages
+ * have the chunk flag in ExtendedFlags2 and only the DataSetWriterId of the
+ * chunked DataSetMessage in the payload header. The security header is the
+ * last header before the payload. Security footers are not supported. */
+
+static UA_Boolean
+headersSupported(const UA_NetworkMessage *nm) {
+    if(nm->chunkMessage && (!nm->payloadHeaderEnabled ||
+                            nm->payloadHeader.dataSetPayloadHeader.count != 1))
+        return false;
+    const UA_NetworkMessageSecurityHeader *sh = &nm->securityHeader;
+    if(nm->securityEnabled && (nm->chunkMessage || sh->securityFooterEnabled ||
+                               sh->nonceLength != sh->messageNonce.length))
+        return false;
+    return nm->networkMessageType == UA_NETWORKMESSAGE_DATASET &&
+        !nm->promotedFieldsEnabled &&
+        (nm->version & UA_UADP_VERSION_MASK) == nm->version &&
+        (!nm->payloadHeaderEnabled || nm->payloadHeader.dataSetPayloadHeader.count > 0);
+}
+
+static UA_Boolean
+extFlags1Enabled(const UA_NetworkMessage *nm) {
+    return nm->publisherIdType != UA_PUBLISHERDATATYPE_BYTE || nm->dataSetClassIdEnabled ||
+        nm->timestampEnabled || nm->picosecondsEnabled || nm->chunkMessage ||
+        nm->securityEnabled;
+}
+
+static UA_Byte
+dataSetMessagesSize(const UA_NetworkMessage *nm) {
+    return nm->payloadHeaderEnabled ? nm->payloadHeader.dataSetPayloadHeader.count : 1;
+}
+
+static size_t
+publisherIdSize(const UA_NetworkMessage *nm) {
+    switch(nm->publisherIdType) {
+    case UA_PUBLISHERDATATYPE_BYTE: return 1;
+    case UA_PUBLISHERDATATYPE_UINT16: return 2;
+    case UA_PUBLISHERDATATYPE_UINT32: return 4;
+    case UA_PUBLISHERDATATYPE_UINT64: return 8;
+    case UA_PUBLISHERDATATYPE_STRING: return 4 + nm->publisherId.publisherIdString.length;
+    default: return 0;
+    }
+}
+
+static size_t
+calcSizeHeaders(const UA_NetworkMessage *nm) {
+    size_t size = 1;
+    if(extFlags1Enabled(nm))
+        size++;
+    if(nm->chunkMessage)
+        size++;
+    if(nm->publisherIdEnabled)
+        size += publisherIdSize(nm);
+    if(nm->dataSetClassIdEnabled)
+        size += 16;
+    if(nm->groupHeaderEnabled) {
+        size++;
+        if(nm->groupHeader.writerGroupIdEnabled)
+            size += 2;
+        if(nm->groupHeader.groupVersionEnabled)
+            size += 4;
+        if(nm->groupHeader.networkMessageNumberEnabled)
+            size += 2;
+        if(nm->groupHeader.sequenceNumberEnabled)
+            size += 2;
+    }
+    if(nm->chunkMessage)
+        size += 2;
+    else if(nm->payloadHeaderEnabled)
+        size += 1 + 2 * (size_t)nm->payloadHeader.dataSetPayloadHeader.count;
+    if(nm->timestampEnabled)
+        size += 8;
+    if(nm->picosecondsEnabled)
+        size += 2;
+    if(nm->securityEnabled)
+        size += 6 + (size_t)nm->securityHeader.nonceLength;
+    return size;
+}
+
+/* The sizes of the DataSetMessages are the start of the payload */
+static size_t
+calcSizePayloadSizes(const UA_NetworkMessage *nm) {
+    if(!nm->chunkMessage && nm->payloadHeaderEnabled &&
+       nm->payloadHeader.dataSetPayloadHeader.count > 1)
+        return 2 * (size_t)nm->payloadHeader.dataSetPayloadHeader.count;
+    return 0;
+}
+
+/* Up to the payload. The buffer is checked by the caller. */
+static UA_Byte *
+encodeHeaders(const UA_NetworkMessage *nm, UA_Byte *pos) {
+    UA_Boolean extFlags1 = extFlags1Enabled(nm);
+    UA_Byte flags = nm->version;
+    if(nm->publisherIdEnabled)
+        flags |= UA_UADP_FLAGS_PUBLISHERID;
+    if(nm->groupHeaderEnabled)
+        flags |= UA_UADP_FLAGS_GROUPHEADER;
+    if(nm->payloadHeaderEnabled)
+        flags |= UA_UADP_FLAGS_PAYLOADHEADER;
+    if(extFlags1)
+        flags |= UA_UADP_FLAGS_EXTFLAGS1;
+    pos = UA_DataSetCodec_write8(pos, flags);
+    if(extFlags1) {
+        UA_Byte ext = (UA_Byte)nm->publisherIdType;
+        if(nm->dataSetClassIdEnabled)
+            ext |= UA_UADP_EXTFLAGS1_DATASETCLASSID;
+        if(nm->timestampEnabled)
+            ext |= UA_UADP_EXTFLAGS1_TIMESTAMP;
+        if(nm->picosecondsEnabled)
+            ext |= UA_UADP_EXTFLAGS1_PICOSECONDS;
+        if(nm->securityEnabled)
+            ext |= UA_UADP_EXTFLAGS1_SECURITY;
+        if(nm->chunkMessage)
+            ext |= UA_UADP_EXTFLAGS1_EXTFLAGS2;
+        pos = UA_DataSetCodec_write8(pos, ext);
+        if(nm->chunkMessage)
+            pos = UA_DataSetCodec_write8(pos, UA_UADP_EXTFLAGS2_CHUNK);
+    }
+
+    if(nm->publisherIdEnabled) {
+        switch(nm->publisherIdType) {
+        case UA_PUBLISHERDATATYPE_BYTE:
+            pos = UA_DataSetCodec_write8(pos, nm->publisherId.publisherIdByte);
+            break;
+        case UA_PUBLISHERDATATYPE_UINT16:
+            pos = UA_DataSetCodec_write16(pos, nm->publisherId.publisherIdUInt16);
+            break;
+        case UA_PUBLISHERDATATYPE_UINT32:
+            pos = UA_DataSetCodec_write32(pos, nm->publisherId.publisherIdUInt32);
+            break;
+        case UA_PUBLISHERDATATYPE_UINT64:
+            pos = UA_DataSetCodec_write64(pos, nm->publisherId.publisherIdUInt64);
+            break;
+        default:
+            pos = UA_DataSetCodec_writeString(pos, &nm->publisherId.publisherIdString);
+            break;
+        }
+    }
+
+    if(nm->dataSetClassIdEnabled) {
+        const UA_Guid *id = &nm->dataSetClassId;
+        pos = UA_DataSetCodec_write32(pos, id->data1);
+        pos = UA_DataSetCodec_write16(pos, id->data2);
+        pos = UA_DataSetCodec_write16(pos, id->data3);
+        memcpy(pos, id->data4, 8);
+        pos += 8;
+    }
+
+    if(nm->groupHeaderEnabled) {
+        const UA_NetworkMessageGroupHeader *gh = &nm->groupHeader;
+        UA_Byte groupFlags = 0;
+        if(gh->writerGroupIdEnabled)
+            groupFlags |= UA_UADP_GROUP_WRITERGROUPID;
+        if(gh->groupVersionEnabled)
+            groupFlags |= UA_UADP_GROUP_GROUPVERSION;
+        if(gh->networkMessageNumberEnabled)
+            groupFlags |= UA_UADP_GROUP_NETWORKMESSAGENUMBER;
+        if(gh->sequenceNumberEnabled)
+            groupFlags |= UA_UADP_GROUP_SEQUENCENUMBER;
+        pos = UA_DataSetCodec_write8(pos, groupFlags);
+        if(gh->writerGroupIdEnabled)
+            pos = UA_DataSetCodec_write16(pos, gh->writerGroupId);
+        if(gh->groupVersionEnabled)
+            pos = UA_DataSetCodec_write32(pos, gh->groupVersion);
+        if(gh->networkMessageNumberEnabled)
+            pos = UA_DataSetCodec_write16(pos, gh->networkMessageNumber);
+        if(gh->sequenceNumberEnabled)
+            pos = UA_DataSetCodec_write16(pos, gh->sequenceNumber);
+    }
+
+    UA_Byte count = dataSetMessagesSize(nm);
+    if(nm->chunkMessage) {
+        pos = UA_DataSetCodec_write16(pos, nm->payloadHeader.dataSetPayloadHeader.dataSetWriterIds[0]);
+    } else if(nm->payloadHeaderEnabled) {
+        pos = UA_DataSetCodec_write8(pos, count);
+        for(size_t i = 0; i < count; i++)
+            pos = UA_DataSetCodec_write16(pos, nm->payloadHeader.dataSetPayloadHeader.dataSetWriterIds[i]);
+    }
+
+    if(nm->timestampEnabled)
+        pos = UA_DataSetCodec_write64(pos, (UA_UInt64)nm->timestamp);
+    if(nm->picosecondsEnabled)
+        pos = UA_DataSetCodec_write16(pos, nm->picoseconds);
+
+    if(nm->securityEnabled) {
+        const UA_NetworkMessageSecurityHeader *sh = &nm->securityHeader;
+        UA_Byte securityFlags = 0;
+        if(sh->networkMessageSigned)
+            securityFlags |= UA_UADP_SECURITY_SIGNED;
+        if(sh->networkMessageEncrypted)
+            securityFlags |= UA_UADP_SECURITY_ENCRYPTED;
+        if(sh->forceKeyReset)
+            securityFlags |= UA_UADP_SECURITY_FORCEKEYRESET;
+        pos = UA_DataSetCodec_write8(pos, securityFlags);
+        pos = UA_DataSetCodec_write32(pos, sh->securityTokenId);
+        pos = UA_DataSetCodec_write8(pos, sh->nonceLength);
+        if(sh->nonceLength > 0)
+            memcpy(pos, sh->messageNonce.data, sh->nonceLength);
+        pos += sh->nonceLength;
+    }
+    return pos;
+}
+
+/* Sets supported to false if the headers contain parts that are left to the
+ * generic decoding. The status code is then to be ignored. The allocations
+ * are the same as by the generic decoding. The MessageNonce is not copied, it
+ * directly precedes the payload. */
+static UA_StatusCode
+decodeHeaders(const UA_ByteString *src, size_t *offset, UA_NetworkMessage *nm,
+              UA_Boolean *supported) {
+    size_t pos = *offset;
+    *supported = false;
+    if(src->length < pos + 1)
+        return UA_STATUSCODE_BADDECODINGERROR;
+    UA_Byte flags = src->data[pos++];
+    UA_Byte extFlags1 = 0;
+    if(flags & UA_UADP_FLAGS_EXTFLAGS1) {
+        if(src->length < pos + 1)
+            return UA_STATUSCODE_BADDECODINGERROR;
+        extFlags1 = src->data[pos++];
+        if(extFlags1 & UA_UADP_EXTFLAGS1_EXTFLAGS2) {
+            /* Only chunks of DataSetMessages */
+            if(src->length < pos + 1 || src->data[pos] != UA_UADP_EXTFLAGS2_CHUNK)
+                return UA_STATUSCODE_GOOD;
+            nm->chunkMessage = true;
+            pos++;
+        }
+    }
+    if(nm->chunkMessage && !(flags & UA_UADP_FLAGS_PAYLOADHEADER))
+        return UA_STATUSCODE_GOOD;
+    *supported = true;
+    nm->version = flags & UA_UADP_VERSION_MASK;
+    nm->networkMessageType = UA_NETWORKMESSAGE_DATASET;
+    nm->publisherIdEnabled = (flags & UA_UADP_FLAGS_PUBLISHERID) != 0;
+    nm->groupHeaderEnabled = (flags & UA_UADP_FLAGS_GROUPHEADER) != 0;
+    nm->payloadHeaderEnabled = (flags & UA_UADP_FLAGS_PAYLOADHEADER) != 0;
+    nm->publisherIdType = (UA_PublisherIdDatatype)(extFlags1 & UA_UADP_EXTFLAGS1_PUBLISHERIDTYPE);
+    nm->dataSetClassIdEnabled = (extFlags1 & UA_UADP_EXTFLAGS1_DATASETCLASSID) != 0;
+    nm->timestampEnabled = (extFlags1 & UA_UADP_EXTFLAGS1_TIMESTAMP) != 0;
+    nm->picosecondsEnabled = (extFlags1 & UA_UADP_EXTFLAGS1_PICOSECONDS) != 0;
+    nm->securityEnabled = (extFlags1 & UA_UADP_EXTFLAGS1_SECURITY) != 0;
+
+    if(nm->publisherIdEnabled) {
+        switch(nm->publisherIdType) {
+        case UA_PUBLISHERDATATYPE_BYTE:
+            if(src->length < pos + 1)
+                return UA_STATUSCODE_BADDECODINGERROR;
+            nm->publisherId.publisherIdByte = src->data[pos++];
+            break;
+        case UA_PUBLISHERDATATYPE_UINT16:
+            if(src->length < pos + 2)
+                return UA_STATUSCODE_BADDECODINGERROR;
+            nm->publisherId.publisherIdUInt16 = UA_DataSetCodec_read16(&src->data[pos]);
+            pos += 2;
+            break;
+        case UA_PUBLISHERDATATYPE_UINT32:
+            if(src->length < pos + 4)
+                return UA_STATUSCODE_BADDECODINGERROR;
+            nm->publisherId.publisherIdUInt32 = UA_DataSetCodec_read32(&src->data[pos]);
+            pos += 4;
+            break;
+        case UA_PUBLISHERDATATYPE_UINT64:
+            if(src->length < pos + 8)
+                return UA_STATUSCODE_BADDECODINGERROR;
+            nm->publisherId.publisherIdUInt64 = UA_DataSetCodec_read64(&src->data[pos]);
+            pos += 8;
+            break;
+        case UA_PUBLISHERDATATYPE_STRING: {
+            UA_StatusCode rv =
+                UA_DataSetCodec_readString(src, &pos, &nm->publisherId.publisherIdString);
+            if(rv != UA_STATUSCODE_GOOD)
+                return rv;
+            break;
+        }
+        default:
+            return UA_STATUSCODE_BADDECODINGERROR;
+        }
+    }
+
+    if(nm->dataSetClassIdEnabled) {
+        if(src->length < pos + 16)
+            return UA_STATUSCODE_BADDECODINGERROR;
+        nm->dataSetClassId.data1 = UA_DataSetCodec_read32(&src->data[pos]);
+        nm->dataSetClassId.data2 = UA_DataSetCodec_read16(&src->data[pos + 4]);
+        nm->dataSetClassId.data3 = UA_DataSetCodec_read16(&src->data[pos + 6]);
+        memcpy(nm->dataSetClassId.data4, &src->data[pos + 8], 8);
+        pos += 16;
+    }
+
+    if(nm->groupHeaderEnabled) {
+        if(src->length < pos + 1)
+            return UA_STATUSCODE_BADDECODINGERROR;
+        UA_Byte groupFlags = src->data[pos++];
+        UA_NetworkMessageGroupHeader *gh = &nm->groupHeader;
+        gh->writerGroupIdEnabled = (groupFlags & UA_UADP_GROUP_WRITERGROUPID) != 0;
+        gh->groupVersionEnabled = (groupFlags & UA_UADP_GROUP_GROUPVERSION) != 0;
+        gh->networkMessageNumberEnabled = (groupFlags & UA_UADP_GROUP_NETWORKMESSAGENUMBER) != 0;
+        gh->sequenceNumberEnabled = (groupFlags & UA_UADP_GROUP_SEQUENCENUMBER) != 0;
+        size_t size = 2 * gh->writerGroupIdEnabled + 4 * gh->groupVersionEnabled +
+            2 * gh->networkMessageNumberEnabled + 2 * gh->sequenceNumberEnabled;
+        if(src->length < pos + size)
+            return UA_STATUSCODE_BADDECODINGERROR;
+        if(gh->writerGroupIdEnabled) {
+            gh->writerGroupId = UA_DataSetCodec_read16(&src->data[pos]);
+            pos += 2;
+        }
+        if(gh->groupVersionEnabled) {
+            gh->groupVersion = UA_DataSetCodec_read32(&src->data[pos]);
+            pos += 4;
+        }
+        if(gh->networkMessageNumberEnabled) {
+            gh->networkMessageNumber = UA_DataSetCodec_read16(&src->data[pos]);
+            pos += 2;
+        }
+        if(gh->sequenceNumberEnabled) {
+            gh->sequenceNumber = UA_DataSetCodec_read16(&src->data[pos]);
+            pos += 2;
+        }
+    }
+
+    if(nm->payloadHeaderEnabled) {
+        UA_Byte count = 1;
+        if(!nm->chunkMessage) {
+            if(src->length < pos + 1)
+                return UA_STATUSCODE_BADDECODINGERROR;
+            count = src->data[pos++];
+        }
+        if(src->length < pos + 2 * (size_t)count)
+            return UA_STATUSCODE_BADDECODINGERROR;
+        UA_DataSetPayloadHeader *ph = &nm->payloadHeader.dataSetPayloadHeader;
+        ph->dataSetWriterIds = (UA_UInt16 *)UA_Array_new(count, &UA_TYPES[UA_TYPES_UINT16]);
+        if(count > 0 && !ph->dataSetWriterIds)
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+        ph->count = count;
+        for(size_t i = 0; i < count; i++)
+            ph->dataSetWriterIds[i] = UA_DataSetCodec_read16(&src->data[pos + 2 * i]);
+        pos += 2 * (size_t)count;
+    }
+
+    if(nm->timestampEnabled) {
+        if(src->length < pos + 8)
+            return UA_STATUSCODE_BADDECODINGERROR;
+        nm->timestamp = (UA_DateTime)UA_DataSetCodec_read64(&src->data[pos]);
+        pos += 8;
+    }
+    if(nm->picosecondsEnabled) {
+        if(src->length < pos + 2)
+            return UA_STATUSCODE_BADDECODINGERROR;
+        nm->picoseconds = UA_DataSetCodec_read16(&src->data[pos]);
+        pos += 2;
+    }
+
+    if(nm->securityEnabled) {
+        if(src->length < pos + 6)
+            return UA_STATUSCODE_BADDECODINGERROR;
+        UA_NetworkMessageSecurityHeader *sh = &nm->securityHeader;
+        UA_Byte securityFlags = src->data[pos];
+        if(securityFlags & UA_UADP_SECURITY_FOOTER)
+            return UA_STATUSCODE_BADNOTSUPPORTED;
+        sh->networkMessageSigned = (securityFlags & UA_UADP_SECURITY_SIGNED) != 0;
+        sh->networkMessageEncrypted = (securityFlags & UA_UADP_SECURITY_ENCRYPTED) != 0;
+        sh->forceKeyReset = (securityFlags & UA_UADP_SECURITY_FORCEKEYRESET) != 0;
+        sh->securityTokenId = UA_DataSetCodec_read32(&src->data[pos + 1]);
+        sh->nonceLength = src->data[pos + 5];
+        pos += 6;
+        if(src->length < pos + sh->nonceLength)
+            return UA_STATUSCODE_BADDECODINGERROR;
+        pos += sh->nonceLength;
+    }
+    *offset = pos;
+    return UA_STATUSCODE_GOOD;
+}
+
+/**
+ * NetworkMessages
+ * ~~~~~~~~~~~~~~~ */
+
+size_t
+UA_NetworkMessage_calcSizeBinaryCodec(UA_NetworkMessage *nm,
+                                      const UA_DataSetCodec *const *codecs) {
+    if(!headersSupported(nm) || nm->chunkMessage)
+        return 0;
+    size_t size = calcSizeHeaders(nm) + calcSizePayloadSizes(nm);
+    UA_Byte count = dataSetMessagesSize(nm);
+    UA_DataSetMessage *dsm = nm->payload.dataSetPayload.dataSetMessages;
+    for(size_t i = 0; i < count; i++) {
+        size_t dsmSize = calcSizeDataSetMessage(codecs[i], &dsm[i]);
+        if(dsmSize == 0)
+            dsmSize = UA_DataSetMessage_calcSizeBinary(&dsm[i]);
+        if(dsmSize > UA_UINT16_MAX)
+            return 0;
+        if(nm->payload.dataSetPayload.sizes)
+            nm->payload.dataSetPayload.sizes[i] = (UA_UInt16)dsmSize;
+        size += dsmSize;
+    }
+    return size;
+}
+
+UA_StatusCode
+UA_NetworkMessage_encodeBinaryCodec(const UA_NetworkMessage *nm,
+                                    const UA_DataSetCodec *const *codecs,
+                                    UA_Byte **bufPos, const UA_Byte *bufEnd) {
+    if(!headersSupported(nm) || nm->chunkMessage)
+        return UA_STATUSCODE_BADNOTSUPPORTED;
+    if((size_t)(bufEnd - *bufPos) < calcSizeHeaders(nm) + calcSizePayloadSizes(nm))
+        return UA_STATUSCODE_BADENCODINGLIMITSEXCEEDED;
+    *bufPos = encodeHeaders(nm, *bufPos);
+    UA_Byte count = dataSetMessagesSize(nm);
+    UA_DataSetMessage *dsm = nm->payload.dataSetPayload.dataSetMessages;
+
+    /* Sizes of the DataSetMessages. Computed if not set, as in the generic
+     * encoding. */
+    if(nm->payloadHeaderEnabled && count > 1) {
+        const UA_UInt16 *sizes = nm->payload.dataSetPayload.sizes;
+        for(size_t i = 0; i < count; i++) {
+            size_t dsmSize = (sizes && sizes[i] != 0) ? sizes[i] :
+                calcSizeDataSetMessage(codecs[i], &dsm[i]);
+            if(dsmSize == 0)
+                dsmSize = UA_DataSetMessage_calcSizeBinary(&dsm[i]);
+            *bufPos = UA_DataSetCodec_write16(*bufPos, (UA_UInt16)dsmSize);
+        }
+    }
+
+    for(size_t i = 0; i < count; i++) {
+        UA_StatusCode rv = encodeDataSetMessage(codecs[i], &dsm[i], bufPos, bufEnd);
+        if(rv != UA_STATUSCODE_GOOD)
+            return rv;
+    }
+    return UA_STATUSCODE_GOOD;
+}
+
+UA_StatusCode
+UA_NetworkMessage_decodeBinaryCodec(const UA_ByteString *src, size_t *offset,
+                                    UA_NetworkMessage *dst,
+                                    const UA_DataSetCodec *const *codecs,
+                                    size_t codecsSize) {
+    size_t start = *offset;
+    memset(dst, 0, sizeof(UA_NetworkMessage));
+    UA_Boolean supported = false;
+    UA_StatusCode rv = decodeHeaders(src, offset, dst, &supported);
+    if(!supported) {
+        memset(dst, 0, sizeof(UA_NetworkMessage));
+        *offset = start;
+        return UA_NetworkMessage_decodeBinary(src, offset, dst);
+    }
+    if(rv != UA_STATUSCODE_GOOD)
+        return rv;
+    if(dst->chunkMessage)
+        return UA_STATUSCODE_BADNOTSUPPORTED; /* see UA_NetworkMessage_decodeChunk */
+    if(dst->securityEnabled)
+        return UA_STATUSCODE_BADSECURITYCHECKSFAILED; /* see ua_pubsub_security.h */
+    return UA_NetworkMessage_decodePayloadCodec(src, offset, dst, codecs, codecsSize);
+}
+
+size_t
+UA_NetworkMessage_calcSizeHeadersCodec(const UA_NetworkMessage *nm) {
+    if(!headersSupported(nm) || nm->chunkMessage)
+        return 0;
+    return calcSizeHeaders(nm);
+}
+
+UA_StatusCode
+UA_NetworkMessage_decodeHeadersCodec(const UA_ByteString *src, size_t *offset,
+                                     UA_NetworkMessage *dst) {
+    memset(dst, 0, sizeof(UA_NetworkMessage));
+    UA_Boolean supported = false;
+    size_t pos = *offset;
+    UA_StatusCode rv = decodeHeaders(src, &pos, dst, &supported);
+    if(rv != UA_STATUSCODE_GOOD)
+        return rv;
+    if(!supported || dst->chunkMessage)
+        return UA_STATUSCODE_BADNOTSUPPORTED;
+    *offset = pos;
+    return UA_STATUSCODE_GOOD;
+}
+
+UA_StatusCode
+UA_NetworkMessage_decodePayloadCodec(const UA_ByteString *src, size_t *offset,
+                                     UA_NetworkMessage *dst,
+                                     const UA_DataSetCodec *const *codecs,
+                                     size_t codecsSize) {
+    /* Sizes of the DataSetMessages */
+    UA_Byte count = dataSetMessagesSize(dst);
+    if(dst->payloadHeaderEnabled && count > 1) {
+        if(src->length < *offset + 2 * (size_t)count)
+            return UA_STATUSCODE_BADDECODINGERROR;
+        dst->payload.dataSetPayload.sizes =
+            (UA_UInt16 *)UA_Array_new(count, &UA_TYPES[UA_TYPES_UINT16]);
+        if(!dst->payload.dataSetPayload.sizes)
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+        for(size_t i = 0; i < count; i++)
+            dst->payload.dataSetPayload.sizes[i] =
+                UA_DataSetCodec_read16(&src->data[*offset + 2 * i]);
+        *offset += 2 * (size_t)count;
+    }
+
+    if(count == 0)
+        return UA_STATUSCODE_GOOD;
+    UA_DataSetMessage *dsm = (UA_DataSetMessage *)UA_calloc(count, sizeof(UA_DataSetMessage));
+    if(!dsm)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    dst->payload.dataSetPayload.dataSetMessages = dsm;
+    for(size_t i = 0; i < count; i++) {
+        UA_UInt16 size = dst->payload.dataSetPayload.sizes ?
+            dst->payload.dataSetPayload.sizes[i] : 0;
+        UA_StatusCode rv = decodeDataSetMessage(src, offset, &dsm[i], size, codecs, codecsSize);
+        if(rv != UA_STATUSCODE_GOOD)
+            return rv;
+    }
+    return UA_STATUSCODE_GOOD;
+}
+
+/**
+ * Chunks
+ * ~~~~~~
+ * The chunk payload is the MessageSequenceNumber, ChunkOffset and TotalSize,
+ * followed by the chunk data as a ByteString. */
+
+#define UA_CHUNK_FIELDS_SIZE 14
+
+size_t
+UA_NetworkMessage_calcSizeChunkHeaders(const UA_NetworkMessage *nm) {
+    if(!nm->chunkMessage || !headersSupported(nm))
+        return 0;
+    return calcSizeHeaders(nm) + UA_CHUNK_FIELDS_SIZE;
+}
+
+UA_StatusCode
+UA_NetworkMessage_encodeChunk(const UA_NetworkMessage *nm, const UA_NetworkMessageChunk *chunk,
+                              UA_Byte **bufPos, const UA_Byte *bufEnd) {
+    size_t size = UA_NetworkMessage_calcSizeChunkHeaders(nm);
+    if(size == 0)
+        return UA_STATUSCODE_BADNOTSUPPORTED;
+    if(chunk->chunkData.length > UA_INT32_MAX ||
+       (size_t)chunk->chunkOffset + chunk->chunkData.length > chunk->totalSize)
+        return UA_STATUSCODE_BADINVALIDARGUMENT;
+    if((size_t)(bufEnd - *bufPos) < size + chunk->chunkData.length)
+        return UA_STATUSCODE_BADENCODINGLIMITSEXCEEDED;
+    UA_Byte *pos = encodeHeaders(nm, *bufPos);
+    pos = UA_DataSetCodec_write16(pos, chunk->messageSequenceNumber);
+    pos = UA_DataSetCodec_write32(pos, chunk->chunkOffset);
+    pos = UA_DataSetCodec_write32(pos, chunk->totalSize);
+    pos = UA_DataSetCodec_write32(pos, (UA_UInt32)chunk->chunkData.length);
+    if(chunk->chunkData.length > 0)
+        memcpy(pos, chunk->chunkData.data, chunk->chunkData.length);
+    *bufPos = pos + chunk->chunkData.length;
+    return UA_STATUSCODE_GOOD;
+}
+
+UA_Boolean
+UA_NetworkMessage_isChunk(const UA_ByteString *src, size_t offset) {
+    return src->length >= offset + 3 &&
+        (src->data[offset] & UA_UADP_FLAGS_EXTFLAGS1) &&
+        (src->data[offset + 1] & UA_UADP_EXTFLAGS1_EXTFLAGS2) &&
+        (src->data[offset + 2] & UA_UADP_EXTFLAGS2_CHUNK);
+}
+
+UA_StatusCode
+UA_NetworkMessage_decodeChunk(const UA_ByteString *src, size_t *offset,
+                              UA_NetworkMessage *dst, UA_NetworkMessageChunk *chunk) {
+    memset(dst, 0, sizeof(UA_NetworkMessage));
+    memset(chunk, 0, sizeof(UA_NetworkMessageChunk));
+    size_t pos = *offset;
+    UA_Boolean supported = false;
+    UA_StatusCode rv = decodeHeaders(src, &pos, dst, &supported);
+    if(!supported || !dst->chunkMessage)
+        return (rv != UA_STATUSCODE_GOOD) ? rv : UA_STATUSCODE_BADNOTSUPPORTED;
+    if(rv != UA_STATUSCODE_GOOD)
+        return rv;
+    if(src->length < pos + UA_CHUNK_FIELDS_SIZE)
+        return UA_STATUSCODE_BADDECODINGERROR;
+    chunk->messageSequenceNumber = UA_DataSetCodec_read16(&src->data[pos]);
+    chunk->chunkOffset = UA_DataSetCodec_read32(&src->data[pos + 2]);
+    chunk->totalSize = UA_DataSetCodec_read32(&src->data[pos + 6]);
+    UA_Int32 length = (UA_Int32)UA_DataSetCodec_read32(&src->data[pos + 10]);
+    pos += UA_CHUNK_FIELDS_SIZE;
+    if(length < 0)
+        length = 0;
+    if(src->length - pos < (size_t)length ||
+       (size_t)chunk->chunkOffset + (size_t)length > chunk->totalSize)
+        return UA_STATUSCODE_BADDECODINGERROR;
+    chunk->chunkData.data = (length > 0) ? &src->data[pos] : NULL;
+    chunk->chunkData.length = (size_t)length;
+    *offset = pos + (size_t)length;
+    return UA_STATUSCODE_GOOD;
+}
+
+#endif /* UA_ENABLE_PUBSUB */
@@ -0,0 +1,283 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef UA_PUBSUB_CODEC_H_
+#define UA_PUBSUB_CODEC_H_
+
+#include <open62541/types.h>
+#include <open62541/types_generated_handling.h>
+
+#include "ua_pubsub_networkmessage.h"
+
+_UA_BEGIN_DECLS
+
+#ifdef UA_ENABLE_PUBSUB /* conditional compilation */
+
+/**
+ * Generated DataSet Codecs
+ * ------------------------
+ * ``pubsub/generate_dataset_codec.py`` generates the encoding and decoding of
+ * the fields of one DataSet layout as straight-line C code. The generated
+ * functions write and read the fields of key frames with Variant field
+ * encoding. They check the type of every field with a pointer comparison
+ * instead of going through the type table.
+ *
+ * The NetworkMessage functions below encode the UADP headers directly and use
+ * the codec of a DataSetMessage where it applies. Otherwise they fall back to
+ * the generic encoding: for DataSetMessages without a codec, delta frames,
+ * other field encodings, and fields whose type does not match the codec.
+ * NetworkMessages with promoted fields or security footers are left to the
+ * generic functions entirely. The encoded bytes are the same in both cases.
+ *
+ * Publishers bind a codec to a PublishedDataSet with
+ * ``UA_Server_setDataSetCodec``. Subscribers pass their codecs to
+ * ``UA_NetworkMessage_decodeBinaryCodec``. A codec is tried for key frames
+ * with its number of fields and is dropped for that message as soon as an
+ * encoded type does not match. */
+
+typedef struct {
+    UA_Byte builtInType; /* NodeId of the type in ns0 */
+    UA_Int32 valueRank;  /* -1 (scalar) or 1 (array) */
+} UA_DataSetCodecField;
+
+typedef struct {
+    const char *name;
+    size_t fieldsSize;
+    const UA_DataSetCodecField *fields;
+
+    /* Returns 0 if the values do not have the types of the layout */
+    size_t (*calcSizeFields)(const UA_DataValue *fields);
+    UA_StatusCode (*encodeFields)(const UA_DataValue *fields, UA_Byte **bufPos,
+                                  const UA_Byte *bufEnd);
+    /* Decodes into fieldsSize initialized DataValues. They are cleared by the
+     * caller also if decoding fails. */
+    UA_StatusCode (*decodeFields)(const UA_ByteString *src, size_t *offset,
+                                  UA_DataValue *fields);
+} UA_DataSetCodec;
+
+/* Returns 0 if the NetworkMessage cannot be encoded with the codecs, then
+ * UA_NetworkMessage_calcSizeBinary applies. Sets the sizes of the
+ * DataSetMessages in the payload. codecs has one (possibly NULL) entry per
+ * DataSetMessage. */
+size_t UA_EXPORT
+UA_NetworkMessage_calcSizeBinaryCodec(UA_NetworkMessage *nm,
+                                      const UA_DataSetCodec *const *codecs);
+
+/* Only after UA_NetworkMessage_calcSizeBinaryCodec returned a size */
+UA_StatusCode UA_EXPORT
+UA_NetworkMessage_encodeBinaryCodec(const UA_NetworkMessage *nm,
+                                    const UA_DataSetCodec *const *codecs,
+                                    UA_Byte **bufPos, const UA_Byte *bufEnd);
+
+/* Falls back to UA_NetworkMessage_decodeBinary for messages with unsupported
+ * headers. Returns UA_STATUSCODE_BADNOTSUPPORTED for chunk messages and
+ * UA_STATUSCODE_BADSECURITYCHECKSFAILED for messages with a security header.
+ * The result is cleared with UA_NetworkMessage_clear. */
+UA_StatusCode UA_EXPORT
+UA_NetworkMessage_decodeBinaryCodec(const UA_ByteString *src, size_t *offset,
+                                    UA_NetworkMessage *dst,
+                                    const UA_DataSetCodec *const *codecs,
+                                    size_t codecsSize);
+
+/* The headers and the payload separately, for the message security that
+ * works on the payload in between. The headers end with the security header
+ * and its MessageNonce. The payload starts with the sizes of the
+ * DataSetMessages. calcSizeHeaders returns 0 and decodeHeaders returns
+ * UA_STATUSCODE_BADNOTSUPPORTED for headers that the codec does not
+ * support. */
+size_t UA_EXPORT
+UA_NetworkMessage_calcSizeHeadersCodec(const UA_NetworkMessage *nm);
+
+UA_StatusCode UA_EXPORT
+UA_NetworkMessage_decodeHeadersCodec(const UA_ByteString *src, size_t *offset,
+                                     UA_NetworkMessage *dst);
+
+UA_StatusCode UA_EXPORT
+UA_NetworkMessage_decodePayloadCodec(const UA_ByteString *src, size_t *offset,
+                                     UA_NetworkMessage *dst,
+                                     const UA_DataSetCodec *const *codecs,
+                                     size_t codecsSize);
+
+/**
+ * Chunk Messages
+ * ~~~~~~~~~~~~~~
+ * A DataSetMessage that does not fit into one NetworkMessage is sent as a
+ * sequence of chunk messages (Part 14, 7.2.2.2.4). Each carries the headers
+ * with the chunk flag, the DataSetWriterId of the chunked DataSetMessage and a
+ * slice of its encoding at an offset. The generic functions of this version
+ * do not handle chunks. Receivers put them back together with the chunk
+ * reassembler of ``ua_pubsub_chunk.h``. */
+
+typedef struct {
+    UA_UInt16 messageSequenceNumber; /* of the chunked DataSetMessage */
+    UA_UInt32 chunkOffset;
+    UA_UInt32 totalSize;             /* of the encoded DataSetMessage */
+    UA_ByteString chunkData;         /* not owned */
+} UA_NetworkMessageChunk;
+
+/* Size of a chunk message without the chunk data. Returns 0 if the headers
+ * are not supported. The chunk flag and the payload header with one
+ * DataSetWriterId have to be set. */
+size_t UA_EXPORT
+UA_NetworkMessage_calcSizeChunkHeaders(const UA_NetworkMessage *nm);
+
+UA_StatusCode UA_EXPORT
+UA_NetworkMessage_encodeChunk(const UA_NetworkMessage *nm, const UA_NetworkMessageChunk *chunk,
+                              UA_Byte **bufPos, const UA_Byte *bufEnd);
+
+/* Looks at the flags only */
+UA_Boolean UA_EXPORT
+UA_NetworkMessage_isChunk(const UA_ByteString *src, size_t offset);
+
+/* Decodes the headers into dst and points the chunk data into src. dst is
+ * cleared with UA_NetworkMessage_clear also if decoding fails. */
+UA_StatusCode UA_EXPORT
+UA_NetworkMessage_decodeChunk(const UA_ByteString *src, size_t *offset,
+                              UA_NetworkMessage *dst, UA_NetworkMessageChunk *chunk);
+
+/**
+ * Helpers for the Generated Code
+ * ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ * Integers are written byte by byte in little-endian order, which compilers
+ * merge into single stores. */
+
+#define UA_DATASETCODEC_ARRAY 0x80
+
+static UA_INLINE UA_Boolean
+UA_DataSetCodec_isScalar(const UA_Variant *v, const UA_DataType *type) {
+    return v->type == type && v->arrayLength == 0 &&
+        v->data > UA_EMPTY_ARRAY_SENTINEL && v->arrayDimensionsSize == 0;
+}
+
+static UA_INLINE UA_Boolean
+UA_DataSetCodec_isArray(const UA_Variant *v, const UA_DataType *type) {
+    return v->type == type && v->arrayDimensionsSize == 0 &&
+        (v->arrayLength > 0 || v->data <= UA_EMPTY_ARRAY_SENTINEL) &&
+        v->arrayLength <= UA_INT32_MAX;
+}
+
+/* -1 for null arrays and strings, as in the generic encoding */
+static UA_INLINE UA_Int32
+UA_DataSetCodec_encodedLength(const void *data, size_t length) {
+    if(length > 0)
+        return (UA_Int32)length;
+    return (data == UA_EMPTY_ARRAY_SENTINEL) ? 0 : -1;
+}
+
+static UA_INLINE UA_Byte *
+UA_DataSetCodec_write8(UA_Byte *pos, UA_Byte v) {
+    pos[0] = v;
+    return pos + 1;
+}
+
+static UA_INLINE UA_Byte *
+UA_DataSetCodec_write16(UA_Byte *pos, UA_UInt16 v) {
+    pos[0] = (UA_Byte)v;
+    pos[1] = (UA_Byte)(v >> 8);
+    return pos + 2;
+}
+
+static UA_INLINE UA_Byte *
+UA_DataSetCodec_write32(UA_Byte *pos, UA_UInt32 v) {
+    pos[0] = (UA_Byte)v;
+    pos[1] = (UA_Byte)(v >> 8);
+    pos[2] = (UA_Byte)(v >> 16);
+    pos[3] = (UA_Byte)(v >> 24);
+    return pos + 4;
+}
+
+static UA_INLINE UA_Byte *
+UA_DataSetCodec_write64(UA_Byte *pos, UA_UInt64 v) {
+    for(size_t i = 0; i < 8; i++)
+        pos[i] = (UA_Byte)(v >> (8 * i));
+    return pos + 8;
+}
+
+static UA_INLINE UA_Byte *
+UA_DataSetCodec_writeFloat(UA_Byte *pos, UA_Float v) {
+    UA_UInt32 bits;
+    memcpy(&bits, &v, sizeof(bits));
+    return UA_DataSetCodec_write32(pos, bits);
+}
+
+static UA_INLINE UA_Byte *
+UA_DataSetCodec_writeDouble(UA_Byte *pos, UA_Double v) {
+    UA_UInt64 bits;
+    memcpy(&bits, &v, sizeof(bits));
+    return UA_DataSetCodec_write64(pos, bits);
+}
+
+/* Strings and ByteStrings */
+static UA_INLINE UA_Byte *
+UA_DataSetCodec_writeString(UA_Byte *pos, const UA_String *v) {
+    pos = UA_DataSetCodec_write32(pos, (UA_UInt32)UA_DataSetCodec_encodedLength(v->data, v->length));
+    if(v->length > 0)
+        memcpy(pos, v->data, v->length);
+    return pos + v->length;
+}
+
+static UA_INLINE UA_UInt16
+UA_DataSetCodec_read16(const UA_Byte *pos) {
+    return (UA_UInt16)(pos[0] | (pos[1] << 8));
+}
+
+static UA_INLINE UA_UInt32
+UA_DataSetCodec_read32(const UA_Byte *pos) {
+    return (UA_UInt32)pos[0] | ((UA_UInt32)pos[1] << 8) |
+        ((UA_UInt32)pos[2] << 16) | ((UA_UInt32)pos[3] << 24);
+}
+
+static UA_INLINE UA_UInt64
+UA_DataSetCodec_read64(const UA_Byte *pos) {
+    UA_UInt64 v = 0;
+    for(size_t i = 0; i < 8; i++)
+        v |= (UA_UInt64)pos[i] << (8 * i);
+    return v;
+}
+
+static UA_INLINE UA_Float
+UA_DataSetCodec_readFloat(const UA_Byte *pos) {
+    UA_UInt32 bits = UA_DataSetCodec_read32(pos);
+    UA_Float v;
+    memcpy(&v, &bits, sizeof(v));
+    return v;
+}
+
+static UA_INLINE UA_Double
+UA_DataSetCodec_readDouble(const UA_Byte *pos) {
+    UA_UInt64 bits = UA_DataSetCodec_read64(pos);
+    UA_Double v;
+    memcpy(&v, &bits, sizeof(v));
+    return v;
+}
+
+/* Checks the encoding byte of the Variant and that size bytes follow it */
+static UA_INLINE UA_Boolean
+UA_DataSetCodec_expect(const UA_ByteString *src, size_t *pos, UA_Byte encoding,
+                       size_t size) {
+    if(src->length < *pos + 1 + size || src->data[*pos] != encoding)
+        return false;
+    (*pos)++;
+    return true;
+}
+
+UA_StatusCode UA_EXPORT
+UA_DataSetCodec_readString(const UA_ByteString *src, size_t *pos, UA_String *v);
+
+/* Allocates the scalar value of the field */
+void UA_EXPORT *
+UA_DataSetCodec_newScalar(UA_DataValue *field, const UA_DataType *type);
+
+/* Reads the array length and allocates the array of the field. Each element
+ * takes at least minSize bytes. */
+UA_StatusCode UA_EXPORT
+UA_DataSetCodec_newArray(const UA_ByteString *src, size_t *pos, UA_DataValue *field,
+                         const UA_DataType *type, size_t minSize);
+
+#endif /* UA_ENABLE_PUBSUB */
+
+_UA_END_DECLS
+
+#endif /* UA_PUBSUB_CODEC_H_ */
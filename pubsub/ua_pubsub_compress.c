@@ -0,0 +1,446 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include "ua_pubsub_compress.h"
+
+#ifdef UA_ENABLE_PUBSUB /* conditional compilation */
+
+#define UA_COMPRESSION_PROPERTIES 4
+
+static const char *compressionKeys[UA_COMPRESSION_PROPERTIES] =
+    {"CompressionType", "ScaleFactor", "Offset", "DeltaCoding"};
+
+/* Indexed by UA_FieldCompressionType */
+static const char *compressionTypeNames[] =
+    {"None", "Float", "ScaledInt16", "ScaledInt32"};
+
+static UA_Boolean
+isFinite(UA_Double v) {
+    return v - v == 0.0; /* NaN for infinity and NaN */
+}
+
+UA_StatusCode
+UA_FieldCompression_check(const UA_FieldCompression *c) {
+    switch(c->type) {
+    case UA_FIELDCOMPRESSION_NONE:
+        return UA_STATUSCODE_GOOD;
+    case UA_FIELDCOMPRESSION_FLOAT:
+        return c->deltaCoding ? UA_STATUSCODE_BADINVALIDARGUMENT : UA_STATUSCODE_GOOD;
+    case UA_FIELDCOMPRESSION_SCALEDINT16:
+    case UA_FIELDCOMPRESSION_SCALEDINT32:
+        if(!(c->scale > 0.0) || !isFinite(c->scale) || !isFinite(c->offset))
+            return UA_STATUSCODE_BADINVALIDARGUMENT;
+        return UA_STATUSCODE_GOOD;
+    default:
+        return UA_STATUSCODE_BADINVALIDARGUMENT;
+    }
+}
+
+/* The type of the encoded values. With delta coding, arrays may also be sent
+ * in a smaller integer type. */
+static const UA_DataType *
+encodedType(const UA_FieldCompression *c) {
+    switch(c->type) {
+    case UA_FIELDCOMPRESSION_FLOAT: return &UA_TYPES[UA_TYPES_FLOAT];
+    case UA_FIELDCOMPRESSION_SCALEDINT16: return &UA_TYPES[UA_TYPES_INT16];
+    case UA_FIELDCOMPRESSION_SCALEDINT32: return &UA_TYPES[UA_TYPES_INT32];
+    default: return NULL;
+    }
+}
+
+/* Copies the array dimensions of src to dst, which holds the values */
+static UA_StatusCode
+copyArrayDimensions(const UA_Variant *src, UA_Variant *dst) {
+    if(src->arrayDimensionsSize == 0)
+        return UA_STATUSCODE_GOOD;
+    UA_StatusCode rv = UA_Array_copy(src->arrayDimensions, src->arrayDimensionsSize,
+                                     (void **)&dst->arrayDimensions,
+                                     &UA_TYPES[UA_TYPES_UINT32]);
+    if(rv != UA_STATUSCODE_GOOD) {
+        UA_Variant_deleteMembers(dst);
+        return rv;
+    }
+    dst->arrayDimensionsSize = src->arrayDimensionsSize;
+    return UA_STATUSCODE_GOOD;
+}
+
+/**
+ * Compression
+ * ~~~~~~~~~~~ */
+
+static UA_Double
+sourceValue(const UA_Variant *src, size_t i) {
+    if(src->type == &UA_TYPES[UA_TYPES_DOUBLE])
+        return ((const UA_Double *)src->data)[i];
+    return ((const UA_Float *)src->data)[i];
+}
+
+/* Rounds half away from zero and saturates */
+static UA_Int32
+quantize(const UA_FieldCompression *c, UA_Double value, UA_Int32 min, UA_Int32 max) {
+    UA_Double q = (value - c->offset) / c->scale;
+    if(q != q)
+        return 0;
+    if(q <= (UA_Double)min)
+        return min;
+    if(q >= (UA_Double)max)
+        return max;
+    return (UA_Int32)(q < 0.0 ? q - 0.5 : q + 0.5);
+}
+
+/* Narrows the integers of the array in place. Narrowing from the front is
+ * safe, as an element is read before the bytes it occupied are overwritten.
+ * The elements are copied through locals, the array is never accessed through
+ * pointers of two integer types. */
+static void
+narrowInt16(UA_Byte *data, size_t length) {
+    for(size_t i = 0; i < length; i++) {
+        UA_Int16 wide;
+        memcpy(&wide, &data[i * sizeof(UA_Int16)], sizeof(UA_Int16));
+        UA_SByte narrow = (UA_SByte)wide;
+        memcpy(&data[i], &narrow, sizeof(UA_SByte));
+    }
+}
+
+static void
+narrowInt32(UA_Byte *data, size_t length, const UA_DataType *type) {
+    for(size_t i = 0; i < length; i++) {
+        UA_Int32 wide;
+        memcpy(&wide, &data[i * sizeof(UA_Int32)], sizeof(UA_Int32));
+        if(type == &UA_TYPES[UA_TYPES_SBYTE]) {
+            UA_SByte narrow = (UA_SByte)wide;
+            memcpy(&data[i], &narrow, sizeof(UA_SByte));
+        } else {
+            UA_Int16 narrow = (UA_Int16)wide;
+            memcpy(&data[i * sizeof(UA_Int16)], &narrow, sizeof(UA_Int16));
+        }
+    }
+}
+
+/* Replaces the integers by their differences to the one before, wrapping
+ * around in the width of the type. Then narrows them to the smallest type that
+ * holds all differences. */
+static void
+deltaEncode(UA_Variant *v) {
+    size_t length = v->arrayLength;
+    UA_Int32 min = 0, max = 0;
+    if(v->type == &UA_TYPES[UA_TYPES_INT16]) {
+        UA_Int16 *q = (UA_Int16 *)v->data;
+        for(size_t i = length - 1; i > 0; i--)
+            q[i] = (UA_Int16)(UA_UInt16)((UA_UInt16)q[i] - (UA_UInt16)q[i - 1]);
+        for(size_t i = 0; i < length; i++) {
+            if(q[i] < min) min = q[i];
+            if(q[i] > max) max = q[i];
+        }
+        if(min < UA_SBYTE_MIN || max > UA_SBYTE_MAX)
+            return;
+        narrowInt16((UA_Byte *)v->data, length);
+        v->type = &UA_TYPES[UA_TYPES_SBYTE];
+        return;
+    }
+
+    UA_Int32 *q = (UA_Int32 *)v->data;
+    for(size_t i = length - 1; i > 0; i--)
+        q[i] = (UA_Int32)((UA_UInt32)q[i] - (UA_UInt32)q[i - 1]);
+    for(size_t i = 0; i < length; i++) {
+        if(q[i] < min) min = q[i];
+        if(q[i] > max) max = q[i];
+    }
+    const UA_DataType *type;
+    if(min >= UA_SBYTE_MIN && max <= UA_SBYTE_MAX)
+        type = &UA_TYPES[UA_TYPES_SBYTE];
+    else if(min >= UA_INT16_MIN && max <= UA_INT16_MAX)
+        type = &UA_TYPES[UA_TYPES_INT16];
+    else
+        return;
+    narrowInt32((UA_Byte *)v->data, length, type);
+    v->type = type;
+}
+
+UA_StatusCode
+UA_FieldCompression_compress(const UA_FieldCompression *c, const UA_Variant *src,
+                             UA_Variant *dst) {
+    UA_Variant_init(dst);
+    if(c->type == UA_FIELDCOMPRESSION_NONE)
+        return UA_Variant_copy(src, dst);
+    const UA_DataType *type = encodedType(c);
+    if(!type)
+        return UA_STATUSCODE_BADINVALIDARGUMENT;
+    if(src->type != &UA_TYPES[UA_TYPES_DOUBLE] && src->type != &UA_TYPES[UA_TYPES_FLOAT])
+        return UA_STATUSCODE_BADTYPEMISMATCH;
+
+    UA_Boolean scalar = UA_Variant_isScalar(src);
+    size_t length = scalar ? 1 : src->arrayLength;
+    if(length == 0) {
+        /* Empty or null array */
+        UA_Variant_setArray(dst, (src->data == NULL) ? NULL : UA_EMPTY_ARRAY_SENTINEL, 0, type);
+        return copyArrayDimensions(src, dst);
+    }
+    void *data = UA_Array_new(length, type);
+    if(!data)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+
+    if(c->type == UA_FIELDCOMPRESSION_FLOAT) {
+        UA_Float *f = (UA_Float *)data;
+        for(size_t i = 0; i < length; i++)
+            f[i] = (UA_Float)sourceValue(src, i);
+    } else if(c->type == UA_FIELDCOMPRESSION_SCALEDINT16) {
+        UA_Int16 *q = (UA_Int16 *)data;
+        for(size_t i = 0; i < length; i++)
+            q[i] = (UA_Int16)quantize(c, sourceValue(src, i), UA_INT16_MIN, UA_INT16_MAX);
+    } else {
+        UA_Int32 *q = (UA_Int32 *)data;
+        for(size_t i = 0; i < length; i++)
+            q[i] = quantize(c, sourceValue(src, i), UA_INT32_MIN, UA_INT32_MAX);
+    }
+
+    if(scalar) {
+        UA_Variant_setScalar(dst, data, type);
+        return UA_STATUSCODE_GOOD;
+    }
+    UA_Variant_setArray(dst, data, length, type);
+    if(c->deltaCoding)
+        deltaEncode(dst);
+    return copyArrayDimensions(src, dst);
+}
+
+/**
+ * Expansion
+ * ~~~~~~~~~ */
+
+static UA_Int32
+encodedInteger(const UA_Variant *src, size_t i) {
+    if(src->type == &UA_TYPES[UA_TYPES_SBYTE])
+        return ((const UA_SByte *)src->data)[i];
+    if(src->type == &UA_TYPES[UA_TYPES_INT16])
+        return ((const UA_Int16 *)src->data)[i];
+    return ((const UA_Int32 *)src->data)[i];
+}
+
+UA_StatusCode
+UA_FieldCompression_expand(const UA_FieldCompression *c, const UA_Variant *src,
+                           UA_Variant *dst) {
+    UA_Variant_init(dst);
+    if(c->type == UA_FIELDCOMPRESSION_NONE)
+        return UA_Variant_copy(src, dst);
+    const UA_DataType *type = encodedType(c);
+    if(!type)
+        return UA_STATUSCODE_BADINVALIDARGUMENT;
+
+    /* Check the encoded type */
+    UA_Boolean scalar = UA_Variant_isScalar(src);
+    UA_Boolean delta = c->deltaCoding && !scalar && c->type != UA_FIELDCOMPRESSION_FLOAT;
+    if(src->type != type &&
+       !(delta && (src->type == &UA_TYPES[UA_TYPES_SBYTE] ||
+                   src->type == &UA_TYPES[UA_TYPES_INT16])))
+        return UA_STATUSCODE_BADTYPEMISMATCH;
+
+    const UA_DataType *doubleType = &UA_TYPES[UA_TYPES_DOUBLE];
+    size_t length = scalar ? 1 : src->arrayLength;
+    if(length == 0) {
+        UA_Variant_setArray(dst, (src->data == NULL) ? NULL : UA_EMPTY_ARRAY_SENTINEL,
+                            0, doubleType);
+        return copyArrayDimensions(src, dst);
+    }
+    UA_Double *values = (UA_Double *)UA_Array_new(length, doubleType);
+    if(!values)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+
+    if(c->type == UA_FIELDCOMPRESSION_FLOAT) {
+        const UA_Float *f = (const UA_Float *)src->data;
+        for(size_t i = 0; i < length; i++)
+            values[i] = (UA_Double)f[i];
+    } else if(!delta) {
+        for(size_t i = 0; i < length; i++)
+            values[i] = c->offset + (UA_Double)encodedInteger(src, i) * c->scale;
+    } else {
+        /* Sum up the differences in the width of the integer type */
+        UA_Boolean wide = (c->type == UA_FIELDCOMPRESSION_SCALEDINT32);
+        UA_UInt32 q = 0;
+        for(size_t i = 0; i < length; i++) {
+            q += (UA_UInt32)encodedInteger(src, i);
+            UA_Int32 integer = wide ? (UA_Int32)q : (UA_Int16)(UA_UInt16)q;
+            values[i] = c->offset + (UA_Double)integer * c->scale;
+        }
+    }
+
+    if(scalar) {
+        UA_Variant_setScalar(dst, values, doubleType);
+        return UA_STATUSCODE_GOOD;
+    }
+    UA_Variant_setArray(dst, values, length, doubleType);
+    return copyArrayDimensions(src, dst);
+}
+
+/**
+ * Properties
+ * ~~~~~~~~~~ */
+
+static UA_Boolean
+isCompressionKey(const UA_QualifiedName *key, size_t index) {
+    UA_String name = UA_STRING((char *)(uintptr_t)compressionKeys[index]);
+    return key->namespaceIndex == 0 && UA_String_equal(&key->name, &name);
+}
+
+static UA_Boolean
+isCompressionProperty(const UA_KeyValuePair *kv) {
+    for(size_t i = 0; i < UA_COMPRESSION_PROPERTIES; i++) {
+        if(isCompressionKey(&kv->key, i))
+            return true;
+    }
+    return false;
+}
+
+static UA_StatusCode
+setProperty(UA_KeyValuePair *kv, size_t index, const void *value, const UA_DataType *type) {
+    UA_QualifiedName key = UA_QUALIFIEDNAME(0, (char *)(uintptr_t)compressionKeys[index]);
+    UA_StatusCode rv = UA_QualifiedName_copy(&key, &kv->key);
+    if(rv != UA_STATUSCODE_GOOD)
+        return rv;
+    return UA_Variant_setScalarCopy(&kv->value, value, type);
+}
+
+UA_StatusCode
+UA_FieldCompression_setProperties(const UA_FieldCompression *c, size_t *propertiesSize,
+                                  UA_KeyValuePair **properties) {
+    size_t added = 0;
+    if(c && c->type != UA_FIELDCOMPRESSION_NONE) {
+        UA_StatusCode rv = UA_FieldCompression_check(c);
+        if(rv != UA_STATUSCODE_GOOD)
+            return rv;
+        added = UA_COMPRESSION_PROPERTIES;
+    }
+    size_t kept = 0;
+    for(size_t i = 0; i < *propertiesSize; i++) {
+        if(!isCompressionProperty(&(*properties)[i]))
+            kept++;
+    }
+
+    /* Set up the new properties first, so that nothing changes on failure */
+    UA_KeyValuePair *newProperties = NULL;
+    if(kept + added > 0) {
+        newProperties = (UA_KeyValuePair *)
+            UA_Array_new(kept + added, &UA_TYPES[UA_TYPES_KEYVALUEPAIR]);
+        if(!newProperties)
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+    }
+    if(added > 0) {
+        UA_KeyValuePair *kv = &newProperties[kept];
+        UA_String typeName = UA_STRING((char *)(uintptr_t)compressionTypeNames[c->type]);
+        UA_StatusCode rv = setProperty(&kv[0], 0, &typeName, &UA_TYPES[UA_TYPES_STRING]);
+        rv |= setProperty(&kv[1], 1, &c->scale, &UA_TYPES[UA_TYPES_DOUBLE]);
+        rv |= setProperty(&kv[2], 2, &c->offset, &UA_TYPES[UA_TYPES_DOUBLE]);
+        rv |= setProperty(&kv[3], 3, &c->deltaCoding, &UA_TYPES[UA_TYPES_BOOLEAN]);
+        if(rv != UA_STATUSCODE_GOOD) {
+            UA_Array_delete(newProperties, kept + added, &UA_TYPES[UA_TYPES_KEYVALUEPAIR]);
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+        }
+    }
+
+    /* Move the other properties over */
+    size_t j = 0;
+    for(size_t i = 0; i < *propertiesSize; i++) {
+        if(isCompressionProperty(&(*properties)[i]))
+            UA_KeyValuePair_deleteMembers(&(*properties)[i]);
+        else
+            newProperties[j++] = (*properties)[i];
+    }
+    if(*propertiesSize > 0)
+        UA_free(*properties);
+    *properties = newProperties;
+    *propertiesSize = kept + added;
+    return UA_STATUSCODE_GOOD;
+}
+
+UA_Boolean
+UA_FieldCompression_fromProperties(size_t propertiesSize, const UA_KeyValuePair *properties,
+                                   UA_FieldCompression *c) {
+    memset(c, 0, sizeof(UA_FieldCompression));
+    UA_Boolean hasType = false;
+    for(size_t i = 0; i < propertiesSize; i++) {
+        const UA_KeyValuePair *kv = &properties[i];
+        if(isCompressionKey(&kv->key, 0) &&
+           UA_Variant_hasScalarType(&kv->value, &UA_TYPES[UA_TYPES_STRING])) {
+            const UA_String *typeName = (const UA_String *)kv->value.data;
+            for(size_t t = UA_FIELDCOMPRESSION_FLOAT; t <= UA_FIELDCOMPRESSION_SCALEDINT32; t++) {
+                UA_String name = UA_STRING((char *)(uintptr_t)compressionTypeNames[t]);
+                if(UA_String_equal(typeName, &name)) {
+                    c->type = (UA_FieldCompressionType)t;
+                    hasType = true;
+                }
+            }
+        } else if(isCompressionKey(&kv->key, 1) &&
+                  UA_Variant_hasScalarType(&kv->value, &UA_TYPES[UA_TYPES_DOUBLE])) {
+            c->scale = *(const UA_Double *)kv->value.data;
+        } else if(isCompressionKey(&kv->key, 2) &&
+                  UA_Variant_hasScalarType(&kv->value, &UA_TYPES[UA_TYPES_DOUBLE])) {
+            c->offset = *(const UA_Double *)kv->value.data;
+        } else if(isCompressionKey(&kv->key, 3) &&
+                  UA_Variant_hasScalarType(&kv->value, &UA_TYPES[UA_TYPES_BOOLEAN])) {
+            c->deltaCoding = *(const UA_Boolean *)kv->value.data;
+        }
+    }
+    return hasType && UA_FieldCompression_check(c) == UA_STATUSCODE_GOOD;
+}
+
+/**
+ * Received Messages
+ * ~~~~~~~~~~~~~~~~~ */
+
+static UA_StatusCode
+expandDataValue(const UA_FieldCompression *c, UA_DataValue *value) {
+    if(c->type == UA_FIELDCOMPRESSION_NONE || !value->hasValue)
+        return UA_STATUSCODE_GOOD;
+    UA_Variant expanded;
+    UA_StatusCode rv = UA_FieldCompression_expand(c, &value->value, &expanded);
+    if(rv != UA_STATUSCODE_GOOD)
+        return rv;
+    UA_Variant_deleteMembers(&value->value);
+    value->value = expanded;
+    return UA_STATUSCODE_GOOD;
+}
+
+UA_StatusCode
+UA_DataSetMessage_expandFields(UA_DataSetMessage *dsm, size_t fieldsSize,
+                               const UA_FieldCompression *fields) {
+    UA_StatusCode rv = UA_STATUSCODE_GOOD;
+    if(dsm->header.dataSetMessageType == UA_DATASETMESSAGE_DATAKEYFRAME) {
+        UA_DataSetMessage_DataKeyFrameData *kf = &dsm->data.keyFrameData;
+        for(size_t i = 0; i < kf->fieldCount && i < fieldsSize && rv == UA_STATUSCODE_GOOD; i++)
+            rv = expandDataValue(&fields[i], &kf->dataSetFields[i]);
+    } else if(dsm->header.dataSetMessageType == UA_DATASETMESSAGE_DATADELTAFRAME) {
+        UA_DataSetMessage_DataDeltaFrameData *df = &dsm->data.deltaFrameData;
+        for(size_t i = 0; i < df->fieldCount && rv == UA_STATUSCODE_GOOD; i++) {
+            UA_DataSetMessage_DeltaFrameField *dff = &df->deltaFrameFields[i];
+            if(dff->fieldIndex < fieldsSize)
+                rv = expandDataValue(&fields[dff->fieldIndex], &dff->fieldValue);
+        }
+    }
+    return rv;
+}
+
+UA_StatusCode
+UA_NetworkMessage_expandFields(UA_NetworkMessage *nm, size_t compressionsSize,
+                               const UA_DataSetCompression *compressions) {
+    if(nm->networkMessageType != UA_NETWORKMESSAGE_DATASET || !nm->payloadHeaderEnabled)
+        return UA_STATUSCODE_GOOD;
+    const UA_DataSetPayloadHeader *ph = &nm->payloadHeader.dataSetPayloadHeader;
+    for(size_t i = 0; i < ph->count; i++) {
+        for(size_t j = 0; j < compressionsSize; j++) {
+            const UA_DataSetCompression *dc = &compressions[j];
+            if(dc->dataSetWriterId != ph->dataSetWriterIds[i])
+                continue;
+            UA_StatusCode rv =
+                UA_DataSetMessage_expandFields(&nm->payload.dataSetPayload.dataSetMessages[i],
+                                               dc->fieldsSize, dc->fields);
+            if(rv != UA_STATUSCODE_GOOD)
+                return rv;
+            break;
+        }
+    }
+    return UA_STATUSCODE_GOOD;
+}
+
+#endif /* UA_ENABLE_PUBSUB */
@@ -0,0 +1,118 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef UA_PUBSUB_COMPRESS_H_
+#define UA_PUBSUB_COMPRESS_H_
+
+#include <open62541/types.h>
+#include <open62541/types_generated.h>
+
+#include "ua_pubsub_networkmessage.h"
+
+_UA_BEGIN_DECLS
+
+#ifdef UA_ENABLE_PUBSUB /* conditional compilation */
+
+/**
+ * Field Compression
+ * -----------------
+ * Lossy encodings for Double and Float fields (scalars and arrays) that
+ * carry fewer bytes on the wire than the value:
+ *
+ * - ``UA_FIELDCOMPRESSION_FLOAT`` narrows the values to Float. The relative
+ *   error is at most 2^-24. Values beyond the range of Float become infinite.
+ * - ``UA_FIELDCOMPRESSION_SCALEDINT16`` and ``_SCALEDINT32`` send the integer
+ *   ``round((value - offset) / scale)``. The receiver computes
+ *   ``offset + integer * scale``. The error is at most ``scale / 2`` for values
+ *   in the range of the integer type. Values outside of it saturate, and NaN
+ *   becomes the offset.
+ *
+ * With ``deltaCoding``, an array of scaled integers is sent as the difference
+ * of each element to the one before. The first element is sent as its
+ * difference to zero, that is to the offset. The differences wrap around in
+ * the width of the integer type, so the integers are reconstructed exactly.
+ * The array is sent in the smallest integer type (SByte, Int16 or Int32) that
+ * holds all differences. Smooth signals then take one byte per element. The
+ * type of the Variant tells the receiver which one was used.
+ *
+ * The receiver needs the same settings to expand the values back to Double.
+ * The publisher writes them into the properties of the field metadata (keys
+ * ``CompressionType``, ``ScaleFactor``, ``Offset`` and ``DeltaCoding``
+ * in namespace 0), from where subscribers can take them. */
+
+typedef enum {
+    UA_FIELDCOMPRESSION_NONE = 0,
+    UA_FIELDCOMPRESSION_FLOAT = 1,
+    UA_FIELDCOMPRESSION_SCALEDINT16 = 2,
+    UA_FIELDCOMPRESSION_SCALEDINT32 = 3
+} UA_FieldCompressionType;
+
+typedef struct {
+    UA_FieldCompressionType type;
+    UA_Double scale;        /* > 0, for the scaled integers */
+    UA_Double offset;
+    UA_Boolean deltaCoding; /* for arrays of scaled integers */
+} UA_FieldCompression;
+
+/* Returns UA_STATUSCODE_BADINVALIDARGUMENT for invalid settings */
+UA_StatusCode UA_EXPORT
+UA_FieldCompression_check(const UA_FieldCompression *c);
+
+/* Encodes a Double or Float scalar or array into dst. dst is initialized
+ * first. Returns UA_STATUSCODE_BADTYPEMISMATCH for other values. */
+UA_StatusCode UA_EXPORT
+UA_FieldCompression_compress(const UA_FieldCompression *c, const UA_Variant *src,
+                             UA_Variant *dst);
+
+/* Decodes an encoded value into a Double scalar or array in dst. dst is
+ * initialized first. Returns UA_STATUSCODE_BADTYPEMISMATCH if the value is not
+ * encoded with the settings. */
+UA_StatusCode UA_EXPORT
+UA_FieldCompression_expand(const UA_FieldCompression *c, const UA_Variant *src,
+                           UA_Variant *dst);
+
+/* Replaces the compression properties in the array of properties (for
+ * example of a FieldMetaData). NULL or UA_FIELDCOMPRESSION_NONE removes
+ * them. */
+UA_StatusCode UA_EXPORT
+UA_FieldCompression_setProperties(const UA_FieldCompression *c, size_t *propertiesSize,
+                                  UA_KeyValuePair **properties);
+
+/* Reads the settings from the properties. Returns false if the properties do
+ * not contain a valid compression. */
+UA_Boolean UA_EXPORT
+UA_FieldCompression_fromProperties(size_t propertiesSize, const UA_KeyValuePair *properties,
+                                   UA_FieldCompression *c);
+
+/**
+ * Expanding Received Messages
+ * ~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ * The compression of the fields of one DataSetWriter. Fields without a
+ * compression have the type ``UA_FIELDCOMPRESSION_NONE``. */
+
+typedef struct {
+    UA_UInt16 dataSetWriterId;
+    size_t fieldsSize;
+    const UA_FieldCompression *fields;
+} UA_DataSetCompression;
+
+/* Expands the fields of a key frame or delta frame in place. Fields that are
+ * beyond fieldsSize or carry no value are left as they are. */
+UA_StatusCode UA_EXPORT
+UA_DataSetMessage_expandFields(UA_DataSetMessage *dsm, size_t fieldsSize,
+                               const UA_FieldCompression *fields);
+
+/* Expands the DataSetMessages of the DataSetWriters in compressions. Requires
+ * the payload header with the DataSetWriterIds; messages without it are left
+ * as they are. */
+UA_StatusCode UA_EXPORT
+UA_NetworkMessage_expandFields(UA_NetworkMessage *nm, size_t compressionsSize,
+                               const UA_DataSetCompression *compressions);
+
+#endif /* UA_ENABLE_PUBSUB */
+
+_UA_END_DECLS
+
+#endif /* UA_PUBSUB_COMPRESS_H_ */
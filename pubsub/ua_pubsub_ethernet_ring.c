@@ -0,0 +1,892 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <open62541/plugin/log_stdout.h>
+#include <open62541/server_config.h>
+
+#include "pubsub_ethernet_ring.h"
+#include "pubsub_channel_ext.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <net/if.h>
+#include <arpa/inet.h>
+#include <linux/if_ether.h>
+#include <linux/if_packet.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#ifdef UA_ENABLE_PUBSUB_ETH_XDP
+#include <xdp/xsk.h>
+#endif
+
+#define UA_ETHERTYPE_UADP 0xB62C
+#define UA_ETHERTYPE_VLAN 0x8100
+#define UA_ETH_HEADER_SIZE 14
+#define UA_ETH_VLAN_TAG_SIZE 4
+#define UA_ETH_MIN_FRAME 60
+
+#define UA_ETHRING_FRAME_SIZE 2048
+#define UA_ETHRING_BLOCK_SIZE (1 << 16)
+#define UA_ETHRING_DEFAULT_FRAMES 256
+#define UA_ETHRING_MIN_FRAMES (UA_ETHRING_BLOCK_SIZE / UA_ETHRING_FRAME_SIZE)
+
+typedef enum {
+    UA_ETHRING_MODE_MMAP,
+    UA_ETHRING_MODE_XDP
+} UA_EthernetRingMode;
+
+/* Ethernet channel data on shared rings */
+typedef struct {
+    UA_EthernetRingMode mode;
+    char ifName[IF_NAMESIZE];
+    int ifIndex;
+    UA_Byte srcAddress[ETH_ALEN];
+    UA_Byte dstAddress[ETH_ALEN];
+    UA_UInt16 vid;
+    UA_Byte prio;
+    UA_UInt32 frames;
+    UA_UInt64 txErrors;
+
+    /* PACKET_MMAP. The transmit socket is the channel socket. The receive
+     * socket and ring are set up in regist. */
+    UA_Byte *txMap;
+    UA_UInt32 txCursor;
+    UA_UInt32 txQueued;
+    UA_SOCKET rxSocket;
+    UA_Byte *rxMap;
+    UA_UInt32 rxBlocks;
+    UA_UInt32 rxBlock;
+    struct tpacket3_hdr *rxPacket; /* next packet in the current block */
+    UA_UInt32 rxRemaining;         /* packets left in the current block */
+
+#ifdef UA_ENABLE_PUBSUB_ETH_XDP
+    /* AF_XDP. The first half of the UMEM frames is used for reception, the
+     * second half for transmission. */
+    UA_UInt32 xdpQueue;
+    UA_Boolean xdpSkipProgLoad;
+    UA_Boolean xdpRegistered;
+    void *umemArea;
+    struct xsk_umem *umem;
+    struct xsk_socket *xsk;
+    struct xsk_ring_prod fill;
+    struct xsk_ring_cons comp;
+    struct xsk_ring_prod tx;
+    struct xsk_ring_cons rx;
+    UA_UInt64 *txFree;
+    UA_UInt32 txFreeCount;
+#endif
+} UA_PubSubChannelDataEthernetRing;
+
+static UA_Boolean
+isMulticastAddress(const UA_Byte *address) {
+    return (address[0] & 0x01) != 0;
+}
+
+static int
+hexValue(UA_Byte c) {
+    if(c >= '0' && c <= '9')
+        return c - '0';
+    if(c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if(c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+/* Parse opc.eth://<MAC>[:<VID>[.<PCP>]] */
+static UA_StatusCode
+parseEthernetUrl(const UA_String *url, UA_Byte *address, UA_UInt16 *vid, UA_Byte *prio) {
+    const char *prefix = "opc.eth://";
+    size_t pos = strlen(prefix);
+    if(url->length < pos + 17 || strncmp((const char*)url->data, prefix, pos) != 0)
+        return UA_STATUSCODE_BADINVALIDARGUMENT;
+    for(size_t i = 0; i < ETH_ALEN; i++) {
+        int hi = hexValue(url->data[pos]);
+        int lo = hexValue(url->data[pos + 1]);
+        if(hi < 0 || lo < 0)
+            return UA_STATUSCODE_BADINVALIDARGUMENT;
+        address[i] = (UA_Byte)((hi << 4) | lo);
+        pos += 2;
+        if(i < ETH_ALEN - 1) {
+            if(url->data[pos] != '-')
+                return UA_STATUSCODE_BADINVALIDARGUMENT;
+            pos++;
+        }
+    }
+
+    *vid = 0;
+    *prio = 0;
+    if(pos < url->length && url->data[pos] == ':') {
+        UA_UInt32 value = 0;
+        size_t start = ++pos;
+        while(pos < url->length && url->data[pos] >= '0' && url->data[pos] <= '9')
+            value = value * 10 + (UA_UInt32)(url->data[pos++] - '0');
+        if(pos == start || value == 0 || value > 4094)
+            return UA_STATUSCODE_BADINVALIDARGUMENT;
+        *vid = (UA_UInt16)value;
+        if(pos < url->length && url->data[pos] == '.') {
+            pos++;
+            if(pos >= url->length || url->data[pos] < '0' || url->data[pos] > '7')
+                return UA_STATUSCODE_BADINVALIDARGUMENT;
+            *prio = (UA_Byte)(url->data[pos++] - '0');
+        }
+    }
+    if(pos < url->length && url->data[pos] != '/')
+        return UA_STATUSCODE_BADINVALIDARGUMENT;
+    return UA_STATUSCODE_GOOD;
+}
+
+/* Write the Ethernet header and the payload to the frame. Returns the frame
+ * length including the padding to the minimum frame size. */
+static size_t
+writeFrame(const UA_PubSubChannelDataEthernetRing *channelData,
+           UA_Byte *frame, const UA_ByteString *payload) {
+    size_t pos = 0;
+    memcpy(&frame[pos], channelData->dstAddress, ETH_ALEN);
+    pos += ETH_ALEN;
+    memcpy(&frame[pos], channelData->srcAddress, ETH_ALEN);
+    pos += ETH_ALEN;
+    if(channelData->vid > 0) {
+        UA_UInt16 tci = (UA_UInt16)((channelData->prio << 13) | channelData->vid);
+        frame[pos++] = (UA_Byte)(UA_ETHERTYPE_VLAN >> 8);
+        frame[pos++] = (UA_Byte)(UA_ETHERTYPE_VLAN & 0xFF);
+        frame[pos++] = (UA_Byte)(tci >> 8);
+        frame[pos++] = (UA_Byte)(tci & 0xFF);
+    }
+    frame[pos++] = (UA_Byte)(UA_ETHERTYPE_UADP >> 8);
+    frame[pos++] = (UA_Byte)(UA_ETHERTYPE_UADP & 0xFF);
+    memcpy(&frame[pos], payload->data, payload->length);
+    pos += payload->length;
+    if(pos < UA_ETH_MIN_FRAME) {
+        memset(&frame[pos], 0, UA_ETH_MIN_FRAME - pos);
+        pos = UA_ETH_MIN_FRAME;
+    }
+    return pos;
+}
+
+/* Copy the payload of a received UADP frame into the message. Frames of other
+ * EtherTypes are skipped. */
+static UA_Boolean
+readFrame(const UA_Byte *frame, size_t length, UA_ByteString *message) {
+    if(length < UA_ETH_HEADER_SIZE)
+        return false;
+    size_t pos = 2 * ETH_ALEN;
+    UA_UInt16 etherType = (UA_UInt16)((frame[pos] << 8) | frame[pos + 1]);
+    if(etherType == UA_ETHERTYPE_VLAN) {
+        pos += UA_ETH_VLAN_TAG_SIZE;
+        if(length < pos + 2)
+            return false;
+        etherType = (UA_UInt16)((frame[pos] << 8) | frame[pos + 1]);
+    }
+    if(etherType != UA_ETHERTYPE_UADP)
+        return false;
+    pos += 2;
+    size_t payloadLength = length - pos;
+    if(payloadLength > message->length) {
+        UA_LOG_WARNING(UA_Log_Stdout, UA_LOGCATEGORY_SERVER,
+                       "PubSub Ethernet: Message truncated to the receive buffer");
+        payloadLength = message->length;
+    }
+    memcpy(message->data, &frame[pos], payloadLength);
+    message->length = payloadLength;
+    return true;
+}
+
+static UA_Boolean
+waitReadable(UA_SOCKET sockfd, UA_UInt32 timeout) {
+    struct pollfd pfd;
+    pfd.fd = sockfd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    return poll(&pfd, 1, (int)((timeout + 999) / 1000)) > 0;
+}
+
+static void
+parseConnectionProperties(const UA_PubSubConnectionConfig *connectionConfig,
+                          UA_PubSubChannelDataEthernetRing *channelData) {
+    UA_String modeParam = UA_STRING("mode"), framesParam = UA_STRING("frames"),
+        queueParam = UA_STRING("xdpQueue"), skipParam = UA_STRING("xdpSkipProgLoad");
+    UA_String xdpMode = UA_STRING("xdp");
+    for(size_t i = 0; i < connectionConfig->connectionPropertiesSize; i++) {
+        const UA_KeyValuePair *property = &connectionConfig->connectionProperties[i];
+        if(UA_String_equal(&property->key.name, &modeParam)) {
+            if(UA_Variant_hasScalarType(&property->value, &UA_TYPES[UA_TYPES_STRING]) &&
+               UA_String_equal((UA_String *) property->value.data, &xdpMode))
+                channelData->mode = UA_ETHRING_MODE_XDP;
+        } else if(UA_String_equal(&property->key.name, &framesParam)) {
+            if(UA_Variant_hasScalarType(&property->value, &UA_TYPES[UA_TYPES_UINT32]))
+                channelData->frames = *(UA_UInt32 *) property->value.data;
+#ifdef UA_ENABLE_PUBSUB_ETH_XDP
+        } else if(UA_String_equal(&property->key.name, &queueParam)) {
+            if(UA_Variant_hasScalarType(&property->value, &UA_TYPES[UA_TYPES_UINT32]))
+                channelData->xdpQueue = *(UA_UInt32 *) property->value.data;
+        } else if(UA_String_equal(&property->key.name, &skipParam)) {
+            if(UA_Variant_hasScalarType(&property->value, &UA_TYPES[UA_TYPES_BOOLEAN]))
+                channelData->xdpSkipProgLoad = *(UA_Boolean *) property->value.data;
+#else
+        } else if(UA_String_equal(&property->key.name, &queueParam) ||
+                  UA_String_equal(&property->key.name, &skipParam)) {
+            /* Ignored without AF_XDP support */
+#endif
+        } else {
+            UA_LOG_WARNING(UA_Log_Stdout, UA_LOGCATEGORY_SERVER,
+                           "PubSub Connection creation. Unknown connection parameter.");
+        }
+    }
+}
+
+/*****************/
+/* PACKET_MMAP   */
+/*****************/
+
+static UA_StatusCode
+setupPacketRing(UA_SOCKET sockfd, int ringType, UA_UInt32 frames, UA_Byte **map) {
+    int version = TPACKET_V3;
+    if(setsockopt(sockfd, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) < 0)
+        return UA_STATUSCODE_BADINTERNALERROR;
+
+    struct tpacket_req3 req;
+    memset(&req, 0, sizeof(req));
+    req.tp_block_size = UA_ETHRING_BLOCK_SIZE;
+    req.tp_frame_size = UA_ETHRING_FRAME_SIZE;
+    req.tp_frame_nr = frames;
+    req.tp_block_nr = frames / UA_ETHRING_MIN_FRAMES;
+    if(ringType == PACKET_RX_RING)
+        req.tp_retire_blk_tov = 1; /* hand partly filled blocks over after 1ms */
+    if(setsockopt(sockfd, SOL_PACKET, ringType, &req, sizeof(req)) < 0)
+        return UA_STATUSCODE_BADINTERNALERROR;
+
+    size_t mapSize = (size_t)req.tp_block_size * req.tp_block_nr;
+    void *m = mmap(NULL, mapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, sockfd, 0);
+    if(m == MAP_FAILED)
+        return UA_STATUSCODE_BADINTERNALERROR;
+    *map = (UA_Byte *)m;
+    return UA_STATUSCODE_GOOD;
+}
+
+static UA_StatusCode
+bindPacketSocket(UA_SOCKET sockfd, int ifIndex, UA_UInt16 protocol) {
+    struct sockaddr_ll sll;
+    memset(&sll, 0, sizeof(sll));
+    sll.sll_family = AF_PACKET;
+    sll.sll_protocol = htons(protocol);
+    sll.sll_ifindex = ifIndex;
+    if(bind(sockfd, (struct sockaddr*)&sll, sizeof(sll)) < 0)
+        return UA_STATUSCODE_BADINTERNALERROR;
+    return UA_STATUSCODE_GOOD;
+}
+
+static UA_StatusCode
+UA_EthernetRing_openMmap(UA_PubSubChannel *channel) {
+    UA_PubSubChannelDataEthernetRing *channelData =
+        (UA_PubSubChannelDataEthernetRing *) channel->handle;
+    /* Protocol 0: the transmit socket receives no frames */
+    channel->sockfd = socket(AF_PACKET, SOCK_RAW, 0);
+    if(channel->sockfd < 0)
+        return UA_STATUSCODE_BADINTERNALERROR;
+    UA_StatusCode retval =
+        setupPacketRing(channel->sockfd, PACKET_TX_RING, channelData->frames, &channelData->txMap);
+    if(retval == UA_STATUSCODE_GOOD)
+        retval = bindPacketSocket(channel->sockfd, channelData->ifIndex, 0);
+    return retval;
+}
+
+/* Trigger the transmission of all frames marked with TP_STATUS_SEND_REQUEST */
+static UA_StatusCode
+UA_EthernetRing_flushMmap(UA_PubSubChannel *channel, UA_Boolean wait) {
+    UA_PubSubChannelDataEthernetRing *channelData =
+        (UA_PubSubChannelDataEthernetRing *) channel->handle;
+    if(channelData->txQueued == 0)
+        return UA_STATUSCODE_GOOD;
+    if(send(channel->sockfd, NULL, 0, wait ? 0 : MSG_DONTWAIT) < 0 &&
+       errno != EAGAIN && errno != EWOULDBLOCK)
+        return UA_STATUSCODE_BADINTERNALERROR;
+    channelData->txQueued = 0;
+    return UA_STATUSCODE_GOOD;
+}
+
+static UA_StatusCode
+UA_EthernetRing_sendMmap(UA_PubSubChannel *channel, const UA_ByteString *buf,
+                         UA_Boolean block) {
+    UA_PubSubChannelDataEthernetRing *channelData =
+        (UA_PubSubChannelDataEthernetRing *) channel->handle;
+    UA_Byte *frame = &channelData->txMap[(size_t)channelData->txCursor * UA_ETHRING_FRAME_SIZE];
+    struct tpacket3_hdr *hdr = (struct tpacket3_hdr *)frame;
+    volatile UA_UInt32 *status = &hdr->tp_status;
+
+    /* The ring is full. Send the queued frames and wait for the slot. */
+    if(*status != TP_STATUS_AVAILABLE) {
+        if(UA_EthernetRing_flushMmap(channel, block) != UA_STATUSCODE_GOOD)
+            return UA_STATUSCODE_BADINTERNALERROR;
+        if(*status == TP_STATUS_WRONG_FORMAT)
+            channelData->txErrors++;
+        else if(*status != TP_STATUS_AVAILABLE)
+            return block ? UA_STATUSCODE_BADINTERNALERROR : UA_STATUSCODE_BADWOULDBLOCK;
+    }
+
+    UA_Byte *data = frame + TPACKET3_HDRLEN - sizeof(struct sockaddr_ll);
+    hdr->tp_len = (UA_UInt32)writeFrame(channelData, data, buf);
+    hdr->tp_next_offset = 0;
+    __sync_synchronize();
+    *status = TP_STATUS_SEND_REQUEST;
+    channelData->txCursor = (channelData->txCursor + 1) % channelData->frames;
+    channelData->txQueued++;
+    return UA_STATUSCODE_GOOD;
+}
+
+static UA_StatusCode
+UA_EthernetRing_registMmap(UA_PubSubChannel *channel) {
+    UA_PubSubChannelDataEthernetRing *channelData =
+        (UA_PubSubChannelDataEthernetRing *) channel->handle;
+    channelData->rxSocket = socket(AF_PACKET, SOCK_RAW, htons(UA_ETHERTYPE_UADP));
+    if(channelData->rxSocket < 0)
+        return UA_STATUSCODE_BADINTERNALERROR;
+    UA_StatusCode retval = setupPacketRing(channelData->rxSocket, PACKET_RX_RING,
+                                           channelData->frames, &channelData->rxMap);
+    if(retval == UA_STATUSCODE_GOOD)
+        retval = bindPacketSocket(channelData->rxSocket, channelData->ifIndex, UA_ETHERTYPE_UADP);
+    if(retval == UA_STATUSCODE_GOOD && isMulticastAddress(channelData->dstAddress)) {
+        struct packet_mreq mreq;
+        memset(&mreq, 0, sizeof(mreq));
+        mreq.mr_ifindex = channelData->ifIndex;
+        mreq.mr_type = PACKET_MR_MULTICAST;
+        mreq.mr_alen = ETH_ALEN;
+        memcpy(mreq.mr_address, channelData->dstAddress, ETH_ALEN);
+        if(setsockopt(channelData->rxSocket, SOL_PACKET, PACKET_ADD_MEMBERSHIP,
+                      &mreq, sizeof(mreq)) < 0)
+            retval = UA_STATUSCODE_BADINTERNALERROR;
+    }
+    if(retval != UA_STATUSCODE_GOOD) {
+        if(channelData->rxMap)
+            munmap(channelData->rxMap, (size_t)channelData->frames * UA_ETHRING_FRAME_SIZE);
+        close(channelData->rxSocket);
+        channelData->rxMap = NULL;
+        channelData->rxSocket = -1;
+        return retval;
+    }
+    channelData->rxBlocks = channelData->frames / UA_ETHRING_MIN_FRAMES;
+    channelData->rxBlock = 0;
+    channelData->rxPacket = NULL;
+    channelData->rxRemaining = 0;
+    return UA_STATUSCODE_GOOD;
+}
+
+static void
+UA_EthernetRing_unregistMmap(UA_PubSubChannelDataEthernetRing *channelData) {
+    if(channelData->rxSocket < 0)
+        return;
+    munmap(channelData->rxMap, (size_t)channelData->frames * UA_ETHRING_FRAME_SIZE);
+    close(channelData->rxSocket); /* also drops the membership */
+    channelData->rxMap = NULL;
+    channelData->rxSocket = -1;
+}
+
+/* Walk the packets of the retired blocks. A block is returned to the kernel
+ * once its last packet has been copied out. */
+static UA_StatusCode
+UA_EthernetRing_receiveMmap(UA_PubSubChannel *channel, UA_ByteString *message,
+                            UA_UInt32 timeout) {
+    UA_PubSubChannelDataEthernetRing *channelData =
+        (UA_PubSubChannelDataEthernetRing *) channel->handle;
+    if(channelData->rxSocket < 0) {
+        message->length = 0;
+        return UA_STATUSCODE_BADINTERNALERROR;
+    }
+
+    size_t bufferSize = message->length;
+    UA_Boolean waited = false;
+    while(true) {
+        struct tpacket_block_desc *block = (struct tpacket_block_desc *)
+            &channelData->rxMap[(size_t)channelData->rxBlock * UA_ETHRING_BLOCK_SIZE];
+        if(!channelData->rxPacket) {
+            if(!(block->hdr.bh1.block_status & TP_STATUS_USER)) {
+                if(waited || timeout == 0 || !waitReadable(channelData->rxSocket, timeout)) {
+                    message->length = 0;
+                    return UA_STATUSCODE_GOODNONCRITICALTIMEOUT;
+                }
+                waited = true;
+                continue;
+            }
+            __sync_synchronize();
+            channelData->rxPacket = (struct tpacket3_hdr *)
+                ((UA_Byte *)block + block->hdr.bh1.offset_to_first_pkt);
+            channelData->rxRemaining = block->hdr.bh1.num_pkts;
+        }
+
+        UA_Boolean found = false;
+        if(channelData->rxRemaining > 0) {
+            struct tpacket3_hdr *packet = channelData->rxPacket;
+            message->length = bufferSize;
+            found = readFrame((UA_Byte *)packet + packet->tp_mac, packet->tp_snaplen, message);
+            channelData->rxPacket = (struct tpacket3_hdr *)
+                ((UA_Byte *)packet + packet->tp_next_offset);
+            channelData->rxRemaining--;
+        }
+
+        if(channelData->rxRemaining == 0) {
+            block->hdr.bh1.block_status = TP_STATUS_KERNEL;
+            __sync_synchronize();
+            channelData->rxBlock = (channelData->rxBlock + 1) % channelData->rxBlocks;
+            channelData->rxPacket = NULL;
+        }
+        if(found)
+            return UA_STATUSCODE_GOOD;
+    }
+}
+
+/*****************/
+/* AF_XDP        */
+/*****************/
+
+#ifdef UA_ENABLE_PUBSUB_ETH_XDP
+
+static UA_StatusCode
+UA_EthernetRing_openXdp(UA_PubSubChannel *channel) {
+    UA_PubSubChannelDataEthernetRing *channelData =
+        (UA_PubSubChannelDataEthernetRing *) channel->handle;
+    size_t areaSize = (size_t)channelData->frames * 2 * UA_ETHRING_FRAME_SIZE;
+    if(posix_memalign(&channelData->umemArea, (size_t)sysconf(_SC_PAGESIZE), areaSize) != 0)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    channelData->txFree = (UA_UInt64 *) UA_calloc(channelData->frames, sizeof(UA_UInt64));
+    if(!channelData->txFree)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+
+    struct xsk_umem_config umemConfig;
+    memset(&umemConfig, 0, sizeof(umemConfig));
+    umemConfig.fill_size = channelData->frames;
+    umemConfig.comp_size = channelData->frames;
+    umemConfig.frame_size = UA_ETHRING_FRAME_SIZE;
+    if(xsk_umem__create(&channelData->umem, channelData->umemArea, areaSize,
+                        &channelData->fill, &channelData->comp, &umemConfig) != 0)
+        return UA_STATUSCODE_BADINTERNALERROR;
+
+    struct xsk_socket_config socketConfig;
+    memset(&socketConfig, 0, sizeof(socketConfig));
+    socketConfig.rx_size = channelData->frames;
+    socketConfig.tx_size = channelData->frames;
+    if(channelData->xdpSkipProgLoad)
+        socketConfig.libxdp_flags = XSK_LIBXDP_FLAGS__INHIBIT_PROG_LOAD;
+    if(xsk_socket__create(&channelData->xsk, channelData->ifName, channelData->xdpQueue,
+                          channelData->umem, &channelData->rx, &channelData->tx,
+                          &socketConfig) != 0)
+        return UA_STATUSCODE_BADINTERNALERROR;
+    channel->sockfd = xsk_socket__fd(channelData->xsk);
+
+    /* Transmit frames follow the receive frames */
+    for(UA_UInt32 i = 0; i < channelData->frames; i++)
+        channelData->txFree[i] = (UA_UInt64)(channelData->frames + i) * UA_ETHRING_FRAME_SIZE;
+    channelData->txFreeCount = channelData->frames;
+    return UA_STATUSCODE_GOOD;
+}
+
+/* Receive frames are only handed to the kernel once a subscriber registers.
+ * Before that, the socket drops all frames on the queue. */
+static UA_StatusCode
+UA_EthernetRing_registXdp(UA_PubSubChannelDataEthernetRing *channelData) {
+    UA_UInt32 idx;
+    if(xsk_ring_prod__reserve(&channelData->fill, channelData->frames, &idx) != channelData->frames)
+        return UA_STATUSCODE_BADINTERNALERROR;
+    for(UA_UInt32 i = 0; i < channelData->frames; i++)
+        *xsk_ring_prod__fill_addr(&channelData->fill, idx++) = (UA_UInt64)i * UA_ETHRING_FRAME_SIZE;
+    xsk_ring_prod__submit(&channelData->fill, channelData->frames);
+    channelData->xdpRegistered = true;
+    return UA_STATUSCODE_GOOD;
+}
+
+static void
+UA_EthernetRing_reapXdp(UA_PubSubChannelDataEthernetRing *channelData) {
+    UA_UInt32 idx;
+    UA_UInt32 completed = xsk_ring_cons__peek(&channelData->comp, channelData->frames, &idx);
+    for(UA_UInt32 i = 0; i < completed; i++)
+        channelData->txFree[channelData->txFreeCount++] =
+            *xsk_ring_cons__comp_addr(&channelData->comp, idx++);
+    xsk_ring_cons__release(&channelData->comp, completed);
+}
+
+static UA_StatusCode
+UA_EthernetRing_flushXdp(UA_PubSubChannel *channel) {
+    UA_PubSubChannelDataEthernetRing *channelData =
+        (UA_PubSubChannelDataEthernetRing *) channel->handle;
+    if(channelData->txQueued == 0)
+        return UA_STATUSCODE_GOOD;
+    if(sendto(channel->sockfd, NULL, 0, MSG_DONTWAIT, NULL, 0) < 0 &&
+       errno != EAGAIN && errno != EBUSY && errno != ENOBUFS)
+        return UA_STATUSCODE_BADINTERNALERROR;
+    channelData->txQueued = 0;
+    return UA_STATUSCODE_GOOD;
+}
+
+static UA_StatusCode
+UA_EthernetRing_sendXdp(UA_PubSubChannel *channel, const UA_ByteString *buf) {
+    UA_PubSubChannelDataEthernetRing *channelData =
+        (UA_PubSubChannelDataEthernetRing *) channel->handle;
+    UA_EthernetRing_reapXdp(channelData);
+    if(channelData->txFreeCount == 0) {
+        /* All frames are in flight. Kick the queue and take what completed. */
+        UA_EthernetRing_flushXdp(channel);
+        UA_EthernetRing_reapXdp(channelData);
+        if(channelData->txFreeCount == 0)
+            return UA_STATUSCODE_BADRESOURCEUNAVAILABLE;
+    }
+
+    UA_UInt32 idx;
+    if(xsk_ring_prod__reserve(&channelData->tx, 1, &idx) != 1)
+        return UA_STATUSCODE_BADRESOURCEUNAVAILABLE;
+    UA_UInt64 addr = channelData->txFree[--channelData->txFreeCount];
+    UA_Byte *frame = (UA_Byte *)xsk_umem__get_data(channelData->umemArea, addr);
+    struct xdp_desc *desc = xsk_ring_prod__tx_desc(&channelData->tx, idx);
+    desc->addr = addr;
+    desc->len = (UA_UInt32)writeFrame(channelData, frame, buf);
+    xsk_ring_prod__submit(&channelData->tx, 1);
+    channelData->txQueued++;
+    return UA_STATUSCODE_GOOD;
+}
+
+static UA_StatusCode
+UA_EthernetRing_receiveXdp(UA_PubSubChannel *channel, UA_ByteString *message,
+                           UA_UInt32 timeout) {
+    UA_PubSubChannelDataEthernetRing *channelData =
+        (UA_PubSubChannelDataEthernetRing *) channel->handle;
+    if(!channelData->xdpRegistered) {
+        message->length = 0;
+        return UA_STATUSCODE_BADINTERNALERROR;
+    }
+
+    size_t bufferSize = message->length;
+    UA_Boolean waited = false;
+    while(true) {
+        UA_UInt32 idx;
+        if(xsk_ring_cons__peek(&channelData->rx, 1, &idx) == 0) {
+            if(xsk_ring_prod__needs_wakeup(&channelData->fill))
+                recvfrom(channel->sockfd, NULL, 0, MSG_DONTWAIT, NULL, NULL);
+            if(waited || timeout == 0 || !waitReadable(channel->sockfd, timeout)) {
+                message->length = 0;
+                return UA_STATUSCODE_GOODNONCRITICALTIMEOUT;
+            }
+            waited = true;
+            continue;
+        }
+
+        const struct xdp_desc *desc = xsk_ring_cons__rx_desc(&channelData->rx, idx);
+        UA_UInt64 addr = desc->addr;
+        message->length = bufferSize;
+        UA_Boolean found = readFrame((const UA_Byte *)
+                                     xsk_umem__get_data(channelData->umemArea, addr),
+                                     desc->len, message);
+        xsk_ring_cons__release(&channelData->rx, 1);
+
+        /* Give the frame back to the fill ring */
+        UA_UInt32 fillIdx;
+        if(xsk_ring_prod__reserve(&channelData->fill, 1, &fillIdx) == 1) {
+            *xsk_ring_prod__fill_addr(&channelData->fill, fillIdx) =
+                addr - (addr % UA_ETHRING_FRAME_SIZE);
+            xsk_ring_prod__submit(&channelData->fill, 1);
+        }
+        if(found)
+            return UA_STATUSCODE_GOOD;
+    }
+}
+
+static void
+UA_EthernetRing_closeXdp(UA_PubSubChannelDataEthernetRing *channelData) {
+    if(channelData->xsk)
+        xsk_socket__delete(channelData->xsk);
+    if(channelData->umem)
+        xsk_umem__delete(channelData->umem);
+    free(channelData->umemArea);
+    UA_free(channelData->txFree);
+}
+
+#endif /* UA_ENABLE_PUBSUB_ETH_XDP */
+
+/*****************/
+/* Channel       */
+/*****************/
+
+static UA_StatusCode
+UA_PubSubChannelEthernetRing_close(UA_PubSubChannel *channel);
+
+static UA_PubSubChannel *
+UA_PubSubChannelEthernetRing_open(const UA_PubSubConnectionConfig *connectionConfig) {
+    if(!UA_Variant_hasScalarType(&connectionConfig->address,
+                                 &UA_TYPES[UA_TYPES_NETWORKADDRESSURLDATATYPE])) {
+        UA_LOG_ERROR(UA_Log_Stdout, UA_LOGCATEGORY_SERVER,
+                     "PubSub Connection creation failed. Invalid Address.");
+        return NULL;
+    }
+    UA_NetworkAddressUrlDataType *address =
+        (UA_NetworkAddressUrlDataType *)connectionConfig->address.data;
+
+    UA_PubSubChannelDataEthernetRing *channelData = (UA_PubSubChannelDataEthernetRing *)
+        UA_calloc(1, sizeof(UA_PubSubChannelDataEthernetRing));
+    UA_PubSubChannel *newChannel = (UA_PubSubChannel *) UA_calloc(1, sizeof(UA_PubSubChannel));
+    if(!channelData || !newChannel) {
+        UA_LOG_ERROR(UA_Log_Stdout, UA_LOGCATEGORY_SERVER,
+                     "PubSub Connection creation failed. Out of memory.");
+        UA_free(channelData);
+        UA_free(newChannel);
+        return NULL;
+    }
+    newChannel->handle = channelData;
+    newChannel->sockfd = -1;
+    channelData->rxSocket = -1;
+    channelData->frames = UA_ETHRING_DEFAULT_FRAMES;
+
+    if(parseEthernetUrl(&address->url, channelData->dstAddress,
+                        &channelData->vid, &channelData->prio) != UA_STATUSCODE_GOOD) {
+        UA_LOG_ERROR(UA_Log_Stdout, UA_LOGCATEGORY_SERVER,
+                     "PubSub Connection creation failed. Invalid URL.");
+        UA_PubSubChannelEthernetRing_close(newChannel);
+        return NULL;
+    }
+    parseConnectionProperties(connectionConfig, channelData);
+    if(channelData->frames < UA_ETHRING_MIN_FRAMES ||
+       (channelData->frames & (channelData->frames - 1)) != 0) {
+        UA_LOG_ERROR(UA_Log_Stdout, UA_LOGCATEGORY_SERVER,
+                     "PubSub Connection creation failed. Invalid number of frames.");
+        UA_PubSubChannelEthernetRing_close(newChannel);
+        return NULL;
+    }
+#ifndef UA_ENABLE_PUBSUB_ETH_XDP
+    if(channelData->mode == UA_ETHRING_MODE_XDP) {
+        UA_LOG_ERROR(UA_Log_Stdout, UA_LOGCATEGORY_SERVER,
+                     "PubSub Connection creation failed. AF_XDP support is not enabled.");
+        UA_PubSubChannelEthernetRing_close(newChannel);
+        return NULL;
+    }
+#endif
+
+    /* Look up the interface index and the source address */
+    if(address->networkInterface.length == 0 ||
+       address->networkInterface.length >= IF_NAMESIZE) {
+        UA_LOG_ERROR(UA_Log_Stdout, UA_LOGCATEGORY_SERVER,
+                     "PubSub Connection creation failed. Invalid interface.");
+        UA_PubSubChannelEthernetRing_close(newChannel);
+        return NULL;
+    }
+    memcpy(channelData->ifName, address->networkInterface.data, address->networkInterface.length);
+    channelData->ifName[address->networkInterface.length] = '\0';
+    channelData->ifIndex = (int)if_nametoindex(channelData->ifName);
+    struct ifreq ifreq;
+    memset(&ifreq, 0, sizeof(ifreq));
+    memcpy(ifreq.ifr_name, channelData->ifName, IF_NAMESIZE);
+    int ioctlSocket = socket(AF_INET, SOCK_DGRAM, 0);
+    int res = (ioctlSocket >= 0) ? ioctl(ioctlSocket, SIOCGIFHWADDR, &ifreq) : -1;
+    if(ioctlSocket >= 0)
+        close(ioctlSocket);
+    if(channelData->ifIndex == 0 || res < 0) {
+        UA_LOG_ERROR(UA_Log_Stdout, UA_LOGCATEGORY_SERVER,
+                     "PubSub Connection creation failed. Unknown interface.");
+        UA_PubSubChannelEthernetRing_close(newChannel);
+        return NULL;
+    }
+    memcpy(channelData->srcAddress, ifreq.ifr_hwaddr.sa_data, ETH_ALEN);
+
+    UA_StatusCode retval = UA_STATUSCODE_GOOD;
+#ifdef UA_ENABLE_PUBSUB_ETH_XDP
+    if(channelData->mode == UA_ETHRING_MODE_XDP)
+        retval = UA_EthernetRing_openXdp(newChannel);
+    else
+#endif
+        retval = UA_EthernetRing_openMmap(newChannel);
+    if(retval != UA_STATUSCODE_GOOD) {
+        UA_LOG_ERROR(UA_Log_Stdout, UA_LOGCATEGORY_SERVER,
+                     "PubSub Connection creation failed. Cannot set up the transmit ring: %s",
+                     strerror(errno));
+        UA_PubSubChannelEthernetRing_close(newChannel);
+        return NULL;
+    }
+    newChannel->state = UA_PUBSUB_CHANNEL_RDY;
+    return newChannel;
+}
+
+/* Without block, a full ring returns UA_STATUSCODE_BADWOULDBLOCK instead of
+ * waiting for a free frame */
+static UA_StatusCode
+UA_PubSubChannelEthernetRing_sendMessage(UA_PubSubChannel *channel, const UA_ByteString *buf,
+                                         UA_Boolean block) {
+    UA_PubSubChannelDataEthernetRing *channelData =
+        (UA_PubSubChannelDataEthernetRing *) channel->handle;
+    size_t headerSize = UA_ETH_HEADER_SIZE + (channelData->vid > 0 ? UA_ETH_VLAN_TAG_SIZE : 0);
+    if(buf->length + headerSize + TPACKET3_HDRLEN > UA_ETHRING_FRAME_SIZE) {
+        UA_LOG_ERROR(UA_Log_Stdout, UA_LOGCATEGORY_SERVER,
+                     "PubSub Connection sending failed. Message does not fit into a frame.");
+        return UA_STATUSCODE_BADINTERNALERROR;
+    }
+    UA_StatusCode retval;
+#ifdef UA_ENABLE_PUBSUB_ETH_XDP
+    if(channelData->mode == UA_ETHRING_MODE_XDP) {
+        retval = UA_EthernetRing_sendXdp(channel, buf);
+        if(!block && retval == UA_STATUSCODE_BADRESOURCEUNAVAILABLE)
+            return UA_STATUSCODE_BADWOULDBLOCK;
+    } else
+#endif
+        retval = UA_EthernetRing_sendMmap(channel, buf, block);
+    if(retval != UA_STATUSCODE_GOOD && retval != UA_STATUSCODE_BADWOULDBLOCK)
+        UA_LOG_ERROR(UA_Log_Stdout, UA_LOGCATEGORY_SERVER,
+                     "PubSub Connection sending failed.");
+    return retval;
+}
+
+static UA_StatusCode
+UA_PubSubChannelEthernetRing_send(UA_PubSubChannel *channel, UA_ExtensionObject *transportSettings,
+                                  const UA_ByteString *buf) {
+    return UA_PubSubChannelEthernetRing_sendMessage(channel, buf, true);
+}
+
+static UA_StatusCode
+UA_PubSubChannelEthernetRing_sendNonBlocking(UA_PubSubChannel *channel,
+                                             UA_ExtensionObject *transportSettings,
+                                             const UA_ByteString *buf) {
+    return UA_PubSubChannelEthernetRing_sendMessage(channel, buf, false);
+}
+
+/* Hand the frames queued in this publish cycle to the kernel */
+static UA_StatusCode
+UA_PubSubChannelEthernetRing_yield(UA_PubSubChannel *channel, UA_UInt16 timeout) {
+    UA_PubSubChannelDataEthernetRing *channelData =
+        (UA_PubSubChannelDataEthernetRing *) channel->handle;
+    UA_StatusCode retval;
+#ifdef UA_ENABLE_PUBSUB_ETH_XDP
+    if(channelData->mode == UA_ETHRING_MODE_XDP)
+        retval = UA_EthernetRing_flushXdp(channel);
+    else
+#endif
+        retval = UA_EthernetRing_flushMmap(channel, false);
+    if(channelData->txErrors > 0) {
+        UA_LOG_WARNING(UA_Log_Stdout, UA_LOGCATEGORY_SERVER,
+                       "PubSub Ethernet: %lu frames were rejected by the kernel",
+                       (unsigned long)channelData->txErrors);
+        channelData->txErrors = 0;
+    }
+    return retval;
+}
+
+static UA_StatusCode
+UA_PubSubChannelEthernetRing_regist(UA_PubSubChannel *channel, UA_ExtensionObject *transportSettings,
+                                    void (*callback)(UA_ByteString *encodedBuffer, UA_ByteString *topic)) {
+    UA_PubSubChannelDataEthernetRing *channelData =
+        (UA_PubSubChannelDataEthernetRing *) channel->handle;
+    UA_StatusCode retval;
+#ifdef UA_ENABLE_PUBSUB_ETH_XDP
+    if(channelData->mode == UA_ETHRING_MODE_XDP) {
+        if(channelData->xdpRegistered)
+            return UA_STATUSCODE_GOOD;
+        retval = UA_EthernetRing_registXdp(channelData);
+    } else
+#endif
+    {
+        if(channelData->rxSocket >= 0)
+            return UA_STATUSCODE_GOOD;
+        retval = UA_EthernetRing_registMmap(channel);
+    }
+    if(retval != UA_STATUSCODE_GOOD) {
+        UA_LOG_ERROR(UA_Log_Stdout, UA_LOGCATEGORY_SERVER,
+                     "PubSub Connection regist failed. Cannot set up the receive ring.");
+        return retval;
+    }
+    channel->state = UA_PUBSUB_CHANNEL_PUB_SUB;
+    return UA_STATUSCODE_GOOD;
+}
+
+static UA_StatusCode
+UA_PubSubChannelEthernetRing_unregist(UA_PubSubChannel *channel, UA_ExtensionObject *transportSettings) {
+    UA_PubSubChannelDataEthernetRing *channelData =
+        (UA_PubSubChannelDataEthernetRing *) channel->handle;
+    /* The fill ring of an AF_XDP socket cannot be drained. The frames stay
+     * with the kernel until the channel is closed. */
+    if(channelData->mode == UA_ETHRING_MODE_MMAP)
+        UA_EthernetRing_unregistMmap(channelData);
+    channel->state = UA_PUBSUB_CHANNEL_PUB;
+    return UA_STATUSCODE_GOOD;
+}
+
+static UA_StatusCode
+UA_PubSubChannelEthernetRing_receive(UA_PubSubChannel *channel, UA_ByteString *message,
+                                     UA_ExtensionObject *transportSettings, UA_UInt32 timeout) {
+#ifdef UA_ENABLE_PUBSUB_ETH_XDP
+    UA_PubSubChannelDataEthernetRing *channelData =
+        (UA_PubSubChannelDataEthernetRing *) channel->handle;
+    if(channelData->mode == UA_ETHRING_MODE_XDP)
+        return UA_EthernetRing_receiveXdp(channel, message, timeout);
+#endif
+    return UA_EthernetRing_receiveMmap(channel, message, timeout);
+}
+
+static UA_StatusCode
+UA_PubSubChannelEthernetRing_close(UA_PubSubChannel *channel) {
+    UA_PubSubChannelDataEthernetRing *channelData =
+        (UA_PubSubChannelDataEthernetRing *) channel->handle;
+#ifdef UA_ENABLE_PUBSUB_ETH_XDP
+    if(channelData->mode == UA_ETHRING_MODE_XDP) {
+        UA_EthernetRing_flushXdp(channel);
+        UA_EthernetRing_closeXdp(channelData);
+    } else
+#endif
+    {
+        UA_EthernetRing_flushMmap(channel, true);
+        UA_EthernetRing_unregistMmap(channelData);
+        if(channelData->txMap)
+            munmap(channelData->txMap, (size_t)channelData->frames * UA_ETHRING_FRAME_SIZE);
+        if(channel->sockfd >= 0)
+            close(channel->sockfd);
+    }
+    UA_PubSubChannel_removeExtension(channel);
+    UA_free(channelData);
+    UA_free(channel);
+    return UA_STATUSCODE_GOOD;
+}
+
+/* The receive ring has its own socket. AF_XDP sockets take no BPF filters. */
+static UA_SOCKET
+UA_PubSubChannelEthernetRing_receiveSocket(UA_PubSubChannel *channel) {
+    UA_PubSubChannelDataEthernetRing *channelData =
+        (UA_PubSubChannelDataEthernetRing *) channel->handle;
+    if(channelData->mode != UA_ETHRING_MODE_MMAP)
+        return -1;
+    return channelData->rxSocket;
+}
+
+static const UA_PubSubChannelExtension UA_PubSubChannelEthernetRing_extension = {
+    NULL,
+    NULL,
+    UA_PubSubChannelEthernetRing_receiveSocket,
+    UA_PubSubChannelEthernetRing_sendNonBlocking,
+    NULL,
+    NULL,
+    NULL
+};
+
+static UA_PubSubChannel *
+TransportLayerEthernetRing_addChannel(UA_PubSubConnectionConfig *connectionConfig) {
+    UA_PubSubChannel *pubSubChannel = UA_PubSubChannelEthernetRing_open(connectionConfig);
+    if(pubSubChannel) {
+        pubSubChannel->regist = UA_PubSubChannelEthernetRing_regist;
+        pubSubChannel->unregist = UA_PubSubChannelEthernetRing_unregist;
+        pubSubChannel->send = UA_PubSubChannelEthernetRing_send;
+        pubSubChannel->receive = UA_PubSubChannelEthernetRing_receive;
+        pubSubChannel->close = UA_PubSubChannelEthernetRing_close;
+        pubSubChannel->yield = UA_PubSubChannelEthernetRing_yield;
+        pubSubChannel->connectionConfig = connectionConfig;
+        if(UA_PubSubChannel_setExtension(pubSubChannel, &UA_PubSubChannelEthernetRing_extension) !=
+           UA_STATUSCODE_GOOD) {
+            pubSubChannel->close(pubSubChannel);
+            return NULL;
+        }
+    }
+    return pubSubChannel;
+}
+
+UA_PubSubTransportLayer
+UA_PubSubTransportLayerEthernetRing() {
+    UA_PubSubTransportLayer pubSubTransportLayer;
+    pubSubTransportLayer.transportProfileUri =
+        UA_STRING("http://opcfoundation.org/UA-Profile/Transport/pubsub-eth-uadp");
+    pubSubTransportLayer.createPubSubChannel = &TransportLayerEthernetRing_addChannel;
+    return pubSubTransportLayer;
+}
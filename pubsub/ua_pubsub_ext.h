@@ -0,0 +1,376 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef UA_PUBSUB_EXT_H_
+#define UA_PUBSUB_EXT_H_
+
+#include <open62541/server.h>
+#include <open62541/server_pubsub.h>
+
+#include "ua_pubsub_codec.h"
+#include "ua_pubsub_compress.h"
+#include "ua_pubsub_mailbox.h"
+#include "ua_pubsub_scheduler.h"
+#include "ua_pubsub_security.h"
+
+_UA_BEGIN_DECLS
+
+#ifdef UA_ENABLE_PUBSUB /* conditional compilation */
+
+/**
+ * PubSub Extensions
+ * =================
+ * Additions to the PubSub server API that are implemented in ``ua_pubsub.c``
+ * of this repository. They operate on the entities created with the regular
+ * API from ``server_pubsub.h``.
+ *
+ * Event-triggered WriterGroups
+ * ----------------------------
+ * An event-triggered WriterGroup is not published on the fixed
+ * ``publishingInterval`` cycle. Instead, a write to one of the variables
+ * published by the writers of the group schedules a publish. Writes that
+ * arrive within ``minInterval`` after the last publish are coalesced into the
+ * next NetworkMessage. If no write arrives for ``maxInterval``, the group is
+ * published anyway as a heartbeat. */
+
+typedef struct {
+    UA_Duration minInterval; /* in ms; 0 publishes after every write */
+    UA_Duration maxInterval; /* in ms; 0 disables the heartbeat */
+} UA_WriterGroupTriggerConfig;
+
+/* Switch a WriterGroup to event-triggered publishing. The write hooks are
+ * installed on the published variables of the DataSetFields that are
+ * reachable from the writers of the group at the time of the call. Existing
+ * value callbacks of these variables are still called and are restored when
+ * the trigger is removed. */
+UA_StatusCode UA_EXPORT
+UA_Server_setWriterGroupTrigger(UA_Server *server, const UA_NodeId writerGroup,
+                                const UA_WriterGroupTriggerConfig *config);
+
+/* Return to cyclic publishing with the configured publishingInterval */
+UA_StatusCode UA_EXPORT
+UA_Server_removeWriterGroupTrigger(UA_Server *server, const UA_NodeId writerGroup);
+
+/**
+ * Publishing Offset
+ * -----------------
+ * The messages of a WriterGroup are encoded at the start of every cycle and
+ * handed to the network at ``publishingOffset`` (in ms) after the nominal
+ * start of the cycle. The transport holds the messages back until then (for
+ * example with ``SO_TXTIME``), so that the time on the wire does not depend on
+ * the sampling and encoding time. The nominal cycles start at multiples of the
+ * publishing interval on the clock of the transport, independent of when the
+ * publish callback runs. So publishers with synchronized clocks share the
+ * cycles. The offset must leave enough time to encode the group after the
+ * callback (see the phase of the publish scheduler). If the offset has
+ * already passed when the cycle starts, the messages are sent right away.
+ *
+ * Returns ``UA_STATUSCODE_BADNOTSUPPORTED`` if the transport of the connection
+ * cannot schedule messages. A negative offset disables the scheduling. The
+ * offset is ignored while the group is event-triggered. */
+UA_StatusCode UA_EXPORT
+UA_Server_setWriterGroupPublishingOffset(UA_Server *server, const UA_NodeId writerGroup,
+                                         UA_Duration publishingOffset);
+
+/**
+ * Publish Scheduling
+ * ------------------
+ * All cyclic WriterGroups of the server are published from one scheduler (see
+ * ``ua_pubsub_scheduler.h``) instead of one timer each. The cycle of a group
+ * starts at its phase (in ms) relative to the start of the scheduler. By
+ * default, the phase of a new group is placed in the largest gap between the
+ * cycles of the existing groups, so that groups with the same interval do not
+ * sample, encode and send at the same time. Groups that are due at the same
+ * time are published in the order of the ``priority`` of their configuration,
+ * highest first.
+ *
+ * A fixed phase must be smaller than the ``publishingInterval``. A negative
+ * phase is assigned by the scheduler. The new phase applies from the next
+ * cycle that is at least one interval after the last publish
+ *
+ * Every server has its own scheduler. With
+ * ``UA_ENABLE_PUBSUB_CUSTOM_PUBLISH_HANDLING``, the WriterGroups are
+ * registered one by one with the custom publish handling of the application
+ * instead. Phases and priorities are then not applied, and the schedule
+ * statistics return ``UA_STATUSCODE_BADNOTSUPPORTED``. */
+UA_StatusCode UA_EXPORT
+UA_Server_setWriterGroupPhase(UA_Server *server, const UA_NodeId writerGroup,
+                              UA_Duration phase);
+
+/* The phase and the lateness of the cycles of a cyclic WriterGroup. Returns
+ * UA_STATUSCODE_BADINVALIDSTATE while the group is event-triggered. The
+ * statistics restart when the interval or the phase changes. */
+UA_StatusCode UA_EXPORT
+UA_Server_getWriterGroupScheduleStatistics(UA_Server *server, const UA_NodeId writerGroup,
+                                           UA_PubSubScheduleStatistics *statistics);
+
+/**
+ * Live Reconfiguration
+ * --------------------
+ * ``UA_Server_updateWriterGroupConfig`` from ``server_pubsub.h`` accepts every
+ * field of the configuration while the group is publishing. The new
+ * configuration is copied and validated first. Only then it replaces the old
+ * one, so a publish never sees a partly applied update and a rejected update
+ * leaves the group unchanged. A new ``publishingInterval`` applies from the
+ * first cycle of the group that is at least one new interval after the last
+ * publish. There is no additional publish. A new ``priority`` applies to the
+ * next cycle. Writers are added and removed live with the regular API.
+ *
+ * ``UA_Server_updateDataSetWriterConfig`` does the same for a DataSetWriter.
+ * The next DataSetMessage of the writer is a key frame. */
+UA_StatusCode UA_EXPORT
+UA_Server_updateDataSetWriterConfig(UA_Server *server, const UA_NodeId dsw,
+                                    const UA_DataSetWriterConfig *config);
+
+/**
+ * Bulk DataSetField Configuration
+ * -------------------------------
+ * Every DataSetField that is added or removed with the regular API changes the
+ * configuration version of the PublishedDataSet. The writers of the DataSet
+ * then flush their last samples and send a key frame. The bulk functions
+ * change many fields at once with a single version change. All arguments are
+ * checked before the PublishedDataSet is modified. If one of them is invalid,
+ * nothing is changed. */
+
+/* The fields end up in the same order as with one UA_Server_addDataSetField
+ * per config. If given, fieldIdentifiers must have fieldConfigsSize entries. */
+UA_DataSetFieldResult UA_EXPORT
+UA_Server_addDataSetFields(UA_Server *server, const UA_NodeId publishedDataSet,
+                           size_t fieldConfigsSize, const UA_DataSetFieldConfig *fieldConfigs,
+                           UA_NodeId *fieldIdentifiers);
+
+/* Returns UA_STATUSCODE_BADNOTFOUND if one of the fields is not part of the
+ * PublishedDataSet */
+UA_DataSetFieldResult UA_EXPORT
+UA_Server_removeDataSetFields(UA_Server *server, const UA_NodeId publishedDataSet,
+                              size_t fieldsSize, const UA_NodeId *fields);
+
+/**
+ * Generated DataSet Codecs
+ * ------------------------
+ * Encodes the DataSetMessages of the PublishedDataSet with a codec generated by
+ * ``pubsub/generate_dataset_codec.py`` (see ``ua_pubsub_codec.h``). The layout
+ * of the codec is checked against the DataType and ValueRank of the published
+ * variables. The codec is used as long as the configuration version of the
+ * PublishedDataSet stays the same. Adding or removing fields disables it until
+ * it is set again. NULL removes the codec. */
+UA_StatusCode UA_EXPORT
+UA_Server_setDataSetCodec(UA_Server *server, const UA_NodeId pds,
+                          const UA_DataSetCodec *codec);
+
+/**
+ * DataSetField Mailboxes
+ * ----------------------
+ * Samples the DataSetField from a value mailbox (see ``ua_pubsub_mailbox.h``)
+ * instead of reading the published variable. Producer threads write into the
+ * mailbox at their own rate, without the server loop and without
+ * ``UA_Server_writeValue``. The publisher copies the latest value at sampling
+ * time with the source timestamp of the producer. The memory of the previous
+ * sample is reused with delta frames.
+ *
+ * The type and length of the mailbox are checked against the DataType and
+ * ValueRank of the published variable. The variable itself is no longer
+ * read or written, so event-triggered WriterGroups do not see the updates.
+ * The mailbox is not copied and must outlive the binding. It is unbound with
+ * NULL and when the field is removed. */
+UA_StatusCode UA_EXPORT
+UA_Server_setDataSetFieldMailbox(UA_Server *server, const UA_NodeId dsf,
+                                 const UA_ValueMailbox *mailbox);
+
+/**
+ * PublishedDataSet Snapshots
+ * --------------------------
+ * Samples all fields of the PublishedDataSet in one read from a DataSet
+ * snapshot (see ``ua_pubsub_mailbox.h``). Field by field, a DataSetMessage
+ * can combine values of different producer updates. From the snapshot, all
+ * fields of a DataSetMessage come from the same write of the producer. The
+ * read does not lock out the producers.
+ *
+ * ``fields`` maps the snapshot fields to the DataSetFields and must have an
+ * entry for every field of the PublishedDataSet. The order of the snapshot is
+ * therefore independent of the order of the fields in the DataSetMessage
+ * (which is the reverse of the order in which they were added). The types are
+ * checked as for the mailboxes. The snapshot takes precedence over the
+ * mailboxes of the fields. It is used as long as the configuration version of
+ * the PublishedDataSet stays the same and must outlive the binding. NULL
+ * removes the snapshot. */
+UA_StatusCode UA_EXPORT
+UA_Server_setPublishedDataSetSnapshot(UA_Server *server, const UA_NodeId pds,
+                                      const UA_DataSetSnapshot *snapshot,
+                                      const UA_NodeId *fields);
+
+/**
+ * Key Frame Staggering
+ * --------------------
+ * With delta frames (``UA_ENABLE_PUBSUB_DELTAFRAMES``), a DataSetWriter sends a
+ * key frame every ``keyFrameCount + 1`` cycles and after every change of the
+ * configuration version of its PublishedDataSet. Writers that start together
+ * send their key frames together, so the size of the NetworkMessages of the
+ * group jumps periodically.
+ *
+ * With ``staggerKeyFrames``, the writers that send an unscheduled key frame in
+ * the same cycle are moved to consecutive cycles of the key frame period. For
+ * that, their next key frame comes earlier than the configured period.
+ * ``maxKeyFramesPerCycle`` limits the key frames of the group per
+ * cycle. A writer over the budget sends a delta frame and tries again in the
+ * next cycle. If it has no valid last key frame, it sends a KeepAlive instead.
+ * Writers without delta frames (a single field or a ``keyFrameCount`` of 0)
+ * are not limited. Returns ``UA_STATUSCODE_BADNOTSUPPORTED`` without delta
+ * frames. */
+
+typedef struct {
+    UA_Boolean staggerKeyFrames;
+    UA_UInt16 maxKeyFramesPerCycle; /* 0 for no limit */
+} UA_WriterGroupKeyFrameConfig;
+
+UA_StatusCode UA_EXPORT
+UA_Server_setWriterGroupKeyFrameConfig(UA_Server *server, const UA_NodeId writerGroup,
+                                       const UA_WriterGroupKeyFrameConfig *config);
+
+/**
+ * Transmit Queue
+ * --------------
+ * By default, a publish waits until the transport has taken every
+ * NetworkMessage. With a transmit queue, the messages of the connection are
+ * handed to the transport without blocking. Messages that the transport
+ * cannot take right away are queued and sent from a timed callback every
+ * ``retryInterval`` until the queue is empty. New messages are queued behind
+ * the old ones to keep the order. The policy decides what happens to a new
+ * message if the queue is full:
+ *
+ * - ``DROPOLDEST`` drops the oldest queued message
+ * - ``DROPNEWEST`` drops the new message
+ * - ``COALESCE`` replaces a queued NetworkMessage of the same DataSetWriters
+ *   and DataSetMessage types with the new one, also if the queue is not full.
+ *   Otherwise the oldest message is dropped. Chunks are not coalesced.
+ *
+ * When a queued delta frame is dropped or replaced, the DataSetWriters of the
+ * message send a key frame next, so that the subscribers do not keep stale
+ * values. The same holds for dropped key frames.
+ *
+ * Queued messages are sent when the publish cycle they belong to is over.
+ * They do not respect the publishing offset. Returns
+ * ``UA_STATUSCODE_BADNOTSUPPORTED`` if the transport cannot send without
+ * blocking. A capacity of 0 sends the queued messages and removes the
+ * queue. */
+
+typedef enum {
+    UA_PUBSUB_TXQUEUE_DROPOLDEST = 0,
+    UA_PUBSUB_TXQUEUE_DROPNEWEST = 1,
+    UA_PUBSUB_TXQUEUE_COALESCE = 2
+} UA_PubSubTxQueuePolicy;
+
+typedef struct {
+    size_t capacity; /* NetworkMessages */
+    UA_PubSubTxQueuePolicy policy;
+    UA_Duration retryInterval; /* in ms */
+} UA_PubSubTxQueueConfig;
+
+typedef struct {
+    size_t depth;            /* currently queued */
+    size_t maxDepth;
+    UA_UInt64 sent;
+    UA_UInt64 queued;        /* not taken by the transport right away,
+                              * without the replaced (coalesced) ones */
+    UA_UInt64 droppedOldest;
+    UA_UInt64 droppedNewest;
+    UA_UInt64 coalesced;
+    UA_UInt64 sendErrors;
+} UA_PubSubTxQueueStatistics;
+
+UA_StatusCode UA_EXPORT
+UA_Server_setPubSubConnectionTxQueue(UA_Server *server, const UA_NodeId connection,
+                                     const UA_PubSubTxQueueConfig *config);
+
+/* Returns UA_STATUSCODE_BADINVALIDSTATE if the connection has no queue */
+UA_StatusCode UA_EXPORT
+UA_Server_getPubSubConnectionTxQueueStatistics(UA_Server *server, const UA_NodeId connection,
+                                               UA_PubSubTxQueueStatistics *statistics);
+
+/**
+ * Chunked NetworkMessages
+ * -----------------------
+ * A NetworkMessage that is larger than ``maxNetworkMessageSize`` is not sent
+ * as one datagram that the IP layer fragments (where one lost fragment loses
+ * the message). Instead, each of its DataSetMessages is sent as a sequence of
+ * chunk messages that fit into the maximum size (see ``ua_pubsub_codec.h``).
+ * A DataSetMessage of more than 65535 bytes, which does not fit the size
+ * fields of the payload header, is always chunked. Without a maximum, the
+ * chunks then fill an Ethernet frame. The chunk reassembler of this
+ * repository rejects such DataSetMessages.
+ *
+ * Chunks are only sent for UADP without security and promoted fields. The
+ * subscriber needs a chunk reassembler (``ua_pubsub_chunk.h``), which the
+ * sharded receiver has built in. 0 removes the maximum. */
+
+UA_StatusCode UA_EXPORT
+UA_Server_setWriterGroupMaxNetworkMessageSize(UA_Server *server, const UA_NodeId writerGroup,
+                                              UA_UInt32 maxNetworkMessageSize);
+
+/**
+ * WriterGroup Security
+ * --------------------
+ * Signs, or signs and encrypts, the NetworkMessages of the WriterGroup with
+ * the keys of its security group (see ``ua_pubsub_security.h``). The key
+ * schedules are computed when the keys are set. The payload is encrypted in
+ * place in the encode buffer, also in the transmit buffers of the transport,
+ * and the signature is appended there. Setting new keys (for example with a
+ * new SecurityTokenId) replaces the old ones; NULL turns security off.
+ *
+ * Secured messages are encoded with the codec functions. They are not sent in
+ * chunks and carry no promoted fields. A secured NetworkMessage larger than
+ * the ``maxNetworkMessageSize`` of the group is not sent; the publish fails
+ * with ``UA_STATUSCODE_BADNOTSUPPORTED``.
+ *
+ * Returns ``UA_STATUSCODE_BADNOTSUPPORTED`` if a PublishedDataSet of the group
+ * has promoted fields, and without ``UA_ENABLE_PUBSUB_ENCRYPTION``. */
+
+UA_StatusCode UA_EXPORT
+UA_Server_setWriterGroupSecurity(UA_Server *server, const UA_NodeId writerGroup,
+                                 const UA_PubSubSecurityConfig *config);
+
+/**
+ * DataSetField Sampling Divisors
+ * ------------------------------
+ * Fields of one PublishedDataSet can change at different rates. A field with
+ * a sampling divisor n is sampled in every n-th publishing cycle of each
+ * DataSetWriter only. In the other cycles, the last sample is published again
+ * in key frames and left out of delta frames, since it did not change. All
+ * fields are sampled in the first cycle and after a change of the
+ * PublishedDataSet. A divisor of 0 or 1 samples the field in every cycle.
+ *
+ * The divisor is ignored while the PublishedDataSet is sampled from a
+ * snapshot. Returns ``UA_STATUSCODE_BADNOTSUPPORTED`` without
+ * ``UA_ENABLE_PUBSUB_DELTAFRAMES``, whose sample store keeps the last
+ * samples. */
+
+UA_StatusCode UA_EXPORT
+UA_Server_setDataSetFieldSamplingDivisor(UA_Server *server, const UA_NodeId dsf,
+                                         UA_UInt32 samplingDivisor);
+
+/**
+ * DataSetField Compression
+ * ------------------------
+ * Publishes a Double or Float field in a lossy encoding with fewer bytes (see
+ * ``ua_pubsub_compress.h``). The value is encoded right after sampling, so
+ * delta frames only carry fields whose encoding changed. The settings are
+ * written into the properties of the field metadata. Subscribers pass the
+ * same settings to ``UA_DataSetMessage_expandFields`` or to the sharded
+ * receiver to get Double values back. Fields whose value cannot be encoded
+ * are sent with the status ``UA_STATUSCODE_BADTYPEMISMATCH`` and no value.
+ *
+ * Like adding a field, setting or removing the compression updates the major
+ * configuration version of the PublishedDataSet. Codecs and snapshots that
+ * were bound before have to be bound again. NULL removes the compression. */
+
+UA_StatusCode UA_EXPORT
+UA_Server_setDataSetFieldCompression(UA_Server *server, const UA_NodeId dsf,
+                                     const UA_FieldCompression *compression);
+
+#endif /* UA_ENABLE_PUBSUB */
+
+_UA_END_DECLS
+
+#endif /* UA_PUBSUB_EXT_H_ */
@@ -0,0 +1,271 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include "ua_pubsub_lvc.h"
+
+#ifdef UA_ENABLE_PUBSUB /* conditional compilation */
+
+#include "ua_util_internal.h"
+
+typedef struct UA_LastValueEntry {
+    LIST_ENTRY(UA_LastValueEntry) listEntry;
+    UA_Variant publisherId;
+    UA_UInt16 dataSetWriterId;
+
+    /* A key frame was received and all delta frames since then were applied */
+    UA_Boolean valid;
+    UA_Boolean majorVersionEnabled;
+    UA_UInt32 majorVersion;
+    UA_Boolean minorVersionEnabled;
+    UA_UInt32 minorVersion;
+    UA_Boolean sequenceNumberEnabled;
+    UA_UInt16 sequenceNumber;
+
+    size_t fieldsSize;
+    UA_DataValue *fields;
+} UA_LastValueEntry;
+
+struct UA_PubSubLastValueCache {
+    LIST_HEAD(UA_ListOfLastValueEntry, UA_LastValueEntry) entries;
+};
+
+/* PublisherIds are strings or pointer-free integers */
+static UA_Boolean
+publisherIdEqual(const UA_Variant *a, const UA_Variant *b) {
+    if(a->type != b->type)
+        return false;
+    if(!a->type)
+        return true;
+    if(a->type == &UA_TYPES[UA_TYPES_STRING])
+        return UA_String_equal((const UA_String *)a->data, (const UA_String *)b->data);
+    return memcmp(a->data, b->data, a->type->memSize) == 0;
+}
+
+void
+UA_NetworkMessage_getPublisherId(const UA_NetworkMessage *networkMessage,
+                                 UA_Variant *publisherId) {
+    UA_Variant_init(publisherId);
+    if(!networkMessage->publisherIdEnabled)
+        return;
+    UA_NetworkMessage *nm = (UA_NetworkMessage *)(uintptr_t)networkMessage;
+    switch(nm->publisherIdType) {
+    case UA_PUBLISHERDATATYPE_BYTE:
+        UA_Variant_setScalar(publisherId, &nm->publisherId.publisherIdByte,
+                             &UA_TYPES[UA_TYPES_BYTE]);
+        break;
+    case UA_PUBLISHERDATATYPE_UINT16:
+        UA_Variant_setScalar(publisherId, &nm->publisherId.publisherIdUInt16,
+                             &UA_TYPES[UA_TYPES_UINT16]);
+        break;
+    case UA_PUBLISHERDATATYPE_UINT32:
+        UA_Variant_setScalar(publisherId, &nm->publisherId.publisherIdUInt32,
+                             &UA_TYPES[UA_TYPES_UINT32]);
+        break;
+    case UA_PUBLISHERDATATYPE_UINT64:
+        UA_Variant_setScalar(publisherId, &nm->publisherId.publisherIdUInt64,
+                             &UA_TYPES[UA_TYPES_UINT64]);
+        break;
+    case UA_PUBLISHERDATATYPE_STRING:
+        UA_Variant_setScalar(publisherId, &nm->publisherId.publisherIdString,
+                             &UA_TYPES[UA_TYPES_STRING]);
+        break;
+    default:
+        break;
+    }
+}
+
+UA_PubSubLastValueCache *
+UA_PubSubLastValueCache_new(void) {
+    return (UA_PubSubLastValueCache *) UA_calloc(1, sizeof(UA_PubSubLastValueCache));
+}
+
+void
+UA_PubSubLastValueCache_delete(UA_PubSubLastValueCache *lvc) {
+    if(!lvc)
+        return;
+    UA_LastValueEntry *entry, *tmpEntry;
+    LIST_FOREACH_SAFE(entry, &lvc->entries, listEntry, tmpEntry) {
+        LIST_REMOVE(entry, listEntry);
+        UA_Variant_deleteMembers(&entry->publisherId);
+        UA_Array_delete(entry->fields, entry->fieldsSize, &UA_TYPES[UA_TYPES_DATAVALUE]);
+        UA_free(entry);
+    }
+    UA_free(lvc);
+}
+
+static UA_LastValueEntry *
+UA_PubSubLastValueCache_find(const UA_PubSubLastValueCache *lvc,
+                             const UA_Variant *publisherId, UA_UInt16 dataSetWriterId) {
+    UA_LastValueEntry *entry;
+    LIST_FOREACH(entry, &lvc->entries, listEntry) {
+        if(entry->dataSetWriterId == dataSetWriterId &&
+           publisherIdEqual(&entry->publisherId, publisherId))
+            return entry;
+    }
+    return NULL;
+}
+
+/* Move the fields of the key frame into the entry */
+static UA_StatusCode
+UA_LastValueEntry_applyKeyFrame(UA_LastValueEntry *entry, UA_DataSetMessage *dsm) {
+    UA_DataSetMessage_DataKeyFrameData *keyFrame = &dsm->data.keyFrameData;
+    if(keyFrame->fieldCount > 0 && !keyFrame->dataSetFields)
+        return UA_STATUSCODE_GOOD; /* not decoded */
+
+    /* A late key frame must not overwrite newer values */
+    if(entry->valid && entry->sequenceNumberEnabled &&
+       dsm->header.dataSetMessageSequenceNrEnabled) {
+        UA_UInt16 distance = (UA_UInt16)(dsm->header.dataSetMessageSequenceNr -
+                                         entry->sequenceNumber);
+        if(distance == 0 || distance >= 0x8000)
+            return UA_STATUSCODE_GOOD; /* duplicate or out of order */
+    }
+
+    if(entry->fieldsSize != keyFrame->fieldCount) {
+        UA_DataValue *fields = (UA_DataValue *)
+            UA_Array_new(keyFrame->fieldCount, &UA_TYPES[UA_TYPES_DATAVALUE]);
+        if(!fields) {
+            entry->valid = false;
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+        }
+        UA_Array_delete(entry->fields, entry->fieldsSize, &UA_TYPES[UA_TYPES_DATAVALUE]);
+        entry->fields = fields;
+        entry->fieldsSize = keyFrame->fieldCount;
+    }
+
+    for(size_t i = 0; i < entry->fieldsSize; i++) {
+        UA_DataValue_deleteMembers(&entry->fields[i]);
+        entry->fields[i] = keyFrame->dataSetFields[i];
+        UA_DataValue_init(&keyFrame->dataSetFields[i]);
+    }
+
+    entry->majorVersionEnabled = dsm->header.configVersionMajorVersionEnabled;
+    entry->majorVersion = dsm->header.configVersionMajorVersion;
+    entry->minorVersionEnabled = dsm->header.configVersionMinorVersionEnabled;
+    entry->minorVersion = dsm->header.configVersionMinorVersion;
+    entry->sequenceNumberEnabled = dsm->header.dataSetMessageSequenceNrEnabled;
+    entry->sequenceNumber = dsm->header.dataSetMessageSequenceNr;
+    entry->valid = true;
+    return UA_STATUSCODE_GOOD;
+}
+
+/* The delta frame is either applied completely or not at all */
+static void
+UA_LastValueEntry_applyDeltaFrame(UA_LastValueEntry *entry, UA_DataSetMessage *dsm) {
+    const UA_DataSetMessageHeader *header = &dsm->header;
+    if(header->dataSetMessageSequenceNrEnabled && entry->sequenceNumberEnabled) {
+        UA_UInt16 distance = (UA_UInt16)(header->dataSetMessageSequenceNr - entry->sequenceNumber);
+        if(distance == 0 || distance >= 0x8000)
+            return; /* duplicate or out of order */
+        if(distance > 1) {
+            entry->valid = false; /* lost a message in between */
+            return;
+        }
+    }
+
+    /* The field indices refer to a different layout or the DataSet has
+     * changed since the key frame */
+    if((header->configVersionMajorVersionEnabled && entry->majorVersionEnabled &&
+        header->configVersionMajorVersion != entry->majorVersion) ||
+       (header->configVersionMinorVersionEnabled && entry->minorVersionEnabled &&
+        header->configVersionMinorVersion != entry->minorVersion)) {
+        entry->valid = false;
+        return;
+    }
+
+    UA_DataSetMessage_DataDeltaFrameData *deltaFrame = &dsm->data.deltaFrameData;
+    if(deltaFrame->fieldCount > 0 && !deltaFrame->deltaFrameFields)
+        return; /* not decoded */
+    for(size_t i = 0; i < deltaFrame->fieldCount; i++) {
+        if(deltaFrame->deltaFrameFields[i].fieldIndex >= entry->fieldsSize) {
+            entry->valid = false;
+            return;
+        }
+    }
+
+    for(size_t i = 0; i < deltaFrame->fieldCount; i++) {
+        UA_DataSetMessage_DeltaFrameField *field = &deltaFrame->deltaFrameFields[i];
+        UA_DataValue *target = &entry->fields[field->fieldIndex];
+        UA_DataValue_deleteMembers(target);
+        *target = field->fieldValue;
+        UA_DataValue_init(&field->fieldValue);
+    }
+
+    if(header->dataSetMessageSequenceNrEnabled) {
+        entry->sequenceNumberEnabled = true;
+        entry->sequenceNumber = header->dataSetMessageSequenceNr;
+    }
+}
+
+static UA_StatusCode
+UA_PubSubLastValueCache_processDataSetMessage(UA_PubSubLastValueCache *lvc,
+                                              const UA_Variant *publisherId,
+                                              UA_UInt16 dataSetWriterId,
+                                              UA_DataSetMessage *dsm) {
+    if(!dsm->header.dataSetMessageValid)
+        return UA_STATUSCODE_GOOD;
+
+    UA_LastValueEntry *entry = UA_PubSubLastValueCache_find(lvc, publisherId, dataSetWriterId);
+    if(dsm->header.dataSetMessageType == UA_DATASETMESSAGE_DATAKEYFRAME) {
+        if(!entry) {
+            entry = (UA_LastValueEntry *) UA_calloc(1, sizeof(UA_LastValueEntry));
+            if(!entry)
+                return UA_STATUSCODE_BADOUTOFMEMORY;
+            if(UA_Variant_copy(publisherId, &entry->publisherId) != UA_STATUSCODE_GOOD) {
+                UA_free(entry);
+                return UA_STATUSCODE_BADOUTOFMEMORY;
+            }
+            entry->dataSetWriterId = dataSetWriterId;
+            LIST_INSERT_HEAD(&lvc->entries, entry, listEntry);
+        }
+        return UA_LastValueEntry_applyKeyFrame(entry, dsm);
+    }
+
+    /* Delta frames need a valid key frame to build on */
+    if(dsm->header.dataSetMessageType == UA_DATASETMESSAGE_DATADELTAFRAME &&
+       entry && entry->valid)
+        UA_LastValueEntry_applyDeltaFrame(entry, dsm);
+    return UA_STATUSCODE_GOOD;
+}
+
+UA_StatusCode
+UA_PubSubLastValueCache_processNetworkMessage(UA_PubSubLastValueCache *lvc,
+                                              UA_NetworkMessage *networkMessage) {
+    if(!lvc || !networkMessage)
+        return UA_STATUSCODE_BADINVALIDARGUMENT;
+    if(networkMessage->networkMessageType != UA_NETWORKMESSAGE_DATASET ||
+       !networkMessage->payload.dataSetPayload.dataSetMessages)
+        return UA_STATUSCODE_GOOD;
+
+    UA_Variant publisherId;
+    UA_NetworkMessage_getPublisherId(networkMessage, &publisherId);
+
+    size_t dsmCount = 1;
+    if(networkMessage->payloadHeaderEnabled)
+        dsmCount = networkMessage->payloadHeader.dataSetPayloadHeader.count;
+
+    UA_StatusCode retVal = UA_STATUSCODE_GOOD;
+    for(size_t i = 0; i < dsmCount; i++) {
+        UA_UInt16 dataSetWriterId = 0;
+        if(networkMessage->payloadHeaderEnabled)
+            dataSetWriterId = networkMessage->payloadHeader.dataSetPayloadHeader.dataSetWriterIds[i];
+        retVal |= UA_PubSubLastValueCache_processDataSetMessage(lvc, &publisherId, dataSetWriterId,
+                      &networkMessage->payload.dataSetPayload.dataSetMessages[i]);
+    }
+    return retVal;
+}
+
+const UA_DataValue *
+UA_PubSubLastValueCache_getDataSet(const UA_PubSubLastValueCache *lvc,
+                                   const UA_Variant *publisherId,
+                                   UA_UInt16 dataSetWriterId, size_t *fieldsSize) {
+    UA_LastValueEntry *entry = UA_PubSubLastValueCache_find(lvc, publisherId, dataSetWriterId);
+    if(!entry || !entry->valid)
+        return NULL;
+    *fieldsSize = entry->fieldsSize;
+    return entry->fields;
+}
+
+#endif /* UA_ENABLE_PUBSUB */
@@ -0,0 +1,76 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef UA_PUBSUB_LVC_H_
+#define UA_PUBSUB_LVC_H_
+
+#include <open62541/types.h>
+
+#include "ua_pubsub_networkmessage.h"
+
+_UA_BEGIN_DECLS
+
+#ifdef UA_ENABLE_PUBSUB /* conditional compilation */
+
+/**
+ * Last-Value Cache
+ * ----------------
+ * Reconstructs the DataSets of received DataSetMessages on the subscriber
+ * side. There is one entry per PublisherId and DataSetWriterId. A key frame
+ * replaces all fields of the entry. A delta frame replaces the fields it
+ * contains by their ``fieldIndex``.
+ *
+ * An entry is valid after a key frame and becomes invalid when a delta frame
+ * cannot be applied to it:
+ *
+ * - the ``configVersionMajorVersion`` of the message differs from the one of
+ *   the last key frame (the field layout has changed),
+ * - the ``configVersionMinorVersion`` of the message differs from the one of
+ *   the last key frame (the DataSet was changed, for example extended),
+ * - the sequence number shows that a DataSetMessage was lost,
+ * - a ``fieldIndex`` is outside of the DataSet.
+ *
+ * Delta frames are dropped until the next key frame. Key frames and delta
+ * frames with a sequence number that is not newer than the last one of a valid
+ * entry are ignored. Messages
+ * without a payload header are stored under DataSetWriterId 0.
+ *
+ * The cache is not thread-safe. The DataSets it returns stay unchanged until
+ * the next call of ``processNetworkMessage``. */
+
+struct UA_PubSubLastValueCache;
+typedef struct UA_PubSubLastValueCache UA_PubSubLastValueCache;
+
+UA_PubSubLastValueCache UA_EXPORT *
+UA_PubSubLastValueCache_new(void);
+
+void UA_EXPORT
+UA_PubSubLastValueCache_delete(UA_PubSubLastValueCache *lvc);
+
+/* Apply all DataSetMessages of a decoded NetworkMessage. The field values are
+ * moved from the message into the cache. The message still has to be cleared
+ * afterwards. */
+UA_StatusCode UA_EXPORT
+UA_PubSubLastValueCache_processNetworkMessage(UA_PubSubLastValueCache *lvc,
+                                              UA_NetworkMessage *networkMessage);
+
+/* Returns the reconstructed fields or NULL if the entry is unknown or
+ * invalid. The PublisherId is a scalar Byte, UInt16, UInt32, UInt64 or
+ * String. An empty variant matches messages without PublisherId. */
+const UA_DataValue UA_EXPORT *
+UA_PubSubLastValueCache_getDataSet(const UA_PubSubLastValueCache *lvc,
+                                   const UA_Variant *publisherId,
+                                   UA_UInt16 dataSetWriterId, size_t *fieldsSize);
+
+/* Set the variant to the PublisherId of the message without copying it */
+void UA_EXPORT
+UA_NetworkMessage_getPublisherId(const UA_NetworkMessage *networkMessage,
+                                 UA_Variant *publisherId);
+
+#endif /* UA_ENABLE_PUBSUB */
+
+_UA_END_DECLS
+
+#endif /* UA_PUBSUB_LVC_H_ */
@@ -0,0 +1,332 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include "ua_pubsub_mailbox.h"
+
+#ifdef UA_ENABLE_PUBSUB /* conditional compilation */
+
+typedef struct {
+    UA_DataSetSnapshotField field;
+    size_t valueSize; /* in bytes */
+    size_t offset;    /* first word in a copy */
+} UA_SnapshotFieldLayout;
+
+/* The copies are stored in words that are accessed atomically, so that a read
+ * that overlaps with a write is not a data race. A copy is the source
+ * timestamp followed by the values of the fields. */
+struct UA_DataSetSnapshot {
+    size_t fieldsSize;
+    UA_SnapshotFieldLayout *fields;
+    size_t copyWords;
+    UA_Boolean writing; /* serializes the writers */
+    UA_UInt64 sequence; /* two per write; odd while copy 0 is written */
+    UA_UInt64 *words;   /* two copies */
+};
+
+/* A mailbox is a snapshot of one field */
+struct UA_ValueMailbox {
+    UA_DataSetSnapshot snapshot;
+    UA_SnapshotFieldLayout field;
+};
+
+static UA_StatusCode
+UA_DataSetSnapshot_init(UA_DataSetSnapshot *snapshot, size_t fieldsSize,
+                        const UA_DataSetSnapshotField *fields,
+                        UA_SnapshotFieldLayout *layouts) {
+    size_t words = 1; /* source timestamp */
+    for(size_t i = 0; i < fieldsSize; i++) {
+        const UA_DataType *type = fields[i].type;
+        if(!type || !type->pointerFree)
+            return UA_STATUSCODE_BADINVALIDARGUMENT;
+        layouts[i].field = fields[i];
+        layouts[i].valueSize = type->memSize * (fields[i].arrayLength > 0 ? fields[i].arrayLength : 1);
+        layouts[i].offset = words;
+        words += (layouts[i].valueSize + sizeof(UA_UInt64) - 1) / sizeof(UA_UInt64);
+    }
+    snapshot->fieldsSize = fieldsSize;
+    snapshot->fields = layouts;
+    snapshot->copyWords = words;
+    snapshot->words = (UA_UInt64 *)UA_calloc(2 * words, sizeof(UA_UInt64));
+    return snapshot->words ? UA_STATUSCODE_GOOD : UA_STATUSCODE_BADOUTOFMEMORY;
+}
+
+/**
+ * Latch
+ * ~~~~~ */
+
+static void
+storeValue(UA_UInt64 *words, const UA_Byte *value, size_t size) {
+    size_t i = 0;
+    for(; size >= sizeof(UA_UInt64); i++) {
+        UA_UInt64 word;
+        memcpy(&word, value, sizeof(UA_UInt64));
+        __atomic_store_n(&words[i], word, __ATOMIC_RELAXED);
+        value += sizeof(UA_UInt64);
+        size -= sizeof(UA_UInt64);
+    }
+    if(size > 0) {
+        UA_UInt64 word = 0;
+        memcpy(&word, value, size);
+        __atomic_store_n(&words[i], word, __ATOMIC_RELAXED);
+    }
+}
+
+static void
+loadValue(const UA_UInt64 *words, UA_Byte *value, size_t size) {
+    size_t i = 0;
+    for(; size >= sizeof(UA_UInt64); i++) {
+        UA_UInt64 word = __atomic_load_n(&words[i], __ATOMIC_RELAXED);
+        memcpy(value, &word, sizeof(UA_UInt64));
+        value += sizeof(UA_UInt64);
+        size -= sizeof(UA_UInt64);
+    }
+    if(size > 0) {
+        UA_UInt64 word = __atomic_load_n(&words[i], __ATOMIC_RELAXED);
+        memcpy(value, &word, size);
+    }
+}
+
+/* Both copies hold the last write between two writes. A field without a new
+ * value is therefore already in place. */
+static void
+storeCopy(const UA_DataSetSnapshot *snapshot, UA_UInt64 *copy,
+          const void *const *values, UA_DateTime sourceTimestamp) {
+    __atomic_store_n(&copy[0], (UA_UInt64)sourceTimestamp, __ATOMIC_RELAXED);
+    for(size_t i = 0; i < snapshot->fieldsSize; i++) {
+        if(values[i])
+            storeValue(&copy[snapshot->fields[i].offset], (const UA_Byte *)values[i],
+                       snapshot->fields[i].valueSize);
+    }
+}
+
+/* Moves the readers to the other copy. The release store keeps the earlier
+ * stores to the copy they move to from becoming visible after the switch.
+ * The fence keeps the following stores to the copy they leave from becoming
+ * visible before it. */
+static void
+switchCopy(UA_DataSetSnapshot *snapshot, UA_UInt64 sequence) {
+    __atomic_store_n(&snapshot->sequence, sequence, __ATOMIC_RELEASE);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+void
+UA_DataSetSnapshot_write(UA_DataSetSnapshot *snapshot, const void *const *values,
+                         UA_DateTime sourceTimestamp) {
+    while(__atomic_exchange_n(&snapshot->writing, true, __ATOMIC_ACQUIRE)) {
+        while(__atomic_load_n(&snapshot->writing, __ATOMIC_RELAXED)) {}
+    }
+
+    /* Readers take copy 1 while copy 0 is written and the other way round.
+     * Copy 1 still has to be complete from the last write when the readers
+     * move to it. */
+    UA_UInt64 sequence = __atomic_load_n(&snapshot->sequence, __ATOMIC_RELAXED);
+    switchCopy(snapshot, sequence + 1);
+    storeCopy(snapshot, snapshot->words, values, sourceTimestamp);
+    switchCopy(snapshot, sequence + 2);
+    storeCopy(snapshot, &snapshot->words[snapshot->copyWords], values, sourceTimestamp);
+
+    __atomic_store_n(&snapshot->writing, false, __ATOMIC_RELEASE);
+}
+
+/* Returns the sequence number for the read or 0 before the first write. Copy
+ * 1 is written after copy 0 in the first write. */
+static UA_UInt64
+beginRead(const UA_DataSetSnapshot *snapshot) {
+    UA_UInt64 sequence = __atomic_load_n(&snapshot->sequence, __ATOMIC_ACQUIRE);
+    return (sequence < 2) ? 0 : sequence;
+}
+
+static const UA_UInt64 *
+readCopy(const UA_DataSetSnapshot *snapshot, UA_UInt64 sequence) {
+    return &snapshot->words[(sequence & 1) * snapshot->copyWords];
+}
+
+/* Returns false if the copy may have changed underneath. The read is then
+ * repeated with the updated sequence number. */
+static UA_Boolean
+endRead(const UA_DataSetSnapshot *snapshot, UA_UInt64 *sequence) {
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if(__atomic_load_n(&snapshot->sequence, __ATOMIC_RELAXED) == *sequence)
+        return true;
+    *sequence = __atomic_load_n(&snapshot->sequence, __ATOMIC_ACQUIRE);
+    return false;
+}
+
+/* Keep the memory of a value with the same layout */
+static UA_StatusCode
+prepareDataValue(const UA_DataSetSnapshotField *field, UA_DataValue *value) {
+    UA_Variant *v = &value->value;
+    void *data = NULL;
+    if(v->storageType == UA_VARIANT_DATA &&
+       v->type == field->type && v->arrayLength == field->arrayLength &&
+       v->arrayDimensionsSize == 0 && v->data > UA_EMPTY_ARRAY_SENTINEL) {
+        data = v->data;
+        v->data = NULL;
+    }
+    UA_DataValue_deleteMembers(value);
+    UA_DataValue_init(value);
+    if(!data) {
+        if(field->arrayLength == 0)
+            data = UA_new(field->type);
+        else
+            data = UA_Array_new(field->arrayLength, field->type);
+        if(!data)
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+    }
+    if(field->arrayLength == 0)
+        UA_Variant_setScalar(v, data, field->type);
+    else
+        UA_Variant_setArray(v, data, field->arrayLength, field->type);
+    return UA_STATUSCODE_GOOD;
+}
+
+/**
+ * DataSet Snapshot
+ * ~~~~~~~~~~~~~~~~ */
+
+UA_DataSetSnapshot *
+UA_DataSetSnapshot_new(size_t fieldsSize, const UA_DataSetSnapshotField *fields) {
+    UA_DataSetSnapshot *snapshot = (UA_DataSetSnapshot *)UA_calloc(1, sizeof(UA_DataSetSnapshot));
+    if(!snapshot)
+        return NULL;
+    UA_SnapshotFieldLayout *layouts = (UA_SnapshotFieldLayout *)
+        UA_calloc(fieldsSize > 0 ? fieldsSize : 1, sizeof(UA_SnapshotFieldLayout));
+    if(!layouts ||
+       UA_DataSetSnapshot_init(snapshot, fieldsSize, fields, layouts) != UA_STATUSCODE_GOOD) {
+        UA_free(snapshot->words);
+        UA_free(layouts);
+        UA_free(snapshot);
+        return NULL;
+    }
+    return snapshot;
+}
+
+void
+UA_DataSetSnapshot_delete(UA_DataSetSnapshot *snapshot) {
+    if(!snapshot)
+        return;
+    UA_free(snapshot->words);
+    UA_free(snapshot->fields);
+    UA_free(snapshot);
+}
+
+size_t
+UA_DataSetSnapshot_getFieldsSize(const UA_DataSetSnapshot *snapshot) {
+    return snapshot->fieldsSize;
+}
+
+const UA_DataSetSnapshotField *
+UA_DataSetSnapshot_getField(const UA_DataSetSnapshot *snapshot, size_t field) {
+    if(field >= snapshot->fieldsSize)
+        return NULL;
+    return &snapshot->fields[field].field;
+}
+
+UA_StatusCode
+UA_DataSetSnapshot_readDataValues(const UA_DataSetSnapshot *snapshot,
+                                  UA_DataValue *values, const size_t *positions) {
+    /* Allocate outside of the read */
+    UA_StatusCode res = UA_STATUSCODE_GOOD;
+    for(size_t i = 0; i < snapshot->fieldsSize; i++) {
+        UA_DataValue *value = &values[positions ? positions[i] : i];
+        res |= prepareDataValue(&snapshot->fields[i].field, value);
+    }
+
+    UA_UInt64 sequence = beginRead(snapshot);
+    if(sequence == 0 || res != UA_STATUSCODE_GOOD) {
+        for(size_t i = 0; i < snapshot->fieldsSize; i++) {
+            UA_DataValue *value = &values[positions ? positions[i] : i];
+            UA_DataValue_deleteMembers(value);
+            UA_DataValue_init(value);
+            value->hasStatus = true;
+            value->status = UA_STATUSCODE_BADWAITINGFORINITIALDATA;
+        }
+        return (res != UA_STATUSCODE_GOOD) ? UA_STATUSCODE_BADOUTOFMEMORY : UA_STATUSCODE_GOOD;
+    }
+
+    UA_DateTime sourceTimestamp;
+    do {
+        const UA_UInt64 *copy = readCopy(snapshot, sequence);
+        sourceTimestamp = (UA_DateTime)__atomic_load_n(&copy[0], __ATOMIC_RELAXED);
+        for(size_t i = 0; i < snapshot->fieldsSize; i++) {
+            const UA_SnapshotFieldLayout *layout = &snapshot->fields[i];
+            UA_DataValue *value = &values[positions ? positions[i] : i];
+            loadValue(&copy[layout->offset], (UA_Byte *)value->value.data, layout->valueSize);
+        }
+    } while(!endRead(snapshot, &sequence));
+
+    for(size_t i = 0; i < snapshot->fieldsSize; i++) {
+        UA_DataValue *value = &values[positions ? positions[i] : i];
+        value->hasValue = true;
+        value->hasSourceTimestamp = true;
+        value->sourceTimestamp = sourceTimestamp;
+    }
+    return UA_STATUSCODE_GOOD;
+}
+
+/**
+ * Value Mailbox
+ * ~~~~~~~~~~~~~ */
+
+UA_ValueMailbox *
+UA_ValueMailbox_new(const UA_DataType *type, size_t arrayLength) {
+    UA_ValueMailbox *mb = (UA_ValueMailbox *)UA_calloc(1, sizeof(UA_ValueMailbox));
+    if(!mb)
+        return NULL;
+    UA_DataSetSnapshotField field = {type, arrayLength};
+    if(UA_DataSetSnapshot_init(&mb->snapshot, 1, &field, &mb->field) != UA_STATUSCODE_GOOD) {
+        UA_free(mb->snapshot.words);
+        UA_free(mb);
+        return NULL;
+    }
+    return mb;
+}
+
+void
+UA_ValueMailbox_delete(UA_ValueMailbox *mailbox) {
+    if(!mailbox)
+        return;
+    UA_free(mailbox->snapshot.words);
+    UA_free(mailbox);
+}
+
+const UA_DataType *
+UA_ValueMailbox_getType(const UA_ValueMailbox *mailbox) {
+    return mailbox->field.field.type;
+}
+
+size_t
+UA_ValueMailbox_getArrayLength(const UA_ValueMailbox *mailbox) {
+    return mailbox->field.field.arrayLength;
+}
+
+void
+UA_ValueMailbox_write(UA_ValueMailbox *mailbox, const void *value,
+                      UA_DateTime sourceTimestamp) {
+    const void *values[1] = {value};
+    UA_DataSetSnapshot_write(&mailbox->snapshot, values, sourceTimestamp);
+}
+
+UA_UInt64
+UA_ValueMailbox_read(const UA_ValueMailbox *mailbox, void *value,
+                     UA_DateTime *sourceTimestamp) {
+    const UA_DataSetSnapshot *snapshot = &mailbox->snapshot;
+    UA_UInt64 sequence = beginRead(snapshot);
+    if(sequence == 0)
+        return 0;
+    do {
+        const UA_UInt64 *copy = readCopy(snapshot, sequence);
+        *sourceTimestamp = (UA_DateTime)__atomic_load_n(&copy[0], __ATOMIC_RELAXED);
+        loadValue(&copy[mailbox->field.offset], (UA_Byte *)value, mailbox->field.valueSize);
+    } while(!endRead(snapshot, &sequence));
+    return sequence / 2;
+}
+
+UA_StatusCode
+UA_ValueMailbox_readDataValue(const UA_ValueMailbox *mailbox, UA_DataValue *value) {
+    return UA_DataSetSnapshot_readDataValues(&mailbox->snapshot, value, NULL);
+}
+
+#endif /* UA_ENABLE_PUBSUB */
@@ -0,0 +1,120 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef UA_PUBSUB_MAILBOX_H_
+#define UA_PUBSUB_MAILBOX_H_
+
+#include <open62541/types.h>
+
+_UA_BEGIN_DECLS
+
+#ifdef UA_ENABLE_PUBSUB /* conditional compilation */
+
+/**
+ * Value Mailbox
+ * -------------
+ * A slot for the latest value of a published field that producer threads
+ * update without the server lock, the node store or the encoding. A producer
+ * writes a value of a fixed, pointer-free type (a scalar or an array of fixed
+ * length) together with its source timestamp. The publisher reads a consistent
+ * copy when it samples the field (see ``UA_Server_setDataSetFieldMailbox``).
+ * Intermediate values that are written between two samples are overwritten.
+ *
+ * The mailbox is a sequence lock with two copies of the value (a latch). The
+ * writer updates one copy after the other and moves the sequence number
+ * before each. A reader takes the copy that is not being written and reads it
+ * again only if a write to that copy started in the meantime. Readers never
+ * wait for a writer, also not for one that is preempted in the middle of a
+ * write, and writers never wait for readers. Writes and reads do not allocate.
+ *
+ * Concurrent writers are serialized with a spinlock; a single producer per
+ * mailbox never spins. Reads are possible from any number of threads. */
+
+struct UA_ValueMailbox;
+typedef struct UA_ValueMailbox UA_ValueMailbox;
+
+/* The type must be pointer-free. An arrayLength of 0 selects a scalar. Returns
+ * NULL for other types. */
+UA_ValueMailbox UA_EXPORT *
+UA_ValueMailbox_new(const UA_DataType *type, size_t arrayLength);
+
+/* No thread may use the mailbox anymore */
+void UA_EXPORT
+UA_ValueMailbox_delete(UA_ValueMailbox *mailbox);
+
+const UA_DataType UA_EXPORT *
+UA_ValueMailbox_getType(const UA_ValueMailbox *mailbox);
+
+size_t UA_EXPORT
+UA_ValueMailbox_getArrayLength(const UA_ValueMailbox *mailbox);
+
+/* value points to a scalar or to arrayLength elements of the type */
+void UA_EXPORT
+UA_ValueMailbox_write(UA_ValueMailbox *mailbox, const void *value,
+                      UA_DateTime sourceTimestamp);
+
+/* Copies the latest value into value. Returns the number of writes up to that
+ * value, 0 if nothing was written yet (value is then unchanged). */
+UA_UInt64 UA_EXPORT
+UA_ValueMailbox_read(const UA_ValueMailbox *mailbox, void *value,
+                     UA_DateTime *sourceTimestamp);
+
+/* Reads into a DataValue with the source timestamp. The memory of the variant
+ * is reused if it holds a value of the same type and length. Before the first
+ * write, the status is UA_STATUSCODE_BADWAITINGFORINITIALDATA without a
+ * value. */
+UA_StatusCode UA_EXPORT
+UA_ValueMailbox_readDataValue(const UA_ValueMailbox *mailbox, UA_DataValue *value);
+
+/**
+ * DataSet Snapshot
+ * ----------------
+ * A mailbox for all fields of a DataSet. A producer updates several fields in
+ * one write, and a reader always gets the fields of the same write, never a
+ * mix of an older and a newer update. The snapshot is the same latch as the
+ * value mailbox, with the fields and one source timestamp in each copy. The
+ * publisher samples a PublishedDataSet from it in one read (see
+ * ``UA_Server_setPublishedDataSetSnapshot``). */
+
+typedef struct {
+    const UA_DataType *type; /* pointer-free */
+    size_t arrayLength;      /* 0 for a scalar */
+} UA_DataSetSnapshotField;
+
+struct UA_DataSetSnapshot;
+typedef struct UA_DataSetSnapshot UA_DataSetSnapshot;
+
+/* Returns NULL if one of the types is not pointer-free */
+UA_DataSetSnapshot UA_EXPORT *
+UA_DataSetSnapshot_new(size_t fieldsSize, const UA_DataSetSnapshotField *fields);
+
+/* No thread may use the snapshot anymore */
+void UA_EXPORT
+UA_DataSetSnapshot_delete(UA_DataSetSnapshot *snapshot);
+
+size_t UA_EXPORT
+UA_DataSetSnapshot_getFieldsSize(const UA_DataSetSnapshot *snapshot);
+
+const UA_DataSetSnapshotField UA_EXPORT *
+UA_DataSetSnapshot_getField(const UA_DataSetSnapshot *snapshot, size_t field);
+
+/* values has one entry per field. A NULL entry keeps the value of the field
+ * from the previous write (zero before the first). */
+void UA_EXPORT
+UA_DataSetSnapshot_write(UA_DataSetSnapshot *snapshot, const void *const *values,
+                         UA_DateTime sourceTimestamp);
+
+/* Reads all fields into DataValues with the source timestamp of the write,
+ * as UA_ValueMailbox_readDataValue. Field i goes to values[positions[i]], or
+ * to values[i] if positions is NULL. */
+UA_StatusCode UA_EXPORT
+UA_DataSetSnapshot_readDataValues(const UA_DataSetSnapshot *snapshot,
+                                  UA_DataValue *values, const size_t *positions);
+
+#endif /* UA_ENABLE_PUBSUB */
+
+_UA_END_DECLS
+
+#endif /* UA_PUBSUB_MAILBOX_H_ */
@@ -0,0 +1,578 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <open62541/plugin/log_stdout.h>
+
+#include "ua_pubsub_readerfilter.h"
+
+#ifdef UA_ENABLE_PUBSUB /* conditional compilation */
+
+#include "pubsub_channel_ext.h"
+
+#ifdef __linux__
+#include <errno.h>
+#include <linux/filter.h>
+#include <sys/socket.h>
+#endif
+
+/* UADP header flags (Part 14, 7.2.2.2.2) */
+#define UA_UADP_VERSION_MASK 0x0F
+#define UA_UADP_FLAGS_PUBLISHERID 0x10
+#define UA_UADP_FLAGS_GROUPHEADER 0x20
+#define UA_UADP_FLAGS_PAYLOADHEADER 0x40
+#define UA_UADP_FLAGS_EXTFLAGS1 0x80
+#define UA_UADP_EXTFLAGS1_PUBLISHERIDTYPE 0x07
+#define UA_UADP_EXTFLAGS1_DATASETCLASSID 0x08
+#define UA_UADP_EXTFLAGS1_EXTFLAGS2 0x80
+/* Chunk flag and NetworkMessage type. Only unchunked DataSet messages are
+ * filtered. */
+#define UA_UADP_EXTFLAGS2_UNFILTERABLE 0x1D
+#define UA_UADP_GROUP_WRITERGROUPID 0x01
+#define UA_UADP_GROUP_GROUPVERSION 0x02
+#define UA_UADP_GROUP_NETWORKMESSAGENUMBER 0x04
+#define UA_UADP_GROUP_SEQUENCENUMBER 0x08
+
+#define UA_READERFILTER_MAXSTRING 64
+#define UA_READERFILTER_MAXWRITERIDS 16
+
+/* Encode the PublisherId of the filter as it appears on the wire. Returns the
+ * PublisherIdType or -1 if the filter has no PublisherId. */
+static int
+encodePublisherId(const UA_PubSubReaderFilter *filter,
+                  UA_Byte encoded[4 + UA_READERFILTER_MAXSTRING], size_t *encodedSize) {
+    const UA_Variant *id = &filter->publisherId;
+    UA_UInt64 value = 0;
+    int type;
+    if(!id->type || !id->data) {
+        return -1;
+    } else if(id->type == &UA_TYPES[UA_TYPES_BYTE]) {
+        value = *(const UA_Byte *)id->data;
+        *encodedSize = 1;
+        type = 0;
+    } else if(id->type == &UA_TYPES[UA_TYPES_UINT16]) {
+        value = *(const UA_UInt16 *)id->data;
+        *encodedSize = 2;
+        type = 1;
+    } else if(id->type == &UA_TYPES[UA_TYPES_UINT32]) {
+        value = *(const UA_UInt32 *)id->data;
+        *encodedSize = 4;
+        type = 2;
+    } else if(id->type == &UA_TYPES[UA_TYPES_UINT64]) {
+        value = *(const UA_UInt64 *)id->data;
+        *encodedSize = 8;
+        type = 3;
+    } else if(id->type == &UA_TYPES[UA_TYPES_STRING]) {
+        const UA_String *s = (const UA_String *)id->data;
+        if(s->length > UA_READERFILTER_MAXSTRING)
+            return -2;
+        value = s->length;
+        if(s->length > 0)
+            memcpy(&encoded[4], s->data, s->length);
+        *encodedSize = 4 + s->length;
+        type = 4;
+    } else {
+        return -2;
+    }
+    /* Integers and the string length are encoded little-endian */
+    size_t valueSize = (type == 4) ? 4 : *encodedSize;
+    for(size_t i = 0; i < valueSize; i++)
+        encoded[i] = (UA_Byte)(value >> (8 * i));
+    return type;
+}
+
+/* Returns SIZE_MAX for unknown types and strings that are null or longer
+ * than 65535 bytes. Truncated strings have the size of the length field. */
+static size_t
+publisherIdSize(UA_Byte type, const UA_ByteString *message, size_t offset) {
+    switch(type) {
+    case 0: return 1;
+    case 1: return 2;
+    case 2: return 4;
+    case 3: return 8;
+    case 4:
+        if(message->length < offset + 4)
+            return 4;
+        if(message->data[offset + 2] != 0 || message->data[offset + 3] != 0)
+            return SIZE_MAX;
+        return 4 + (size_t)message->data[offset] + ((size_t)message->data[offset + 1] << 8);
+    default:
+        return SIZE_MAX;
+    }
+}
+
+static UA_UInt16
+readUInt16(const UA_ByteString *message, size_t offset) {
+    return (UA_UInt16)(message->data[offset] | (message->data[offset + 1] << 8));
+}
+
+UA_Boolean
+UA_PubSubReaderFilter_match(const UA_PubSubReaderFilter *filter,
+                            const UA_ByteString *message) {
+    UA_Byte encodedId[4 + UA_READERFILTER_MAXSTRING];
+    size_t encodedIdSize = 0;
+    int idType = encodePublisherId(filter, encodedId, &encodedIdSize);
+    if(idType < -1)
+        return true;
+
+    size_t offset = 0;
+    if(message->length < 1)
+        return false;
+    UA_Byte flags = message->data[offset++];
+    if((flags & UA_UADP_VERSION_MASK) != 1)
+        return true;
+
+    UA_Byte extFlags1 = 0;
+    if(flags & UA_UADP_FLAGS_EXTFLAGS1) {
+        if(message->length < offset + 1)
+            return false;
+        extFlags1 = message->data[offset++];
+        if(extFlags1 & UA_UADP_EXTFLAGS1_EXTFLAGS2) {
+            if(message->length < offset + 1)
+                return false;
+            if(message->data[offset++] & UA_UADP_EXTFLAGS2_UNFILTERABLE)
+                return true;
+        }
+    }
+
+    if(flags & UA_UADP_FLAGS_PUBLISHERID) {
+        UA_Byte type = extFlags1 & UA_UADP_EXTFLAGS1_PUBLISHERIDTYPE;
+        size_t size = publisherIdSize(type, message, offset);
+        if(size == SIZE_MAX)
+            return idType < 0; /* cannot be skipped, cannot be the filtered id */
+        if(message->length < offset + size)
+            return false;
+        if(idType >= 0 && (type != idType || size != encodedIdSize ||
+                           memcmp(&message->data[offset], encodedId, size) != 0))
+            return false;
+        offset += size;
+    } else if(idType >= 0) {
+        return false;
+    }
+
+    if(extFlags1 & UA_UADP_EXTFLAGS1_DATASETCLASSID)
+        offset += 16;
+
+    if(flags & UA_UADP_FLAGS_GROUPHEADER) {
+        if(message->length < offset + 1)
+            return false;
+        UA_Byte groupFlags = message->data[offset++];
+        if(filter->writerGroupId != 0) {
+            if(!(groupFlags & UA_UADP_GROUP_WRITERGROUPID) ||
+               message->length < offset + 2 ||
+               readUInt16(message, offset) != filter->writerGroupId)
+                return false;
+        }
+        if(groupFlags & UA_UADP_GROUP_WRITERGROUPID)
+            offset += 2;
+        if(groupFlags & UA_UADP_GROUP_GROUPVERSION)
+            offset += 4;
+        if(groupFlags & UA_UADP_GROUP_NETWORKMESSAGENUMBER)
+            offset += 2;
+        if(groupFlags & UA_UADP_GROUP_SEQUENCENUMBER)
+            offset += 2;
+    } else if(filter->writerGroupId != 0) {
+        return false;
+    }
+
+    if(filter->dataSetWriterId == 0 || !(flags & UA_UADP_FLAGS_PAYLOADHEADER))
+        return true;
+    if(message->length < offset + 1)
+        return false;
+    size_t count = message->data[offset++];
+    if(message->length < offset + 2 * count)
+        return false;
+    for(size_t i = 0; i < count; i++) {
+        if(readUInt16(message, offset + 2 * i) == filter->dataSetWriterId)
+            return true;
+    }
+    return false;
+}
+
+#ifdef __linux__
+
+/**
+ * BPF Program
+ * ~~~~~~~~~~~
+ * The program walks the UADP header with the offset of the current field in
+ * the X register. Jumps go to labels that are resolved after the program is
+ * complete. Classic BPF only jumps forward by up to 255 instructions. */
+
+#define UA_BPF_MAXINSNS 256
+#define UA_BPF_MAXLABELS 24
+#define UA_BPF_MAXFIXUPS 128
+
+/* Scratch memory */
+#define UA_BPF_MEM_FLAGS 0
+#define UA_BPF_MEM_EXTFLAGS1 1
+#define UA_BPF_MEM_LENGTHHIGH 2
+#define UA_BPF_MEM_LENGTHLOW 3
+#define UA_BPF_MEM_GROUPFLAGS 4
+#define UA_BPF_MEM_COUNT 5
+
+/* Jump targets */
+#define UA_BPF_NEXT 0
+#define UA_BPF_ACCEPT 1
+#define UA_BPF_DROP 2
+
+typedef struct {
+    struct sock_filter insns[UA_BPF_MAXINSNS];
+    size_t insnsSize;
+    size_t labels[UA_BPF_MAXLABELS];
+    size_t labelsSize;
+    struct {
+        size_t insn;
+        size_t label;
+        UA_Boolean jf; /* else jt, or k for BPF_JA */
+    } fixups[UA_BPF_MAXFIXUPS];
+    size_t fixupsSize;
+    UA_Boolean overflow;
+} UA_BpfProgram;
+
+static size_t
+UA_BpfProgram_newLabel(UA_BpfProgram *p) {
+    if(p->labelsSize == UA_BPF_MAXLABELS) {
+        p->overflow = true;
+        return UA_BPF_NEXT;
+    }
+    p->labels[p->labelsSize] = SIZE_MAX;
+    return p->labelsSize++;
+}
+
+static void
+UA_BpfProgram_placeLabel(UA_BpfProgram *p, size_t label) {
+    if(label != UA_BPF_NEXT)
+        p->labels[label] = p->insnsSize;
+}
+
+static void
+UA_BpfProgram_fixup(UA_BpfProgram *p, size_t label, UA_Boolean jf) {
+    if(label == UA_BPF_NEXT)
+        return;
+    if(p->fixupsSize == UA_BPF_MAXFIXUPS) {
+        p->overflow = true;
+        return;
+    }
+    p->fixups[p->fixupsSize].insn = p->insnsSize - 1;
+    p->fixups[p->fixupsSize].label = label;
+    p->fixups[p->fixupsSize].jf = jf;
+    p->fixupsSize++;
+}
+
+static void
+UA_BpfProgram_stmt(UA_BpfProgram *p, UA_UInt16 code, UA_UInt32 k) {
+    if(p->insnsSize == UA_BPF_MAXINSNS) {
+        p->overflow = true;
+        return;
+    }
+    struct sock_filter insn = BPF_STMT(code, k);
+    p->insns[p->insnsSize++] = insn;
+}
+
+static void
+UA_BpfProgram_jump(UA_BpfProgram *p, UA_UInt16 code, UA_UInt32 k,
+                   size_t jt, size_t jf) {
+    UA_BpfProgram_stmt(p, (UA_UInt16)(BPF_JMP | code), k);
+    if(p->overflow)
+        return;
+    UA_BpfProgram_fixup(p, jt, false);
+    UA_BpfProgram_fixup(p, jf, true);
+}
+
+static void
+UA_BpfProgram_goto(UA_BpfProgram *p, size_t label) {
+    UA_BpfProgram_stmt(p, BPF_JMP | BPF_JA, 0);
+    if(!p->overflow)
+        UA_BpfProgram_fixup(p, label, false);
+}
+
+/* X += k */
+static void
+UA_BpfProgram_advance(UA_BpfProgram *p, UA_UInt32 k) {
+    UA_BpfProgram_stmt(p, BPF_MISC | BPF_TXA, 0);
+    UA_BpfProgram_stmt(p, BPF_ALU | BPF_ADD | BPF_K, k);
+    UA_BpfProgram_stmt(p, BPF_MISC | BPF_TAX, 0);
+}
+
+/* Skip the bytes if the flag is set in the scratch memory slot */
+static void
+UA_BpfProgram_skipIf(UA_BpfProgram *p, UA_UInt32 mem, UA_UInt32 flag, UA_UInt32 k) {
+    size_t skip = UA_BpfProgram_newLabel(p);
+    UA_BpfProgram_stmt(p, BPF_LD | BPF_MEM, mem);
+    UA_BpfProgram_jump(p, BPF_JSET | BPF_K, flag, UA_BPF_NEXT, skip);
+    UA_BpfProgram_advance(p, k);
+    UA_BpfProgram_placeLabel(p, skip);
+}
+
+/* Compare the raw bytes at X. Loads are big-endian. */
+static void
+UA_BpfProgram_compareBytes(UA_BpfProgram *p, const UA_Byte *bytes, size_t bytesSize) {
+    size_t i = 0;
+    while(i < bytesSize) {
+        size_t left = bytesSize - i;
+        UA_UInt32 k;
+        if(left >= 4) {
+            k = ((UA_UInt32)bytes[i] << 24) | ((UA_UInt32)bytes[i+1] << 16) |
+                ((UA_UInt32)bytes[i+2] << 8) | bytes[i+3];
+            UA_BpfProgram_stmt(p, BPF_LD | BPF_W | BPF_IND, (UA_UInt32)i);
+            i += 4;
+        } else if(left >= 2) {
+            k = ((UA_UInt32)bytes[i] << 8) | bytes[i+1];
+            UA_BpfProgram_stmt(p, BPF_LD | BPF_H | BPF_IND, (UA_UInt32)i);
+            i += 2;
+        } else {
+            k = bytes[i];
+            UA_BpfProgram_stmt(p, BPF_LD | BPF_B | BPF_IND, (UA_UInt32)i);
+            i += 1;
+        }
+        UA_BpfProgram_jump(p, BPF_JEQ | BPF_K, k, UA_BPF_NEXT, UA_BPF_DROP);
+    }
+}
+
+/* UInt16 as loaded by BPF_H from the little-endian encoding */
+static UA_UInt32
+swap16(UA_UInt16 v) {
+    return (UA_UInt32)(((v & 0xFF) << 8) | (v >> 8));
+}
+
+static UA_StatusCode
+UA_BpfProgram_generate(UA_BpfProgram *p, const UA_PubSubReaderFilter *filter,
+                       UA_UInt32 headerOffset) {
+    UA_Byte encodedId[4 + UA_READERFILTER_MAXSTRING];
+    size_t encodedIdSize = 0;
+    int idType = encodePublisherId(filter, encodedId, &encodedIdSize);
+    if(idType < -1)
+        return UA_STATUSCODE_BADNOTSUPPORTED;
+
+    memset(p, 0, sizeof(UA_BpfProgram));
+    p->labelsSize = 3; /* next, accept, drop */
+
+    /* Version and flags */
+    size_t extFlagsDone = UA_BpfProgram_newLabel(p);
+    UA_BpfProgram_stmt(p, BPF_LD | BPF_B | BPF_ABS, headerOffset);
+    UA_BpfProgram_stmt(p, BPF_ST, UA_BPF_MEM_FLAGS);
+    UA_BpfProgram_stmt(p, BPF_ALU | BPF_AND | BPF_K, UA_UADP_VERSION_MASK);
+    UA_BpfProgram_jump(p, BPF_JEQ | BPF_K, 1, UA_BPF_NEXT, UA_BPF_ACCEPT);
+    UA_BpfProgram_stmt(p, BPF_LD | BPF_IMM, 0);
+    UA_BpfProgram_stmt(p, BPF_ST, UA_BPF_MEM_EXTFLAGS1);
+    UA_BpfProgram_stmt(p, BPF_LDX | BPF_IMM, headerOffset + 1);
+    UA_BpfProgram_stmt(p, BPF_LD | BPF_MEM, UA_BPF_MEM_FLAGS);
+    UA_BpfProgram_jump(p, BPF_JSET | BPF_K, UA_UADP_FLAGS_EXTFLAGS1, UA_BPF_NEXT, extFlagsDone);
+    UA_BpfProgram_stmt(p, BPF_LD | BPF_B | BPF_IND, 0);
+    UA_BpfProgram_stmt(p, BPF_ST, UA_BPF_MEM_EXTFLAGS1);
+    UA_BpfProgram_advance(p, 1);
+    UA_BpfProgram_stmt(p, BPF_LD | BPF_MEM, UA_BPF_MEM_EXTFLAGS1);
+    UA_BpfProgram_jump(p, BPF_JSET | BPF_K, UA_UADP_EXTFLAGS1_EXTFLAGS2, UA_BPF_NEXT, extFlagsDone);
+    UA_BpfProgram_stmt(p, BPF_LD | BPF_B | BPF_IND, 0);
+    UA_BpfProgram_jump(p, BPF_JSET | BPF_K, UA_UADP_EXTFLAGS2_UNFILTERABLE, UA_BPF_ACCEPT, UA_BPF_NEXT);
+    UA_BpfProgram_advance(p, 1);
+    UA_BpfProgram_placeLabel(p, extFlagsDone);
+
+    /* PublisherId */
+    size_t publisherIdDone = UA_BpfProgram_newLabel(p);
+    UA_BpfProgram_stmt(p, BPF_LD | BPF_MEM, UA_BPF_MEM_FLAGS);
+    UA_BpfProgram_jump(p, BPF_JSET | BPF_K, UA_UADP_FLAGS_PUBLISHERID, UA_BPF_NEXT,
+                       idType >= 0 ? UA_BPF_DROP : publisherIdDone);
+    UA_BpfProgram_stmt(p, BPF_LD | BPF_MEM, UA_BPF_MEM_EXTFLAGS1);
+    UA_BpfProgram_stmt(p, BPF_ALU | BPF_AND | BPF_K, UA_UADP_EXTFLAGS1_PUBLISHERIDTYPE);
+    if(idType >= 0) {
+        UA_BpfProgram_jump(p, BPF_JEQ | BPF_K, (UA_UInt32)idType, UA_BPF_NEXT, UA_BPF_DROP);
+        UA_BpfProgram_compareBytes(p, encodedId, encodedIdSize);
+        UA_BpfProgram_advance(p, (UA_UInt32)encodedIdSize);
+    } else {
+        size_t skip[4];
+        for(size_t i = 0; i < 4; i++)
+            skip[i] = UA_BpfProgram_newLabel(p);
+        for(size_t i = 0; i < 4; i++)
+            UA_BpfProgram_jump(p, BPF_JEQ | BPF_K, (UA_UInt32)i, skip[i], UA_BPF_NEXT);
+        UA_BpfProgram_jump(p, BPF_JEQ | BPF_K, 4, UA_BPF_NEXT, UA_BPF_ACCEPT);
+        /* String with the length in the lower two bytes */
+        UA_BpfProgram_stmt(p, BPF_LD | BPF_H | BPF_IND, 2);
+        UA_BpfProgram_jump(p, BPF_JEQ | BPF_K, 0, UA_BPF_NEXT, UA_BPF_ACCEPT);
+        UA_BpfProgram_stmt(p, BPF_LD | BPF_B | BPF_IND, 1);
+        UA_BpfProgram_stmt(p, BPF_ALU | BPF_LSH | BPF_K, 8);
+        UA_BpfProgram_stmt(p, BPF_ST, UA_BPF_MEM_LENGTHHIGH);
+        UA_BpfProgram_stmt(p, BPF_LD | BPF_B | BPF_IND, 0);
+        UA_BpfProgram_stmt(p, BPF_ST, UA_BPF_MEM_LENGTHLOW);
+        UA_BpfProgram_stmt(p, BPF_MISC | BPF_TXA, 0);
+        UA_BpfProgram_stmt(p, BPF_ALU | BPF_ADD | BPF_K, 4);
+        UA_BpfProgram_stmt(p, BPF_LDX | BPF_MEM, UA_BPF_MEM_LENGTHHIGH);
+        UA_BpfProgram_stmt(p, BPF_ALU | BPF_ADD | BPF_X, 0);
+        UA_BpfProgram_stmt(p, BPF_LDX | BPF_MEM, UA_BPF_MEM_LENGTHLOW);
+        UA_BpfProgram_stmt(p, BPF_ALU | BPF_ADD | BPF_X, 0);
+        UA_BpfProgram_stmt(p, BPF_MISC | BPF_TAX, 0);
+        UA_BpfProgram_goto(p, publisherIdDone);
+        static const UA_UInt32 sizes[4] = {1, 2, 4, 8};
+        for(size_t i = 0; i < 4; i++) {
+            UA_BpfProgram_placeLabel(p, skip[i]);
+            UA_BpfProgram_advance(p, sizes[i]);
+            if(i < 3)
+                UA_BpfProgram_goto(p, publisherIdDone);
+        }
+    }
+    UA_BpfProgram_placeLabel(p, publisherIdDone);
+
+    if(filter->writerGroupId == 0 && filter->dataSetWriterId == 0) {
+        UA_BpfProgram_goto(p, UA_BPF_ACCEPT);
+    } else {
+        /* DataSetClassId */
+        UA_BpfProgram_skipIf(p, UA_BPF_MEM_EXTFLAGS1, UA_UADP_EXTFLAGS1_DATASETCLASSID, 16);
+
+        /* GroupHeader */
+        size_t groupHeaderDone = UA_BpfProgram_newLabel(p);
+        UA_BpfProgram_stmt(p, BPF_LD | BPF_MEM, UA_BPF_MEM_FLAGS);
+        UA_BpfProgram_jump(p, BPF_JSET | BPF_K, UA_UADP_FLAGS_GROUPHEADER, UA_BPF_NEXT,
+                           filter->writerGroupId != 0 ? UA_BPF_DROP : groupHeaderDone);
+        UA_BpfProgram_stmt(p, BPF_LD | BPF_B | BPF_IND, 0);
+        UA_BpfProgram_stmt(p, BPF_ST, UA_BPF_MEM_GROUPFLAGS);
+        UA_BpfProgram_advance(p, 1);
+        if(filter->writerGroupId != 0) {
+            UA_BpfProgram_stmt(p, BPF_LD | BPF_MEM, UA_BPF_MEM_GROUPFLAGS);
+            UA_BpfProgram_jump(p, BPF_JSET | BPF_K, UA_UADP_GROUP_WRITERGROUPID,
+                               UA_BPF_NEXT, UA_BPF_DROP);
+            UA_BpfProgram_stmt(p, BPF_LD | BPF_H | BPF_IND, 0);
+            UA_BpfProgram_jump(p, BPF_JEQ | BPF_K, swap16(filter->writerGroupId),
+                               UA_BPF_NEXT, UA_BPF_DROP);
+        }
+        if(filter->dataSetWriterId == 0) {
+            UA_BpfProgram_goto(p, UA_BPF_ACCEPT);
+        } else {
+            UA_BpfProgram_skipIf(p, UA_BPF_MEM_GROUPFLAGS, UA_UADP_GROUP_WRITERGROUPID, 2);
+            UA_BpfProgram_skipIf(p, UA_BPF_MEM_GROUPFLAGS, UA_UADP_GROUP_GROUPVERSION, 4);
+            UA_BpfProgram_skipIf(p, UA_BPF_MEM_GROUPFLAGS, UA_UADP_GROUP_NETWORKMESSAGENUMBER, 2);
+            UA_BpfProgram_skipIf(p, UA_BPF_MEM_GROUPFLAGS, UA_UADP_GROUP_SEQUENCENUMBER, 2);
+        }
+        UA_BpfProgram_placeLabel(p, groupHeaderDone);
+
+        /* PayloadHeader */
+        if(filter->dataSetWriterId != 0) {
+            UA_BpfProgram_stmt(p, BPF_LD | BPF_MEM, UA_BPF_MEM_FLAGS);
+            UA_BpfProgram_jump(p, BPF_JSET | BPF_K, UA_UADP_FLAGS_PAYLOADHEADER,
+                               UA_BPF_NEXT, UA_BPF_ACCEPT);
+            UA_BpfProgram_stmt(p, BPF_LD | BPF_B | BPF_IND, 0);
+            UA_BpfProgram_stmt(p, BPF_ST, UA_BPF_MEM_COUNT);
+            UA_BpfProgram_advance(p, 1);
+            for(UA_UInt32 i = 0; i < UA_READERFILTER_MAXWRITERIDS; i++) {
+                UA_BpfProgram_stmt(p, BPF_LD | BPF_MEM, UA_BPF_MEM_COUNT);
+                UA_BpfProgram_jump(p, BPF_JGT | BPF_K, i, UA_BPF_NEXT, UA_BPF_DROP);
+                UA_BpfProgram_stmt(p, BPF_LD | BPF_H | BPF_IND, 2 * i);
+                UA_BpfProgram_jump(p, BPF_JEQ | BPF_K, swap16(filter->dataSetWriterId),
+                                   UA_BPF_ACCEPT, UA_BPF_NEXT);
+            }
+            /* Too many DataSetWriterIds to check */
+            UA_BpfProgram_stmt(p, BPF_LD | BPF_MEM, UA_BPF_MEM_COUNT);
+            UA_BpfProgram_jump(p, BPF_JGT | BPF_K, UA_READERFILTER_MAXWRITERIDS,
+                               UA_BPF_ACCEPT, UA_BPF_DROP);
+        }
+    }
+
+    /* Return the whole packet or nothing */
+    UA_BpfProgram_placeLabel(p, UA_BPF_ACCEPT);
+    UA_BpfProgram_stmt(p, BPF_RET | BPF_K, 0xFFFFFFFF);
+    UA_BpfProgram_placeLabel(p, UA_BPF_DROP);
+    UA_BpfProgram_stmt(p, BPF_RET | BPF_K, 0);
+    if(p->overflow)
+        return UA_STATUSCODE_BADNOTSUPPORTED;
+
+    for(size_t i = 0; i < p->fixupsSize; i++) {
+        size_t insn = p->fixups[i].insn;
+        size_t target = p->labels[p->fixups[i].label];
+        if(target == SIZE_MAX || target <= insn)
+            return UA_STATUSCODE_BADINTERNALERROR;
+        size_t offset = target - insn - 1;
+        if(p->insns[insn].code == (BPF_JMP | BPF_JA)) {
+            p->insns[insn].k = (UA_UInt32)offset;
+            continue;
+        }
+        if(offset > 255)
+            return UA_STATUSCODE_BADNOTSUPPORTED;
+        if(p->fixups[i].jf)
+            p->insns[insn].jf = (UA_Byte)offset;
+        else
+            p->insns[insn].jt = (UA_Byte)offset;
+    }
+    return UA_STATUSCODE_GOOD;
+}
+
+static UA_SOCKET
+receiveSocket(UA_PubSubChannel *channel) {
+    const UA_PubSubChannelExtension *ext = UA_PubSubChannel_getExtension(channel);
+    if(ext && ext->receiveSocket)
+        return ext->receiveSocket(channel);
+    return channel->sockfd;
+}
+
+UA_StatusCode
+UA_PubSubChannel_attachReaderFilter(UA_PubSubChannel *channel,
+                                    const UA_PubSubReaderFilter *filter) {
+    if(!channel || !filter)
+        return UA_STATUSCODE_BADINVALIDARGUMENT;
+    UA_SOCKET sockfd = receiveSocket(channel);
+    if(sockfd < 0)
+        return UA_STATUSCODE_BADNOTSUPPORTED;
+
+    /* Offset of the NetworkMessage in the packet the filter sees */
+    int domain = 0, type = 0;
+    socklen_t optlen = sizeof(int);
+    if(getsockopt(sockfd, SOL_SOCKET, SO_DOMAIN, &domain, &optlen) < 0)
+        return UA_STATUSCODE_BADNOTSUPPORTED;
+    optlen = sizeof(int);
+    if(getsockopt(sockfd, SOL_SOCKET, SO_TYPE, &type, &optlen) < 0)
+        return UA_STATUSCODE_BADNOTSUPPORTED;
+    UA_UInt32 headerOffset;
+    if((domain == AF_INET || domain == AF_INET6) && type == SOCK_DGRAM)
+        headerOffset = 8; /* UDP header */
+    else if(domain == AF_PACKET && type == SOCK_RAW)
+        headerOffset = 14; /* Ethernet header */
+    else
+        return UA_STATUSCODE_BADNOTSUPPORTED;
+
+    UA_BpfProgram *p = (UA_BpfProgram *) UA_malloc(sizeof(UA_BpfProgram));
+    if(!p)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    UA_StatusCode retval = UA_BpfProgram_generate(p, filter, headerOffset);
+    if(retval == UA_STATUSCODE_GOOD) {
+        struct sock_fprog fprog;
+        fprog.len = (unsigned short)p->insnsSize;
+        fprog.filter = p->insns;
+        if(setsockopt(sockfd, SOL_SOCKET, SO_ATTACH_FILTER, &fprog, sizeof(fprog)) < 0) {
+            UA_LOG_WARNING(UA_Log_Stdout, UA_LOGCATEGORY_SERVER,
+                           "PubSub reader filter: The kernel rejected the BPF program");
+            retval = UA_STATUSCODE_BADNOTSUPPORTED;
+        }
+    }
+    UA_free(p);
+    return retval;
+}
+
+UA_StatusCode
+UA_PubSubChannel_detachReaderFilter(UA_PubSubChannel *channel) {
+    if(!channel)
+        return UA_STATUSCODE_BADINVALIDARGUMENT;
+    UA_SOCKET sockfd = receiveSocket(channel);
+    if(sockfd < 0)
+        return UA_STATUSCODE_BADNOTSUPPORTED;
+    int dummy = 0;
+    if(setsockopt(sockfd, SOL_SOCKET, SO_DETACH_FILTER, &dummy, sizeof(dummy)) < 0 &&
+       errno != ENOENT)
+        return UA_STATUSCODE_BADINTERNALERROR;
+    return UA_STATUSCODE_GOOD;
+}
+
+#else /* __linux__ */
+
+UA_StatusCode
+UA_PubSubChannel_attachReaderFilter(UA_PubSubChannel *channel,
+                                    const UA_PubSubReaderFilter *filter) {
+    return UA_STATUSCODE_BADNOTSUPPORTED;
+}
+
+UA_StatusCode
+UA_PubSubChannel_detachReaderFilter(UA_PubSubChannel *channel) {
+    return UA_STATUSCODE_BADNOTSUPPORTED;
+}
+
+#endif /* __linux__ */
+
+#endif /* UA_ENABLE_PUBSUB */
@@ -0,0 +1,63 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef UA_PUBSUB_READERFILTER_H_
+#define UA_PUBSUB_READERFILTER_H_
+
+#include <open62541/plugin/pubsub.h>
+
+_UA_BEGIN_DECLS
+
+#ifdef UA_ENABLE_PUBSUB /* conditional compilation */
+
+/**
+ * Reader Filter
+ * -------------
+ * Selects the UADP NetworkMessages a subscriber is interested in by the
+ * PublisherId, WriterGroupId and DataSetWriterId in their headers. The check
+ * only looks at the header and runs before the message is decoded.
+ *
+ * On Linux the filter can also be compiled to a classic BPF program and
+ * attached to the receive socket of a channel. The kernel then drops the
+ * messages of other publishers before they are copied to userspace. This
+ * works for UDP sockets and for raw Ethernet packet sockets.
+ *
+ * Messages whose header cannot be checked are passed on. This includes
+ * messages that are chunked, are no DataSet messages, have no payload header
+ * while a DataSetWriterId is required, or list more DataSetWriterIds than the
+ * BPF program checks. ``UA_PubSubReaderFilter_match`` must therefore be called
+ * in userspace also when the BPF program is attached. */
+
+typedef struct {
+    /* Scalar Byte, UInt16, UInt32, UInt64 or String. Empty matches every
+     * PublisherId. */
+    UA_Variant publisherId;
+    UA_UInt16 writerGroupId;   /* 0 matches every WriterGroup */
+    UA_UInt16 dataSetWriterId; /* 0 matches every DataSetWriter */
+} UA_PubSubReaderFilter;
+
+/* Returns false only if the header of the encoded NetworkMessage shows that
+ * it does not match the filter */
+UA_Boolean UA_EXPORT
+UA_PubSubReaderFilter_match(const UA_PubSubReaderFilter *filter,
+                            const UA_ByteString *message);
+
+/* Attach the filter as a BPF program to the receive socket of a registered
+ * channel. Replaces a previously attached filter. Returns
+ * UA_STATUSCODE_BADNOTSUPPORTED if the channel has no suitable socket or the
+ * filter cannot be expressed as a BPF program (PublisherId strings longer
+ * than 64 bytes). */
+UA_StatusCode UA_EXPORT
+UA_PubSubChannel_attachReaderFilter(UA_PubSubChannel *channel,
+                                    const UA_PubSubReaderFilter *filter);
+
+UA_StatusCode UA_EXPORT
+UA_PubSubChannel_detachReaderFilter(UA_PubSubChannel *channel);
+
+#endif /* UA_ENABLE_PUBSUB */
+
+_UA_END_DECLS
+
+#endif /* UA_PUBSUB_READERFILTER_H_ */
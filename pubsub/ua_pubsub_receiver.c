@@ -0,0 +1,668 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE /* pthread_setaffinity_np */
+#endif
+
+#include <open62541/plugin/log_stdout.h>
+
+#include "ua_pubsub_receiver.h"
+#include "ua_pubsub_codec.h"
+#include "ua_pubsub_trace.h"
+
+#ifdef UA_ENABLE_PUBSUB_RECEIVER /* conditional compilation */
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <netdb.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <linux/filter.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define UA_RECEIVER_DEFAULT_QUEUESIZE 256
+#define UA_RECEIVER_DEFAULT_MESSAGESIZE 65535
+#define UA_RECEIVER_MAX_SHARDS 256
+#define UA_RECEIVER_CACHELINE 64
+
+/* The head is written by the worker, the tail by the server thread. They are
+ * kept on separate cache lines. */
+typedef struct {
+    UA_PubSubReceiver *receiver;
+    size_t index;
+    UA_SOCKET sockfd;
+    pthread_t thread;
+    UA_Boolean threadStarted;
+    UA_NetworkMessage *ring;
+    UA_ChunkReassembler *reassembler; /* used by the worker only */
+#ifdef UA_ENABLE_PUBSUB_ENCRYPTION
+    UA_PubSubSecurityContext *security; /* used by the worker only */
+#endif
+
+    __attribute__((aligned(UA_RECEIVER_CACHELINE))) UA_UInt64 head;
+    UA_PubSubReceiverStatistics statistics;
+    __attribute__((aligned(UA_RECEIVER_CACHELINE))) UA_UInt64 tail;
+} UA_PubSubReceiverShard;
+
+struct UA_PubSubReceiver {
+    UA_PubSubReceiverConfig config; /* with the defaults applied */
+    UA_PubSubSecurityConfig security; /* config.security points here */
+    UA_DataSetCompression *compressions; /* config.compressions points here */
+    struct sockaddr_storage address;
+    socklen_t addressLength;
+    unsigned int interfaceIndex;
+    struct in_addr interfaceAddress;
+    UA_Boolean running;
+    size_t nextShard;
+    UA_PubSubReceiverShard *shards;
+};
+
+static UA_Boolean
+isMulticast(const struct sockaddr_storage *addr) {
+    if(addr->ss_family == AF_INET)
+        return IN_MULTICAST(ntohl(((const struct sockaddr_in *)addr)->sin_addr.s_addr));
+    if(addr->ss_family == AF_INET6)
+        return IN6_IS_ADDR_MULTICAST(&((const struct sockaddr_in6 *)addr)->sin6_addr);
+    return false;
+}
+
+/* Split opc.udp://host:port/ into host and port strings */
+static UA_StatusCode
+parseUdpUrl(const UA_String *url, char *host, size_t hostSize,
+            char *port, size_t portSize) {
+    const char *prefix = "opc.udp://";
+    size_t prefixLength = strlen(prefix);
+    if(url->length <= prefixLength || strncmp((const char*)url->data, prefix, prefixLength) != 0)
+        return UA_STATUSCODE_BADINVALIDARGUMENT;
+
+    size_t pos = prefixLength;
+    size_t hostStart = pos, hostEnd;
+    if(url->data[pos] == '[') {
+        /* IPv6 literal */
+        hostStart = ++pos;
+        while(pos < url->length && url->data[pos] != ']')
+            pos++;
+        if(pos == url->length)
+            return UA_STATUSCODE_BADINVALIDARGUMENT;
+        hostEnd = pos++;
+    } else {
+        while(pos < url->length && url->data[pos] != ':' && url->data[pos] != '/')
+            pos++;
+        hostEnd = pos;
+    }
+    if(hostEnd == hostStart || hostEnd - hostStart >= hostSize)
+        return UA_STATUSCODE_BADINVALIDARGUMENT;
+    memcpy(host, &url->data[hostStart], hostEnd - hostStart);
+    host[hostEnd - hostStart] = '\0';
+
+    if(pos >= url->length || url->data[pos] != ':')
+        return UA_STATUSCODE_BADINVALIDARGUMENT;
+    size_t portStart = ++pos;
+    while(pos < url->length && url->data[pos] >= '0' && url->data[pos] <= '9')
+        pos++;
+    if(pos == portStart || pos - portStart >= portSize)
+        return UA_STATUSCODE_BADINVALIDARGUMENT;
+    memcpy(port, &url->data[portStart], pos - portStart);
+    port[pos - portStart] = '\0';
+    return UA_STATUSCODE_GOOD;
+}
+
+/**
+ * Shard Selection
+ * ~~~~~~~~~~~~~~~
+ * The hash is computed from the IP and UDP headers with loads relative to the
+ * network header. This works both in socket filters, where the packet starts
+ * at the UDP header, and in reuseport programs, where it starts at the UDP
+ * payload. IPv6 extension headers are not skipped. */
+
+#define UA_RECEIVER_SHARDPROG_MAXINSNS 24
+
+static size_t
+buildShardProgram(struct sock_filter *prog, int family, size_t shardsSize,
+                  UA_Boolean selectSocket, size_t shard) {
+    size_t n = 0;
+    if(family == AF_INET) {
+        struct sock_filter v4[] = {
+            BPF_STMT(BPF_LD | BPF_W | BPF_ABS, (UA_UInt32)SKF_NET_OFF + 12), /* source */
+            BPF_STMT(BPF_ST, 0),
+            BPF_STMT(BPF_LD | BPF_B | BPF_ABS, (UA_UInt32)SKF_NET_OFF),      /* IHL */
+            BPF_STMT(BPF_ALU | BPF_AND | BPF_K, 0x0F),
+            BPF_STMT(BPF_ALU | BPF_LSH | BPF_K, 2),
+            BPF_STMT(BPF_MISC | BPF_TAX, 0),
+            BPF_STMT(BPF_LD | BPF_H | BPF_IND, (UA_UInt32)SKF_NET_OFF),      /* port */
+        };
+        memcpy(prog, v4, sizeof(v4));
+        n = sizeof(v4) / sizeof(struct sock_filter);
+    } else {
+        struct sock_filter v6[] = {
+            BPF_STMT(BPF_LD | BPF_W | BPF_ABS, (UA_UInt32)SKF_NET_OFF + 20), /* source */
+            BPF_STMT(BPF_ST, 0),
+            BPF_STMT(BPF_LD | BPF_H | BPF_ABS, (UA_UInt32)SKF_NET_OFF + 40), /* port */
+        };
+        memcpy(prog, v6, sizeof(v6));
+        n = sizeof(v6) / sizeof(struct sock_filter);
+    }
+
+    /* (address + port) folded to 16 bit, modulo the number of shards */
+    struct sock_filter hash[] = {
+        BPF_STMT(BPF_LDX | BPF_MEM, 0),
+        BPF_STMT(BPF_ALU | BPF_ADD | BPF_X, 0),
+        BPF_STMT(BPF_ST, 1),
+        BPF_STMT(BPF_ALU | BPF_RSH | BPF_K, 16),
+        BPF_STMT(BPF_LDX | BPF_MEM, 1),
+        BPF_STMT(BPF_ALU | BPF_XOR | BPF_X, 0),
+        BPF_STMT(BPF_ALU | BPF_AND | BPF_K, 0xFFFF),
+        BPF_STMT(BPF_ALU | BPF_MOD | BPF_K, (UA_UInt32)shardsSize),
+    };
+    memcpy(&prog[n], hash, sizeof(hash));
+    n += sizeof(hash) / sizeof(struct sock_filter);
+
+    if(selectSocket) {
+        /* The socket index in the reuseport group */
+        struct sock_filter ret = BPF_STMT(BPF_RET | BPF_A, 0);
+        prog[n++] = ret;
+    } else {
+        struct sock_filter tail[] = {
+            BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, (UA_UInt32)shard, 0, 1),
+            BPF_STMT(BPF_RET | BPF_K, 0xFFFFFFFF),
+            BPF_STMT(BPF_RET | BPF_K, 0),
+        };
+        memcpy(&prog[n], tail, sizeof(tail));
+        n += sizeof(tail) / sizeof(struct sock_filter);
+    }
+    return n;
+}
+
+static UA_StatusCode
+attachShardProgram(UA_PubSubReceiver *receiver, UA_PubSubReceiverShard *shard) {
+    if(receiver->config.shardsSize == 1)
+        return UA_STATUSCODE_GOOD;
+    UA_Boolean multicast = isMulticast(&receiver->address);
+    /* The reuseport program is shared by the group */
+    if(!multicast && shard->index > 0)
+        return UA_STATUSCODE_GOOD;
+
+    struct sock_filter insns[UA_RECEIVER_SHARDPROG_MAXINSNS];
+    struct sock_fprog fprog;
+    fprog.len = (unsigned short)
+        buildShardProgram(insns, receiver->address.ss_family,
+                          receiver->config.shardsSize, !multicast, shard->index);
+    fprog.filter = insns;
+    int option = multicast ? SO_ATTACH_FILTER : SO_ATTACH_REUSEPORT_CBPF;
+    if(setsockopt(shard->sockfd, SOL_SOCKET, option, &fprog, sizeof(fprog)) < 0) {
+        UA_LOG_ERROR(UA_Log_Stdout, UA_LOGCATEGORY_SERVER,
+                     "PubSub receiver: Cannot attach the shard program (%s)", strerror(errno));
+        return UA_STATUSCODE_BADINTERNALERROR;
+    }
+    return UA_STATUSCODE_GOOD;
+}
+
+/* Bind to the port on all addresses and join the group */
+static UA_StatusCode
+openShardSocket(UA_PubSubReceiver *receiver, UA_PubSubReceiverShard *shard) {
+    shard->sockfd = socket(receiver->address.ss_family, SOCK_DGRAM, IPPROTO_UDP);
+    if(shard->sockfd < 0)
+        return UA_STATUSCODE_BADINTERNALERROR;
+    int enable = 1;
+    if(setsockopt(shard->sockfd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable)) < 0 ||
+       setsockopt(shard->sockfd, SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(enable)) < 0)
+        return UA_STATUSCODE_BADINTERNALERROR;
+
+    /* Filter before bind, so that no datagram reaches the wrong shard */
+    UA_Boolean multicast = isMulticast(&receiver->address);
+    if(multicast) {
+        UA_StatusCode retval = attachShardProgram(receiver, shard);
+        if(retval != UA_STATUSCODE_GOOD)
+            return retval;
+    }
+
+    struct sockaddr_storage bindAddress;
+    memset(&bindAddress, 0, sizeof(bindAddress));
+    bindAddress.ss_family = receiver->address.ss_family;
+    if(bindAddress.ss_family == AF_INET) {
+        struct sockaddr_in *sin = (struct sockaddr_in *)&bindAddress;
+        sin->sin_port = ((struct sockaddr_in *)&receiver->address)->sin_port;
+        sin->sin_addr.s_addr = multicast ? htonl(INADDR_ANY) :
+            ((struct sockaddr_in *)&receiver->address)->sin_addr.s_addr;
+    } else {
+        struct sockaddr_in6 *sin6 = (struct sockaddr_in6 *)&bindAddress;
+        sin6->sin6_port = ((struct sockaddr_in6 *)&receiver->address)->sin6_port;
+        sin6->sin6_addr = multicast ? in6addr_any :
+            ((struct sockaddr_in6 *)&receiver->address)->sin6_addr;
+    }
+    if(bind(shard->sockfd, (struct sockaddr*)&bindAddress, receiver->addressLength) < 0) {
+        UA_LOG_ERROR(UA_Log_Stdout, UA_LOGCATEGORY_SERVER,
+                     "PubSub receiver: Cannot bind socket (%s)", strerror(errno));
+        return UA_STATUSCODE_BADINTERNALERROR;
+    }
+    if(!multicast)
+        return attachShardProgram(receiver, shard);
+
+    int res;
+    if(receiver->address.ss_family == AF_INET) {
+        struct ip_mreqn groupRequest;
+        memset(&groupRequest, 0, sizeof(groupRequest));
+        groupRequest.imr_multiaddr = ((struct sockaddr_in *)&receiver->address)->sin_addr;
+        groupRequest.imr_address = receiver->interfaceAddress;
+        groupRequest.imr_ifindex = (int)receiver->interfaceIndex;
+        res = setsockopt(shard->sockfd, IPPROTO_IP, IP_ADD_MEMBERSHIP,
+                         &groupRequest, sizeof(groupRequest));
+    } else {
+        struct ipv6_mreq groupRequest;
+        groupRequest.ipv6mr_multiaddr = ((struct sockaddr_in6 *)&receiver->address)->sin6_addr;
+        groupRequest.ipv6mr_interface = receiver->interfaceIndex;
+        res = setsockopt(shard->sockfd, IPPROTO_IPV6, IPV6_ADD_MEMBERSHIP,
+                         &groupRequest, sizeof(groupRequest));
+    }
+    if(res < 0) {
+        UA_LOG_ERROR(UA_Log_Stdout, UA_LOGCATEGORY_SERVER,
+                     "PubSub receiver: Cannot join the group (%s)", strerror(errno));
+        return UA_STATUSCODE_BADINTERNALERROR;
+    }
+    return UA_STATUSCODE_GOOD;
+}
+
+/**
+ * Workers
+ * ~~~~~~~ */
+
+/* Returns true if the chunk completed a DataSetMessage. Then nm holds it. */
+static UA_Boolean
+UA_PubSubReceiverShard_reassemble(UA_PubSubReceiverShard *shard, const UA_ByteString *buffer,
+                                  UA_NetworkMessage *nm) {
+    UA_PubSubReceiverStatistics *statistics = &shard->statistics;
+    UA_ChunkReassemblerStatistics before, after;
+    UA_ChunkReassembler_getStatistics(shard->reassembler, &before);
+    UA_Boolean complete = false;
+    UA_StatusCode res = UA_ChunkReassembler_add(shard->reassembler, buffer,
+                                                UA_DateTime_nowMonotonic(), nm, &complete);
+    UA_ChunkReassembler_getStatistics(shard->reassembler, &after);
+
+    __atomic_add_fetch(&statistics->chunks, 1, __ATOMIC_RELAXED);
+    UA_UInt64 dropped = (after.timedOut + after.evicted + after.rejected) -
+        (before.timedOut + before.evicted + before.rejected);
+    if(dropped > 0)
+        __atomic_add_fetch(&statistics->chunksDropped, dropped, __ATOMIC_RELAXED);
+    if(res != UA_STATUSCODE_GOOD && res != UA_STATUSCODE_BADENCODINGLIMITSEXCEEDED)
+        __atomic_add_fetch(&statistics->decodeErrors, 1, __ATOMIC_RELAXED);
+    if(complete)
+        __atomic_add_fetch(&statistics->reassembled, 1, __ATOMIC_RELAXED);
+    return complete;
+}
+
+/* The buffer is decrypted in place */
+static UA_Boolean
+UA_PubSubReceiverShard_decode(UA_PubSubReceiverShard *shard, UA_ByteString *buffer) {
+    UA_PubSubReceiver *receiver = shard->receiver;
+    UA_PubSubReceiverStatistics *statistics = &shard->statistics;
+    if(!UA_PubSubReaderFilter_match(&receiver->config.filter, buffer)) {
+        __atomic_add_fetch(&statistics->filtered, 1, __ATOMIC_RELAXED);
+        return false;
+    }
+
+    /* Check for space before the work of decoding */
+    UA_UInt64 head = shard->head;
+    UA_UInt64 tail = __atomic_load_n(&shard->tail, __ATOMIC_ACQUIRE);
+    if(head - tail >= receiver->config.queueSize) {
+        __atomic_add_fetch(&statistics->queueFull, 1, __ATOMIC_RELAXED);
+        return false;
+    }
+
+    /* Decode in place */
+    UA_NetworkMessage *nm = &shard->ring[head & (receiver->config.queueSize - 1)];
+    memset(nm, 0, sizeof(UA_NetworkMessage));
+    UA_StatusCode res;
+#ifdef UA_ENABLE_PUBSUB_ENCRYPTION
+    if(shard->security) {
+        res = UA_PubSubSecurityContext_decode(shard->security, buffer, nm, NULL, 0);
+        if(res == UA_STATUSCODE_BADSECURITYCHECKSFAILED) {
+            UA_NetworkMessage_clear(nm);
+            __atomic_add_fetch(&statistics->securityErrors, 1, __ATOMIC_RELAXED);
+            return false;
+        }
+    } else
+#endif
+    if(UA_NetworkMessage_isChunk(buffer, 0)) {
+        if(!UA_PubSubReceiverShard_reassemble(shard, buffer, nm))
+            return false;
+        res = UA_STATUSCODE_GOOD;
+    } else {
+        size_t offset = 0;
+        res = UA_NetworkMessage_decodeBinary(buffer, &offset, nm);
+    }
+    if(res == UA_STATUSCODE_GOOD && receiver->config.compressionsSize > 0)
+        res = UA_NetworkMessage_expandFields(nm, receiver->config.compressionsSize,
+                                             receiver->config.compressions);
+    UA_PUBSUB_TRACE(rx_decoded, UA_PubSubTrace_writerGroupId(nm),
+                    UA_PubSubTrace_dataSetWriterId(nm),
+                    UA_PubSubTrace_sequenceNumber(nm), buffer->length, res);
+    if(res != UA_STATUSCODE_GOOD) {
+        UA_NetworkMessage_clear(nm);
+        __atomic_add_fetch(&statistics->decodeErrors, 1, __ATOMIC_RELAXED);
+        return false;
+    }
+    __atomic_store_n(&shard->head, head + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+static void *
+UA_PubSubReceiverShard_run(void *arg) {
+    UA_PubSubReceiverShard *shard = (UA_PubSubReceiverShard *)arg;
+    UA_PubSubReceiver *receiver = shard->receiver;
+    UA_ByteString buffer;
+    if(UA_ByteString_allocBuffer(&buffer, receiver->config.maxMessageSize) != UA_STATUSCODE_GOOD) {
+        UA_LOG_ERROR(UA_Log_Stdout, UA_LOGCATEGORY_SERVER,
+                     "PubSub receiver: Out of memory in worker %lu",
+                     (unsigned long)shard->index);
+        return NULL;
+    }
+    size_t bufferSize = buffer.length;
+
+    while(__atomic_load_n(&receiver->running, __ATOMIC_ACQUIRE)) {
+        /* Woken up by shutdown() when the receiver is deleted */
+        ssize_t received = recv(shard->sockfd, buffer.data, bufferSize, 0);
+        if(received < 0) {
+            if(errno == EINTR || errno == EAGAIN)
+                continue;
+            UA_LOG_ERROR(UA_Log_Stdout, UA_LOGCATEGORY_SERVER,
+                         "PubSub receiver: Worker %lu stopped (%s)",
+                         (unsigned long)shard->index, strerror(errno));
+            break;
+        }
+        if(received == 0)
+            continue;
+        __atomic_add_fetch(&shard->statistics.received, 1, __ATOMIC_RELAXED);
+        UA_PUBSUB_TRACE(rx_received, shard->index, received);
+        buffer.length = (size_t)received;
+        UA_PubSubReceiverShard_decode(shard, &buffer);
+    }
+
+    buffer.length = bufferSize;
+    UA_ByteString_clear(&buffer);
+    return NULL;
+}
+
+/**
+ * Receiver
+ * ~~~~~~~~ */
+
+static UA_StatusCode
+UA_PubSubReceiver_setAddress(UA_PubSubReceiver *receiver,
+                             const UA_PubSubConnectionConfig *connectionConfig) {
+    if(!UA_Variant_hasScalarType(&connectionConfig->address,
+                                 &UA_TYPES[UA_TYPES_NETWORKADDRESSURLDATATYPE]))
+        return UA_STATUSCODE_BADINVALIDARGUMENT;
+    const UA_NetworkAddressUrlDataType *address =
+        (const UA_NetworkAddressUrlDataType *)connectionConfig->address.data;
+
+    char host[256], port[8];
+    if(parseUdpUrl(&address->url, host, sizeof(host), port, sizeof(port)) != UA_STATUSCODE_GOOD)
+        return UA_STATUSCODE_BADINVALIDARGUMENT;
+    struct addrinfo hints, *rp;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+    hints.ai_protocol = IPPROTO_UDP;
+    if(getaddrinfo(host, port, &hints, &rp) != 0 || !rp)
+        return UA_STATUSCODE_BADINVALIDARGUMENT;
+    memcpy(&receiver->address, rp->ai_addr, rp->ai_addrlen);
+    receiver->addressLength = rp->ai_addrlen;
+    freeaddrinfo(rp);
+
+    /* The interface is given either by name or by IPv4 address */
+    if(address->networkInterface.length > 0 && address->networkInterface.length < IF_NAMESIZE + 16) {
+        char ifName[IF_NAMESIZE + 16];
+        memcpy(ifName, address->networkInterface.data, address->networkInterface.length);
+        ifName[address->networkInterface.length] = '\0';
+        receiver->interfaceIndex = if_nametoindex(ifName);
+        if(receiver->interfaceIndex == 0 &&
+           inet_pton(AF_INET, ifName, &receiver->interfaceAddress) != 1)
+            return UA_STATUSCODE_BADINVALIDARGUMENT;
+    }
+    return UA_STATUSCODE_GOOD;
+}
+
+static UA_StatusCode
+UA_PubSubReceiver_startWorker(UA_PubSubReceiver *receiver, UA_PubSubReceiverShard *shard) {
+    if(pthread_create(&shard->thread, NULL, UA_PubSubReceiverShard_run, shard) != 0)
+        return UA_STATUSCODE_BADINTERNALERROR;
+    shard->threadStarted = true;
+    if(receiver->config.pinWorkers) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        cpu_set_t cpuSet;
+        CPU_ZERO(&cpuSet);
+        CPU_SET((int)(shard->index % (size_t)(cpus > 0 ? cpus : 1)), &cpuSet);
+        if(pthread_setaffinity_np(shard->thread, sizeof(cpuSet), &cpuSet) != 0)
+            UA_LOG_WARNING(UA_Log_Stdout, UA_LOGCATEGORY_SERVER,
+                           "PubSub receiver: Cannot pin worker %lu",
+                           (unsigned long)shard->index);
+    }
+    return UA_STATUSCODE_GOOD;
+}
+
+static void
+UA_PubSubReceiver_clearCompressions(UA_PubSubReceiver *receiver) {
+    for(size_t i = 0; i < receiver->config.compressionsSize; i++)
+        UA_free((void *)(uintptr_t)receiver->compressions[i].fields);
+    UA_free(receiver->compressions);
+    receiver->compressions = NULL;
+    receiver->config.compressions = NULL;
+    receiver->config.compressionsSize = 0;
+}
+
+/* Deep copy, the compressions of the caller can be freed */
+static UA_StatusCode
+UA_PubSubReceiver_copyCompressions(UA_PubSubReceiver *receiver,
+                                   const UA_PubSubReceiverConfig *config) {
+    if(config->compressionsSize == 0)
+        return UA_STATUSCODE_GOOD;
+    UA_DataSetCompression *compressions = (UA_DataSetCompression *)
+        UA_calloc(config->compressionsSize, sizeof(UA_DataSetCompression));
+    if(!compressions)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    receiver->compressions = compressions;
+    receiver->config.compressions = compressions;
+    for(size_t i = 0; i < config->compressionsSize; i++) {
+        const UA_DataSetCompression *src = &config->compressions[i];
+        UA_FieldCompression *fields = NULL;
+        if(src->fieldsSize > 0) {
+            fields = (UA_FieldCompression *)
+                UA_malloc(src->fieldsSize * sizeof(UA_FieldCompression));
+            if(!fields)
+                return UA_STATUSCODE_BADOUTOFMEMORY;
+            memcpy(fields, src->fields, src->fieldsSize * sizeof(UA_FieldCompression));
+        }
+        compressions[i].dataSetWriterId = src->dataSetWriterId;
+        compressions[i].fieldsSize = src->fieldsSize;
+        compressions[i].fields = fields;
+        receiver->config.compressionsSize++;
+    }
+    return UA_STATUSCODE_GOOD;
+}
+
+UA_PubSubReceiver *
+UA_PubSubReceiver_new(const UA_PubSubConnectionConfig *connectionConfig,
+                      const UA_PubSubReceiverConfig *config) {
+    if(!connectionConfig || !config)
+        return NULL;
+    UA_PubSubReceiver *receiver = (UA_PubSubReceiver *) UA_calloc(1, sizeof(UA_PubSubReceiver));
+    if(!receiver)
+        return NULL;
+    receiver->config = *config;
+    if(config->security) {
+        receiver->security = *config->security;
+        receiver->config.security = &receiver->security;
+    }
+    UA_Variant_init(&receiver->config.filter.publisherId);
+    receiver->config.compressionsSize = 0;
+    receiver->config.compressions = NULL;
+    if(UA_Variant_copy(&config->filter.publisherId,
+                       &receiver->config.filter.publisherId) != UA_STATUSCODE_GOOD ||
+       UA_PubSubReceiver_copyCompressions(receiver, config) != UA_STATUSCODE_GOOD) {
+        UA_PubSubReceiver_delete(receiver);
+        return NULL;
+    }
+
+    /* Defaults */
+    if(receiver->config.shardsSize == 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        receiver->config.shardsSize = (cpus > 0) ? (size_t)cpus : 1;
+    }
+    if(receiver->config.queueSize == 0)
+        receiver->config.queueSize = UA_RECEIVER_DEFAULT_QUEUESIZE;
+    if(receiver->config.maxMessageSize == 0)
+        receiver->config.maxMessageSize = UA_RECEIVER_DEFAULT_MESSAGESIZE;
+    if(receiver->config.shardsSize > UA_RECEIVER_MAX_SHARDS ||
+       (receiver->config.queueSize & (receiver->config.queueSize - 1)) != 0) {
+        UA_LOG_ERROR(UA_Log_Stdout, UA_LOGCATEGORY_SERVER,
+                     "PubSub receiver creation failed. Invalid configuration.");
+        UA_PubSubReceiver_delete(receiver);
+        return NULL;
+    }
+    if(UA_PubSubReceiver_setAddress(receiver, connectionConfig) != UA_STATUSCODE_GOOD) {
+        UA_LOG_ERROR(UA_Log_Stdout, UA_LOGCATEGORY_SERVER,
+                     "PubSub receiver creation failed. Invalid address.");
+        UA_PubSubReceiver_delete(receiver);
+        return NULL;
+    }
+
+    /* The shards are aligned for the cache line separation of head and tail */
+    size_t shardsSize = receiver->config.shardsSize;
+    if(posix_memalign((void**)&receiver->shards, UA_RECEIVER_CACHELINE,
+                      shardsSize * sizeof(UA_PubSubReceiverShard)) != 0) {
+        receiver->shards = NULL;
+        UA_PubSubReceiver_delete(receiver);
+        return NULL;
+    }
+    memset(receiver->shards, 0, shardsSize * sizeof(UA_PubSubReceiverShard));
+    for(size_t i = 0; i < shardsSize; i++) {
+        receiver->shards[i].receiver = receiver;
+        receiver->shards[i].index = i;
+        receiver->shards[i].sockfd = -1;
+    }
+
+    /* The sockets join the reuseport group in the order of the shards */
+    for(size_t i = 0; i < shardsSize; i++) {
+        UA_PubSubReceiverShard *shard = &receiver->shards[i];
+        shard->ring = (UA_NetworkMessage *)
+            UA_calloc(receiver->config.queueSize, sizeof(UA_NetworkMessage));
+        shard->reassembler = UA_ChunkReassembler_new(&receiver->config.chunks);
+        UA_Boolean securityReady = (receiver->config.security == NULL);
+#ifdef UA_ENABLE_PUBSUB_ENCRYPTION
+        if(receiver->config.security) {
+            shard->security = UA_PubSubSecurityContext_new(receiver->config.security);
+            securityReady = (shard->security != NULL);
+        }
+#endif
+        if(!shard->ring || !shard->reassembler || !securityReady ||
+           openShardSocket(receiver, shard) != UA_STATUSCODE_GOOD) {
+            UA_LOG_ERROR(UA_Log_Stdout, UA_LOGCATEGORY_SERVER,
+                         "PubSub receiver creation failed. Cannot set up shard %lu.",
+                         (unsigned long)i);
+            UA_PubSubReceiver_delete(receiver);
+            return NULL;
+        }
+    }
+
+    receiver->running = true;
+    for(size_t i = 0; i < shardsSize; i++) {
+        if(UA_PubSubReceiver_startWorker(receiver, &receiver->shards[i]) != UA_STATUSCODE_GOOD) {
+            UA_LOG_ERROR(UA_Log_Stdout, UA_LOGCATEGORY_SERVER,
+                         "PubSub receiver creation failed. Cannot start the workers.");
+            UA_PubSubReceiver_delete(receiver);
+            return NULL;
+        }
+    }
+    return receiver;
+}
+
+void
+UA_PubSubReceiver_delete(UA_PubSubReceiver *receiver) {
+    if(!receiver)
+        return;
+    __atomic_store_n(&receiver->running, false, __ATOMIC_RELEASE);
+    if(receiver->shards) {
+        for(size_t i = 0; i < receiver->config.shardsSize; i++) {
+            UA_PubSubReceiverShard *shard = &receiver->shards[i];
+            if(shard->threadStarted) {
+                shutdown(shard->sockfd, SHUT_RD);
+                pthread_join(shard->thread, NULL);
+            }
+            if(shard->sockfd >= 0)
+                close(shard->sockfd); /* also leaves the group */
+            if(shard->ring) {
+                for(UA_UInt64 j = shard->tail; j != shard->head; j++)
+                    UA_NetworkMessage_clear(&shard->ring[j & (receiver->config.queueSize - 1)]);
+                UA_free(shard->ring);
+            }
+            UA_ChunkReassembler_delete(shard->reassembler);
+#ifdef UA_ENABLE_PUBSUB_ENCRYPTION
+            UA_PubSubSecurityContext_delete(shard->security);
+#endif
+        }
+        free(receiver->shards);
+    }
+    UA_Variant_deleteMembers(&receiver->config.filter.publisherId);
+    UA_PubSubReceiver_clearCompressions(receiver);
+    memset(&receiver->security, 0, sizeof(UA_PubSubSecurityConfig));
+    UA_free(receiver);
+}
+
+size_t
+UA_PubSubReceiver_process(UA_PubSubReceiver *receiver, size_t max,
+                          UA_PubSubReceiverCallback callback, void *context) {
+    size_t shardsSize = receiver->config.shardsSize;
+    size_t mask = receiver->config.queueSize - 1;
+    size_t count = 0;
+    size_t idle = 0;
+    /* One message per shard in turn until all are empty */
+    while(count < max && idle < shardsSize) {
+        UA_PubSubReceiverShard *shard = &receiver->shards[receiver->nextShard];
+        receiver->nextShard = (receiver->nextShard + 1) % shardsSize;
+        UA_UInt64 tail = shard->tail;
+        if(tail == __atomic_load_n(&shard->head, __ATOMIC_ACQUIRE)) {
+            idle++;
+            continue;
+        }
+        idle = 0;
+        UA_NetworkMessage *nm = &shard->ring[tail & mask];
+        UA_PUBSUB_TRACE(rx_dispatched, UA_PubSubTrace_writerGroupId(nm),
+                        UA_PubSubTrace_dataSetWriterId(nm),
+                        UA_PubSubTrace_sequenceNumber(nm), shard->index);
+        callback(context, nm);
+        UA_NetworkMessage_clear(nm);
+        __atomic_store_n(&shard->tail, tail + 1, __ATOMIC_RELEASE);
+        count++;
+    }
+    return count;
+}
+
+size_t
+UA_PubSubReceiver_getShardsSize(const UA_PubSubReceiver *receiver) {
+    return receiver->config.shardsSize;
+}
+
+UA_StatusCode
+UA_PubSubReceiver_getStatistics(const UA_PubSubReceiver *receiver, size_t shard,
+                                UA_PubSubReceiverStatistics *statistics) {
+    if(shard >= receiver->config.shardsSize)
+        return UA_STATUSCODE_BADINVALIDARGUMENT;
+    const UA_PubSubReceiverStatistics *s = &receiver->shards[shard].statistics;
+    statistics->received = __atomic_load_n(&s->received, __ATOMIC_RELAXED);
+    statistics->filtered = __atomic_load_n(&s->filtered, __ATOMIC_RELAXED);
+    statistics->decodeErrors = __atomic_load_n(&s->decodeErrors, __ATOMIC_RELAXED);
+    statistics->queueFull = __atomic_load_n(&s->queueFull, __ATOMIC_RELAXED);
+    statistics->chunks = __atomic_load_n(&s->chunks, __ATOMIC_RELAXED);
+    statistics->reassembled = __atomic_load_n(&s->reassembled, __ATOMIC_RELAXED);
+    statistics->chunksDropped = __atomic_load_n(&s->chunksDropped, __ATOMIC_RELAXED);
+    statistics->securityErrors = __atomic_load_n(&s->securityErrors, __ATOMIC_RELAXED);
+    return UA_STATUSCODE_GOOD;
+}
+
+#endif /* UA_ENABLE_PUBSUB_RECEIVER */
@@ -0,0 +1,121 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef UA_PUBSUB_RECEIVER_H_
+#define UA_PUBSUB_RECEIVER_H_
+
+#include <open62541/plugin/pubsub.h>
+
+#include "ua_pubsub_networkmessage.h"
+#include "ua_pubsub_readerfilter.h"
+#include "ua_pubsub_chunk.h"
+#include "ua_pubsub_compress.h"
+#include "ua_pubsub_security.h"
+
+_UA_BEGIN_DECLS
+
+#ifdef UA_ENABLE_PUBSUB_RECEIVER /* conditional compilation */
+
+/**
+ * Sharded Receiver
+ * ----------------
+ * Receives and decodes the UADP messages of a UDP connection on several
+ * worker threads (Linux only, link with pthread). Each worker has its own
+ * socket bound to the same address with ``SO_REUSEPORT``. A BPF program
+ * hashes the source address and port of every datagram to a shard, so all
+ * messages of a publisher are handled by the same worker in the order they
+ * arrive. For unicast addresses the program selects the socket of the
+ * reuseport group. Multicast datagrams are delivered to every socket, there
+ * each socket drops the datagrams of the other shards.
+ *
+ * The workers decode the messages into a single-producer single-consumer ring
+ * per shard. The server thread takes them out with
+ * ``UA_PubSubReceiver_process``. If a ring is full, the worker drops new
+ * messages until the server thread catches up.
+ *
+ * Chunk messages are put back together by a chunk reassembler per worker
+ * before they go into the ring. The chunks of a DataSetMessage come from the
+ * same publisher and therefore to the same worker.
+ *
+ * With a security configuration, every worker verifies and decrypts the
+ * messages with its own security context (``ua_pubsub_security.h``).
+ * Messages that are not protected with the configured keys are dropped.
+ *
+ * The workers also expand compressed fields (``ua_pubsub_compress.h``) of the
+ * configured DataSetWriters. Messages with fields that do not match the
+ * compression count as decode errors.
+ *
+ * The address is taken from the connection config (``opc.udp://host:port/``
+ * and optionally the interface name or IPv4 address). Sending is not
+ * supported; use a regular connection for that. */
+
+typedef struct {
+    /* Number of worker threads and sockets. 0 selects the number of online
+     * CPUs. */
+    size_t shardsSize;
+    /* Decoded messages per shard (power of two). 0 selects 256. */
+    size_t queueSize;
+    /* Receive buffer per worker. 0 selects 65535 bytes. */
+    size_t maxMessageSize;
+    /* Pin worker i to CPU i (modulo the number of CPUs) */
+    UA_Boolean pinWorkers;
+    /* Messages are skipped before decoding if they do not match. Copied. */
+    UA_PubSubReaderFilter filter;
+    /* Limits of the chunk reassembler of every worker */
+    UA_ChunkReassemblerConfig chunks;
+    /* Keys of the security group. NULL for unsecured messages. Copied.
+     * Requires UA_ENABLE_PUBSUB_ENCRYPTION. */
+    const UA_PubSubSecurityConfig *security;
+    /* Compressed fields per DataSetWriterId. Copied. */
+    size_t compressionsSize;
+    const UA_DataSetCompression *compressions;
+} UA_PubSubReceiverConfig;
+
+typedef struct {
+    UA_UInt64 received;     /* datagrams read from the socket */
+    UA_UInt64 filtered;     /* skipped by the reader filter */
+    UA_UInt64 decodeErrors;
+    UA_UInt64 queueFull;    /* decoded messages that found the ring full */
+    UA_UInt64 chunks;
+    UA_UInt64 reassembled;  /* DataSetMessages put together from chunks */
+    UA_UInt64 chunksDropped; /* incomplete messages: timed out, evicted or rejected */
+    UA_UInt64 securityErrors; /* not signed or encrypted as configured */
+} UA_PubSubReceiverStatistics;
+
+struct UA_PubSubReceiver;
+typedef struct UA_PubSubReceiver UA_PubSubReceiver;
+
+/* Opens the sockets and starts the workers. Returns NULL on failure. */
+UA_PubSubReceiver UA_EXPORT *
+UA_PubSubReceiver_new(const UA_PubSubConnectionConfig *connectionConfig,
+                      const UA_PubSubReceiverConfig *config);
+
+/* Stops the workers and frees the queued messages */
+void UA_EXPORT
+UA_PubSubReceiver_delete(UA_PubSubReceiver *receiver);
+
+typedef void
+(*UA_PubSubReceiverCallback)(void *context, UA_NetworkMessage *networkMessage);
+
+/* Must be called from one thread. Hands up to max decoded messages to the
+ * callback, taking them from the shards in turn. The message is cleared after
+ * the callback returns; the callback may move content out of it. Returns the
+ * number of messages. */
+size_t UA_EXPORT
+UA_PubSubReceiver_process(UA_PubSubReceiver *receiver, size_t max,
+                          UA_PubSubReceiverCallback callback, void *context);
+
+size_t UA_EXPORT
+UA_PubSubReceiver_getShardsSize(const UA_PubSubReceiver *receiver);
+
+UA_StatusCode UA_EXPORT
+UA_PubSubReceiver_getStatistics(const UA_PubSubReceiver *receiver, size_t shard,
+                                UA_PubSubReceiverStatistics *statistics);
+
+#endif /* UA_ENABLE_PUBSUB_RECEIVER */
+
+_UA_END_DECLS
+
+#endif /* UA_PUBSUB_RECEIVER_H_ */
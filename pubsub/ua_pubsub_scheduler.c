@@ -0,0 +1,370 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include "ua_pubsub_scheduler.h"
+
+#ifdef UA_ENABLE_PUBSUB /* conditional compilation */
+
+#include "ua_util_internal.h"
+
+#include <stdlib.h>
+
+/* Entries with more due times per cycle of a new entry are ignored for the
+ * automatic phase. They coincide with every phase anyway. */
+#define UA_PUBSUB_SCHEDULER_MAXPOINTS UA_PUBSUB_SCHEDULER_SLOTS
+
+typedef struct UA_PubSubSchedulerEntry {
+    LIST_ENTRY(UA_PubSubSchedulerEntry) listEntry;
+    LIST_ENTRY(UA_PubSubSchedulerEntry) slotEntry;
+    UA_Boolean inSlot; /* Not in the slot while the entry waits to run */
+    UA_UInt64 id;
+    UA_Int64 interval; /* in ticks */
+    UA_Int64 phase;    /* in ticks; < interval */
+    UA_Int64 due;      /* tick of the next run */
+    UA_Byte priority;
+    UA_PubSubScheduledCallback callback;
+    void *data;
+
+    /* Statistics */
+    UA_UInt64 cycles;
+    UA_UInt64 missedCycles;
+    UA_DateTime lastLateness;
+    UA_DateTime maxLateness;
+    UA_Double sumLateness;
+} UA_PubSubSchedulerEntry;
+
+struct UA_PubSubScheduler {
+    UA_DateTime start;      /* monotonic time of tick 0 */
+    UA_DateTime resolution; /* length of a tick */
+    UA_Int64 lastTick;      /* last processed tick */
+    UA_UInt64 lastId;
+    size_t entriesSize;
+    LIST_HEAD(UA_ListOfPubSubSchedulerEntry, UA_PubSubSchedulerEntry) entries;
+    LIST_HEAD(UA_ListOfPubSubSchedulerSlot, UA_PubSubSchedulerEntry) slots[UA_PUBSUB_SCHEDULER_SLOTS];
+
+    /* The due entries of the current process call */
+    UA_PubSubSchedulerEntry **batch;
+    size_t batchSize;
+    size_t batchCapacity;
+};
+
+static UA_DateTime
+dueTime(const UA_PubSubScheduler *scheduler, UA_Int64 tick) {
+    return scheduler->start + tick * scheduler->resolution;
+}
+
+static void
+insertEntry(UA_PubSubScheduler *scheduler, UA_PubSubSchedulerEntry *entry) {
+    size_t slot = (size_t)(entry->due % UA_PUBSUB_SCHEDULER_SLOTS);
+    LIST_INSERT_HEAD(&scheduler->slots[slot], entry, slotEntry);
+    entry->inSlot = true;
+}
+
+static UA_PubSubSchedulerEntry *
+findEntry(const UA_PubSubScheduler *scheduler, UA_UInt64 id) {
+    UA_PubSubSchedulerEntry *entry;
+    LIST_FOREACH(entry, &scheduler->entries, listEntry) {
+        if(entry->id == id)
+            return entry;
+    }
+    return NULL;
+}
+
+UA_PubSubScheduler *
+UA_PubSubScheduler_new(UA_Duration resolution) {
+    UA_PubSubScheduler *scheduler = (UA_PubSubScheduler *)
+        UA_calloc(1, sizeof(UA_PubSubScheduler));
+    if(!scheduler)
+        return NULL;
+    scheduler->start = UA_DateTime_nowMonotonic();
+    scheduler->resolution = (UA_DateTime)(resolution * (UA_Double)UA_DATETIME_MSEC);
+    if(scheduler->resolution < 1)
+        scheduler->resolution = 1;
+    return scheduler;
+}
+
+void
+UA_PubSubScheduler_delete(UA_PubSubScheduler *scheduler) {
+    UA_PubSubSchedulerEntry *entry, *tmp;
+    LIST_FOREACH_SAFE(entry, &scheduler->entries, listEntry, tmp) {
+        LIST_REMOVE(entry, listEntry);
+        UA_free(entry);
+    }
+    UA_free(scheduler->batch);
+    UA_free(scheduler);
+}
+
+static UA_Int64
+gcd(UA_Int64 a, UA_Int64 b) {
+    while(b != 0) {
+        UA_Int64 t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+static int
+compareInt64(const void *a, const void *b) {
+    UA_Int64 x = *(const UA_Int64 *)a;
+    UA_Int64 y = *(const UA_Int64 *)b;
+    return (x > y) - (x < y);
+}
+
+/* The phase in the middle of the largest gap between the due times of the
+ * existing entries, projected onto one cycle of the new entry */
+static UA_Int64
+automaticPhase(const UA_PubSubScheduler *scheduler, UA_Int64 interval) {
+    size_t pointsSize = 0;
+    const UA_PubSubSchedulerEntry *entry;
+    LIST_FOREACH(entry, &scheduler->entries, listEntry) {
+        UA_Int64 points = interval / gcd(interval, entry->interval);
+        if(points <= UA_PUBSUB_SCHEDULER_MAXPOINTS)
+            pointsSize += (size_t)points;
+    }
+    if(pointsSize == 0)
+        return 0;
+    UA_Int64 *points = (UA_Int64 *)UA_malloc(pointsSize * sizeof(UA_Int64));
+    if(!points)
+        return 0;
+
+    size_t pos = 0;
+    LIST_FOREACH(entry, &scheduler->entries, listEntry) {
+        UA_Int64 g = gcd(interval, entry->interval);
+        if(interval / g > UA_PUBSUB_SCHEDULER_MAXPOINTS)
+            continue;
+        for(UA_Int64 p = entry->phase % g; p < interval; p += g)
+            points[pos++] = p;
+    }
+    qsort(points, pointsSize, sizeof(UA_Int64), compareInt64);
+
+    /* The gap after the last point wraps around */
+    UA_Int64 gapStart = points[pointsSize - 1];
+    UA_Int64 gap = points[0] + interval - points[pointsSize - 1];
+    for(size_t i = 1; i < pointsSize; i++) {
+        if(points[i] - points[i - 1] > gap) {
+            gapStart = points[i - 1];
+            gap = points[i] - points[i - 1];
+        }
+    }
+    UA_free(points);
+    return (gapStart + gap / 2) % interval;
+}
+
+UA_StatusCode
+UA_PubSubScheduler_add(UA_PubSubScheduler *scheduler, UA_Duration interval,
+                       UA_Duration phase, UA_Byte priority, UA_DateTime notBefore,
+                       UA_PubSubScheduledCallback callback, void *data, UA_UInt64 *id) {
+    if(!callback || interval <= 0.0)
+        return UA_STATUSCODE_BADINVALIDARGUMENT;
+
+    /* Room for the entry in the batch */
+    if(scheduler->batchCapacity <= scheduler->entriesSize) {
+        size_t capacity = scheduler->batchCapacity * 2;
+        if(capacity < 8)
+            capacity = 8;
+        UA_PubSubSchedulerEntry **batch = (UA_PubSubSchedulerEntry **)
+            UA_realloc(scheduler->batch, capacity * sizeof(UA_PubSubSchedulerEntry *));
+        if(!batch)
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+        scheduler->batch = batch;
+        scheduler->batchCapacity = capacity;
+    }
+
+    UA_PubSubSchedulerEntry *entry = (UA_PubSubSchedulerEntry *)
+        UA_calloc(1, sizeof(UA_PubSubSchedulerEntry));
+    if(!entry)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    UA_Double res = (UA_Double)scheduler->resolution;
+    entry->interval = (UA_Int64)(interval * (UA_Double)UA_DATETIME_MSEC / res + 0.5);
+    if(entry->interval < 1)
+        entry->interval = 1;
+    if(phase < 0.0)
+        entry->phase = automaticPhase(scheduler, entry->interval);
+    else
+        entry->phase = (UA_Int64)(phase * (UA_Double)UA_DATETIME_MSEC / res + 0.5) %
+            entry->interval;
+    entry->priority = priority;
+    entry->callback = callback;
+    entry->data = data;
+    entry->id = ++scheduler->lastId;
+
+    /* The first due time at or after the first tick after notBefore. Never
+     * before the last processed tick, so the entry is found by the next
+     * process call. */
+    UA_DateTime now = UA_DateTime_nowMonotonic();
+    if(notBefore < now)
+        notBefore = now;
+    UA_Int64 tick = (notBefore - scheduler->start + scheduler->resolution - 1) /
+        scheduler->resolution;
+    if(tick < scheduler->lastTick)
+        tick = scheduler->lastTick;
+    entry->due = entry->phase;
+    if(tick > entry->phase)
+        entry->due += ((tick - entry->phase + entry->interval - 1) / entry->interval) *
+            entry->interval;
+
+    LIST_INSERT_HEAD(&scheduler->entries, entry, listEntry);
+    scheduler->entriesSize++;
+    insertEntry(scheduler, entry);
+    if(id)
+        *id = entry->id;
+    return UA_STATUSCODE_GOOD;
+}
+
+UA_StatusCode
+UA_PubSubScheduler_remove(UA_PubSubScheduler *scheduler, UA_UInt64 id) {
+    UA_PubSubSchedulerEntry *entry = findEntry(scheduler, id);
+    if(!entry)
+        return UA_STATUSCODE_BADNOTFOUND;
+    if(entry->inSlot) {
+        LIST_REMOVE(entry, slotEntry);
+    } else {
+        /* Waiting in the batch of the current process call */
+        for(size_t i = 0; i < scheduler->batchSize; i++) {
+            if(scheduler->batch[i] == entry)
+                scheduler->batch[i] = NULL;
+        }
+    }
+    LIST_REMOVE(entry, listEntry);
+    scheduler->entriesSize--;
+    UA_free(entry);
+    return UA_STATUSCODE_GOOD;
+}
+
+UA_StatusCode
+UA_PubSubScheduler_setPriority(UA_PubSubScheduler *scheduler, UA_UInt64 id,
+                               UA_Byte priority) {
+    UA_PubSubSchedulerEntry *entry = findEntry(scheduler, id);
+    if(!entry)
+        return UA_STATUSCODE_BADNOTFOUND;
+    entry->priority = priority;
+    return UA_STATUSCODE_GOOD;
+}
+
+UA_StatusCode
+UA_PubSubScheduler_getStatistics(const UA_PubSubScheduler *scheduler, UA_UInt64 id,
+                                 UA_PubSubScheduleStatistics *statistics) {
+    const UA_PubSubSchedulerEntry *entry = findEntry(scheduler, id);
+    if(!entry)
+        return UA_STATUSCODE_BADNOTFOUND;
+    UA_Double msec = (UA_Double)UA_DATETIME_MSEC;
+    statistics->phase = (UA_Double)(entry->phase * scheduler->resolution) / msec;
+    statistics->cycles = entry->cycles;
+    statistics->missedCycles = entry->missedCycles;
+    statistics->lastLateness = (UA_Double)entry->lastLateness / msec;
+    statistics->maxLateness = (UA_Double)entry->maxLateness / msec;
+    statistics->meanLateness = 0.0;
+    if(entry->cycles > 0)
+        statistics->meanLateness = entry->sumLateness / (UA_Double)entry->cycles / msec;
+    return UA_STATUSCODE_GOOD;
+}
+
+size_t
+UA_PubSubScheduler_size(const UA_PubSubScheduler *scheduler) {
+    return scheduler->entriesSize;
+}
+
+UA_DateTime
+UA_PubSubScheduler_nextDue(const UA_PubSubScheduler *scheduler) {
+    if(scheduler->entriesSize == 0)
+        return 0;
+
+    /* The first slot with an entry that is due in this revolution */
+    const UA_PubSubSchedulerEntry *entry;
+    for(UA_Int64 tick = scheduler->lastTick;
+        tick < scheduler->lastTick + UA_PUBSUB_SCHEDULER_SLOTS; tick++) {
+        UA_Int64 due = -1;
+        LIST_FOREACH(entry, &scheduler->slots[tick % UA_PUBSUB_SCHEDULER_SLOTS], slotEntry) {
+            if(entry->due <= tick && (due < 0 || entry->due < due))
+                due = entry->due;
+        }
+        if(due >= 0)
+            return dueTime(scheduler, due);
+    }
+
+    /* All entries are due in later revolutions */
+    UA_Int64 due = -1;
+    LIST_FOREACH(entry, &scheduler->entries, listEntry) {
+        if(entry->inSlot && (due < 0 || entry->due < due))
+            due = entry->due;
+    }
+    return (due < 0) ? 0 : dueTime(scheduler, due);
+}
+
+/* By descending priority, then by due time and the order of adding */
+static int
+compareEntries(const void *a, const void *b) {
+    const UA_PubSubSchedulerEntry *x = *(UA_PubSubSchedulerEntry *const *)a;
+    const UA_PubSubSchedulerEntry *y = *(UA_PubSubSchedulerEntry *const *)b;
+    if(x->priority != y->priority)
+        return (x->priority < y->priority) ? 1 : -1;
+    if(x->due != y->due)
+        return (x->due > y->due) - (x->due < y->due);
+    return (x->id > y->id) - (x->id < y->id);
+}
+
+void
+UA_PubSubScheduler_process(UA_PubSubScheduler *scheduler, void *application) {
+    UA_DateTime now = UA_DateTime_nowMonotonic();
+    UA_Int64 tick = (now - scheduler->start) / scheduler->resolution;
+    if(tick < scheduler->lastTick || scheduler->batchSize > 0)
+        return; /* Called from a callback */
+
+    /* Take the due entries out of the wheel. The last processed slot is
+     * visited again for entries that were added since. */
+    UA_Int64 first = scheduler->lastTick;
+    if(tick - first >= UA_PUBSUB_SCHEDULER_SLOTS)
+        first = tick - UA_PUBSUB_SCHEDULER_SLOTS + 1;
+    for(UA_Int64 t = first; t <= tick; t++) {
+        UA_PubSubSchedulerEntry *entry, *tmp;
+        LIST_FOREACH_SAFE(entry, &scheduler->slots[t % UA_PUBSUB_SCHEDULER_SLOTS],
+                          slotEntry, tmp) {
+            if(entry->due > tick)
+                continue;
+            LIST_REMOVE(entry, slotEntry);
+            entry->inSlot = false;
+            scheduler->batch[scheduler->batchSize++] = entry;
+        }
+    }
+    scheduler->lastTick = tick;
+    if(scheduler->batchSize == 0)
+        return;
+    qsort(scheduler->batch, scheduler->batchSize,
+          sizeof(UA_PubSubSchedulerEntry *), compareEntries);
+
+    for(size_t i = 0; i < scheduler->batchSize; i++) {
+        UA_PubSubSchedulerEntry *entry = scheduler->batch[i];
+        if(!entry)
+            continue; /* Removed by an earlier callback */
+        scheduler->batch[i] = NULL;
+
+        /* The lateness at the start of this callback */
+        UA_DateTime start = UA_DateTime_nowMonotonic();
+        UA_DateTime lateness = start - dueTime(scheduler, entry->due);
+        if(lateness < 0)
+            lateness = 0;
+        entry->cycles++;
+        entry->lastLateness = lateness;
+        entry->sumLateness += (UA_Double)lateness;
+        if(lateness > entry->maxLateness)
+            entry->maxLateness = lateness;
+
+        /* Skip the cycles that have already passed. The entry is back in the
+         * wheel before the callback, which may remove it. */
+        UA_Int64 current = (start - scheduler->start) / scheduler->resolution;
+        UA_Int64 missed = 0;
+        if(current > entry->due)
+            missed = (current - entry->due) / entry->interval;
+        entry->missedCycles += (UA_UInt64)missed;
+        entry->due += (missed + 1) * entry->interval;
+        insertEntry(scheduler, entry);
+
+        entry->callback(application, entry->data);
+    }
+    scheduler->batchSize = 0;
+}
+
+#endif /* UA_ENABLE_PUBSUB */
@@ -0,0 +1,94 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef UA_PUBSUB_SCHEDULER_H_
+#define UA_PUBSUB_SCHEDULER_H_
+
+#include <open62541/types.h>
+
+_UA_BEGIN_DECLS
+
+#ifdef UA_ENABLE_PUBSUB /* conditional compilation */
+
+/**
+ * Publish Scheduler
+ * -----------------
+ * Runs the cyclic callbacks of many WriterGroups from a single timer. An entry
+ * is due at ``phase + k * interval`` after the start of the scheduler. Phases
+ * and intervals are rounded to the resolution of the scheduler. The entries
+ * are kept in a hashed timer wheel with one slot per resolution step, so that
+ * the due entries are found without looking at the others. Entries that are
+ * due in a later revolution of the wheel stay in their slot until then.
+ *
+ * Without a configured phase, a new entry gets the phase in the middle of the
+ * largest gap between the due times of the existing entries. Entries with the
+ * same interval are spread evenly across the cycle. For entries with different
+ * intervals, the due times can only coincide modulo the greatest common
+ * divisor of the intervals, which is used for the comparison.
+ *
+ * Entries that are due together run in the order of descending priority. The
+ * lateness of every run (the start of the callback after the due time) is
+ * recorded per entry. If an entry falls behind by more than one interval, the
+ * missed cycles are skipped and counted. */
+
+#define UA_PUBSUB_SCHEDULER_SLOTS 256
+
+typedef void (*UA_PubSubScheduledCallback)(void *application, void *data);
+
+typedef struct {
+    UA_Duration phase;        /* in ms after the start of the scheduler */
+    UA_UInt64 cycles;         /* runs since the entry was added */
+    UA_UInt64 missedCycles;   /* skipped because a run was too late */
+    UA_Duration lastLateness; /* in ms */
+    UA_Duration meanLateness;
+    UA_Duration maxLateness;
+} UA_PubSubScheduleStatistics;
+
+struct UA_PubSubScheduler;
+typedef struct UA_PubSubScheduler UA_PubSubScheduler;
+
+/* The resolution in ms is the granularity of the phases and of the wheel */
+UA_PubSubScheduler *
+UA_PubSubScheduler_new(UA_Duration resolution);
+
+void
+UA_PubSubScheduler_delete(UA_PubSubScheduler *scheduler);
+
+/* Add a cyclic entry. A negative phase is assigned automatically. The first
+ * run is at the first due time after notBefore (a monotonic time, 0 for
+ * now). */
+UA_StatusCode
+UA_PubSubScheduler_add(UA_PubSubScheduler *scheduler, UA_Duration interval,
+                       UA_Duration phase, UA_Byte priority, UA_DateTime notBefore,
+                       UA_PubSubScheduledCallback callback, void *data, UA_UInt64 *id);
+
+/* Can be called from the callbacks */
+UA_StatusCode
+UA_PubSubScheduler_remove(UA_PubSubScheduler *scheduler, UA_UInt64 id);
+
+UA_StatusCode
+UA_PubSubScheduler_setPriority(UA_PubSubScheduler *scheduler, UA_UInt64 id,
+                               UA_Byte priority);
+
+UA_StatusCode
+UA_PubSubScheduler_getStatistics(const UA_PubSubScheduler *scheduler, UA_UInt64 id,
+                                 UA_PubSubScheduleStatistics *statistics);
+
+size_t
+UA_PubSubScheduler_size(const UA_PubSubScheduler *scheduler);
+
+/* Monotonic time of the next due entry. 0 if there are no entries. */
+UA_DateTime
+UA_PubSubScheduler_nextDue(const UA_PubSubScheduler *scheduler);
+
+/* Run the callbacks of the due entries */
+void
+UA_PubSubScheduler_process(UA_PubSubScheduler *scheduler, void *application);
+
+#endif /* UA_ENABLE_PUBSUB */
+
+_UA_END_DECLS
+
+#endif /* UA_PUBSUB_SCHEDULER_H_ */
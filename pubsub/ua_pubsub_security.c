@@ -0,0 +1,228 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include "ua_pubsub_security.h"
+
+#ifdef UA_ENABLE_PUBSUB_ENCRYPTION /* conditional compilation */
+
+#include <limits.h>
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+#include <openssl/core_names.h>
+#else
+#include <openssl/hmac.h>
+#endif
+
+#define UA_AES_BLOCKSIZE 16
+
+struct UA_PubSubSecurityContext {
+    UA_MessageSecurityMode mode;
+    UA_UInt32 securityTokenId;
+    UA_Byte keyNonce[UA_PUBSUB_SECURITY_KEYNONCE_LENGTH];
+
+    /* The MessageNonce is the random prefix and the counter */
+    UA_Byte noncePrefix[4];
+    UA_UInt32 messageCounter;
+
+    /* The key schedules. The cipher context is reinitialized with the
+     * counter block only, the MAC context without the key. */
+    EVP_CIPHER_CTX *cipher; /* NULL without encryption */
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    EVP_MAC *macAlgorithm;
+    EVP_MAC_CTX *mac;
+#else
+    HMAC_CTX *mac;
+#endif
+};
+
+static UA_Boolean
+UA_PubSubSecurityContext_initMac(UA_PubSubSecurityContext *ctx, const UA_Byte *key) {
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    ctx->macAlgorithm = EVP_MAC_fetch(NULL, "HMAC", NULL);
+    if(!ctx->macAlgorithm)
+        return false;
+    ctx->mac = EVP_MAC_CTX_new(ctx->macAlgorithm);
+    if(!ctx->mac)
+        return false;
+    OSSL_PARAM params[2];
+    params[0] = OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST, (char *)"SHA256", 0);
+    params[1] = OSSL_PARAM_construct_end();
+    return EVP_MAC_init(ctx->mac, key, UA_PUBSUB_SECURITY_SIGNINGKEY_LENGTH, params) == 1;
+#else
+    ctx->mac = HMAC_CTX_new();
+    return ctx->mac &&
+        HMAC_Init_ex(ctx->mac, key, UA_PUBSUB_SECURITY_SIGNINGKEY_LENGTH,
+                     EVP_sha256(), NULL) == 1;
+#endif
+}
+
+/* HMAC-SHA256 with the precomputed state of the key */
+static UA_Boolean
+UA_PubSubSecurityContext_sign(UA_PubSubSecurityContext *ctx, const UA_Byte *data,
+                              size_t length, UA_Byte *signature) {
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    size_t signatureLength = 0;
+    return EVP_MAC_init(ctx->mac, NULL, 0, NULL) == 1 &&
+        EVP_MAC_update(ctx->mac, data, length) == 1 &&
+        EVP_MAC_final(ctx->mac, signature, &signatureLength,
+                      UA_PUBSUB_SECURITY_SIGNATURE_LENGTH) == 1 &&
+        signatureLength == UA_PUBSUB_SECURITY_SIGNATURE_LENGTH;
+#else
+    unsigned int signatureLength = 0;
+    return HMAC_Init_ex(ctx->mac, NULL, 0, NULL, NULL) == 1 &&
+        HMAC_Update(ctx->mac, data, length) == 1 &&
+        HMAC_Final(ctx->mac, signature, &signatureLength) == 1 &&
+        signatureLength == UA_PUBSUB_SECURITY_SIGNATURE_LENGTH;
+#endif
+}
+
+/* AES-CTR in place. Encryption and decryption are the same. */
+static UA_Boolean
+UA_PubSubSecurityContext_crypt(UA_PubSubSecurityContext *ctx, const UA_Byte *messageNonce,
+                               UA_Byte *data, size_t length) {
+    if(length > INT_MAX)
+        return false;
+    UA_Byte counterBlock[UA_AES_BLOCKSIZE];
+    memcpy(counterBlock, ctx->keyNonce, UA_PUBSUB_SECURITY_KEYNONCE_LENGTH);
+    memcpy(&counterBlock[UA_PUBSUB_SECURITY_KEYNONCE_LENGTH], messageNonce,
+           UA_PUBSUB_SECURITY_MESSAGENONCE_LENGTH);
+    counterBlock[12] = 0;
+    counterBlock[13] = 0;
+    counterBlock[14] = 0;
+    counterBlock[15] = 1;
+    int outLength = 0;
+    if(EVP_EncryptInit_ex(ctx->cipher, NULL, NULL, NULL, counterBlock) != 1)
+        return false;
+    return length == 0 ||
+        EVP_EncryptUpdate(ctx->cipher, data, &outLength, data, (int)length) == 1;
+}
+
+UA_PubSubSecurityContext *
+UA_PubSubSecurityContext_new(const UA_PubSubSecurityConfig *config) {
+    if(!config || (config->mode != UA_MESSAGESECURITYMODE_SIGN &&
+                   config->mode != UA_MESSAGESECURITYMODE_SIGNANDENCRYPT))
+        return NULL;
+    const EVP_CIPHER *cipher;
+    switch(config->policy) {
+    case UA_PUBSUB_SECURITYPOLICY_AES128CTR: cipher = EVP_aes_128_ctr(); break;
+    case UA_PUBSUB_SECURITYPOLICY_AES256CTR: cipher = EVP_aes_256_ctr(); break;
+    default: return NULL;
+    }
+
+    UA_PubSubSecurityContext *ctx = (UA_PubSubSecurityContext *)
+        UA_calloc(1, sizeof(UA_PubSubSecurityContext));
+    if(!ctx)
+        return NULL;
+    ctx->mode = config->mode;
+    ctx->securityTokenId = config->securityTokenId;
+    memcpy(ctx->keyNonce, config->keyNonce, UA_PUBSUB_SECURITY_KEYNONCE_LENGTH);
+    if(RAND_bytes(ctx->noncePrefix, sizeof(ctx->noncePrefix)) != 1 ||
+       !UA_PubSubSecurityContext_initMac(ctx, config->signingKey)) {
+        UA_PubSubSecurityContext_delete(ctx);
+        return NULL;
+    }
+    if(config->mode == UA_MESSAGESECURITYMODE_SIGNANDENCRYPT) {
+        ctx->cipher = EVP_CIPHER_CTX_new();
+        if(!ctx->cipher ||
+           EVP_EncryptInit_ex(ctx->cipher, cipher, NULL, config->encryptingKey, NULL) != 1) {
+            UA_PubSubSecurityContext_delete(ctx);
+            return NULL;
+        }
+    }
+    return ctx;
+}
+
+void
+UA_PubSubSecurityContext_delete(UA_PubSubSecurityContext *ctx) {
+    if(!ctx)
+        return;
+    EVP_CIPHER_CTX_free(ctx->cipher);
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    EVP_MAC_CTX_free(ctx->mac);
+    EVP_MAC_free(ctx->macAlgorithm);
+#else
+    HMAC_CTX_free(ctx->mac);
+#endif
+    OPENSSL_cleanse(ctx, sizeof(UA_PubSubSecurityContext));
+    UA_free(ctx);
+}
+
+void
+UA_PubSubSecurityContext_setHeader(UA_PubSubSecurityContext *ctx, UA_NetworkMessage *nm,
+                                   UA_Byte nonce[UA_PUBSUB_SECURITY_MESSAGENONCE_LENGTH]) {
+    /* Draw a new prefix before the counter repeats */
+    ctx->messageCounter++;
+    if(ctx->messageCounter == 0)
+        RAND_bytes(ctx->noncePrefix, sizeof(ctx->noncePrefix));
+    memcpy(nonce, ctx->noncePrefix, sizeof(ctx->noncePrefix));
+    UA_DataSetCodec_write32(&nonce[4], ctx->messageCounter);
+
+    nm->securityEnabled = true;
+    UA_NetworkMessageSecurityHeader *sh = &nm->securityHeader;
+    memset(sh, 0, sizeof(UA_NetworkMessageSecurityHeader));
+    sh->networkMessageSigned = true;
+    sh->networkMessageEncrypted = (ctx->cipher != NULL);
+    sh->securityTokenId = ctx->securityTokenId;
+    sh->nonceLength = UA_PUBSUB_SECURITY_MESSAGENONCE_LENGTH;
+    sh->messageNonce.data = nonce;
+    sh->messageNonce.length = UA_PUBSUB_SECURITY_MESSAGENONCE_LENGTH;
+}
+
+UA_StatusCode
+UA_PubSubSecurityContext_protect(UA_PubSubSecurityContext *ctx, UA_ByteString *message,
+                                 size_t payloadOffset) {
+    if(payloadOffset < UA_PUBSUB_SECURITY_MESSAGENONCE_LENGTH ||
+       message->length < payloadOffset + UA_PUBSUB_SECURITY_SIGNATURE_LENGTH)
+        return UA_STATUSCODE_BADINVALIDARGUMENT;
+    size_t signedLength = message->length - UA_PUBSUB_SECURITY_SIGNATURE_LENGTH;
+
+    /* The MessageNonce is the end of the security header */
+    if(ctx->cipher &&
+       !UA_PubSubSecurityContext_crypt(ctx, &message->data[payloadOffset - UA_PUBSUB_SECURITY_MESSAGENONCE_LENGTH],
+                                       &message->data[payloadOffset], signedLength - payloadOffset))
+        return UA_STATUSCODE_BADINTERNALERROR;
+    if(!UA_PubSubSecurityContext_sign(ctx, message->data, signedLength,
+                                      &message->data[signedLength]))
+        return UA_STATUSCODE_BADINTERNALERROR;
+    return UA_STATUSCODE_GOOD;
+}
+
+UA_StatusCode
+UA_PubSubSecurityContext_decode(UA_PubSubSecurityContext *ctx, UA_ByteString *message,
+                                UA_NetworkMessage *dst, const UA_DataSetCodec *const *codecs,
+                                size_t codecsSize) {
+    size_t offset = 0;
+    UA_StatusCode rv = UA_NetworkMessage_decodeHeadersCodec(message, &offset, dst);
+    if(rv != UA_STATUSCODE_GOOD)
+        return (rv == UA_STATUSCODE_BADNOTSUPPORTED) ? UA_STATUSCODE_BADSECURITYCHECKSFAILED : rv;
+
+    /* Check the protection against the mode */
+    const UA_NetworkMessageSecurityHeader *sh = &dst->securityHeader;
+    if(!dst->securityEnabled || !sh->networkMessageSigned ||
+       sh->networkMessageEncrypted != (ctx->cipher != NULL) ||
+       sh->securityTokenId != ctx->securityTokenId ||
+       sh->nonceLength != UA_PUBSUB_SECURITY_MESSAGENONCE_LENGTH ||
+       message->length < offset + UA_PUBSUB_SECURITY_SIGNATURE_LENGTH)
+        return UA_STATUSCODE_BADSECURITYCHECKSFAILED;
+
+    /* Verify before decrypting */
+    size_t signedLength = message->length - UA_PUBSUB_SECURITY_SIGNATURE_LENGTH;
+    UA_Byte signature[UA_PUBSUB_SECURITY_SIGNATURE_LENGTH];
+    if(!UA_PubSubSecurityContext_sign(ctx, message->data, signedLength, signature) ||
+       CRYPTO_memcmp(signature, &message->data[signedLength],
+                     UA_PUBSUB_SECURITY_SIGNATURE_LENGTH) != 0)
+        return UA_STATUSCODE_BADSECURITYCHECKSFAILED;
+    if(ctx->cipher &&
+       !UA_PubSubSecurityContext_crypt(ctx, &message->data[offset - UA_PUBSUB_SECURITY_MESSAGENONCE_LENGTH],
+                                       &message->data[offset], signedLength - offset))
+        return UA_STATUSCODE_BADINTERNALERROR;
+
+    UA_ByteString payload = {signedLength, message->data};
+    return UA_NetworkMessage_decodePayloadCodec(&payload, &offset, dst, codecs, codecsSize);
+}
+
+#endif /* UA_ENABLE_PUBSUB_ENCRYPTION */
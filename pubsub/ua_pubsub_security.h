@@ -0,0 +1,113 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef UA_PUBSUB_SECURITY_H_
+#define UA_PUBSUB_SECURITY_H_
+
+#include <open62541/types.h>
+#include <open62541/types_generated.h>
+
+#include "ua_pubsub_codec.h"
+
+_UA_BEGIN_DECLS
+
+#ifdef UA_ENABLE_PUBSUB /* conditional compilation */
+
+/**
+ * Message Security
+ * ----------------
+ * Signs and encrypts UADP NetworkMessages with the PubSub-Aes128-CTR and
+ * PubSub-Aes256-CTR security policies (Part 14, 8.3). The payload is
+ * encrypted with AES in counter mode. The counter block is the KeyNonce of
+ * the keys, the MessageNonce of the security header and a block counter that
+ * starts at 1. The signature is the HMAC-SHA256 of the whole message before
+ * it and is appended after the payload.
+ *
+ * The MessageNonce consists of four random bytes, followed by a message
+ * counter. When the counter wraps after 2^32 messages, four new random bytes
+ * are drawn. The first 2^32 nonces of a context are unique. After that, a
+ * nonce repeats only if the same random bytes are drawn twice, which is
+ * likely after about 2^16 draws (2^48 messages). Change the keys long before
+ * that.
+ *
+ * A security context holds the key schedules of one security group: the
+ * expanded AES key and the inner and outer HMAC state after the key. They are
+ * computed once when the context is created, so that a message only costs the
+ * passes over its bytes. The cryptography is done by OpenSSL (libcrypto),
+ * which uses AES-NI and the SHA extensions where the CPU has them.
+ * Enabled with ``UA_ENABLE_PUBSUB_ENCRYPTION``. A context is not
+ * thread-safe; create one per thread.
+ *
+ * The encoding of the headers is done by the codec functions of
+ * ``ua_pubsub_codec.h``. Security footers and chunked messages are not
+ * supported. Messages with another SecurityTokenId than the one of the keys,
+ * or with less protection than the mode of the context, are rejected. */
+
+typedef enum {
+    UA_PUBSUB_SECURITYPOLICY_AES128CTR = 0,
+    UA_PUBSUB_SECURITYPOLICY_AES256CTR = 1
+} UA_PubSubSecurityPolicyType;
+
+#define UA_PUBSUB_SECURITY_SIGNINGKEY_LENGTH 32
+#define UA_PUBSUB_SECURITY_ENCRYPTINGKEY_MAXLENGTH 32
+#define UA_PUBSUB_SECURITY_KEYNONCE_LENGTH 4
+#define UA_PUBSUB_SECURITY_MESSAGENONCE_LENGTH 8
+#define UA_PUBSUB_SECURITY_SIGNATURE_LENGTH 32
+
+typedef struct {
+    UA_PubSubSecurityPolicyType policy;
+    /* UA_MESSAGESECURITYMODE_SIGN or _SIGNANDENCRYPT */
+    UA_MessageSecurityMode mode;
+    UA_UInt32 securityTokenId;
+    UA_Byte signingKey[UA_PUBSUB_SECURITY_SIGNINGKEY_LENGTH];
+    /* The first 16 bytes with AES128CTR */
+    UA_Byte encryptingKey[UA_PUBSUB_SECURITY_ENCRYPTINGKEY_MAXLENGTH];
+    UA_Byte keyNonce[UA_PUBSUB_SECURITY_KEYNONCE_LENGTH];
+} UA_PubSubSecurityConfig;
+
+#ifdef UA_ENABLE_PUBSUB_ENCRYPTION
+
+struct UA_PubSubSecurityContext;
+typedef struct UA_PubSubSecurityContext UA_PubSubSecurityContext;
+
+/* Returns NULL for an invalid configuration */
+UA_PubSubSecurityContext UA_EXPORT *
+UA_PubSubSecurityContext_new(const UA_PubSubSecurityConfig *config);
+
+/* Also wipes the keys */
+void UA_EXPORT
+UA_PubSubSecurityContext_delete(UA_PubSubSecurityContext *ctx);
+
+/* Enables the security header of the NetworkMessage with the next
+ * MessageNonce. The nonce is written to nonce, which has to stay valid until
+ * the message is encoded. */
+void UA_EXPORT
+UA_PubSubSecurityContext_setHeader(UA_PubSubSecurityContext *ctx, UA_NetworkMessage *nm,
+                                   UA_Byte nonce[UA_PUBSUB_SECURITY_MESSAGENONCE_LENGTH]);
+
+/* Protects an encoded message in place. The message is followed by
+ * UA_PUBSUB_SECURITY_SIGNATURE_LENGTH bytes for the signature, which are
+ * included in the length. The payload starts at payloadOffset (see
+ * UA_NetworkMessage_calcSizeHeadersCodec). */
+UA_StatusCode UA_EXPORT
+UA_PubSubSecurityContext_protect(UA_PubSubSecurityContext *ctx, UA_ByteString *message,
+                                 size_t payloadOffset);
+
+/* Verifies the signature, decrypts the payload in place and decodes the
+ * message. Returns UA_STATUSCODE_BADSECURITYCHECKSFAILED if the message is
+ * not protected as configured. dst is cleared with UA_NetworkMessage_clear
+ * also if decoding fails. */
+UA_StatusCode UA_EXPORT
+UA_PubSubSecurityContext_decode(UA_PubSubSecurityContext *ctx, UA_ByteString *message,
+                                UA_NetworkMessage *dst, const UA_DataSetCodec *const *codecs,
+                                size_t codecsSize);
+
+#endif /* UA_ENABLE_PUBSUB_ENCRYPTION */
+
+#endif /* UA_ENABLE_PUBSUB */
+
+_UA_END_DECLS
+
+#endif /* UA_PUBSUB_SECURITY_H_ */
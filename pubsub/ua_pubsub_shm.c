@@ -0,0 +1,368 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <open62541/plugin/log_stdout.h>
+#include <open62541/server_config.h>
+
+#include "pubsub_shm.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <linux/futex.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#define UA_SHM_MAGIC 0x55414D53 /* "UAMS" */
+#define UA_SHM_NAME_PREFIX "/ua_pubsub_"
+#define UA_SHM_MAX_NAME 64
+#define UA_SHM_DEFAULT_SLOTS 256
+#define UA_SHM_DEFAULT_SLOTSIZE 2048
+#define UA_SHM_CACHELINE 64
+
+/* The layout in shared memory. The fields that are written for every message
+ * are kept on their own cache line. */
+typedef struct {
+    UA_UInt32 magic;
+    UA_UInt32 slots;
+    UA_UInt32 slotSize;
+    UA_UInt32 slotStride;
+    UA_Byte pad0[UA_SHM_CACHELINE - 16];
+    UA_UInt64 head;     /* number of messages written */
+    UA_UInt32 futex;    /* incremented before a wakeup */
+    UA_UInt32 waiters;  /* readers sleeping on the futex */
+    UA_Byte pad1[UA_SHM_CACHELINE - 16];
+} UA_ShmRingHeader;
+
+/* Message n is in slot (n % slots). seq is 2n+1 while the slot is written and
+ * 2n+2 once the message is complete. */
+typedef struct {
+    UA_UInt64 seq;
+    UA_UInt32 length;
+    UA_UInt32 reserved;
+} UA_ShmSlotHeader;
+
+typedef struct {
+    UA_ShmRingHeader *ring;
+    size_t mapSize;
+    UA_Boolean registered;
+    UA_UInt64 next;     /* next message to read */
+    UA_UInt64 lost;     /* overrun messages since the last report */
+} UA_PubSubChannelDataSHM;
+
+static UA_ShmSlotHeader *
+getSlot(UA_ShmRingHeader *ring, UA_UInt64 n) {
+    return (UA_ShmSlotHeader *)((UA_Byte *)ring + sizeof(UA_ShmRingHeader) +
+                                (size_t)(n & (ring->slots - 1)) * ring->slotStride);
+}
+
+static void
+futexWait(UA_UInt32 *addr, UA_UInt32 value, UA_UInt32 timeout) {
+    struct timespec ts;
+    ts.tv_sec = (time_t)(timeout / 1000000);
+    ts.tv_nsec = (long)(timeout % 1000000) * 1000;
+    syscall(SYS_futex, addr, FUTEX_WAIT, value, &ts, NULL, 0);
+}
+
+static void
+futexWakeAll(UA_UInt32 *addr) {
+    syscall(SYS_futex, addr, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+static void
+parseConnectionProperties(const UA_PubSubConnectionConfig *connectionConfig,
+                          UA_UInt32 *slots, UA_UInt32 *slotSize) {
+    UA_String slotsParam = UA_STRING("slots"), slotSizeParam = UA_STRING("slotSize");
+    for(size_t i = 0; i < connectionConfig->connectionPropertiesSize; i++) {
+        const UA_KeyValuePair *property = &connectionConfig->connectionProperties[i];
+        if(UA_String_equal(&property->key.name, &slotsParam)) {
+            if(UA_Variant_hasScalarType(&property->value, &UA_TYPES[UA_TYPES_UINT32]))
+                *slots = *(UA_UInt32 *) property->value.data;
+        } else if(UA_String_equal(&property->key.name, &slotSizeParam)) {
+            if(UA_Variant_hasScalarType(&property->value, &UA_TYPES[UA_TYPES_UINT32]))
+                *slotSize = *(UA_UInt32 *) property->value.data;
+        } else {
+            UA_LOG_WARNING(UA_Log_Stdout, UA_LOGCATEGORY_SERVER,
+                           "PubSub Connection creation. Unknown connection parameter.");
+        }
+    }
+}
+
+/* Map the ring. The first channel creates and initializes it. The file lock
+ * keeps others from using the ring before the header is written. */
+static UA_ShmRingHeader *
+mapRing(const char *name, UA_UInt32 slots, UA_UInt32 slotSize, size_t *mapSize) {
+    int fd = shm_open(name, O_RDWR | O_CREAT, 0660);
+    if(fd < 0)
+        return NULL;
+    flock(fd, LOCK_EX);
+
+    UA_UInt32 slotStride = (UA_UInt32)
+        ((sizeof(UA_ShmSlotHeader) + slotSize + UA_SHM_CACHELINE - 1) & ~(size_t)(UA_SHM_CACHELINE - 1));
+    size_t size = sizeof(UA_ShmRingHeader) + (size_t)slots * slotStride;
+    struct stat st;
+    UA_Boolean create = (fstat(fd, &st) == 0 && st.st_size == 0);
+    if(create && ftruncate(fd, (off_t)size) < 0) {
+        flock(fd, LOCK_UN);
+        close(fd);
+        return NULL;
+    }
+    if(!create && (size_t)st.st_size != size) {
+        UA_LOG_ERROR(UA_Log_Stdout, UA_LOGCATEGORY_SERVER,
+                     "PubSub shm: Ring %s exists with a different size", name);
+        flock(fd, LOCK_UN);
+        close(fd);
+        return NULL;
+    }
+
+    void *map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    UA_ShmRingHeader *ring = (map == MAP_FAILED) ? NULL : (UA_ShmRingHeader *)map;
+    if(ring && create) {
+        ring->slots = slots;
+        ring->slotSize = slotSize;
+        ring->slotStride = slotStride;
+        ring->magic = UA_SHM_MAGIC;
+    } else if(ring && (ring->magic != UA_SHM_MAGIC || ring->slots != slots ||
+                       ring->slotSize != slotSize)) {
+        UA_LOG_ERROR(UA_Log_Stdout, UA_LOGCATEGORY_SERVER,
+                     "PubSub shm: Ring %s exists with a different configuration", name);
+        munmap(map, size);
+        ring = NULL;
+    }
+    flock(fd, LOCK_UN);
+    close(fd); /* the mapping stays valid */
+    *mapSize = size;
+    return ring;
+}
+
+static UA_PubSubChannel *
+UA_PubSubChannelSHM_open(const UA_PubSubConnectionConfig *connectionConfig) {
+    if(!UA_Variant_hasScalarType(&connectionConfig->address,
+                                 &UA_TYPES[UA_TYPES_NETWORKADDRESSURLDATATYPE])) {
+        UA_LOG_ERROR(UA_Log_Stdout, UA_LOGCATEGORY_SERVER,
+                     "PubSub Connection creation failed. Invalid Address.");
+        return NULL;
+    }
+    UA_NetworkAddressUrlDataType *address =
+        (UA_NetworkAddressUrlDataType *)connectionConfig->address.data;
+
+    /* opc.shm://<name>[/] */
+    const char *prefix = "opc.shm://";
+    size_t prefixLength = strlen(prefix);
+    const UA_String *url = &address->url;
+    size_t nameLength = url->length > prefixLength ? url->length - prefixLength : 0;
+    if(nameLength > 0 && url->data[url->length - 1] == '/')
+        nameLength--;
+    if(nameLength == 0 || nameLength > UA_SHM_MAX_NAME ||
+       strncmp((const char*)url->data, prefix, prefixLength) != 0 ||
+       memchr(&url->data[prefixLength], '/', nameLength)) {
+        UA_LOG_ERROR(UA_Log_Stdout, UA_LOGCATEGORY_SERVER,
+                     "PubSub Connection creation failed. Invalid URL.");
+        return NULL;
+    }
+    char name[sizeof(UA_SHM_NAME_PREFIX) + UA_SHM_MAX_NAME];
+    memcpy(name, UA_SHM_NAME_PREFIX, strlen(UA_SHM_NAME_PREFIX));
+    memcpy(&name[strlen(UA_SHM_NAME_PREFIX)], &url->data[prefixLength], nameLength);
+    name[strlen(UA_SHM_NAME_PREFIX) + nameLength] = '\0';
+
+    UA_UInt32 slots = UA_SHM_DEFAULT_SLOTS;
+    UA_UInt32 slotSize = UA_SHM_DEFAULT_SLOTSIZE;
+    parseConnectionProperties(connectionConfig, &slots, &slotSize);
+    if(slots == 0 || (slots & (slots - 1)) != 0 || slotSize == 0) {
+        UA_LOG_ERROR(UA_Log_Stdout, UA_LOGCATEGORY_SERVER,
+                     "PubSub Connection creation failed. Invalid slot configuration.");
+        return NULL;
+    }
+
+    UA_PubSubChannelDataSHM *channelData = (UA_PubSubChannelDataSHM *)
+        UA_calloc(1, sizeof(UA_PubSubChannelDataSHM));
+    UA_PubSubChannel *newChannel = (UA_PubSubChannel *) UA_calloc(1, sizeof(UA_PubSubChannel));
+    if(!channelData || !newChannel) {
+        UA_LOG_ERROR(UA_Log_Stdout, UA_LOGCATEGORY_SERVER,
+                     "PubSub Connection creation failed. Out of memory.");
+        UA_free(channelData);
+        UA_free(newChannel);
+        return NULL;
+    }
+    channelData->ring = mapRing(name, slots, slotSize, &channelData->mapSize);
+    if(!channelData->ring) {
+        UA_LOG_ERROR(UA_Log_Stdout, UA_LOGCATEGORY_SERVER,
+                     "PubSub Connection creation failed. Cannot map %s.", name);
+        UA_free(channelData);
+        UA_free(newChannel);
+        return NULL;
+    }
+
+    newChannel->sockfd = -1; /* no socket to poll */
+    newChannel->handle = channelData;
+    newChannel->state = UA_PUBSUB_CHANNEL_RDY;
+    return newChannel;
+}
+
+/* Write the message to the next slot. The writer does not wait for readers. */
+static UA_StatusCode
+UA_PubSubChannelSHM_send(UA_PubSubChannel *channel, UA_ExtensionObject *transportSettings,
+                         const UA_ByteString *buf) {
+    UA_PubSubChannelDataSHM *channelData = (UA_PubSubChannelDataSHM *) channel->handle;
+    UA_ShmRingHeader *ring = channelData->ring;
+    if(buf->length > ring->slotSize) {
+        UA_LOG_ERROR(UA_Log_Stdout, UA_LOGCATEGORY_SERVER,
+                     "PubSub Connection sending failed. Message larger than the slot size.");
+        return UA_STATUSCODE_BADINTERNALERROR;
+    }
+
+    UA_UInt64 n = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+    UA_ShmSlotHeader *slot = getSlot(ring, n);
+    __atomic_store_n(&slot->seq, 2 * n + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy((UA_Byte *)slot + sizeof(UA_ShmSlotHeader), buf->data, buf->length);
+    slot->length = (UA_UInt32)buf->length;
+    __atomic_store_n(&slot->seq, 2 * n + 2, __ATOMIC_RELEASE);
+    __atomic_store_n(&ring->head, n + 1, __ATOMIC_SEQ_CST);
+
+    /* Pairs with the waiter registration in receive. Either the reader sees
+     * the new head or the writer sees the waiter. */
+    if(__atomic_load_n(&ring->waiters, __ATOMIC_SEQ_CST) > 0) {
+        __atomic_add_fetch(&ring->futex, 1, __ATOMIC_SEQ_CST);
+        futexWakeAll(&ring->futex);
+    }
+    return UA_STATUSCODE_GOOD;
+}
+
+/* Readers start with the messages written after the registration */
+static UA_StatusCode
+UA_PubSubChannelSHM_regist(UA_PubSubChannel *channel, UA_ExtensionObject *transportSettings,
+                           void (*callback)(UA_ByteString *encodedBuffer, UA_ByteString *topic)) {
+    UA_PubSubChannelDataSHM *channelData = (UA_PubSubChannelDataSHM *) channel->handle;
+    channelData->next = __atomic_load_n(&channelData->ring->head, __ATOMIC_ACQUIRE);
+    channelData->registered = true;
+    channel->state = UA_PUBSUB_CHANNEL_SUB;
+    return UA_STATUSCODE_GOOD;
+}
+
+static UA_StatusCode
+UA_PubSubChannelSHM_unregist(UA_PubSubChannel *channel, UA_ExtensionObject *transportSettings) {
+    UA_PubSubChannelDataSHM *channelData = (UA_PubSubChannelDataSHM *) channel->handle;
+    channelData->registered = false;
+    channel->state = UA_PUBSUB_CHANNEL_RDY;
+    return UA_STATUSCODE_GOOD;
+}
+
+/* Copy the next message out of the ring. The timeout is given in
+ * microseconds. */
+static UA_StatusCode
+UA_PubSubChannelSHM_receive(UA_PubSubChannel *channel, UA_ByteString *message,
+                            UA_ExtensionObject *transportSettings, UA_UInt32 timeout) {
+    UA_PubSubChannelDataSHM *channelData = (UA_PubSubChannelDataSHM *) channel->handle;
+    UA_ShmRingHeader *ring = channelData->ring;
+    if(!channelData->registered) {
+        UA_LOG_ERROR(UA_Log_Stdout, UA_LOGCATEGORY_SERVER,
+                     "PubSub Connection receive failed. Channel is not registered.");
+        message->length = 0;
+        return UA_STATUSCODE_BADINTERNALERROR;
+    }
+
+    UA_Boolean waited = false;
+    while(true) {
+        UA_UInt64 head = __atomic_load_n(&ring->head, __ATOMIC_SEQ_CST);
+        if(channelData->next == head) {
+            if(waited || timeout == 0) {
+                message->length = 0;
+                return UA_STATUSCODE_GOODNONCRITICALTIMEOUT;
+            }
+            /* Sleep until the writer bumps the futex word. A reader that
+             * dies while sleeping leaves the waiter count raised; this only
+             * costs the writer a superfluous wakeup. */
+            __atomic_add_fetch(&ring->waiters, 1, __ATOMIC_SEQ_CST);
+            UA_UInt32 value = __atomic_load_n(&ring->futex, __ATOMIC_SEQ_CST);
+            if(__atomic_load_n(&ring->head, __ATOMIC_SEQ_CST) == channelData->next)
+                futexWait(&ring->futex, value, timeout);
+            __atomic_sub_fetch(&ring->waiters, 1, __ATOMIC_SEQ_CST);
+            waited = true;
+            continue;
+        }
+
+        /* Skip over the messages that were overwritten */
+        if(head - channelData->next > ring->slots) {
+            channelData->lost += head - ring->slots - channelData->next;
+            channelData->next = head - ring->slots;
+        }
+
+        UA_UInt64 n = channelData->next;
+        UA_ShmSlotHeader *slot = getSlot(ring, n);
+        UA_UInt64 seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+        if(seq != 2 * n + 2) {
+            /* Overwritten since head was read. Resynchronize. */
+            channelData->lost++;
+            channelData->next++;
+            continue;
+        }
+        size_t length = slot->length;
+        if(length > ring->slotSize)
+            length = ring->slotSize;
+        if(length > message->length) {
+            UA_LOG_WARNING(UA_Log_Stdout, UA_LOGCATEGORY_SERVER,
+                           "PubSub shm: Message truncated to the receive buffer");
+            length = message->length;
+        }
+        memcpy(message->data, (UA_Byte *)slot + sizeof(UA_ShmSlotHeader), length);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        channelData->next++;
+        if(__atomic_load_n(&slot->seq, __ATOMIC_RELAXED) != seq) {
+            channelData->lost++; /* torn by the writer during the copy */
+            continue;
+        }
+
+        if(channelData->lost > 0) {
+            UA_LOG_WARNING(UA_Log_Stdout, UA_LOGCATEGORY_SERVER,
+                           "PubSub shm: Reader overrun, %lu messages lost",
+                           (unsigned long)channelData->lost);
+            channelData->lost = 0;
+        }
+        message->length = length;
+        return UA_STATUSCODE_GOOD;
+    }
+}
+
+static UA_StatusCode
+UA_PubSubChannelSHM_yield(UA_PubSubChannel *channel, UA_UInt16 timeout) {
+    return UA_STATUSCODE_GOOD;
+}
+
+static UA_StatusCode
+UA_PubSubChannelSHM_close(UA_PubSubChannel *channel) {
+    UA_PubSubChannelDataSHM *channelData = (UA_PubSubChannelDataSHM *) channel->handle;
+    munmap(channelData->ring, channelData->mapSize);
+    UA_free(channelData);
+    UA_free(channel);
+    return UA_STATUSCODE_GOOD;
+}
+
+static UA_PubSubChannel *
+TransportLayerSHM_addChannel(UA_PubSubConnectionConfig *connectionConfig) {
+    UA_PubSubChannel *pubSubChannel = UA_PubSubChannelSHM_open(connectionConfig);
+    if(pubSubChannel) {
+        pubSubChannel->regist = UA_PubSubChannelSHM_regist;
+        pubSubChannel->unregist = UA_PubSubChannelSHM_unregist;
+        pubSubChannel->send = UA_PubSubChannelSHM_send;
+        pubSubChannel->receive = UA_PubSubChannelSHM_receive;
+        pubSubChannel->close = UA_PubSubChannelSHM_close;
+        pubSubChannel->yield = UA_PubSubChannelSHM_yield;
+        pubSubChannel->connectionConfig = connectionConfig;
+    }
+    return pubSubChannel;
+}
+
+UA_PubSubTransportLayer
+UA_PubSubTransportLayerSHM() {
+    UA_PubSubTransportLayer pubSubTransportLayer;
+    pubSubTransportLayer.transportProfileUri = UA_STRING(UA_PUBSUB_SHM_PROFILE_URI);
+    pubSubTransportLayer.createPubSubChannel = &TransportLayerSHM_addChannel;
+    return pubSubTransportLayer;
+}
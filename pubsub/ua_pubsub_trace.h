@@ -0,0 +1,122 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef UA_PUBSUB_TRACE_H_
+#define UA_PUBSUB_TRACE_H_
+
+#include "ua_pubsub_networkmessage.h"
+
+_UA_BEGIN_DECLS
+
+/**
+ * Static Tracepoints
+ * ------------------
+ * With ``UA_ENABLE_PUBSUB_TRACING`` the publish and receive pipeline contains
+ * USDT probes of the provider ``open62541_pubsub`` (needs ``sys/sdt.h`` from
+ * systemtap-sdt-dev). Every probe has a USDT semaphore that the tracer
+ * increments while it is attached (perf and bpftrace do this with Linux 4.20
+ * and later). Until then, a probe costs one load and a not-taken branch and
+ * its arguments are not evaluated. Without the flag the macros expand to
+ * nothing.
+ *
+ * The probes mark the boundaries between the stages, so the time between two
+ * consecutive probes of a thread is the time of one stage. Most probes take
+ * the WriterGroupId, the DataSetWriterId and the DataSetMessage sequence
+ * number as their first arguments. For NetworkMessages with several
+ * DataSetMessages these are of the first DataSetMessage.
+ *
+ * Publisher (server thread):
+ *
+ * - ``publish_start(wgId, writersCount)``
+ * - ``dsm_generated(wgId, dswId, seq, status)``
+ * - ``nm_start(wgId, dswId, seq, dsmCount)``
+ * - ``nm_sized(wgId, dswId, seq, bytes)``
+ * - ``nm_encoded(wgId, dswId, seq, bytes, status)``
+ * - ``nm_sent(wgId, dswId, seq, bytes, status)``
+ * - ``publish_done(wgId)``
+ *
+ * Subscriber (worker threads of the sharded receiver, or the server thread):
+ *
+ * - ``rx_received(shard, bytes)``
+ * - ``rx_decoded(wgId, dswId, seq, bytes, status)``
+ * - ``rx_dispatched(wgId, dswId, seq, shard)``
+ *
+ * For example, the encoding time per WriterGroup:
+ *
+ *    bpftrace -e 'usdt:./publish_time:open62541_pubsub:nm_sized
+ *                 { @t[tid] = nsecs; }
+ *                 usdt:./publish_time:open62541_pubsub:nm_encoded /@t[tid]/
+ *                 { @encode[arg0] = hist(nsecs - @t[tid]); delete(@t[tid]); }'
+ *
+ * or with perf: ``perf buildid-cache --add ./publish_time``, then
+ * ``perf record -e sdt_open62541_pubsub:* ./publish_time``. */
+
+#ifdef UA_ENABLE_PUBSUB_TRACING
+
+#define _SDT_HAS_SEMAPHORES 1
+#include <sys/sdt.h>
+
+/* The semaphores are weak, so that every translation unit with probes can
+ * define them and the linker keeps one of each */
+#define UA_PUBSUB_TRACE_SEMAPHORE(name)                                 \
+    __attribute__((weak, section(".probes")))                           \
+    volatile unsigned short open62541_pubsub_##name##_semaphore
+
+UA_PUBSUB_TRACE_SEMAPHORE(publish_start);
+UA_PUBSUB_TRACE_SEMAPHORE(dsm_generated);
+UA_PUBSUB_TRACE_SEMAPHORE(nm_start);
+UA_PUBSUB_TRACE_SEMAPHORE(nm_sized);
+UA_PUBSUB_TRACE_SEMAPHORE(nm_encoded);
+UA_PUBSUB_TRACE_SEMAPHORE(nm_sent);
+UA_PUBSUB_TRACE_SEMAPHORE(publish_done);
+UA_PUBSUB_TRACE_SEMAPHORE(rx_received);
+UA_PUBSUB_TRACE_SEMAPHORE(rx_decoded);
+UA_PUBSUB_TRACE_SEMAPHORE(rx_dispatched);
+
+/* A tracer is attached to the probe */
+#define UA_PUBSUB_TRACE_ENABLED(name)                                   \
+    __builtin_expect(open62541_pubsub_##name##_semaphore != 0, 0)
+
+#define UA_PUBSUB_TRACE(name, ...) do {                                 \
+        if(UA_PUBSUB_TRACE_ENABLED(name))                               \
+            STAP_PROBEV(open62541_pubsub, name, __VA_ARGS__);           \
+    } while(0)
+
+/* Identifiers of a NetworkMessage for the probes. 0 if not contained. */
+
+static UA_INLINE UA_UInt16
+UA_PubSubTrace_writerGroupId(const UA_NetworkMessage *nm) {
+    return nm->groupHeaderEnabled ? nm->groupHeader.writerGroupId : 0;
+}
+
+static UA_INLINE UA_UInt16
+UA_PubSubTrace_dataSetWriterId(const UA_NetworkMessage *nm) {
+    if(!nm->payloadHeaderEnabled || nm->networkMessageType != UA_NETWORKMESSAGE_DATASET ||
+       nm->payloadHeader.dataSetPayloadHeader.count == 0 ||
+       !nm->payloadHeader.dataSetPayloadHeader.dataSetWriterIds)
+        return 0;
+    return nm->payloadHeader.dataSetPayloadHeader.dataSetWriterIds[0];
+}
+
+static UA_INLINE UA_UInt16
+UA_PubSubTrace_sequenceNumber(const UA_NetworkMessage *nm) {
+    if(nm->networkMessageType != UA_NETWORKMESSAGE_DATASET ||
+       !nm->payload.dataSetPayload.dataSetMessages)
+        return 0;
+    const UA_DataSetMessageHeader *header =
+        &nm->payload.dataSetPayload.dataSetMessages[0].header;
+    return header->dataSetMessageSequenceNrEnabled ? header->dataSetMessageSequenceNr : 0;
+}
+
+#else
+
+#define UA_PUBSUB_TRACE_ENABLED(name) 0
+#define UA_PUBSUB_TRACE(...) do {} while(0)
+
+#endif /* UA_ENABLE_PUBSUB_TRACING */
+
+_UA_END_DECLS
+
+#endif /* UA_PUBSUB_TRACE_H_ */
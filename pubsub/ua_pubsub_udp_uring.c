@@ -0,0 +1,935 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <open62541/plugin/log_stdout.h>
+#include <open62541/server_config.h>
+
+#include "pubsub_udp_uring.h"
+#include "pubsub_channel_ext.h"
+
+#include <liburing.h>
+#include <errno.h>
+#include <time.h>
+#include <linux/net_tstamp.h>
+#include <netdb.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define UA_URING_DEFAULT_SLOTS 64
+#define UA_URING_DEFAULT_SLOTSIZE 9000
+#define UA_URING_DEFAULT_ZEROCOPY 4096
+#define UA_URING_MAX_SLOTS 32768
+#define UA_URING_RX_BGID 1
+#define UA_URING_CLOSE_TIMEOUT 100 /* ms */
+
+/* Message header of a scheduled send. It must stay in place until the write
+ * is submitted. */
+typedef struct {
+    struct msghdr msg;
+    struct iovec iov;
+    union {
+        char buf[CMSG_SPACE(sizeof(UA_UInt64))];
+        struct cmsghdr align;
+    } control;
+} UA_UringTxMsg;
+
+/* UDP multicast channel data on io_uring */
+typedef struct {
+    struct sockaddr_storage groupAddress;
+    socklen_t groupAddressLength;
+    unsigned int interfaceIndex;
+    struct in_addr interfaceAddress;
+    UA_UInt32 messageTTL;
+    UA_Boolean enableLoopback;
+    UA_Boolean enableReuse;
+    UA_UInt32 slots;
+    UA_UInt32 slotSize;
+    UA_UInt32 zeroCopyThreshold; /* 0 disables zero-copy sends */
+
+    /* Transmit path. Set up with the first send. The socket is connected to
+     * the group address, so that fixed-buffer writes produce datagrams. */
+    UA_Boolean txReady;
+    UA_SOCKET txSocket;
+    struct io_uring txRing;
+    UA_Byte *txArea;
+    UA_UInt16 *txFree;      /* stack of free slot indices */
+    UA_UInt32 txFreeCount;
+    UA_UInt32 txQueued;     /* prepared but not yet submitted */
+    UA_UInt32 txInFlight;   /* submitted, slot not yet returned */
+    UA_UInt64 txErrors;
+
+    /* Scheduled transmission with SO_TXTIME */
+    clockid_t txClock;
+    UA_Boolean txTimeEnabled;
+    UA_UInt64 launchTime;   /* ns on txClock; 0 sends right away */
+    UA_UringTxMsg *txMsgs;  /* one per slot */
+
+    /* Receive path. Set up in regist. */
+    UA_Boolean rxReady;
+    UA_Boolean rxArmed;
+    struct io_uring rxRing;
+    struct io_uring_buf_ring *rxBufRing;
+    UA_Byte *rxArea;
+} UA_PubSubChannelDataUDPUring;
+
+static UA_Boolean
+isMulticast(const struct sockaddr_storage *addr) {
+    if(addr->ss_family == AF_INET)
+        return IN_MULTICAST(ntohl(((const struct sockaddr_in *)addr)->sin_addr.s_addr));
+    if(addr->ss_family == AF_INET6)
+        return IN6_IS_ADDR_MULTICAST(&((const struct sockaddr_in6 *)addr)->sin6_addr);
+    return false;
+}
+
+/* Split opc.udp://host:port/ into host and port strings */
+static UA_StatusCode
+parseUdpUrl(const UA_String *url, char *host, size_t hostSize,
+            char *port, size_t portSize) {
+    const char *prefix = "opc.udp://";
+    size_t prefixLength = strlen(prefix);
+    if(url->length <= prefixLength || strncmp((const char*)url->data, prefix, prefixLength) != 0)
+        return UA_STATUSCODE_BADINVALIDARGUMENT;
+
+    size_t pos = prefixLength;
+    size_t hostStart = pos, hostEnd;
+    if(url->data[pos] == '[') {
+        /* IPv6 literal */
+        hostStart = ++pos;
+        while(pos < url->length && url->data[pos] != ']')
+            pos++;
+        if(pos == url->length)
+            return UA_STATUSCODE_BADINVALIDARGUMENT;
+        hostEnd = pos++;
+    } else {
+        while(pos < url->length && url->data[pos] != ':' && url->data[pos] != '/')
+            pos++;
+        hostEnd = pos;
+    }
+    if(hostEnd == hostStart || hostEnd - hostStart >= hostSize)
+        return UA_STATUSCODE_BADINVALIDARGUMENT;
+    memcpy(host, &url->data[hostStart], hostEnd - hostStart);
+    host[hostEnd - hostStart] = '\0';
+
+    if(pos >= url->length || url->data[pos] != ':')
+        return UA_STATUSCODE_BADINVALIDARGUMENT;
+    size_t portStart = ++pos;
+    while(pos < url->length && url->data[pos] >= '0' && url->data[pos] <= '9')
+        pos++;
+    if(pos == portStart || pos - portStart >= portSize)
+        return UA_STATUSCODE_BADINVALIDARGUMENT;
+    memcpy(port, &url->data[portStart], pos - portStart);
+    port[pos - portStart] = '\0';
+    return UA_STATUSCODE_GOOD;
+}
+
+static void
+parseConnectionProperties(const UA_PubSubConnectionConfig *connectionConfig,
+                          UA_PubSubChannelDataUDPUring *channelData) {
+    UA_String ttlParam = UA_STRING("ttl"), loopbackParam = UA_STRING("loopback"),
+        reuseParam = UA_STRING("reuse"), slotsParam = UA_STRING("slots"),
+        slotSizeParam = UA_STRING("slotSize"), clockParam = UA_STRING("txtimeClock"),
+        zeroCopyParam = UA_STRING("zeroCopyThreshold");
+    UA_String monotonicClock = UA_STRING("monotonic");
+    for(size_t i = 0; i < connectionConfig->connectionPropertiesSize; i++) {
+        const UA_KeyValuePair *property = &connectionConfig->connectionProperties[i];
+        if(UA_String_equal(&property->key.name, &ttlParam)) {
+            if(UA_Variant_hasScalarType(&property->value, &UA_TYPES[UA_TYPES_UINT32]))
+                channelData->messageTTL = *(UA_UInt32 *) property->value.data;
+        } else if(UA_String_equal(&property->key.name, &loopbackParam)) {
+            if(UA_Variant_hasScalarType(&property->value, &UA_TYPES[UA_TYPES_BOOLEAN]))
+                channelData->enableLoopback = *(UA_Boolean *) property->value.data;
+        } else if(UA_String_equal(&property->key.name, &reuseParam)) {
+            if(UA_Variant_hasScalarType(&property->value, &UA_TYPES[UA_TYPES_BOOLEAN]))
+                channelData->enableReuse = *(UA_Boolean *) property->value.data;
+        } else if(UA_String_equal(&property->key.name, &slotsParam)) {
+            if(UA_Variant_hasScalarType(&property->value, &UA_TYPES[UA_TYPES_UINT32]))
+                channelData->slots = *(UA_UInt32 *) property->value.data;
+        } else if(UA_String_equal(&property->key.name, &slotSizeParam)) {
+            if(UA_Variant_hasScalarType(&property->value, &UA_TYPES[UA_TYPES_UINT32]))
+                channelData->slotSize = *(UA_UInt32 *) property->value.data;
+        } else if(UA_String_equal(&property->key.name, &zeroCopyParam)) {
+            if(UA_Variant_hasScalarType(&property->value, &UA_TYPES[UA_TYPES_UINT32]))
+                channelData->zeroCopyThreshold = *(UA_UInt32 *) property->value.data;
+        } else if(UA_String_equal(&property->key.name, &clockParam)) {
+            if(UA_Variant_hasScalarType(&property->value, &UA_TYPES[UA_TYPES_STRING]) &&
+               UA_String_equal((UA_String *) property->value.data, &monotonicClock))
+                channelData->txClock = CLOCK_MONOTONIC;
+        } else {
+            UA_LOG_WARNING(UA_Log_Stdout, UA_LOGCATEGORY_SERVER,
+                           "PubSub Connection creation. Unknown connection parameter.");
+        }
+    }
+}
+
+/* Open a UDP multicast channel. The socket that is created here receives the
+ * messages. Sending uses a second, connected socket. */
+static UA_PubSubChannel *
+UA_PubSubChannelUDPUring_open(const UA_PubSubConnectionConfig *connectionConfig) {
+    if(!UA_Variant_hasScalarType(&connectionConfig->address,
+                                 &UA_TYPES[UA_TYPES_NETWORKADDRESSURLDATATYPE])) {
+        UA_LOG_ERROR(UA_Log_Stdout, UA_LOGCATEGORY_SERVER,
+                     "PubSub Connection creation failed. Invalid Address.");
+        return NULL;
+    }
+    UA_NetworkAddressUrlDataType *address =
+        (UA_NetworkAddressUrlDataType *)connectionConfig->address.data;
+
+    char host[256], port[8];
+    if(parseUdpUrl(&address->url, host, sizeof(host), port, sizeof(port)) != UA_STATUSCODE_GOOD) {
+        UA_LOG_ERROR(UA_Log_Stdout, UA_LOGCATEGORY_SERVER,
+                     "PubSub Connection creation failed. Invalid URL.");
+        return NULL;
+    }
+
+    struct addrinfo hints, *rp;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+    hints.ai_protocol = IPPROTO_UDP;
+    if(getaddrinfo(host, port, &hints, &rp) != 0 || !rp) {
+        UA_LOG_ERROR(UA_Log_Stdout, UA_LOGCATEGORY_SERVER,
+                     "PubSub Connection creation failed. Internal error.");
+        return NULL;
+    }
+
+    UA_PubSubChannelDataUDPUring *channelData = (UA_PubSubChannelDataUDPUring *)
+        UA_calloc(1, sizeof(UA_PubSubChannelDataUDPUring));
+    UA_PubSubChannel *newChannel = (UA_PubSubChannel *) UA_calloc(1, sizeof(UA_PubSubChannel));
+    if(!channelData || !newChannel) {
+        UA_LOG_ERROR(UA_Log_Stdout, UA_LOGCATEGORY_SERVER,
+                     "PubSub Connection creation failed. Out of memory.");
+        UA_free(channelData);
+        UA_free(newChannel);
+        freeaddrinfo(rp);
+        return NULL;
+    }
+    memcpy(&channelData->groupAddress, rp->ai_addr, rp->ai_addrlen);
+    channelData->groupAddressLength = rp->ai_addrlen;
+    freeaddrinfo(rp);
+
+    channelData->messageTTL = 255;
+    channelData->enableLoopback = true;
+    channelData->enableReuse = true;
+    channelData->slots = UA_URING_DEFAULT_SLOTS;
+    channelData->slotSize = UA_URING_DEFAULT_SLOTSIZE;
+    channelData->zeroCopyThreshold = UA_URING_DEFAULT_ZEROCOPY;
+    channelData->txSocket = -1;
+    channelData->txClock = CLOCK_TAI;
+    parseConnectionProperties(connectionConfig, channelData);
+    if(channelData->slots == 0 || channelData->slots > UA_URING_MAX_SLOTS ||
+       (channelData->slots & (channelData->slots - 1)) != 0 || channelData->slotSize == 0) {
+        UA_LOG_ERROR(UA_Log_Stdout, UA_LOGCATEGORY_SERVER,
+                     "PubSub Connection creation failed. Invalid slot configuration.");
+        UA_free(channelData);
+        UA_free(newChannel);
+        return NULL;
+    }
+
+    /* The interface is given either by name or by IPv4 address */
+    if(address->networkInterface.length > 0 && address->networkInterface.length < IF_NAMESIZE + 16) {
+        char ifName[IF_NAMESIZE + 16];
+        memcpy(ifName, address->networkInterface.data, address->networkInterface.length);
+        ifName[address->networkInterface.length] = '\0';
+        channelData->interfaceIndex = if_nametoindex(ifName);
+        if(channelData->interfaceIndex == 0 &&
+           inet_pton(AF_INET, ifName, &channelData->interfaceAddress) != 1) {
+            UA_LOG_ERROR(UA_Log_Stdout, UA_LOGCATEGORY_SERVER,
+                         "PubSub Connection creation failed. Unknown interface.");
+            UA_free(channelData);
+            UA_free(newChannel);
+            return NULL;
+        }
+    }
+
+    newChannel->sockfd = socket(channelData->groupAddress.ss_family, SOCK_DGRAM, IPPROTO_UDP);
+    if(newChannel->sockfd < 0) {
+        UA_LOG_ERROR(UA_Log_Stdout, UA_LOGCATEGORY_SERVER,
+                     "PubSub Connection creation failed. Cannot create socket.");
+        UA_free(channelData);
+        UA_free(newChannel);
+        return NULL;
+    }
+    if(channelData->enableReuse) {
+        int enable = 1;
+        if(setsockopt(newChannel->sockfd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable)) < 0)
+            UA_LOG_WARNING(UA_Log_Stdout, UA_LOGCATEGORY_SERVER,
+                           "PubSub Connection creation problem. Cannot set SO_REUSEADDR.");
+    }
+
+    newChannel->handle = channelData;
+    newChannel->state = UA_PUBSUB_CHANNEL_RDY;
+    return newChannel;
+}
+
+/* Apply the multicast options to the transmit socket */
+static UA_StatusCode
+setMulticastSendOptions(UA_PubSubChannelDataUDPUring *channelData) {
+    int res = 0;
+    if(channelData->groupAddress.ss_family == AF_INET) {
+        int ttl = (int)channelData->messageTTL;
+        int loop = channelData->enableLoopback ? 1 : 0;
+        res |= setsockopt(channelData->txSocket, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+        res |= setsockopt(channelData->txSocket, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop));
+        if(channelData->interfaceIndex != 0 || channelData->interfaceAddress.s_addr != 0) {
+            struct ip_mreqn mreqn;
+            memset(&mreqn, 0, sizeof(mreqn));
+            mreqn.imr_ifindex = (int)channelData->interfaceIndex;
+            mreqn.imr_address = channelData->interfaceAddress;
+            res |= setsockopt(channelData->txSocket, IPPROTO_IP, IP_MULTICAST_IF, &mreqn, sizeof(mreqn));
+        }
+    } else {
+        int hops = (int)channelData->messageTTL;
+        unsigned int loop = channelData->enableLoopback ? 1 : 0;
+        res |= setsockopt(channelData->txSocket, IPPROTO_IPV6, IPV6_MULTICAST_HOPS, &hops, sizeof(hops));
+        res |= setsockopt(channelData->txSocket, IPPROTO_IPV6, IPV6_MULTICAST_LOOP, &loop, sizeof(loop));
+        if(channelData->interfaceIndex != 0)
+            res |= setsockopt(channelData->txSocket, IPPROTO_IPV6, IPV6_MULTICAST_IF,
+                              &channelData->interfaceIndex, sizeof(channelData->interfaceIndex));
+    }
+    return (res == 0) ? UA_STATUSCODE_GOOD : UA_STATUSCODE_BADINTERNALERROR;
+}
+
+static void
+UA_PubSubChannelUDPUring_txCleanup(UA_PubSubChannelDataUDPUring *channelData) {
+    if(channelData->txArea)
+        io_uring_queue_exit(&channelData->txRing);
+    if(channelData->txSocket >= 0)
+        close(channelData->txSocket);
+    free(channelData->txArea);
+    UA_free(channelData->txFree);
+    UA_free(channelData->txMsgs);
+    channelData->txArea = NULL;
+    channelData->txFree = NULL;
+    channelData->txMsgs = NULL;
+    channelData->txTimeEnabled = false;
+    channelData->txSocket = -1;
+    channelData->txReady = false;
+}
+
+static UA_StatusCode
+UA_PubSubChannelUDPUring_txInit(UA_PubSubChannelDataUDPUring *channelData) {
+    channelData->txSocket = socket(channelData->groupAddress.ss_family, SOCK_DGRAM, IPPROTO_UDP);
+    if(channelData->txSocket < 0)
+        return UA_STATUSCODE_BADINTERNALERROR;
+    if(isMulticast(&channelData->groupAddress) &&
+       setMulticastSendOptions(channelData) != UA_STATUSCODE_GOOD)
+        UA_LOG_WARNING(UA_Log_Stdout, UA_LOGCATEGORY_SERVER,
+                       "PubSub io_uring: Cannot apply the multicast options");
+    if(connect(channelData->txSocket, (struct sockaddr*)&channelData->groupAddress,
+               channelData->groupAddressLength) < 0) {
+        UA_PubSubChannelUDPUring_txCleanup(channelData);
+        return UA_STATUSCODE_BADINTERNALERROR;
+    }
+
+    size_t areaSize = (size_t)channelData->slots * channelData->slotSize;
+    void *area = NULL;
+    if(posix_memalign(&area, (size_t)sysconf(_SC_PAGESIZE), areaSize) != 0) {
+        UA_PubSubChannelUDPUring_txCleanup(channelData);
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    }
+    channelData->txFree = (UA_UInt16 *) UA_calloc(channelData->slots, sizeof(UA_UInt16));
+    channelData->txMsgs = (UA_UringTxMsg *) UA_calloc(channelData->slots, sizeof(UA_UringTxMsg));
+    if(!channelData->txFree || !channelData->txMsgs) {
+        free(area);
+        UA_PubSubChannelUDPUring_txCleanup(channelData);
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    }
+    if(io_uring_queue_init(channelData->slots, &channelData->txRing, 0) < 0) {
+        free(area);
+        UA_PubSubChannelUDPUring_txCleanup(channelData);
+        return UA_STATUSCODE_BADINTERNALERROR;
+    }
+    channelData->txArea = (UA_Byte *)area;
+
+    /* All slots are one registered buffer (buf_index 0) */
+    struct iovec iov;
+    iov.iov_base = channelData->txArea;
+    iov.iov_len = areaSize;
+    if(io_uring_register_buffers(&channelData->txRing, &iov, 1) < 0) {
+        UA_PubSubChannelUDPUring_txCleanup(channelData);
+        return UA_STATUSCODE_BADINTERNALERROR;
+    }
+
+    for(UA_UInt32 i = 0; i < channelData->slots; i++)
+        channelData->txFree[i] = (UA_UInt16)(channelData->slots - 1 - i);
+    channelData->txFreeCount = channelData->slots;
+    channelData->txQueued = 0;
+    channelData->txInFlight = 0;
+    channelData->txReady = true;
+    return UA_STATUSCODE_GOOD;
+}
+
+/* Return the slots of completed writes to the free stack. A zero-copy send
+ * completes twice. The first completion has the result and IORING_CQE_F_MORE
+ * set. The slot stays in use until the notification that the kernel no longer
+ * references the data. */
+static void
+UA_PubSubChannelUDPUring_txReap(UA_PubSubChannelDataUDPUring *channelData) {
+    struct io_uring_cqe *cqe;
+    while(io_uring_peek_cqe(&channelData->txRing, &cqe) == 0) {
+        if(!(cqe->flags & IORING_CQE_F_NOTIF) && cqe->res < 0)
+            channelData->txErrors++;
+        if(!(cqe->flags & IORING_CQE_F_MORE)) {
+            channelData->txFree[channelData->txFreeCount++] =
+                (UA_UInt16)io_uring_cqe_get_data64(cqe);
+            channelData->txInFlight--;
+        }
+        io_uring_cqe_seen(&channelData->txRing, cqe);
+    }
+}
+
+static UA_StatusCode
+UA_PubSubChannelUDPUring_txFlush(UA_PubSubChannelDataUDPUring *channelData) {
+    if(channelData->txQueued == 0)
+        return UA_STATUSCODE_GOOD;
+    int res = io_uring_submit(&channelData->txRing);
+    if(res < 0)
+        return UA_STATUSCODE_BADINTERNALERROR;
+    /* Only the submitted writes complete */
+    if((UA_UInt32)res > channelData->txQueued)
+        res = (int)channelData->txQueued;
+    channelData->txInFlight += (UA_UInt32)res;
+    channelData->txQueued -= (UA_UInt32)res;
+    return (channelData->txQueued == 0) ?
+        UA_STATUSCODE_GOOD : UA_STATUSCODE_BADINTERNALERROR;
+}
+
+/* The launch time is passed as control message */
+static void
+prepareTxMsg(UA_UringTxMsg *txMsg, void *data, size_t length, UA_UInt64 launchTime) {
+    memset(txMsg, 0, sizeof(UA_UringTxMsg));
+    txMsg->iov.iov_base = data;
+    txMsg->iov.iov_len = length;
+    txMsg->msg.msg_iov = &txMsg->iov;
+    txMsg->msg.msg_iovlen = 1;
+    if(launchTime == 0)
+        return;
+    txMsg->msg.msg_control = txMsg->control.buf;
+    txMsg->msg.msg_controllen = sizeof(txMsg->control.buf);
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&txMsg->msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_TXTIME;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(UA_UInt64));
+    memcpy(CMSG_DATA(cmsg), &launchTime, sizeof(UA_UInt64));
+}
+
+/* Set up the transmit path with the first send */
+static UA_StatusCode
+UA_PubSubChannelUDPUring_txPrepare(UA_PubSubChannel *channel) {
+    UA_PubSubChannelDataUDPUring *channelData = (UA_PubSubChannelDataUDPUring *) channel->handle;
+    if(!(channel->state == UA_PUBSUB_CHANNEL_PUB || channel->state == UA_PUBSUB_CHANNEL_PUB_SUB ||
+         channel->state == UA_PUBSUB_CHANNEL_RDY)) {
+        UA_LOG_ERROR(UA_Log_Stdout, UA_LOGCATEGORY_SERVER,
+                     "PubSub Connection sending failed. Invalid state.");
+        return UA_STATUSCODE_BADINTERNALERROR;
+    }
+    if(channelData->txReady)
+        return UA_STATUSCODE_GOOD;
+    UA_StatusCode retval = UA_PubSubChannelUDPUring_txInit(channelData);
+    if(retval != UA_STATUSCODE_GOOD) {
+        UA_LOG_ERROR(UA_Log_Stdout, UA_LOGCATEGORY_SERVER,
+                     "PubSub io_uring: Cannot set up the transmit ring");
+        return retval;
+    }
+    if(channel->state == UA_PUBSUB_CHANNEL_RDY)
+        channel->state = UA_PUBSUB_CHANNEL_PUB;
+    else if(channel->state == UA_PUBSUB_CHANNEL_SUB)
+        channel->state = UA_PUBSUB_CHANNEL_PUB_SUB;
+    return UA_STATUSCODE_GOOD;
+}
+
+static struct io_uring_sqe *
+UA_PubSubChannelUDPUring_txGetSqe(UA_PubSubChannelDataUDPUring *channelData) {
+    struct io_uring_sqe *sqe = io_uring_get_sqe(&channelData->txRing);
+    if(sqe)
+        return sqe;
+    if(UA_PubSubChannelUDPUring_txFlush(channelData) != UA_STATUSCODE_GOOD)
+        return NULL;
+    return io_uring_get_sqe(&channelData->txRing);
+}
+
+/* Queue the write of a slot. Messages from the zero-copy threshold on are sent
+ * with IORING_OP_SEND_ZC, so the kernel does not copy the slot. */
+static void
+UA_PubSubChannelUDPUring_txQueueSlot(UA_PubSubChannelDataUDPUring *channelData,
+                                     struct io_uring_sqe *sqe, UA_UInt16 slot, size_t length) {
+    UA_Byte *slotData = &channelData->txArea[(size_t)slot * channelData->slotSize];
+    UA_Boolean zeroCopy =
+        channelData->zeroCopyThreshold > 0 && length >= channelData->zeroCopyThreshold;
+    if(channelData->launchTime == 0) {
+        if(zeroCopy)
+            io_uring_prep_send_zc_fixed(sqe, channelData->txSocket, slotData, length, 0, 0, 0);
+        else
+            io_uring_prep_write_fixed(sqe, channelData->txSocket, slotData,
+                                      (unsigned)length, 0, 0);
+    } else {
+        UA_UringTxMsg *txMsg = &channelData->txMsgs[slot];
+        prepareTxMsg(txMsg, slotData, length, channelData->launchTime);
+        if(zeroCopy)
+            io_uring_prep_sendmsg_zc(sqe, channelData->txSocket, &txMsg->msg, 0);
+        else
+            io_uring_prep_sendmsg(sqe, channelData->txSocket, &txMsg->msg, 0);
+    }
+    io_uring_sqe_set_data64(sqe, slot);
+    channelData->txQueued++;
+}
+
+/* Send a message. The message is copied into a registered slot and queued.
+ * It is handed to the kernel at the end of the publish cycle (yield) or when
+ * no free slot remains. If all slots are in flight, a blocking send waits for
+ * the oldest write. Otherwise UA_STATUSCODE_BADWOULDBLOCK is returned. */
+static UA_StatusCode
+UA_PubSubChannelUDPUring_sendMessage(UA_PubSubChannel *channel, const UA_ByteString *buf,
+                                     UA_Boolean block) {
+    UA_PubSubChannelDataUDPUring *channelData = (UA_PubSubChannelDataUDPUring *) channel->handle;
+    UA_StatusCode retval = UA_PubSubChannelUDPUring_txPrepare(channel);
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+
+    /* Oversized messages bypass the ring. Flush first to keep the order. */
+    if(buf->length > channelData->slotSize) {
+        UA_PubSubChannelUDPUring_txFlush(channelData);
+        UA_UringTxMsg txMsg;
+        prepareTxMsg(&txMsg, buf->data, buf->length, channelData->launchTime);
+        if(sendmsg(channelData->txSocket, &txMsg.msg, block ? 0 : MSG_DONTWAIT) !=
+           (ssize_t)buf->length) {
+            if(!block && (errno == EAGAIN || errno == EWOULDBLOCK))
+                return UA_STATUSCODE_BADWOULDBLOCK;
+            UA_LOG_ERROR(UA_Log_Stdout, UA_LOGCATEGORY_SERVER,
+                         "PubSub Connection sending failed.");
+            return UA_STATUSCODE_BADINTERNALERROR;
+        }
+        return UA_STATUSCODE_GOOD;
+    }
+
+    UA_PubSubChannelUDPUring_txReap(channelData);
+    if(channelData->txFreeCount == 0) {
+        if(!block) {
+            /* Submit what is queued, so that the slots become free */
+            UA_PubSubChannelUDPUring_txFlush(channelData);
+            return UA_STATUSCODE_BADWOULDBLOCK;
+        }
+        /* All slots are in flight. Wait for the oldest write. */
+        if(UA_PubSubChannelUDPUring_txFlush(channelData) != UA_STATUSCODE_GOOD)
+            return UA_STATUSCODE_BADINTERNALERROR;
+        while(channelData->txFreeCount == 0) {
+            /* The slots are lent to the encoder, nothing to wait for */
+            if(channelData->txInFlight == 0)
+                return UA_STATUSCODE_BADINTERNALERROR;
+            struct io_uring_cqe *cqe;
+            if(io_uring_wait_cqe(&channelData->txRing, &cqe) < 0)
+                return UA_STATUSCODE_BADINTERNALERROR;
+            UA_PubSubChannelUDPUring_txReap(channelData);
+        }
+    }
+
+    struct io_uring_sqe *sqe = UA_PubSubChannelUDPUring_txGetSqe(channelData);
+    if(!sqe)
+        return UA_STATUSCODE_BADINTERNALERROR;
+    UA_UInt16 slot = channelData->txFree[--channelData->txFreeCount];
+    memcpy(&channelData->txArea[(size_t)slot * channelData->slotSize], buf->data, buf->length);
+    UA_PubSubChannelUDPUring_txQueueSlot(channelData, sqe, slot, buf->length);
+    return UA_STATUSCODE_GOOD;
+}
+
+static UA_StatusCode
+UA_PubSubChannelUDPUring_send(UA_PubSubChannel *channel, UA_ExtensionObject *transportSettings,
+                              const UA_ByteString *buf) {
+    return UA_PubSubChannelUDPUring_sendMessage(channel, buf, true);
+}
+
+static UA_StatusCode
+UA_PubSubChannelUDPUring_sendNonBlocking(UA_PubSubChannel *channel,
+                                         UA_ExtensionObject *transportSettings,
+                                         const UA_ByteString *buf) {
+    return UA_PubSubChannelUDPUring_sendMessage(channel, buf, false);
+}
+
+/* Lend a free slot to the encoder. The message is then queued without a
+ * copy. Fails without waiting if no slot is free. */
+static UA_StatusCode
+UA_PubSubChannelUDPUring_acquireBuffer(UA_PubSubChannel *channel, size_t length,
+                                       UA_ByteString *buf) {
+    UA_PubSubChannelDataUDPUring *channelData = (UA_PubSubChannelDataUDPUring *) channel->handle;
+    if(length > channelData->slotSize)
+        return UA_STATUSCODE_BADRESOURCEUNAVAILABLE;
+    UA_StatusCode retval = UA_PubSubChannelUDPUring_txPrepare(channel);
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+    UA_PubSubChannelUDPUring_txReap(channelData);
+    if(channelData->txFreeCount == 0)
+        return UA_STATUSCODE_BADRESOURCEUNAVAILABLE;
+    UA_UInt16 slot = channelData->txFree[--channelData->txFreeCount];
+    buf->data = &channelData->txArea[(size_t)slot * channelData->slotSize];
+    buf->length = length;
+    return UA_STATUSCODE_GOOD;
+}
+
+static UA_UInt16
+UA_PubSubChannelUDPUring_slotOf(const UA_PubSubChannelDataUDPUring *channelData,
+                                const UA_ByteString *buf) {
+    return (UA_UInt16)((size_t)(buf->data - channelData->txArea) / channelData->slotSize);
+}
+
+static void
+UA_PubSubChannelUDPUring_releaseBuffer(UA_PubSubChannel *channel, UA_ByteString *buf) {
+    UA_PubSubChannelDataUDPUring *channelData = (UA_PubSubChannelDataUDPUring *) channel->handle;
+    channelData->txFree[channelData->txFreeCount++] =
+        UA_PubSubChannelUDPUring_slotOf(channelData, buf);
+    buf->data = NULL;
+    buf->length = 0;
+}
+
+static UA_StatusCode
+UA_PubSubChannelUDPUring_sendBuffer(UA_PubSubChannel *channel,
+                                    UA_ExtensionObject *transportSettings, UA_ByteString *buf) {
+    UA_PubSubChannelDataUDPUring *channelData = (UA_PubSubChannelDataUDPUring *) channel->handle;
+    struct io_uring_sqe *sqe = UA_PubSubChannelUDPUring_txGetSqe(channelData);
+    if(!sqe) {
+        UA_PubSubChannelUDPUring_releaseBuffer(channel, buf);
+        return UA_STATUSCODE_BADINTERNALERROR;
+    }
+    UA_PubSubChannelUDPUring_txQueueSlot(channelData, sqe,
+                                         UA_PubSubChannelUDPUring_slotOf(channelData, buf),
+                                         buf->length);
+    buf->data = NULL;
+    buf->length = 0;
+    return UA_STATUSCODE_GOOD;
+}
+
+/* Submit the writes queued in this publish cycle */
+static UA_StatusCode
+UA_PubSubChannelUDPUring_yield(UA_PubSubChannel *channel, UA_UInt16 timeout) {
+    UA_PubSubChannelDataUDPUring *channelData = (UA_PubSubChannelDataUDPUring *) channel->handle;
+    if(!channelData->txReady)
+        return UA_STATUSCODE_GOOD;
+    UA_PubSubChannelUDPUring_txReap(channelData);
+    UA_StatusCode retval = UA_PubSubChannelUDPUring_txFlush(channelData);
+    if(channelData->txErrors > 0) {
+        UA_LOG_WARNING(UA_Log_Stdout, UA_LOGCATEGORY_SERVER,
+                       "PubSub io_uring: %lu messages could not be sent",
+                       (unsigned long)channelData->txErrors);
+        channelData->txErrors = 0;
+    }
+    return retval;
+}
+
+static UA_StatusCode
+UA_PubSubChannelUDPUring_rxArm(UA_PubSubChannel *channel) {
+    UA_PubSubChannelDataUDPUring *channelData = (UA_PubSubChannelDataUDPUring *) channel->handle;
+    struct io_uring_sqe *sqe = io_uring_get_sqe(&channelData->rxRing);
+    if(!sqe)
+        return UA_STATUSCODE_BADINTERNALERROR;
+    io_uring_prep_recv_multishot(sqe, channel->sockfd, NULL, 0, 0);
+    sqe->flags |= IOSQE_BUFFER_SELECT;
+    sqe->buf_group = UA_URING_RX_BGID;
+    io_uring_sqe_set_data64(sqe, 0);
+    if(io_uring_submit(&channelData->rxRing) < 0)
+        return UA_STATUSCODE_BADINTERNALERROR;
+    channelData->rxArmed = true;
+    return UA_STATUSCODE_GOOD;
+}
+
+static void
+UA_PubSubChannelUDPUring_rxCleanup(UA_PubSubChannelDataUDPUring *channelData) {
+    if(channelData->rxBufRing)
+        io_uring_free_buf_ring(&channelData->rxRing, channelData->rxBufRing,
+                               channelData->slots, UA_URING_RX_BGID);
+    if(channelData->rxArea)
+        io_uring_queue_exit(&channelData->rxRing);
+    free(channelData->rxArea);
+    channelData->rxBufRing = NULL;
+    channelData->rxArea = NULL;
+    channelData->rxReady = false;
+    channelData->rxArmed = false;
+}
+
+static UA_StatusCode
+UA_PubSubChannelUDPUring_rxInit(UA_PubSubChannelDataUDPUring *channelData) {
+    size_t areaSize = (size_t)channelData->slots * channelData->slotSize;
+    void *area = NULL;
+    if(posix_memalign(&area, (size_t)sysconf(_SC_PAGESIZE), areaSize) != 0)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    if(io_uring_queue_init(8, &channelData->rxRing, 0) < 0) {
+        free(area);
+        return UA_STATUSCODE_BADINTERNALERROR;
+    }
+    channelData->rxArea = (UA_Byte *)area;
+
+    int res = 0;
+    channelData->rxBufRing = io_uring_setup_buf_ring(&channelData->rxRing, channelData->slots,
+                                                     UA_URING_RX_BGID, 0, &res);
+    if(!channelData->rxBufRing) {
+        UA_PubSubChannelUDPUring_rxCleanup(channelData);
+        return UA_STATUSCODE_BADINTERNALERROR;
+    }
+    int mask = io_uring_buf_ring_mask(channelData->slots);
+    for(UA_UInt32 i = 0; i < channelData->slots; i++)
+        io_uring_buf_ring_add(channelData->rxBufRing,
+                              &channelData->rxArea[(size_t)i * channelData->slotSize],
+                              channelData->slotSize, (unsigned short)i, mask, (int)i);
+    io_uring_buf_ring_advance(channelData->rxBufRing, (int)channelData->slots);
+    channelData->rxReady = true;
+    return UA_STATUSCODE_GOOD;
+}
+
+/* Subscribe to the multicast group and start the multishot receive */
+static UA_StatusCode
+UA_PubSubChannelUDPUring_regist(UA_PubSubChannel *channel, UA_ExtensionObject *transportSettings,
+                                void (*callback)(UA_ByteString *encodedBuffer, UA_ByteString *topic)) {
+    UA_PubSubChannelDataUDPUring *channelData = (UA_PubSubChannelDataUDPUring *) channel->handle;
+    if(channelData->rxReady)
+        return UA_STATUSCODE_GOOD;
+
+    /* Bind to the group port on all addresses */
+    struct sockaddr_storage bindAddress;
+    memset(&bindAddress, 0, sizeof(bindAddress));
+    bindAddress.ss_family = channelData->groupAddress.ss_family;
+    if(bindAddress.ss_family == AF_INET) {
+        ((struct sockaddr_in *)&bindAddress)->sin_port =
+            ((struct sockaddr_in *)&channelData->groupAddress)->sin_port;
+        ((struct sockaddr_in *)&bindAddress)->sin_addr.s_addr = htonl(INADDR_ANY);
+    } else {
+        ((struct sockaddr_in6 *)&bindAddress)->sin6_port =
+            ((struct sockaddr_in6 *)&channelData->groupAddress)->sin6_port;
+        ((struct sockaddr_in6 *)&bindAddress)->sin6_addr = in6addr_any;
+    }
+    if(bind(channel->sockfd, (struct sockaddr*)&bindAddress, channelData->groupAddressLength) < 0) {
+        UA_LOG_ERROR(UA_Log_Stdout, UA_LOGCATEGORY_SERVER,
+                     "PubSub Connection regist failed. Cannot bind socket.");
+        return UA_STATUSCODE_BADINTERNALERROR;
+    }
+
+    if(isMulticast(&channelData->groupAddress)) {
+        int res;
+        if(channelData->groupAddress.ss_family == AF_INET) {
+            struct ip_mreqn groupRequest;
+            memset(&groupRequest, 0, sizeof(groupRequest));
+            groupRequest.imr_multiaddr = ((struct sockaddr_in *)&channelData->groupAddress)->sin_addr;
+            groupRequest.imr_address = channelData->interfaceAddress;
+            groupRequest.imr_ifindex = (int)channelData->interfaceIndex;
+            res = setsockopt(channel->sockfd, IPPROTO_IP, IP_ADD_MEMBERSHIP,
+                             &groupRequest, sizeof(groupRequest));
+        } else {
+            struct ipv6_mreq groupRequest;
+            groupRequest.ipv6mr_multiaddr = ((struct sockaddr_in6 *)&channelData->groupAddress)->sin6_addr;
+            groupRequest.ipv6mr_interface = channelData->interfaceIndex;
+            res = setsockopt(channel->sockfd, IPPROTO_IPV6, IPV6_ADD_MEMBERSHIP,
+                             &groupRequest, sizeof(groupRequest));
+        }
+        if(res < 0) {
+            UA_LOG_ERROR(UA_Log_Stdout, UA_LOGCATEGORY_SERVER,
+                         "PubSub Connection regist failed. Cannot join the group.");
+            return UA_STATUSCODE_BADINTERNALERROR;
+        }
+    }
+
+    UA_StatusCode retval = UA_PubSubChannelUDPUring_rxInit(channelData);
+    if(retval != UA_STATUSCODE_GOOD) {
+        UA_LOG_ERROR(UA_Log_Stdout, UA_LOGCATEGORY_SERVER,
+                     "PubSub io_uring: Cannot set up the receive ring");
+        return retval;
+    }
+    retval = UA_PubSubChannelUDPUring_rxArm(channel);
+    if(retval != UA_STATUSCODE_GOOD) {
+        UA_PubSubChannelUDPUring_rxCleanup(channelData);
+        return retval;
+    }
+    channel->state = (channel->state == UA_PUBSUB_CHANNEL_PUB) ?
+        UA_PUBSUB_CHANNEL_PUB_SUB : UA_PUBSUB_CHANNEL_SUB;
+    return UA_STATUSCODE_GOOD;
+}
+
+static UA_StatusCode
+UA_PubSubChannelUDPUring_unregist(UA_PubSubChannel *channel, UA_ExtensionObject *transportSettings) {
+    UA_PubSubChannelDataUDPUring *channelData = (UA_PubSubChannelDataUDPUring *) channel->handle;
+    if(!channelData->rxReady)
+        return UA_STATUSCODE_GOOD;
+    if(isMulticast(&channelData->groupAddress)) {
+        if(channelData->groupAddress.ss_family == AF_INET) {
+            struct ip_mreqn groupRequest;
+            memset(&groupRequest, 0, sizeof(groupRequest));
+            groupRequest.imr_multiaddr = ((struct sockaddr_in *)&channelData->groupAddress)->sin_addr;
+            groupRequest.imr_address = channelData->interfaceAddress;
+            groupRequest.imr_ifindex = (int)channelData->interfaceIndex;
+            setsockopt(channel->sockfd, IPPROTO_IP, IP_DROP_MEMBERSHIP, &groupRequest, sizeof(groupRequest));
+        } else {
+            struct ipv6_mreq groupRequest;
+            groupRequest.ipv6mr_multiaddr = ((struct sockaddr_in6 *)&channelData->groupAddress)->sin6_addr;
+            groupRequest.ipv6mr_interface = channelData->interfaceIndex;
+            setsockopt(channel->sockfd, IPPROTO_IPV6, IPV6_DROP_MEMBERSHIP, &groupRequest, sizeof(groupRequest));
+        }
+    }
+    UA_PubSubChannelUDPUring_rxCleanup(channelData);
+    channel->state = (channel->state == UA_PUBSUB_CHANNEL_PUB_SUB) ?
+        UA_PUBSUB_CHANNEL_PUB : UA_PUBSUB_CHANNEL_RDY;
+    return UA_STATUSCODE_GOOD;
+}
+
+/* Take the next datagram from the completion queue. The timeout is given in
+ * microseconds, like for the UDP-MP transport. */
+static UA_StatusCode
+UA_PubSubChannelUDPUring_receive(UA_PubSubChannel *channel, UA_ByteString *message,
+                                 UA_ExtensionObject *transportSettings, UA_UInt32 timeout) {
+    UA_PubSubChannelDataUDPUring *channelData = (UA_PubSubChannelDataUDPUring *) channel->handle;
+    if(!channelData->rxReady) {
+        UA_LOG_ERROR(UA_Log_Stdout, UA_LOGCATEGORY_SERVER,
+                     "PubSub Connection receive failed. Channel is not registered.");
+        message->length = 0;
+        return UA_STATUSCODE_BADINTERNALERROR;
+    }
+    if(!channelData->rxArmed && UA_PubSubChannelUDPUring_rxArm(channel) != UA_STATUSCODE_GOOD) {
+        message->length = 0;
+        return UA_STATUSCODE_BADINTERNALERROR;
+    }
+
+    struct io_uring_cqe *cqe = NULL;
+    int res = io_uring_peek_cqe(&channelData->rxRing, &cqe);
+    if(res != 0 && timeout > 0) {
+        struct __kernel_timespec ts;
+        ts.tv_sec = (long long)(timeout / 1000000);
+        ts.tv_nsec = (long long)(timeout % 1000000) * 1000;
+        res = io_uring_wait_cqe_timeout(&channelData->rxRing, &cqe, &ts);
+    }
+    if(res != 0) {
+        message->length = 0;
+        return (res == -ETIME || res == -EAGAIN) ?
+            UA_STATUSCODE_GOODNONCRITICALTIMEOUT : UA_STATUSCODE_BADINTERNALERROR;
+    }
+
+    /* The multishot receive ends on errors and when the buffers run out. It
+     * is re-armed with the next call. */
+    if(!(cqe->flags & IORING_CQE_F_MORE))
+        channelData->rxArmed = false;
+
+    if(cqe->res < 0 || !(cqe->flags & IORING_CQE_F_BUFFER)) {
+        UA_StatusCode retval = (cqe->res == -ENOBUFS) ?
+            UA_STATUSCODE_GOODNONCRITICALTIMEOUT : UA_STATUSCODE_BADINTERNALERROR;
+        io_uring_cqe_seen(&channelData->rxRing, cqe);
+        message->length = 0;
+        return retval;
+    }
+
+    unsigned short bid = (unsigned short)(cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+    UA_Byte *rxBuffer = &channelData->rxArea[(size_t)bid * channelData->slotSize];
+    size_t length = (size_t)cqe->res;
+    if(length > message->length) {
+        UA_LOG_WARNING(UA_Log_Stdout, UA_LOGCATEGORY_SERVER,
+                       "PubSub io_uring: Message truncated to the receive buffer");
+        length = message->length;
+    }
+    memcpy(message->data, rxBuffer, length);
+    message->length = length;
+
+    /* Hand the buffer back to the kernel */
+    io_uring_buf_ring_add(channelData->rxBufRing, rxBuffer, channelData->slotSize, bid,
+                          io_uring_buf_ring_mask(channelData->slots), 0);
+    io_uring_buf_ring_advance(channelData->rxBufRing, 1);
+    io_uring_cqe_seen(&channelData->rxRing, cqe);
+    return UA_STATUSCODE_GOOD;
+}
+
+/* Close the channel. Queued messages are sent before the ring is released.
+ * Waits for the submitted writes only, and at most
+ * UA_URING_CLOSE_TIMEOUT ms for each completion. The ring teardown
+ * cancels the writes that are still pending. */
+static UA_StatusCode
+UA_PubSubChannelUDPUring_close(UA_PubSubChannel *channel) {
+    UA_PubSubChannelDataUDPUring *channelData = (UA_PubSubChannelDataUDPUring *) channel->handle;
+    if(channelData->txReady) {
+        if(UA_PubSubChannelUDPUring_txFlush(channelData) != UA_STATUSCODE_GOOD)
+            UA_LOG_WARNING(UA_Log_Stdout, UA_LOGCATEGORY_SERVER,
+                           "PubSub io_uring: Queued messages are not sent on close");
+        UA_PubSubChannelUDPUring_txReap(channelData);
+        while(channelData->txInFlight > 0) {
+            struct io_uring_cqe *cqe;
+            struct __kernel_timespec ts;
+            ts.tv_sec = UA_URING_CLOSE_TIMEOUT / 1000;
+            ts.tv_nsec = (long long)(UA_URING_CLOSE_TIMEOUT % 1000) * 1000000;
+            if(io_uring_wait_cqe_timeout(&channelData->txRing, &cqe, &ts) < 0)
+                break;
+            UA_PubSubChannelUDPUring_txReap(channelData);
+        }
+        UA_PubSubChannelUDPUring_txCleanup(channelData);
+    }
+    UA_PubSubChannelUDPUring_rxCleanup(channelData);
+    UA_PubSubChannel_removeExtension(channel);
+    close(channel->sockfd);
+    UA_free(channelData);
+    UA_free(channel);
+    return UA_STATUSCODE_GOOD;
+}
+
+static UA_UInt64
+UA_PubSubChannelUDPUring_now(UA_PubSubChannel *channel) {
+    UA_PubSubChannelDataUDPUring *channelData = (UA_PubSubChannelDataUDPUring *) channel->handle;
+    struct timespec ts;
+    clock_gettime(channelData->txClock, &ts);
+    return (UA_UInt64)ts.tv_sec * 1000000000 + (UA_UInt64)ts.tv_nsec;
+}
+
+/* SO_TXTIME is enabled with the first launch time. The qdisc of the interface
+ * (etf for CLOCK_TAI, fq for CLOCK_MONOTONIC) holds the datagrams back. */
+static UA_StatusCode
+UA_PubSubChannelUDPUring_setLaunchTime(UA_PubSubChannel *channel, UA_UInt64 launchTime) {
+    UA_PubSubChannelDataUDPUring *channelData = (UA_PubSubChannelDataUDPUring *) channel->handle;
+    if(launchTime != 0 && !channelData->txTimeEnabled) {
+        if(!channelData->txReady && UA_PubSubChannelUDPUring_txInit(channelData) != UA_STATUSCODE_GOOD)
+            return UA_STATUSCODE_BADINTERNALERROR;
+        struct sock_txtime txTime;
+        memset(&txTime, 0, sizeof(txTime));
+        txTime.clockid = channelData->txClock;
+        if(setsockopt(channelData->txSocket, SOL_SOCKET, SO_TXTIME, &txTime, sizeof(txTime)) < 0) {
+            UA_LOG_ERROR(UA_Log_Stdout, UA_LOGCATEGORY_SERVER,
+                         "PubSub io_uring: Cannot enable SO_TXTIME");
+            return UA_STATUSCODE_BADNOTSUPPORTED;
+        }
+        channelData->txTimeEnabled = true;
+    }
+    channelData->launchTime = launchTime;
+    return UA_STATUSCODE_GOOD;
+}
+
+static const UA_PubSubChannelExtension UA_PubSubChannelUDPUring_extension = {
+    UA_PubSubChannelUDPUring_now,
+    UA_PubSubChannelUDPUring_setLaunchTime,
+    NULL,
+    UA_PubSubChannelUDPUring_sendNonBlocking,
+    UA_PubSubChannelUDPUring_acquireBuffer,
+    UA_PubSubChannelUDPUring_sendBuffer,
+    UA_PubSubChannelUDPUring_releaseBuffer
+};
+
+static UA_PubSubChannel *
+TransportLayerUDPUring_addChannel(UA_PubSubConnectionConfig *connectionConfig) {
+    UA_PubSubChannel *pubSubChannel = UA_PubSubChannelUDPUring_open(connectionConfig);
+    if(pubSubChannel) {
+        pubSubChannel->regist = UA_PubSubChannelUDPUring_regist;
+        pubSubChannel->unregist = UA_PubSubChannelUDPUring_unregist;
+        pubSubChannel->send = UA_PubSubChannelUDPUring_send;
+        pubSubChannel->receive = UA_PubSubChannelUDPUring_receive;
+        pubSubChannel->close = UA_PubSubChannelUDPUring_close;
+        pubSubChannel->yield = UA_PubSubChannelUDPUring_yield;
+        pubSubChannel->connectionConfig = connectionConfig;
+        if(UA_PubSubChannel_setExtension(pubSubChannel, &UA_PubSubChannelUDPUring_extension) !=
+           UA_STATUSCODE_GOOD) {
+            pubSubChannel->close(pubSubChannel);
+            return NULL;
+        }
+    }
+    return pubSubChannel;
+}
+
+UA_PubSubTransportLayer
+UA_PubSubTransportLayerUDPUring() {
+    UA_PubSubTransportLayer pubSubTransportLayer;
+    pubSubTransportLayer.transportProfileUri =
+        UA_STRING("http://opcfoundation.org/UA-Profile/Transport/pubsub-udp-uadp");
+    pubSubTransportLayer.createPubSubChannel = &TransportLayerUDPUring_addChannel;
+    return pubSubTransportLayer;
+}